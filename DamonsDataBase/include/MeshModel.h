@@ -48,6 +48,27 @@ namespace DMeshLib {
 		// @param : void  
 		//************************************ 
 		void build();
+		//************************************  
+		// @brief : set the triangles with their half-edge pairs, the half-edge
+		//			structure is filled directly without build()
+		// @return: void
+		// @param : triangles 3 point indices per triangle
+		// @param : pairs opposite of half-edge 3 * t + k (corner k to k + 1 of triangle t), -1 on the border
+		//************************************ 
+		void setTopology(const std::vector<index_type > &triangles, const std::vector<int > &pairs);
+		//************************************  
+		// @brief : replace the mesh by the isosurface of a scalar volume,
+		//			the half-edge structure is set by the extraction
+		// @return: false when the volume has less than 2 samples along an axis
+		// @param : volume nx * ny * nz samples, x varying fastest, inside is above iso
+		// @param : origin position of the first sample
+		// @param : spacing distance between samples along each axis
+		// @param : iso iso value
+		// @param : dualContouring dual contouring (sharp features) instead of marching cubes
+		// @param : closeBorder close the surface on the volume border
+		//************************************ 
+		bool extractIsoSurface(const float *volume, unsigned int nx, unsigned int ny, unsigned int nz, const data_type origin[3], const data_type spacing[3],
+			float iso, bool dualContouring = false, bool closeBorder = true);
 
 	public:
 		// Returns class ID
@@ -116,6 +137,14 @@ namespace DMeshLib {
 			m_meshIndex[i].point_ids[2] = id3;
 			m_meshIndex[i].id = i;
 		}
+		//************************************
+		// @brief : add a polygon face split into triangles turning as the face,
+		//			the face may be concave and have any number of points
+		// @return: number of triangles added
+		// @param : ids point indices of the face, the points must be added before
+		// @param : count number of indices
+		//************************************
+		unsigned int addPolygon(const index_type *ids, unsigned int count);
 		// add and set point normal value
 		void addPointNormal(data_type x, data_type y, data_type z) { m_meshPointNormals.push_back(DGraphic::DPoint<data_type>(x, y, z)); }
 		void addPointNormal(DGraphic::DPoint<data_type> p) { m_meshPointNormals.push_back(p); }
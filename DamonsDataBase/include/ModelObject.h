@@ -15,6 +15,7 @@
 #define CC_HIERARCH_BIT					0x00000000000001	//Hierarchical object
 #define CC_CLOUD_BIT					0x00000000000100	//Point Cloud
 #define CC_MESH_BIT						0x00000000000200	//Mesh
+#define CC_TETMESH_BIT					0x00000000000400	//Tetrahedral mesh
 
 namespace DMeshLib {
 
@@ -28,7 +29,8 @@ namespace DMeshLib {
 			OBJECT = 0,
 			HIERARCHY_OBJECT = CC_HIERARCH_BIT,
 			POINT_CLOUD = HIERARCHY_OBJECT | CC_CLOUD_BIT,
-			MESH = HIERARCHY_OBJECT | CC_MESH_BIT
+			MESH = HIERARCHY_OBJECT | CC_MESH_BIT,
+			TET_MESH = HIERARCHY_OBJECT | CC_TETMESH_BIT
 		};
 	}
 
@@ -75,7 +77,7 @@ namespace DMeshLib {
 	public:
 		ModelObject(std::string name = "");
 		ModelObject(const ModelObject& object);
-		~ModelObject();
+		virtual ~ModelObject();
 	public:
 		//! Changes unique ID
 		/** WARNING: HANDLE WITH CARE!
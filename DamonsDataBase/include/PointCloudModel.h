@@ -0,0 +1,316 @@
+#ifndef _POINTCLOUDMODEL_HEADER_
+#define _POINTCLOUDMODEL_HEADER_
+
+//////////////////////////////////////////////////////////////////////////
+#include "..\include\damons_db.h"
+#include "..\include\ModelObject.h"
+
+#include <string>
+#include <vector>
+#include <assert.h>
+
+namespace DMeshLib {
+
+	using cloud_type = float;
+	using color_type = unsigned char;
+
+	class MeshModel;
+	class TetMeshModel;
+
+	/*!
+	* \class PointScalarField
+	*
+	* \brief one named value per point
+	*/
+	struct PointScalarField {
+		std::string name;
+		std::vector<cloud_type > values;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	/*!
+	* \class PointCloudModel
+	*
+	* \brief point cloud model class, structure of arrays storage
+	*		 coordinates are one contiguous x,y,z array (12 bytes per point),
+	*		 normals/colors/intensity/scalar fields are optional arrays that
+	*		 are only allocated when enabled
+	*/
+	class DAMONS_DB_LIB_API PointCloudModel : public ModelObject {
+
+	protected:
+		// point coordinates x,y,z
+		std::vector<cloud_type > m_points;
+		// point normals nx,ny,nz (empty when the cloud has no normals)
+		std::vector<cloud_type > m_normals;
+		// point colors r,g,b (empty when the cloud has no colors)
+		std::vector<color_type > m_colors;
+		// point intensity (empty when the cloud has no intensity)
+		std::vector<cloud_type > m_intensity;
+		// other per point values
+		std::vector<PointScalarField > m_scalarFields;
+
+	public:
+		PointCloudModel(std::string name = "") :ModelObject((name.empty() ? "unnamed_cloud" : name)) {}
+		PointCloudModel(const PointCloudModel& object);
+		~PointCloudModel();
+
+	public:
+		// Returns class ID
+		inline DB_CLASS_ENUM getClassID() const override { return DB_TYPES::POINT_CLOUD; }
+		//************************************
+		// @brief : refresh current model boundbox, computed in parallel
+		// @return: void
+		// @param : void
+		//************************************
+		void refreshBoundBox()  override;
+
+		//************************************
+		// @brief : clone this cloud deep copy
+		// @return: the new cloud
+		// @param : _cloud the cloud to copy
+		//************************************
+		PointCloudModel * CloneCloud(PointCloudModel * _cloud);
+
+	public:
+		//************************************
+		// @brief : reserve memory for nbpt points in every enabled array
+		// @return: void
+		// @param : nbpt number of points
+		//************************************
+		void reserve(size_t nbpt);
+		//************************************
+		// @brief : resize every enabled array to nbpt points
+		// @return: void
+		// @param : nbpt number of points
+		//************************************
+		void resize(size_t nbpt);
+		//************************************
+		// @brief : release all the points and attributes
+		// @return: void
+		// @param : void
+		//************************************
+		void clear();
+		//************************************
+		// @brief : append many points at once, memory grows geometrically
+		//			enabled attribute arrays grow with the points, their new
+		//			values are zero unless given
+		// @return: void
+		// @param : xyz coordinates, 3 per point
+		// @param : count number of points
+		// @param : normals 3 per point, may be null
+		// @param : colors 3 per point, may be null
+		//************************************
+		void appendPoints(const cloud_type *xyz, size_t count, const cloud_type *normals = nullptr, const color_type *colors = nullptr);
+
+		// add and set point value, attribute arrays are not touched
+		void addPoint(cloud_type x, cloud_type y, cloud_type z) {
+			m_points.push_back(x);
+			m_points.push_back(y);
+			m_points.push_back(z);
+		}
+		void setPoint(size_t i, cloud_type x, cloud_type y, cloud_type z) {
+			assert(i < size());
+			m_points[3 * i] = x;
+			m_points[3 * i + 1] = y;
+			m_points[3 * i + 2] = z;
+		}
+		// add and set point normal value
+		void addPointNormal(cloud_type x, cloud_type y, cloud_type z) {
+			m_normals.push_back(x);
+			m_normals.push_back(y);
+			m_normals.push_back(z);
+		}
+		void setPointNormal(size_t i, cloud_type x, cloud_type y, cloud_type z) {
+			assert(3 * i + 2 < m_normals.size());
+			m_normals[3 * i] = x;
+			m_normals[3 * i + 1] = y;
+			m_normals[3 * i + 2] = z;
+		}
+		// add and set point color value
+		void addPointColor(color_type r, color_type g, color_type b) {
+			m_colors.push_back(r);
+			m_colors.push_back(g);
+			m_colors.push_back(b);
+		}
+		void setPointColor(size_t i, color_type r, color_type g, color_type b) {
+			assert(3 * i + 2 < m_colors.size());
+			m_colors[3 * i] = r;
+			m_colors[3 * i + 1] = g;
+			m_colors[3 * i + 2] = b;
+		}
+		// add and set point intensity value
+		void addPointIntensity(cloud_type v) { m_intensity.push_back(v); }
+		void setPointIntensity(size_t i, cloud_type v) {
+			assert(i < m_intensity.size());
+			m_intensity[i] = v;
+		}
+
+	public:
+		// enable optional attributes, arrays are sized to the current points
+		void enableNormals() { m_normals.resize(3 * size(), cloud_type(0)); }
+		void enableColors() { m_colors.resize(3 * size(), color_type(0)); }
+		void enableIntensity() { m_intensity.resize(size(), cloud_type(0)); }
+		// release optional attributes
+		void removeNormals() { std::vector<cloud_type >().swap(m_normals); }
+		void removeColors() { std::vector<color_type >().swap(m_colors); }
+		void removeIntensity() { std::vector<cloud_type >().swap(m_intensity); }
+
+		//************************************
+		// @brief : add a scalar field sized to the current points
+		//			if a field with this name exists it is returned
+		// @return: index of the field
+		// @param : name name of the field
+		//************************************
+		int addScalarField(const std::string &name);
+		//************************************
+		// @brief : find a scalar field by name
+		// @return: index of the field, -1 if not found
+		// @param : name name of the field
+		//************************************
+		int getScalarFieldIndex(const std::string &name) const;
+		// remove a scalar field
+		void removeScalarField(int index);
+		// get scalar fields
+		unsigned int getScalarFieldNumber() const { return static_cast<unsigned int>(m_scalarFields.size()); }
+		PointScalarField& getScalarField(int index) { assert(index < (int)m_scalarFields.size()); return m_scalarFields[index]; }
+		const PointScalarField& getScalarField(int index) const { assert(index < (int)m_scalarFields.size()); return m_scalarFields[index]; }
+
+	public:
+		//************************************
+		// @brief : estimate unoriented normals from the PCA of point neighborhoods
+		//			the normal array is enabled and overwritten
+		// @return: void
+		// @param : knn number of nearest neighbors (point included)
+		// @param : radius when > 0 neighbors within radius are used instead, at most knn of them if knn > 0
+		//************************************
+		void estimateNormals(unsigned int knn, cloud_type radius = 0);
+		//************************************
+		// @brief : orient the normals consistently by propagation along the
+		//			minimum spanning tree of the k nearest neighbors graph
+		// @return: number of connected parts of the cloud, 0 if it has no normals
+		// @param : knn number of neighbors of the graph
+		// @param : viewpoint sensor position used to seed each part, may be null (+z is used then)
+		//************************************
+		unsigned int orientNormals(unsigned int knn, const DGraphic::DPoint<data_type> *viewpoint = nullptr);
+		//************************************
+		// @brief : voxel grid subsampling, one point per occupied voxel with the
+		//			averaged normals, colors, intensity and scalar fields
+		// @return: the new cloud, owned by the caller
+		// @param : voxelSize edge length of the voxels
+		// @param : nearestToCenter keep the point closest to the voxel center instead of the centroid
+		//************************************
+		PointCloudModel *voxelDownsample(data_type voxelSize, bool nearestToCenter = false);
+		//************************************
+		// @brief : statistical outlier detection, a point is an outlier when the mean
+		//			distance to its knn neighbors exceeds the global mean + stdMul * sigma
+		// @return: number of points kept
+		// @param : knn number of neighbors
+		// @param : stdMul multiplier of the standard deviation
+		// @param : keep mask as return, 1 for the points to keep
+		//************************************
+		size_t statisticalOutlierMask(unsigned int knn, double stdMul, std::vector<unsigned char > &keep) const;
+		//************************************
+		// @brief : radius outlier detection, a point is an outlier when it has
+		//			fewer than minNeighbors other points within radius
+		// @return: number of points kept
+		// @param : radius search radius
+		// @param : minNeighbors neighbors needed to keep a point
+		// @param : keep mask as return, 1 for the points to keep
+		//************************************
+		size_t radiusOutlierMask(cloud_type radius, unsigned int minNeighbors, std::vector<unsigned char > &keep) const;
+		//************************************
+		// @brief : copy the points selected by a mask with all their attributes
+		// @return: the new cloud, owned by the caller
+		// @param : keep one entry per point, non zero to copy the point
+		//************************************
+		PointCloudModel *extractPoints(const std::vector<unsigned char > &keep) const;
+		//************************************
+		// @brief : screened Poisson surface reconstruction from the oriented normals
+		// @return: the mesh, owned by the caller, empty if the cloud has no normals
+		// @param : depth octree depth, the bounding cube is cut in 2^depth cells per axis
+		// @param : screening weight pulling the surface to the points, 0 for plain Poisson
+		//************************************
+		MeshModel *poissonReconstruct(unsigned int depth, double screening = 4.0) const;
+		//************************************
+		// @brief : 2.5D Delaunay triangulation of the points projected on the
+		//			xy plane, as for a terrain, the z of the points is kept
+		// @return: the mesh with its half-edges, owned by the caller
+		// @param : partitions strips triangulated in parallel, 0 for one per
+		//			thread, 1 for the serial triangulation
+		//************************************
+		MeshModel *delaunayTriangulate(unsigned int partitions = 0) const;
+		//************************************
+		// @brief : 3D Delaunay tetrahedralization of the points, duplicated
+		//			points are left out of the tetrahedra
+		// @return: the tetrahedral mesh with its neighbors, owned by the
+		//			caller, empty when the points are coplanar
+		// @param : void
+		//************************************
+		TetMeshModel *delaunayTetrahedralize() const;
+
+	public:
+		// get points numbers
+		size_t size() const { return m_points.size() / 3; }
+		unsigned int getPointsNumber() const { return static_cast<unsigned int>(size()); }
+		bool empty() const { return m_points.empty(); }
+		// get point
+		void getPoint(size_t index, cloud_type &x, cloud_type &y, cloud_type &z) const {
+			assert(index < size());
+			x = m_points[3 * index];
+			y = m_points[3 * index + 1];
+			z = m_points[3 * index + 2];
+		}
+		DGraphic::DPoint<data_type> getPoint(size_t index) const {
+			assert(index < size());
+			return DGraphic::DPoint<data_type>(m_points[3 * index], m_points[3 * index + 1], m_points[3 * index + 2]);
+		}
+		// get point normal
+		void getPointNormal(size_t index, cloud_type &x, cloud_type &y, cloud_type &z) const {
+			assert(3 * index + 2 < m_normals.size());
+			x = m_normals[3 * index];
+			y = m_normals[3 * index + 1];
+			z = m_normals[3 * index + 2];
+		}
+		// get point color
+		void getPointColor(size_t index, color_type &r, color_type &g, color_type &b) const {
+			assert(3 * index + 2 < m_colors.size());
+			r = m_colors[3 * index];
+			g = m_colors[3 * index + 1];
+			b = m_colors[3 * index + 2];
+		}
+		// get point intensity
+		cloud_type getPointIntensity(size_t index) const {
+			assert(index < m_intensity.size());
+			return m_intensity[index];
+		}
+
+		// raw arrays, 3 values per point for points, normals and colors
+		cloud_type* getPointData() { return m_points.data(); }
+		const cloud_type* getPointData() const { return m_points.data(); }
+		cloud_type* getNormalData() { return m_normals.data(); }
+		const cloud_type* getNormalData() const { return m_normals.data(); }
+		color_type* getColorData() { return m_colors.data(); }
+		const color_type* getColorData() const { return m_colors.data(); }
+		cloud_type* getIntensityData() { return m_intensity.data(); }
+		const cloud_type* getIntensityData() const { return m_intensity.data(); }
+
+	public:
+		//************************************
+		// @brief : whether this cloud has the attribute for every point
+		// @return: bool
+		// @param : void
+		//************************************
+		bool hasPointNormals() const {
+			return !m_normals.empty() && m_normals.size() == m_points.size();
+		}
+		bool hasPointColors() const {
+			return !m_colors.empty() && m_colors.size() == m_points.size();
+		}
+		bool hasPointIntensity() const {
+			return !m_intensity.empty() && 3 * m_intensity.size() == m_points.size();
+		}
+	};
+}
+
+#endif
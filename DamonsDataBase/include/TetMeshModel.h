@@ -0,0 +1,160 @@
+#ifndef _TETMESHMODEL_HEADER_
+#define _TETMESHMODEL_HEADER_
+
+//////////////////////////////////////////////////////////////////////////
+#include "..\include\damons_db.h"
+#include "..\include\ModelObject.h"
+
+#include <vector>
+#include <assert.h>
+
+namespace DMeshLib {
+
+	//////////////////////////////////////////////////////////////////////////
+	/*!
+	* \class TetMeshModel
+	*
+	* \brief tetrahedral mesh model class, structure of arrays storage
+	*		 coordinates are one contiguous x,y,z array, tetrahedra are 4
+	*		 point indices each and their neighbors 4 tetrahedron indices
+	*		 each, the neighbor k being across the face opposite to corner k
+	*/
+	class DAMONS_DB_LIB_API TetMeshModel : public ModelObject {
+
+	protected:
+		// point coordinates x,y,z
+		std::vector<data_type > m_points;
+		// tetrahedra, 4 point indices each
+		std::vector<index_type > m_tets;
+		// neighbors, 4 per tetrahedron, -1 on the border (empty when unknown)
+		std::vector<int > m_neighbors;
+
+	public:
+		TetMeshModel(std::string name = "") :ModelObject((name.empty() ? "unnamed_tetmesh" : name)) {}
+		TetMeshModel(const TetMeshModel& object);
+		~TetMeshModel();
+
+	public:
+		// Returns class ID
+		inline DB_CLASS_ENUM getClassID() const override { return DB_TYPES::TET_MESH; }
+		//************************************
+		// @brief : refresh current model boundbox
+		// @return: void
+		// @param : void
+		//************************************
+		void refreshBoundBox()  override;
+
+		//************************************
+		// @brief : clone this tetrahedral mesh deep copy
+		// @return: the new mesh
+		// @param : _mesh the mesh to copy
+		//************************************
+		TetMeshModel * CloneTetMesh(TetMeshModel * _mesh);
+
+	public:
+		//************************************
+		// @brief : reserve memory for points and tetrahedra
+		// @return: void
+		// @param : nbpt number of points
+		// @param : nbtet number of tetrahedra
+		//************************************
+		void reserve(size_t nbpt, size_t nbtet);
+		//************************************
+		// @brief : release all the points and tetrahedra
+		// @return: void
+		// @param : void
+		//************************************
+		void clear();
+		//************************************
+		// @brief : set the tetrahedra with their neighbors, the neighbors
+		//			are dropped if their size does not match
+		// @return: void
+		// @param : tets 4 point indices per tetrahedron, moved from when given as rvalue
+		// @param : neighbors 4 tetrahedra per tetrahedron, -1 on the border
+		//************************************
+		void setTopology(std::vector<index_type > tets, std::vector<int > neighbors);
+
+		// resize container size, new neighbors are -1
+		void ResizePoints(size_t nbpt) { m_points.resize(3 * nbpt); }
+		void ResizeTets(size_t nbtet) {
+			m_tets.resize(4 * nbtet);
+			if (!m_neighbors.empty())
+				m_neighbors.resize(4 * nbtet, -1);
+		}
+		// add and set point value
+		void addPoint(data_type x, data_type y, data_type z) {
+			m_points.push_back(x);
+			m_points.push_back(y);
+			m_points.push_back(z);
+		}
+		void setPoint(size_t i, data_type x, data_type y, data_type z) {
+			assert(i < getPointsNumber());
+			m_points[3 * i] = x;
+			m_points[3 * i + 1] = y;
+			m_points[3 * i + 2] = z;
+		}
+		// add and set tetrahedron value, the neighbors of a new tetrahedron are -1
+		void addTet(index_type id1, index_type id2, index_type id3, index_type id4) {
+			const index_type ids[4] = { id1, id2, id3, id4 };
+			m_tets.insert(m_tets.end(), ids, ids + 4);
+			if (!m_neighbors.empty())
+				m_neighbors.resize(m_tets.size(), -1);
+		}
+		void setTet(size_t i, index_type id1, index_type id2, index_type id3, index_type id4) {
+			assert(i < getTetNumber());
+			m_tets[4 * i] = id1;
+			m_tets[4 * i + 1] = id2;
+			m_tets[4 * i + 2] = id3;
+			m_tets[4 * i + 3] = id4;
+		}
+
+	public:
+		// get points numbers
+		size_t getPointsNumber() const { return m_points.size() / 3; }
+		// get tetrahedra numbers
+		size_t getTetNumber() const { return m_tets.size() / 4; }
+		// get point
+		void getPoint(size_t index, data_type &x, data_type &y, data_type &z) const {
+			assert(index < getPointsNumber());
+			x = m_points[3 * index];
+			y = m_points[3 * index + 1];
+			z = m_points[3 * index + 2];
+		}
+		const data_type *getPoint(size_t index) const {
+			assert(index < getPointsNumber());
+			return &m_points[3 * index];
+		}
+		// get tetrahedron
+		void getTet(size_t index, index_type &id1, index_type &id2, index_type &id3, index_type &id4) const {
+			assert(index < getTetNumber());
+			id1 = m_tets[4 * index];
+			id2 = m_tets[4 * index + 1];
+			id3 = m_tets[4 * index + 2];
+			id4 = m_tets[4 * index + 3];
+		}
+		const index_type *getTet(size_t index) const {
+			assert(index < getTetNumber());
+			return &m_tets[4 * index];
+		}
+		// get the tetrahedron across the face opposite to corner k, -1 on the border
+		int getNeighbor(size_t index, int k) const {
+			assert(index < getTetNumber() && k >= 0 && k < 4);
+			return m_neighbors.empty() ? -1 : m_neighbors[4 * index + k];
+		}
+		bool hasNeighbors() const { return !m_neighbors.empty(); }
+		//************************************
+		// @brief : signed volume of a tetrahedron, positive when the fourth
+		//			point is below the plane of the first three seen counter clockwise
+		// @return: the volume
+		// @param : index tetrahedron
+		//************************************
+		data_type getTetVolume(size_t index) const;
+
+		// raw arrays, 3 values per point, 4 per tetrahedron for the indices and the neighbors
+		data_type* getPointData() { return m_points.data(); }
+		const data_type* getPointData() const { return m_points.data(); }
+		const index_type* getTetData() const { return m_tets.data(); }
+		const int* getNeighborData() const { return m_neighbors.data(); }
+	};
+};
+#endif
@@ -1,4 +1,7 @@
 #include "..\include\MeshModel.h"
+#include "..\..\DamonsMath\include\DamonsParallel.h"
+#include "..\..\DamonsMath\include\DamonsIsoSurface.h"
+#include "..\..\DamonsMath\include\DamonsPolygonTriangulator.h"
 #include <algorithm>
 #include <assert.h>
 
@@ -131,4 +134,99 @@ namespace DMeshLib {
 			std::vector<int >().swap(curedges);
 		}
 	}
+
+	void MeshModel::setTopology(const std::vector<index_type > &triangles, const std::vector<int > &pairs) {
+		assert(pairs.size() == triangles.size());
+		const size_t nt = triangles.size() / 3;
+		m_edgePairs.clear();
+		m_meshIndex.resize(nt);
+		m_halfedges.assign(3 * nt, DamonsHalfEdge());
+
+		DMath::ParallelFor(0, nt, [&](size_t f) {
+			DamonsFace &face = m_meshIndex[f];
+			face.id = static_cast<int>(f);
+			face.edge = static_cast<int>(3 * f);
+			face.point_ids.assign(triangles.begin() + 3 * f, triangles.begin() + 3 * f + 3);
+			for (int k = 0; k < 3; ++k) {
+				DamonsHalfEdge &he = m_halfedges[3 * f + k];
+				he.start_vert = static_cast<int>(triangles[3 * f + k]);
+				he.face = static_cast<int>(f);
+				he.pair = pairs[3 * f + k];
+				he.next = static_cast<int>(3 * f + (k + 1) % 3);
+				he.prev = static_cast<int>(3 * f + (k + 2) % 3);
+			}
+		}, 1 << 12);
+
+		// border half-edges have no face, as in build()
+		for (size_t h = 0; h < 3 * nt; ++h) {
+			if (m_halfedges[h].pair >= 0)
+				continue;
+			DamonsHalfEdge he;
+			he.start_vert = static_cast<int>(triangles[h - h % 3 + (h % 3 + 1) % 3]);
+			he.pair = static_cast<int>(h);
+			m_halfedges[h].pair = static_cast<int>(m_halfedges.size());
+			m_halfedges.push_back(he);
+		}
+		for (size_t h = 0; h < 3 * nt; ++h)
+			m_meshPoints[triangles[h]].edge_out = static_cast<int>(h);
+	}
+
+	unsigned int MeshModel::addPolygon(const index_type *ids, unsigned int count) {
+		if (count < 3)
+			return 0;
+		if (count == 3) {
+			addTriangle(ids[0], ids[1], ids[2]);
+			return 1;
+		}
+
+		// a face on points not read yet can only be cut as a fan
+		std::vector<data_type > coords(3 * count);
+		for (unsigned int i = 0; i < count; ++i) {
+			if (ids[i] >= m_meshPoints.size()) {
+				for (unsigned int k = 2; k < count; ++k)
+					addTriangle(ids[0], ids[k - 1], ids[k]);
+				return count - 2;
+			}
+			const DamonsVertex &p = m_meshPoints[ids[i]];
+			coords[3 * i] = p.x;
+			coords[3 * i + 1] = p.y;
+			coords[3 * i + 2] = p.z;
+		}
+
+		DGraphic::DPolygonTriangulator<data_type> triangulator;
+		std::vector<unsigned int > triangles;
+		const size_t n = triangulator.TriangulateFace(coords.data(), count, triangles);
+		for (size_t t = 0; t < n; ++t)
+			addTriangle(ids[triangles[3 * t]], ids[triangles[3 * t + 1]], ids[triangles[3 * t + 2]]);
+		return static_cast<unsigned int>(n);
+	}
+
+	bool MeshModel::extractIsoSurface(const float *volume, unsigned int nx, unsigned int ny, unsigned int nz, const data_type origin[3], const data_type spacing[3],
+		float iso, bool dualContouring, bool closeBorder) {
+		typedef DGraphic::DIsoSurfaceExtractor<float> Extractor;
+		Extractor extractor(volume, nx, ny, nz, origin, spacing);
+		Extractor::Parameters params;
+		params.mode = dualContouring ? Extractor::EXTRACT_DUAL_CONTOURING : Extractor::EXTRACT_MARCHING_CUBES;
+		params.closeBorder = closeBorder;
+		std::vector<float > vertices;
+		std::vector<index_type > triangles;
+		if (!extractor.Extract(iso, params, vertices, triangles))
+			return false;
+
+		const size_t nv = vertices.size() / 3;
+		m_meshPoints.resize(nv);
+		DMath::ParallelFor(0, nv, [&](size_t i) {
+			setPoint(static_cast<unsigned int>(i), vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+		}, 1 << 14);
+		m_meshPointNormals.clear();
+		m_meshFaceNormals.clear();
+
+		std::vector<int > pairs;
+		Extractor::HalfEdgePairs(triangles, pairs);
+		setTopology(triangles, pairs);
+
+		m_box = DGraphic::DBox<data_type>();
+		refreshBoundBox();
+		return true;
+	}
 };
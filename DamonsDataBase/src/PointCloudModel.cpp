@@ -0,0 +1,384 @@
+#include "..\include\PointCloudModel.h"
+#include "..\include\MeshModel.h"
+#include "..\include\TetMeshModel.h"
+#include "..\..\DamonsMath\include\DamonsParallel.h"
+#include "..\..\DamonsMath\include\DamonsKdTree.h"
+#include "..\..\DamonsMath\include\DamonsNormals.h"
+#include "..\..\DamonsMath\include\DamonsNormalOrient.h"
+#include "..\..\DamonsMath\include\DamonsVoxelFilter.h"
+#include "..\..\DamonsMath\include\DamonsOutlierFilter.h"
+#include "..\..\DamonsMath\include\DamonsPoisson.h"
+#include "..\..\DamonsMath\include\DamonsIsoSurface.h"
+#include "..\..\DamonsMath\include\DamonsDelaunay.h"
+#include "..\..\DamonsMath\include\DamonsDelaunay3D.h"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+//////////////////////////////////////////////////////////////////////////
+namespace DMeshLib {
+
+	PointCloudModel::PointCloudModel(const PointCloudModel& object) : ModelObject(object)
+		, m_points(object.m_points)
+		, m_normals(object.m_normals)
+		, m_colors(object.m_colors)
+		, m_intensity(object.m_intensity)
+		, m_scalarFields(object.m_scalarFields)
+	{
+		m_box = object.m_box;
+	}
+
+	PointCloudModel::~PointCloudModel() {
+		clear();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
+	PointCloudModel * PointCloudModel::CloneCloud(PointCloudModel *_cloud) {
+		assert(_cloud);
+
+		PointCloudModel *pc = new PointCloudModel(*_cloud);
+		return pc;
+	}
+
+	void PointCloudModel::refreshBoundBox() {
+		const size_t n = size();
+		m_box = DGraphic::DBox<data_type>();
+		if (n == 0)
+			return;
+
+		// one partial box per thread, merged afterwards
+		const unsigned int nthreads = DMath::ParallelThreadCount();
+		std::vector<cloud_type > lo(3 * nthreads, std::numeric_limits<cloud_type>::max());
+		std::vector<cloud_type > hi(3 * nthreads, std::numeric_limits<cloud_type>::lowest());
+		const cloud_type *pts = m_points.data();
+
+		DMath::ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+			cloud_type *l = &lo[3 * tid];
+			cloud_type *h = &hi[3 * tid];
+			for (size_t i = b; i < e; ++i) {
+				const cloud_type *p = pts + 3 * i;
+				for (int a = 0; a < 3; ++a) {
+					l[a] = std::min(l[a], p[a]);
+					h[a] = std::max(h[a], p[a]);
+				}
+			}
+		}, 1 << 16);
+
+		for (unsigned int t = 0; t < nthreads; ++t) {
+			if (lo[3 * t] > hi[3 * t])
+				continue;
+			m_box.ExtendBox(DGraphic::DPoint<data_type>(lo[3 * t], lo[3 * t + 1], lo[3 * t + 2]));
+			m_box.ExtendBox(DGraphic::DPoint<data_type>(hi[3 * t], hi[3 * t + 1], hi[3 * t + 2]));
+		}
+	}
+
+	void PointCloudModel::reserve(size_t nbpt) {
+		m_points.reserve(3 * nbpt);
+		if (!m_normals.empty())
+			m_normals.reserve(3 * nbpt);
+		if (!m_colors.empty())
+			m_colors.reserve(3 * nbpt);
+		if (!m_intensity.empty())
+			m_intensity.reserve(nbpt);
+		for (auto &sf : m_scalarFields)
+			sf.values.reserve(nbpt);
+	}
+
+	void PointCloudModel::resize(size_t nbpt) {
+		m_points.resize(3 * nbpt);
+		if (!m_normals.empty())
+			m_normals.resize(3 * nbpt);
+		if (!m_colors.empty())
+			m_colors.resize(3 * nbpt);
+		if (!m_intensity.empty())
+			m_intensity.resize(nbpt);
+		for (auto &sf : m_scalarFields)
+			sf.values.resize(nbpt);
+	}
+
+	void PointCloudModel::clear() {
+		std::vector<cloud_type >().swap(m_points);
+		std::vector<cloud_type >().swap(m_normals);
+		std::vector<color_type >().swap(m_colors);
+		std::vector<cloud_type >().swap(m_intensity);
+		std::vector<PointScalarField >().swap(m_scalarFields);
+	}
+
+	void PointCloudModel::appendPoints(const cloud_type *xyz, size_t count, const cloud_type *normals, const color_type *colors) {
+		if (count == 0)
+			return;
+		const size_t old = size();
+		const size_t need = old + count;
+		// grow geometrically so repeated small appends stay linear
+		if (3 * need > m_points.capacity())
+			reserve(std::max(need, 2 * old));
+
+		m_points.insert(m_points.end(), xyz, xyz + 3 * count);
+
+		if (normals) {
+			if (m_normals.size() < 3 * old)
+				m_normals.resize(3 * old, cloud_type(0));
+			m_normals.insert(m_normals.end(), normals, normals + 3 * count);
+		}
+		else if (!m_normals.empty())
+			m_normals.resize(3 * need, cloud_type(0));
+
+		if (colors) {
+			if (m_colors.size() < 3 * old)
+				m_colors.resize(3 * old, color_type(0));
+			m_colors.insert(m_colors.end(), colors, colors + 3 * count);
+		}
+		else if (!m_colors.empty())
+			m_colors.resize(3 * need, color_type(0));
+
+		if (!m_intensity.empty())
+			m_intensity.resize(need, cloud_type(0));
+		for (auto &sf : m_scalarFields)
+			sf.values.resize(need, cloud_type(0));
+	}
+
+	int PointCloudModel::addScalarField(const std::string &name) {
+		int index = getScalarFieldIndex(name);
+		if (index >= 0)
+			return index;
+
+		PointScalarField sf;
+		sf.name = name;
+		sf.values.resize(size(), cloud_type(0));
+		m_scalarFields.push_back(sf);
+		return static_cast<int>(m_scalarFields.size()) - 1;
+	}
+
+	int PointCloudModel::getScalarFieldIndex(const std::string &name) const {
+		for (size_t i = 0; i < m_scalarFields.size(); ++i) {
+			if (m_scalarFields[i].name == name)
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	void PointCloudModel::removeScalarField(int index) {
+		if (index < 0 || index >= static_cast<int>(m_scalarFields.size()))
+			return;
+		m_scalarFields.erase(m_scalarFields.begin() + index);
+	}
+
+	void PointCloudModel::estimateNormals(unsigned int knn, cloud_type radius) {
+		enableNormals();
+		if (empty())
+			return;
+
+		DGraphic::DKdTree<cloud_type> tree(m_points.data(), size());
+		DGraphic::DNormalEstimator<cloud_type> estimator(m_points.data(), tree);
+		if (radius > 0)
+			estimator.EstimateRadius(radius, m_normals.data(), nullptr, knn);
+		else
+			estimator.EstimateKnn(knn, m_normals.data());
+	}
+
+	unsigned int PointCloudModel::orientNormals(unsigned int knn, const DGraphic::DPoint<data_type> *viewpoint) {
+		if (empty() || !hasPointNormals())
+			return 0;
+
+		DGraphic::DKdTree<cloud_type> tree(m_points.data(), size());
+		DGraphic::DNormalOrienter<cloud_type> orienter(m_points.data(), tree);
+		if (viewpoint) {
+			const cloud_type vp[3] = { static_cast<cloud_type>(viewpoint->x()), static_cast<cloud_type>(viewpoint->y()), static_cast<cloud_type>(viewpoint->z()) };
+			return orienter.Orient(knn, m_normals.data(), vp);
+		}
+		return orienter.Orient(knn, m_normals.data());
+	}
+
+	PointCloudModel *PointCloudModel::voxelDownsample(data_type voxelSize, bool nearestToCenter) {
+		PointCloudModel *out = new PointCloudModel(getName() + "_subsampled");
+		if (empty() || voxelSize <= 0)
+			return out;
+
+		refreshBoundBox();
+		typedef DGraphic::DVoxelDownsampler<cloud_type> Downsampler;
+		Downsampler sampler(m_box, voxelSize, nearestToCenter ? Downsampler::SAMPLE_NEAREST_CENTER : Downsampler::SAMPLE_CENTROID);
+
+		// intensity is averaged as one more scalar
+		const bool normals = hasPointNormals();
+		const bool colors = hasPointColors();
+		const bool intensity = hasPointIntensity();
+		std::vector<const cloud_type * > scalars;
+		if (intensity)
+			scalars.push_back(m_intensity.data());
+		for (auto &sf : m_scalarFields)
+			scalars.push_back(sf.values.data());
+		sampler.SetAttributes(normals, colors, static_cast<unsigned int>(scalars.size()));
+
+		// chunks bound the temporary key arrays
+		const size_t chunk = size_t(1) << 22;
+		std::vector<const cloud_type * > sfChunk(scalars.size());
+		for (size_t b = 0; b < size(); b += chunk) {
+			const size_t count = std::min(chunk, size() - b);
+			for (size_t s = 0; s < scalars.size(); ++s)
+				sfChunk[s] = scalars[s] + b;
+			sampler.AddPoints(&m_points[3 * b], count, normals ? &m_normals[3 * b] : nullptr, colors ? &m_colors[3 * b] : nullptr, sfChunk.empty() ? nullptr : sfChunk.data());
+		}
+
+		std::vector< std::vector<cloud_type > > sfValues;
+		sampler.GetResult(out->m_points, normals ? &out->m_normals : nullptr, colors ? &out->m_colors : nullptr, &sfValues);
+		size_t s = 0;
+		if (intensity)
+			out->m_intensity.swap(sfValues[s++]);
+		for (auto &sf : m_scalarFields) {
+			PointScalarField field;
+			field.name = sf.name;
+			field.values.swap(sfValues[s++]);
+			out->m_scalarFields.push_back(field);
+		}
+		out->refreshBoundBox();
+		return out;
+	}
+
+	size_t PointCloudModel::statisticalOutlierMask(unsigned int knn, double stdMul, std::vector<unsigned char > &keep) const {
+		DGraphic::DKdTree<cloud_type> tree(m_points.data(), size());
+		DGraphic::DOutlierFilter<cloud_type> filter(tree);
+		return filter.Statistical(knn, stdMul, keep);
+	}
+
+	size_t PointCloudModel::radiusOutlierMask(cloud_type radius, unsigned int minNeighbors, std::vector<unsigned char > &keep) const {
+		DGraphic::DKdTree<cloud_type> tree(m_points.data(), size());
+		DGraphic::DOutlierFilter<cloud_type> filter(tree);
+		return filter.Radius(radius, minNeighbors, keep);
+	}
+
+	PointCloudModel *PointCloudModel::extractPoints(const std::vector<unsigned char > &keep) const {
+		assert(keep.size() == size());
+		const size_t n = size();
+
+		// destination of every kept point
+		std::vector<size_t > dst(n);
+		size_t count = 0;
+		for (size_t i = 0; i < n; ++i) {
+			dst[i] = count;
+			count += keep[i] ? 1 : 0;
+		}
+
+		PointCloudModel *out = new PointCloudModel(getName() + "_extract");
+		out->m_points.resize(3 * count);
+		if (hasPointNormals())
+			out->m_normals.resize(3 * count);
+		if (hasPointColors())
+			out->m_colors.resize(3 * count);
+		if (hasPointIntensity())
+			out->m_intensity.resize(count);
+		out->m_scalarFields.resize(m_scalarFields.size());
+		for (size_t s = 0; s < m_scalarFields.size(); ++s) {
+			out->m_scalarFields[s].name = m_scalarFields[s].name;
+			out->m_scalarFields[s].values.resize(count);
+		}
+
+		DMath::ParallelFor(0, n, [&](size_t i) {
+			if (!keep[i])
+				return;
+			const size_t j = dst[i];
+			for (int a = 0; a < 3; ++a)
+				out->m_points[3 * j + a] = m_points[3 * i + a];
+			if (!out->m_normals.empty()) {
+				for (int a = 0; a < 3; ++a)
+					out->m_normals[3 * j + a] = m_normals[3 * i + a];
+			}
+			if (!out->m_colors.empty()) {
+				for (int a = 0; a < 3; ++a)
+					out->m_colors[3 * j + a] = m_colors[3 * i + a];
+			}
+			if (!out->m_intensity.empty())
+				out->m_intensity[j] = m_intensity[i];
+			for (size_t s = 0; s < m_scalarFields.size(); ++s)
+				out->m_scalarFields[s].values[j] = m_scalarFields[s].values[i];
+		}, 1 << 14);
+
+		out->refreshBoundBox();
+		return out;
+	}
+
+	MeshModel *PointCloudModel::poissonReconstruct(unsigned int depth, double screening) const {
+		MeshModel *mesh = new MeshModel(getName() + "_poisson");
+		if (empty() || !hasPointNormals())
+			return mesh;
+
+		DGraphic::DPoissonReconstruction<cloud_type> poisson(m_points.data(), m_normals.data(), size());
+		DGraphic::DPoissonReconstruction<cloud_type>::Parameters params;
+		params.depth = depth;
+		params.screening = screening;
+		std::vector<cloud_type > vertices;
+		std::vector<unsigned int > triangles;
+		if (!poisson.Reconstruct(params, vertices, triangles))
+			return mesh;
+
+		const size_t nv = vertices.size() / 3;
+		mesh->ResizePoints(static_cast<unsigned int>(nv));
+		DMath::ParallelFor(0, nv, [&](size_t i) {
+			mesh->setPoint(static_cast<unsigned int>(i), vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+		}, 1 << 14);
+		std::vector<cloud_type >().swap(vertices);
+
+		std::vector<int > pairs;
+		DGraphic::DIsoSurfaceExtractor<cloud_type>::HalfEdgePairs(triangles, pairs);
+		mesh->setTopology(triangles, pairs);
+		mesh->refreshBoundBox();
+		return mesh;
+	}
+
+	MeshModel *PointCloudModel::delaunayTriangulate(unsigned int partitions) const {
+		MeshModel *mesh = new MeshModel(getName() + "_delaunay");
+		if (size() < 3)
+			return mesh;
+
+		DDelaunay<cloud_type> delaunay;
+		delaunay.SetPoints(m_points.data(), size(), 3);
+		if (partitions == 1)
+			delaunay.DelaunayTriangulate();
+		else
+			delaunay.ParallelDelaunayTriangulate(partitions);
+
+		mesh->ResizePoints(static_cast<unsigned int>(size()));
+		DMath::ParallelFor(0, size(), [&](size_t i) {
+			mesh->setPoint(static_cast<unsigned int>(i), m_points[3 * i], m_points[3 * i + 1], m_points[3 * i + 2]);
+		}, 1 << 14);
+
+		const size_t nt = delaunay.GetTriangleCount();
+		std::vector<unsigned int > triangles(3 * nt);
+		DMath::ParallelFor(0, nt, [&](size_t t) {
+			delaunay.GetTriangle(t, triangles[3 * t], triangles[3 * t + 1], triangles[3 * t + 2]);
+		}, 1 << 14);
+		// the half-edge pairs come from the triangle neighbors, no edge sort
+		std::vector<int > pairs;
+		delaunay.GetHalfEdgePairs(pairs);
+		mesh->setTopology(triangles, pairs);
+		mesh->refreshBoundBox();
+		return mesh;
+	}
+
+	TetMeshModel *PointCloudModel::delaunayTetrahedralize() const {
+		TetMeshModel *tetmesh = new TetMeshModel(getName() + "_tetrahedra");
+		if (size() < 4)
+			return tetmesh;
+
+		DDelaunay3D<cloud_type> delaunay;
+		delaunay.SetPoints(m_points.data(), size(), 3);
+		delaunay.DelaunayTetrahedralize();
+
+		tetmesh->ResizePoints(size());
+		DMath::ParallelFor(0, size(), [&](size_t i) {
+			tetmesh->setPoint(i, m_points[3 * i], m_points[3 * i + 1], m_points[3 * i + 2]);
+		}, 1 << 14);
+
+		const size_t nt = delaunay.GetTetCount();
+		std::vector<index_type > tets(4 * nt);
+		std::vector<int > neighbors(4 * nt);
+		DMath::ParallelFor(0, nt, [&](size_t t) {
+			delaunay.GetTet(t, tets[4 * t], tets[4 * t + 1], tets[4 * t + 2], tets[4 * t + 3]);
+			for (int k = 0; k < 4; ++k)
+				neighbors[4 * t + k] = delaunay.GetNeighbor(t, k);
+		}, 1 << 14);
+		tetmesh->setTopology(std::move(tets), std::move(neighbors));
+		tetmesh->refreshBoundBox();
+		return tetmesh;
+	}
+}
@@ -0,0 +1,91 @@
+#include "..\include\TetMeshModel.h"
+#include "..\..\DamonsMath\include\DamonsParallel.h"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+//////////////////////////////////////////////////////////////////////////
+namespace DMeshLib {
+
+	TetMeshModel::TetMeshModel(const TetMeshModel& object) : ModelObject(object)
+		, m_points(object.m_points)
+		, m_tets(object.m_tets)
+		, m_neighbors(object.m_neighbors)
+	{
+		m_box = object.m_box;
+	}
+
+	TetMeshModel::~TetMeshModel() {
+		clear();
+	}
+
+	TetMeshModel * TetMeshModel::CloneTetMesh(TetMeshModel *_mesh) {
+		assert(_mesh);
+
+		TetMeshModel *tm = new TetMeshModel(*_mesh);
+		return tm;
+	}
+
+	void TetMeshModel::refreshBoundBox() {
+		const size_t n = getPointsNumber();
+		m_box = DGraphic::DBox<data_type>();
+		if (n == 0)
+			return;
+
+		// one partial box per thread, merged afterwards
+		const unsigned int nthreads = DMath::ParallelThreadCount();
+		std::vector<data_type > lo(3 * nthreads, std::numeric_limits<data_type>::max());
+		std::vector<data_type > hi(3 * nthreads, std::numeric_limits<data_type>::lowest());
+		const data_type *pts = m_points.data();
+
+		DMath::ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+			data_type *l = &lo[3 * tid];
+			data_type *h = &hi[3 * tid];
+			for (size_t i = b; i < e; ++i) {
+				const data_type *p = pts + 3 * i;
+				for (int a = 0; a < 3; ++a) {
+					l[a] = std::min(l[a], p[a]);
+					h[a] = std::max(h[a], p[a]);
+				}
+			}
+		}, 1 << 16);
+
+		for (unsigned int t = 0; t < nthreads; ++t) {
+			if (lo[3 * t] > hi[3 * t])
+				continue;
+			m_box.ExtendBox(DGraphic::DPoint<data_type>(lo[3 * t], lo[3 * t + 1], lo[3 * t + 2]));
+			m_box.ExtendBox(DGraphic::DPoint<data_type>(hi[3 * t], hi[3 * t + 1], hi[3 * t + 2]));
+		}
+	}
+
+	void TetMeshModel::reserve(size_t nbpt, size_t nbtet) {
+		m_points.reserve(3 * nbpt);
+		m_tets.reserve(4 * nbtet);
+		if (!m_neighbors.empty())
+			m_neighbors.reserve(4 * nbtet);
+	}
+
+	void TetMeshModel::clear() {
+		std::vector<data_type >().swap(m_points);
+		std::vector<index_type >().swap(m_tets);
+		std::vector<int >().swap(m_neighbors);
+	}
+
+	void TetMeshModel::setTopology(std::vector<index_type > tets, std::vector<int > neighbors) {
+		m_tets.swap(tets);
+		if (neighbors.size() == m_tets.size())
+			m_neighbors.swap(neighbors);
+		else
+			std::vector<int >().swap(m_neighbors);
+	}
+
+	data_type TetMeshModel::getTetVolume(size_t index) const {
+		const index_type *t = getTet(index);
+		const data_type *a = getPoint(t[0]), *b = getPoint(t[1]), *c = getPoint(t[2]), *d = getPoint(t[3]);
+		const data_type ad[3] = { a[0] - d[0], a[1] - d[1], a[2] - d[2] };
+		const data_type bd[3] = { b[0] - d[0], b[1] - d[1], b[2] - d[2] };
+		const data_type cd[3] = { c[0] - d[0], c[1] - d[1], c[2] - d[2] };
+		return (ad[2] * (bd[0] * cd[1] - bd[1] * cd[0]) + bd[2] * (cd[0] * ad[1] - cd[1] * ad[0])
+			+ cd[2] * (ad[0] * bd[1] - ad[1] * bd[0])) / 6;
+	}
+};
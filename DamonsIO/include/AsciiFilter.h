@@ -1,69 +1,88 @@
-//##########################################################################
-//#                                                                        #
-//#                              CLOUDCOMPARE                              #
-//#                                                                        #
-//#  This program is free software; you can redistribute it and/or modify  #
-//#  it under the terms of the GNU General Public License as published by  #
-//#  the Free Software Foundation; version 2 or later of the License.      #
-//#                                                                        #
-//#  This program is distributed in the hope that it will be useful,       #
-//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
-//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
-//#  GNU General Public License for more details.                          #
-//#                                                                        #
-//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
-//#                                                                        #
-//##########################################################################
-
 #ifndef CC_ASCII_FILTER_HEADER
 #define CC_ASCII_FILTER_HEADER
 
-#include "FileIOFilter.h"
+#include "..\include\FileIOFilter.h"
+#include "..\..\DamonsDataBase\include\MeshModel.h"
+#include "..\..\DamonsDataBase\include\PointCloudModel.h"
 
-//dialogs
-#include "AsciiOpenDlg.h"
-#include "AsciiSaveDlg.h"
+#include <vector>
 
-//! ASCII point cloud I/O filter
-class QCC_IO_LIB_API AsciiFilter : public FileIOFilter
-{
-public:
+namespace DamonsIO {
+	//! ASCII point cloud I/O filter
+	/** One point per line, values separated by spaces, tabs, commas or semicolons.
+		Lines starting with '#' or "//" and a leading point count (PTS files)
+		are skipped. A header line before the data, commented or not, names the
+		columns:
+			X Y Z [Intensity] [R G B] [Nx Ny Nz] [scalar names ...]
+		Saving writes the columns in this order behind such a header, so a file
+		reads back with the same layout. Without a header, columns are guessed
+		from the first data line: intensity is present when the column count is
+		4, 7, 10...; a triple of unit length is read as a normal, a triple of
+		integers in [0,255] as a color.
+	**/
+	class DAMONS_IO_LIB_API AsciiFilter : public FileIOFilter
+	{
+	public:
+		AsciiFilter() :FileIOFilter() {
+			uid = "ASCII_Filter";
+		}
+	public:
 
-	//static accessors
-	static inline QString GetFileFilter() { return "ASCII cloud (*.txt *.asc *.neu *.xyz *.pts *.csv)"; }
-	static inline QString GetDefaultExtension() { return "asc"; }
+		//static accessors
+		static inline std::string GetFileFilter() { return "ASCII cloud (*.txt *.asc *.neu *.xyz *.pts *.csv)"; }
+		static inline std::string GetDefaultExtension() { return "asc"; }
 
-	//inherited from FileIOFilter
-	bool importSupported() const override { return true; }
-	bool exportSupported() const override { return true; }
-	CC_FILE_ERROR loadFile(const QString& filename, ccHObject& container, LoadParameters& parameters) override;
-	CC_FILE_ERROR saveToFile(ccHObject* entity, const QString& filename, const SaveParameters& parameters) override;
-	QStringList getFileFilters(bool onImport) const override { return QStringList(GetFileFilter()); }
-	QString getDefaultExtension() const override { return GetDefaultExtension(); }
-	bool canLoadExtension(const QString& upperCaseExt) const override;
-	bool canSave(CC_CLASS_ENUM type, bool& multiple, bool& exclusive) const override;
+		//************************************
+		// @brief : read the x y z columns and the intensity and colors (if any)
+		//			chunk by chunk, the file is never loaded at once
+		// @return: error type(if any)
+		// @param : filename file to read
+		// @param : chunkSize maximum number of points of a chunk
+		// @param : callback receives every chunk, returns false to stop
+		//************************************
+		static DAMONS_FILE_ERROR StreamPoints(const std::string& filename, size_t chunkSize, const PointChunkCallback& callback);
 
-	//! Loads an ASCII file with a predefined format
-	CC_FILE_ERROR loadCloudFromFormatedAsciiFile(	const QString& filename,
-													ccHObject& container,
-													const AsciiOpenDlg::Sequence& openSequence,
-													char separator,
-													unsigned approximateNumberOfLines,
-													qint64 fileSize,
-													unsigned maxCloudSize,
-													unsigned skipLines,
-													LoadParameters& parameters,
-													bool showLabelsIn2D = false);
+		//inherited from FileIOFilter
+		virtual bool importSupported() const override { return true; }
+		virtual bool exportSupported() const override { return true; }
+		virtual DAMONS_FILE_ERROR loadFile(const std::string& filename, DMeshLib::ModelObject *&container, LoadParameters& parameters) override;
+		virtual DAMONS_FILE_ERROR saveToFile(DMeshLib::ModelObject* entity, const std::string& filename, const SaveParameters& parameters) override;
+		virtual std::string getFileFilter() const override { return GetFileFilter(); }
+		virtual std::string getDefaultExtension() const override { return GetDefaultExtension(); }
+		virtual bool canLoadExtension(const std::string& upperCaseExt) const override;
 
-	//! Returns associated dialog (creates it if necessary)
-	static AsciiOpenDlg* GetOpenDialog(QWidget* parentWidget = nullptr);
-	//! Returns associated dialog (creates it if necessary)
-	static AsciiSaveDlg* GetSaveDialog(QWidget* parentWidget = nullptr);
+	protected:
+		//! column layout of a file, -1 when absent
+		struct ColumnLayout
+		{
+			ColumnLayout() : columns(0), intensity(-1), colors(-1), normals(-1) {}
+			int columns;
+			int intensity;
+			int colors;
+			int normals;
+			std::vector<int> scalars;
+		};
 
-protected:
+		//************************************
+		// @brief : guess the column layout from the first data line
+		// @return: the layout
+		// @param : values values of the first data line
+		//************************************
+		static ColumnLayout GuessLayout(const std::vector<double>& values);
 
-	//! Internal use only
-	CC_FILE_ERROR saveFile(ccHObject* entity, FILE *theFile);
-};
+		//************************************
+		// @brief : read the column layout from a header line naming the columns
+		// @return: true if the line names the X Y Z columns first, else layout and names are unchanged
+		// @param : begin start of the line, comment marks included
+		// @param : end end of the line
+		// @param : layout the layout as return
+		// @param : names names of the scalar columns as return
+		//************************************
+		static bool ParseHeader(const char* begin, const char* end, ColumnLayout& layout, std::vector<std::string>& names);
 
+		//! Custom save method
+		DAMONS_FILE_ERROR saveCloud(const DMeshLib::PointCloudModel* cloud, FILE *theFile);
+		DAMONS_FILE_ERROR saveMeshVertices(DMeshLib::MeshModel* mesh, FILE *theFile);
+	};
+}
 #endif //CC_ASCII_FILTER_HEADER
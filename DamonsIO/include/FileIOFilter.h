@@ -2,6 +2,8 @@
 #define _FILEIOFILTER_HEADER_
 
 #include <memory>
+#include <vector>
+#include <functional>
 
 #include "..\include\damons_io.h"
 
@@ -30,6 +32,23 @@ namespace DamonsIO {
 		CC_FERR_NOT_IMPLEMENTED,
 	};
 
+	//! A block of points given by a streaming reader
+	/** xyz holds 3 values per point, rgb and intensity are empty when the
+		file has no such attribute, else sized like the points
+	**/
+	struct PointChunk
+	{
+		std::vector<double> xyz;
+		std::vector<unsigned char> rgb;
+		std::vector<float> intensity;
+
+		size_t size() const { return xyz.size() / 3; }
+		void clear() { xyz.clear(); rgb.clear(); intensity.clear(); }
+	};
+
+	//! Receives the chunks of a streaming reader, returns false to stop reading
+	typedef std::function<bool(const PointChunk&)> PointChunkCallback;
+
 	/*!
 	 * \class FileIOFilter
 	 *
@@ -57,6 +76,7 @@ namespace DamonsIO {
 				, preserveShiftOnSave(true)
 				, autoComputeNormals(false)
 				, sessionStart(true)
+				, loadAsPointCloud(false)
 				, process(0.0)
 			{}
 
@@ -68,6 +88,9 @@ namespace DamonsIO {
 			bool autoComputeNormals;
 			//! Session start (whether the load action is the first of a session)
 			bool sessionStart;
+			//! Whether vertices are loaded into a PointCloudModel (faces, if any, are ignored)
+			/** Files without faces are always loaded as point clouds **/
+			bool loadAsPointCloud;
 			//! load process
 			double process;
 		};
@@ -228,6 +251,19 @@ namespace DamonsIO {
 											const SaveParameters& parameters,
 											const std::string& fileFilter);
 
+		//************************************
+		// @brief : Streams the points of a big file by chunks of bounded size
+		//			the file is never loaded at once, only ASCII clouds and
+		//			PLY vertices are supported
+		// @return: error type(if any), CC_FERR_CANCELED_BY_USER if the callback stopped the reading
+		// @param : filename file to read
+		// @param : chunkSize maximum number of points of a chunk
+		// @param : callback receives every chunk
+		//************************************
+		static DAMONS_FILE_ERROR StreamPointsFromFile(const std::string& filename,
+													  size_t chunkSize,
+													  const PointChunkCallback& callback);
+
 	public: //global filters registration mechanism
 
 		//! Init internal filters (should be called once)
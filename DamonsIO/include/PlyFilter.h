@@ -3,6 +3,7 @@
 
 #include "..\include\FileIOFilter.h"
 #include "..\..\DamonsDataBase\include\MeshModel.h"
+#include "..\..\DamonsDataBase\include\PointCloudModel.h"
 #include "rply.h"
 
 namespace DamonsIO {
@@ -55,6 +56,16 @@ namespace DamonsIO {
 		static inline std::string GetDefaultExtension() { return "ply"; }
 		static void SetDefaultOutputFormat(e_ply_storage_mode format);
 
+		//************************************
+		// @brief : read the vertices (x, y, z, colors and intensity if any)
+		//			chunk by chunk, faces and other elements are skipped
+		// @return: error type(if any)
+		// @param : filename file to read
+		// @param : chunkSize maximum number of points of a chunk
+		// @param : callback receives every chunk, returns false to stop
+		//************************************
+		static DAMONS_FILE_ERROR StreamPoints(const std::string& filename, size_t chunkSize, const PointChunkCallback& callback);
+
 		//inherited from FileIOFilter
 		virtual bool importSupported() const override { return true; }
 		virtual bool exportSupported() const override { return true; }
@@ -0,0 +1,173 @@
+#ifndef CC_TILED_CLOUD_HEADER
+#define CC_TILED_CLOUD_HEADER
+
+#include "..\include\FileIOFilter.h"
+#include "..\..\DamonsDataBase\include\PointCloudModel.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace DamonsIO {
+
+	//! Node of a tiled cloud, as stored in the hierarchy file
+	/** the nodes are stored level by level and by Morton code inside a level,
+		so the children of a node are contiguous. the points of a node are
+		count int32 x y z triples, then count float intensities and count
+		r g b triples when the cloud has them, padded to 4 bytes
+	**/
+	struct TiledCloudNode
+	{
+		//! Morton code of the node cell at its depth
+		uint64_t code;
+		//! first byte of the node points in its tile
+		uint64_t offset;
+		//! points stored in the node
+		uint64_t count;
+		//! points of the whole subtree
+		uint64_t total;
+		uint32_t depth;
+		//! tile file holding the points
+		uint32_t tile;
+		//! -1 for the root
+		int32_t parent;
+		//! -1 for a leaf
+		int32_t firstChild;
+		uint32_t childCount;
+		uint32_t reserved;
+	};
+
+	//! Converts a huge point cloud into an octree of binary tiles
+	/** The input (ASCII cloud or PLY vertices) is streamed chunk by chunk and
+		never held in memory. The points are quantized on a cube, binned on the
+		cells of a coarse grid and every bin is sorted along a Morton curve and
+		split in memory. Bins over memoryBudget are first split on disk, so at
+		most memoryBudget points are loaded at once, unless more points share
+		one cell of maxDepth.
+
+		Like DGraphic::DLodOctree, the levels are additive: a node holds the
+		first point of each occupied cell of a grid 2^sampleDepth times finer
+		than the node, left out the points of its ancestors, and every point
+		belongs to exactly one node. Loading all the nodes down to a depth gives
+		a uniform subsample of the cloud.
+
+		The output directory holds 'cloud.hierarchy' (header and nodes) and the
+		tile files 'tile_<n>.bin': tile 0 holds the coarse nodes above the bins,
+		tile n the nodes of bin n. Temporary files of the size of the input are
+		written in the directory during the conversion.
+	**/
+	class DAMONS_IO_LIB_API TiledCloudConverter
+	{
+	public:
+		//! Conversion parameters
+		struct Parameters
+		{
+			Parameters()
+				: chunkSize(1 << 20)
+				, memoryBudget(1 << 23)
+				, leafCapacity(50000)
+				, sampleDepth(7)
+				, maxDepth(14)
+				, precision(0.001)
+			{}
+
+			//! points read at once from the input
+			size_t chunkSize;
+			//! most points sorted at once, bins are cut until they fit or reach maxDepth
+			size_t memoryBudget;
+			//! nodes with more points are split
+			unsigned leafCapacity;
+			//! the samples of a node come from a grid 2^sampleDepth cells wide
+			unsigned sampleDepth;
+			//! deepest node, at most 21 - sampleDepth
+			unsigned maxDepth;
+			//! quantization step of the coordinates
+			double precision;
+		};
+
+	public:
+		TiledCloudConverter() {}
+
+		//************************************
+		// @brief : convert a point file into a tiled cloud
+		// @return: error type(if any)
+		// @param : filename ASCII or PLY file to convert
+		// @param : directory output directory, created if missing
+		// @param : parameters conversion parameters
+		//************************************
+		DAMONS_FILE_ERROR convert(const std::string& filename, const std::string& directory, const Parameters& parameters = Parameters());
+	};
+
+	//! Reads the nodes of a tiled cloud on demand
+	/** Only the hierarchy is read by open, the tiles are memory mapped the
+		first time one of their nodes is loaded and stay mapped until close.
+	**/
+	class DAMONS_IO_LIB_API TiledCloudReader
+	{
+	public:
+		TiledCloudReader();
+		~TiledCloudReader();
+
+		//************************************
+		// @brief : read the hierarchy of a tiled cloud
+		// @return: error type(if any)
+		// @param : directory directory written by TiledCloudConverter
+		//************************************
+		DAMONS_FILE_ERROR open(const std::string& directory);
+		//! unmap the tiles and release the hierarchy
+		void close();
+
+		size_t getNodeCount() const { return m_nodes.size(); }
+		//! node 0 is the root
+		const TiledCloudNode& getNode(size_t node) const { return m_nodes[node]; }
+		//! bounding box of the cell of a node
+		void getNodeBox(size_t node, double minCorner[3], double maxCorner[3]) const;
+		//! distance between the samples of a node
+		double getNodeSpacing(size_t node) const;
+		uint64_t getPointCount() const { return m_pointCount; }
+		bool hasColors() const { return m_hasColors; }
+		bool hasIntensity() const { return m_hasIntensity; }
+
+		//************************************
+		// @brief : nodes intersecting a box down to a depth, parents first
+		// @return: number of points of the nodes
+		// @param : minCorner maxCorner query box
+		// @param : maxDepth deepest node, the subsample gets denser with it
+		// @param : nodes selected nodes as return
+		//************************************
+		uint64_t queryNodes(const double minCorner[3], const double maxCorner[3], unsigned maxDepth, std::vector<unsigned>& nodes) const;
+
+		//************************************
+		// @brief : load the points of some nodes
+		// @return: the points, nullptr on error
+		// @param : nodes nodes to load
+		// @param : minCorner maxCorner if not null only the points inside are kept
+		//************************************
+		DMeshLib::PointCloudModel* loadNodes(const std::vector<unsigned>& nodes, const double* minCorner = nullptr, const double* maxCorner = nullptr);
+
+		//! points inside a box, down to a depth
+		DMeshLib::PointCloudModel* loadBox(const double minCorner[3], const double maxCorner[3], unsigned maxDepth);
+		//! the whole cloud down to a depth
+		DMeshLib::PointCloudModel* loadLevel(unsigned maxDepth);
+
+	protected:
+		class MappedFile;
+
+		//! the mapping of a tile, mapped on first use
+		const unsigned char* mapTile(unsigned tile, size_t& length);
+
+	protected:
+		std::string m_directory;
+		std::vector<TiledCloudNode> m_nodes;
+		std::vector<std::shared_ptr<MappedFile> > m_tiles;
+		double m_origin[3];
+		double m_size;
+		double m_step;
+		uint64_t m_pointCount;
+		unsigned m_sampleDepth;
+		bool m_hasColors;
+		bool m_hasIntensity;
+	};
+}
+#endif //CC_TILED_CLOUD_HEADER
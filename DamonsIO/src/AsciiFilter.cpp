@@ -1,1076 +1,501 @@
-//##########################################################################
-//#                                                                        #
-//#                              CLOUDCOMPARE                              #
-//#                                                                        #
-//#  This program is free software; you can redistribute it and/or modify  #
-//#  it under the terms of the GNU General Public License as published by  #
-//#  the Free Software Foundation; version 2 or later of the License.      #
-//#                                                                        #
-//#  This program is distributed in the hope that it will be useful,       #
-//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
-//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
-//#  GNU General Public License for more details.                          #
-//#                                                                        #
-//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
-//#                                                                        #
-//##########################################################################
-
-#include "AsciiFilter.h"
-
-//Qt
-#include <QFile>
-#include <QFileInfo>
-#include <QSharedPointer>
-#include <QTextStream>
-
-//CClib
-#include <ScalarField.h>
-#include <Garbage.h>
-
-//qCC_db
-#include <cc2DLabel.h>
-#include <ccLog.h>
-#include <ccPointCloud.h>
-#include <ccProgressDialog.h>
-#include <ccScalarField.h>
+#include "..\include\AsciiFilter.h"
 
 //System
-#include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <assert.h>
 
-//Qt
-#include <QScopedPointer>
-
-Garbage<QDialog> s_dialogGarbage;
-AsciiSaveDlg* s_saveDialog(nullptr);
-AsciiOpenDlg* s_openDialog(nullptr);
+namespace DamonsIO {
 
-AsciiSaveDlg* AsciiFilter::GetSaveDialog(QWidget* parentWidget/*=0*/)
-{
-	if (!s_saveDialog)
+	bool AsciiFilter::canLoadExtension(const std::string& upperCaseExt) const
 	{
-		s_saveDialog = new AsciiSaveDlg(parentWidget);
-		if (!parentWidget)
-			s_dialogGarbage.add(s_saveDialog);
+		return (upperCaseExt == "TXT"
+			|| upperCaseExt == "ASC"
+			|| upperCaseExt == "NEU"
+			|| upperCaseExt == "XYZ"
+			|| upperCaseExt == "PTS"
+			|| upperCaseExt == "CSV");
 	}
 
-	return s_saveDialog;
-}
-
-AsciiOpenDlg* AsciiFilter::GetOpenDialog(QWidget* parentWidget/*=0*/)
-{
-	if (!s_openDialog)
+	//! split a line into numbers, return false if a token is not a number
+	static bool ParseNumbers(const char* begin, const char* end, std::vector<double>& values)
 	{
-		s_openDialog = new AsciiOpenDlg(parentWidget);
-		if (!parentWidget)
-			s_dialogGarbage.add(s_openDialog);
-	}
-
-	return s_openDialog;
-}
-
-bool AsciiFilter::canLoadExtension(const QString& upperCaseExt) const
-{
-	return (	upperCaseExt == "ASC"
-			||	upperCaseExt == "TXT"
-			||	upperCaseExt == "XYZ"
-			||	upperCaseExt == "NEU"
-			||	upperCaseExt == "PTS"
-			||	upperCaseExt == "CSV");
-}
-
-bool AsciiFilter::canSave(CC_CLASS_ENUM type, bool& multiple, bool& exclusive) const
-{
-	if (	type == CC_TYPES::POINT_CLOUD			//only one cloud per file
-		||	type == CC_TYPES::HIERARCHY_OBJECT )	//but we can also save a group (each cloud inside will be saved as a separated file)
-	{
-		multiple = true;
-		exclusive = true;
-		return true;
-	}
-
-	return false;
-}
-
-CC_FILE_ERROR AsciiFilter::saveToFile(ccHObject* entity, const QString& filename, const SaveParameters& parameters)
-{
-	assert(entity && !filename.isEmpty());
-
-	AsciiSaveDlg* saveDialog = GetSaveDialog(parameters.parentWidget);
-	assert(saveDialog);
-
-	//if the dialog shouldn't be shown, we'll simply take the default values!
-	if (parameters.alwaysDisplaySaveDialog && saveDialog->autoShow() && !saveDialog->exec())
-	{
-		return CC_FERR_CANCELED_BY_USER;
-	}
-
-	if (!entity->isKindOf(CC_TYPES::POINT_CLOUD))
-	{
-		if (entity->isA(CC_TYPES::HIERARCHY_OBJECT)) //multiple clouds?
-		{
-			QFileInfo fi(filename);
-			QString extension = fi.suffix();
-			QString baseName = fi.completeBaseName();
-			QString path = fi.path();
-
-			unsigned count = entity->getChildrenNumber();
-			//we count the number of clouds first
-			unsigned cloudCount = 0;
-			{
-				for (unsigned i = 0; i < count; ++i)
-				{
-					ccHObject* child = entity->getChild(i);
-					if (child->isKindOf(CC_TYPES::POINT_CLOUD))
-						++cloudCount;
-				}
-			}
-			
-			//we can now create the corresponding file(s)
-			if (cloudCount > 1)
-			{
-				unsigned counter = 0;
-				//disable the save dialog so that it doesn't appear again!
-				AsciiSaveDlg* saveDialog = GetSaveDialog();
-				assert(saveDialog);
-
-				bool autoShow = saveDialog->autoShow();
-				saveDialog->setAutoShow(false);
-
-				for (unsigned i=0; i<count; ++i)
-				{
-					ccHObject* child = entity->getChild(i);
-					if (child->isKindOf(CC_TYPES::POINT_CLOUD))
-					{
-						QString subFilename = path+QString("/");
-						subFilename += QString(baseName).replace("cloudname",child->getName(),Qt::CaseInsensitive);
-						counter++;
-						assert(counter <= cloudCount);
-						subFilename += QString("_%1").arg(cloudCount-counter,6,10,QChar('0'));
-						if (!extension.isEmpty())
-							subFilename += QString(".") + extension;
-						
-						CC_FILE_ERROR result = saveToFile(entity->getChild(i),subFilename,parameters);
-						if (result != CC_FERR_NO_ERROR)
-						{
-							return result;
-						}
-						else
-						{
-							ccLog::Print(QString("[ASCII] Cloud '%1' has been saved in: %2").arg(child->getName(),subFilename));
-						}
-					}
-					else
-					{
-						ccLog::Warning(QString("[ASCII] Entity '%1' can't be saved this way!").arg(child->getName()));
-					}
-				}
-
-				//restore previous state
-				saveDialog->setAutoShow(autoShow);
-
-				return CC_FERR_NO_ERROR;
-			}
-		}
-		else
+		values.clear();
+		const char* p = begin;
+		while (p < end)
 		{
-			return CC_FERR_BAD_ARGUMENT;
+			while (p < end && (*p == ' ' || *p == '\t' || *p == ',' || *p == ';' || *p == '\r'))
+				++p;
+			if (p >= end)
+				break;
+			char* stop = nullptr;
+			double v = std::strtod(p, &stop);
+			if (stop == p)
+				return false;
+			values.push_back(v);
+			p = stop;
 		}
+		return true;
 	}
 
-	QFile file(filename);
-	if (!file.open(QFile::WriteOnly | QFile::Truncate))
-		return CC_FERR_WRITING;
-	QTextStream stream(&file);
-
-	ccGenericPointCloud* cloud = ccHObjectCaster::ToGenericPointCloud(entity);
-
-	unsigned numberOfPoints = cloud->size();
-	bool writeColors = cloud->hasColors();
-	bool writeNorms = cloud->hasNormals();
-	std::vector<ccScalarField*> theScalarFields;
-	if (cloud->isKindOf(CC_TYPES::POINT_CLOUD))
-	{
-		ccPointCloud* ccCloud = static_cast<ccPointCloud*>(cloud);
-		for (unsigned i = 0; i < ccCloud->getNumberOfScalarFields(); ++i)
-			theScalarFields.push_back(static_cast<ccScalarField*>(ccCloud->getScalarField(i)));
-	}
-	bool writeSF = (!theScalarFields.empty());
-
-	//progress dialog
-	QScopedPointer<ccProgressDialog> pDlg(nullptr);
-	if (parameters.parentWidget)
+	static bool IsUnitTriple(const double* v)
 	{
-		pDlg.reset(new ccProgressDialog(true, parameters.parentWidget));
-		pDlg->setMethodTitle(QObject::tr("Saving cloud [%1]").arg(cloud->getName()));
-		pDlg->setInfo(QObject::tr("Number of points: %1").arg(numberOfPoints));
-		pDlg->start();
+		double len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		return std::fabs(len - 1.0) < 1.0e-3;
 	}
-	CCLib::NormalizedProgress nprogress(pDlg.data(), numberOfPoints);
-
-	//output precision
-	const int s_coordPrecision = saveDialog->coordsPrecision();
-	const int s_sfPrecision = saveDialog->sfPrecision(); 
-	const int s_nPrecision = 2+sizeof(PointCoordinateType);
-
-	//other parameters
-	bool saveColumnsHeader = saveDialog->saveColumnsNamesHeader();
-	bool savePointCountHeader = saveDialog->savePointCountHeader();
-	bool swapColorAndSFs = saveDialog->swapColorAndSF();
-	QChar separator(saveDialog->getSeparator());
-	bool saveFloatColors = saveDialog->saveFloatColors();
 
-	if (saveColumnsHeader)
+	static bool IsColorTriple(const double* v)
 	{
-		QString header("//");
-		header.append(AsciiHeaderColumns::X());
-		header.append(separator);
-		header.append(AsciiHeaderColumns::Y());
-		header.append(separator);
-		header.append(AsciiHeaderColumns::Z());
-
-		if (writeColors && !swapColorAndSFs)
-		{
-			header.append(separator);
-			header.append(saveFloatColors ? AsciiHeaderColumns::Rf() : AsciiHeaderColumns::R());
-			header.append(separator);
-			header.append(saveFloatColors ? AsciiHeaderColumns::Gf() : AsciiHeaderColumns::G());
-			header.append(separator);
-			header.append(saveFloatColors ? AsciiHeaderColumns::Bf() : AsciiHeaderColumns::B());
-		}
-
-		if (writeSF)
-		{
-			//add each associated SF name
-			for (std::vector<ccScalarField*>::const_iterator it = theScalarFields.begin(); it != theScalarFields.end(); ++it)
-			{
-				QString sfName((*it)->getName());
-				sfName.replace(separator, '_');
-				header.append(separator);
-				header.append(sfName);
-			}
-		}
-
-		if (writeColors && swapColorAndSFs)
-		{
-			header.append(separator);
-			header.append(saveFloatColors ? AsciiHeaderColumns::Rf() : AsciiHeaderColumns::R());
-			header.append(separator);
-			header.append(saveFloatColors ? AsciiHeaderColumns::Gf() : AsciiHeaderColumns::G());
-			header.append(separator);
-			header.append(saveFloatColors ? AsciiHeaderColumns::Bf() : AsciiHeaderColumns::B());
-		}
-
-		if (writeNorms)
+		for (int k = 0; k < 3; ++k)
 		{
-			header.append(separator);
-			header.append(AsciiHeaderColumns::Nx());
-			header.append(separator);
-			header.append(AsciiHeaderColumns::Ny());
-			header.append(separator);
-			header.append(AsciiHeaderColumns::Nz());
+			if (v[k] < 0 || v[k] > 255 || v[k] != std::floor(v[k]))
+				return false;
 		}
-		
-		stream << header << "\n";
-	}
-
-	if (savePointCountHeader)
-	{
-		stream << QString::number(numberOfPoints) << "\n";
+		return true;
 	}
 
-	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
-	for (unsigned i = 0; i < numberOfPoints; ++i)
+	//! read a file by big chunks and call handleLine(begin, end) on every line
+	/** a line never crosses the end of the buffer, the reading stops when
+		handleLine returns false. returns false in that case
+	**/
+	template<class LineHandler>
+	static bool ForEachLine(FILE* fp, LineHandler& handleLine)
 	{
-		//line for the current point
-		QString line;
-
-		//write current point coordinates
-		const CCVector3* P = cloud->getPoint(i);
-		CCVector3d Pglobal = cloud->toGlobal3d<PointCoordinateType>(*P);
-		line.append(QString::number(Pglobal.x, 'f', s_coordPrecision));
-		line.append(separator);
-		line.append(QString::number(Pglobal.y, 'f', s_coordPrecision));
-		line.append(separator);
-		line.append(QString::number(Pglobal.z, 'f', s_coordPrecision));
-
-		QString colorLine;
-		if (writeColors)
+		std::vector<char> buffer(1 << 22);
+		size_t kept = 0;
+		bool eof = false;
+		while (!eof)
 		{
-			//add rgb color
-			const ccColor::Rgb& col = cloud->getPointColor(i);
-			if (saveFloatColors)
+			if (kept + 1 >= buffer.size())
+				buffer.resize(buffer.size() * 2);
+			const size_t wanted = buffer.size() - 1 - kept;
+			const size_t n = fread(buffer.data() + kept, 1, wanted, fp);
+			eof = (n < wanted);
+			const size_t avail = kept + n;
+			buffer[avail] = '\0';
+
+			const char* start = buffer.data();
+			const char* end = buffer.data() + avail;
+			const char* nl;
+			while ((nl = static_cast<const char*>(memchr(start, '\n', end - start))) != nullptr)
 			{
-				colorLine.append(separator);
-				colorLine.append(QString::number(static_cast<double>(col.r) / ccColor::MAX));
-				colorLine.append(separator);
-				colorLine.append(QString::number(static_cast<double>(col.g) / ccColor::MAX));
-				colorLine.append(separator);
-				colorLine.append(QString::number(static_cast<double>(col.b) / ccColor::MAX));
+				if (!handleLine(start, nl))
+					return false;
+				start = nl + 1;
 			}
-			else
+			kept = static_cast<size_t>(end - start);
+			if (eof && kept > 0)
 			{
-				colorLine.append(separator);
-				colorLine.append(QString::number(col.r));
-				colorLine.append(separator);
-				colorLine.append(QString::number(col.g));
-				colorLine.append(separator);
-				colorLine.append(QString::number(col.b));
+				if (!handleLine(start, end))
+					return false;
+				kept = 0;
 			}
-
-			if (!swapColorAndSFs)
-				line.append(colorLine);
-		}
-
-		if (writeSF)
-		{
-			//add each associated SF values
-			for (std::vector<ccScalarField*>::const_iterator it = theScalarFields.begin(); it != theScalarFields.end(); ++it)
+			else if (kept > 0)
 			{
-				line.append(separator);
-				double sfVal = (*it)->getGlobalShift() + (*it)->getValue(i);
-				line.append(QString::number(sfVal, 'f', s_sfPrecision));
+				memmove(buffer.data(), start, kept);
 			}
 		}
-
-		if (writeColors && swapColorAndSFs)
-			line.append(colorLine);
-
-		if (writeNorms)
-		{
-			//add normal vector
-			const CCVector3& N = cloud->getPointNormal(i);
-			line.append(separator);
-			line.append(QString::number(N.x, 'f', s_nPrecision));
-			line.append(separator);
-			line.append(QString::number(N.y, 'f', s_nPrecision));
-			line.append(separator);
-			line.append(QString::number(N.z, 'f', s_nPrecision));
-		}
-
-		stream << line << "\n";
-
-		if (pDlg && !nprogress.oneStep())
-		{
-			result = CC_FERR_CANCELED_BY_USER;
-			break;
-		}
-	}
-
-	return result;
-}
-
-CC_FILE_ERROR AsciiFilter::loadFile(const QString& filename,
-									ccHObject& container,
-									LoadParameters& parameters)
-{
-	//we get the size of the file to open
-	QFile file(filename);
-	if (!file.exists())
-		return CC_FERR_READING;
-
-	qint64 fileSize = file.size();
-	if (fileSize == 0)
-		return CC_FERR_NO_LOAD;
-
-	//column attribution dialog
-	//DGM: we ask for the semi-persistent dialog as it may have
-	//been already initialized (by the command-line for instance)
-	AsciiOpenDlg* openDialog = GetOpenDialog(parameters.parentWidget);
-	assert(openDialog);
-	openDialog->setFilename(filename);
-
-	bool forceDialogDisplay = parameters.alwaysDisplayLoadDialog;
-	//if we should try to avoid displaying the dialog
-	//DGM: actually, we respect the wish of the caller by default ;)
-	//if (!forceDialogDisplay)
-	//{
-	//	//we must check that the automatically guessed sequence is ok
-	//	if (!openDialog->safeSequence())
-	//	{
-	//		forceDialogDisplay = true;
-	//	}
-	//}
-
-	if (openDialog->restorePreviousContext())
-	{
-		//if we can/should use the previous sequence ('Apply all')
-		forceDialogDisplay = false;
+		return true;
 	}
 
-	if (parameters.sessionStart)
+	static bool IsSeparator(char c)
 	{
-		//we do this AFTER calling restorePreviousContext because it may still be good that the previous
-		//configuration is restored even though the user needs to confirm it
-		AsciiOpenDlg::ResetApplyAll();
+		return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
 	}
 
-	QString dummyStr;
-	if (	forceDialogDisplay
-		|| !AsciiOpenDlg::CheckOpenSequence(openDialog->getOpenSequence(), dummyStr))
+	//! a column name written as one header token
+	static std::string HeaderToken(std::string name)
 	{
-		//show the dialog
-		if (!openDialog->exec())
+		for (auto& c : name)
 		{
-			//release the 'source' dialog (so as to be sure to reset it next time)
-			assert(openDialog == s_openDialog);
-			s_dialogGarbage.destroy(s_openDialog);
-			openDialog = s_openDialog = nullptr;
-
-			//process was cancelled
-			return CC_FERR_CANCELED_BY_USER;
+			if (IsSeparator(c))
+				c = '_';
 		}
+		return name;
 	}
 
-	//we compute the approximate line number
-	double averageLineSize = openDialog->getAverageLineSize();
-	unsigned approximateNumberOfLines = static_cast<unsigned>(ceil(static_cast<double>(fileSize)/averageLineSize));
-
-	AsciiOpenDlg::Sequence openSequence = openDialog->getOpenSequence();
-	char separator = static_cast<char>(openDialog->getSeparator());
-	unsigned maxCloudSize = openDialog->getMaxCloudSize();
-	unsigned skipLineCount = openDialog->getSkippedLinesCount();
-	bool showLabelsIn2D = openDialog->showLabelsIn2D();
-
-	//release the 'source' dialog (so as to be sure to reset it next time)
-	assert(openDialog == s_openDialog);
-	s_dialogGarbage.destroy(s_openDialog);
-	openDialog = s_openDialog = nullptr;
-
-	return loadCloudFromFormatedAsciiFile(	filename,
-											container,
-											openSequence,
-											separator,
-											approximateNumberOfLines,
-											fileSize,
-											maxCloudSize,
-											skipLineCount,
-											parameters,
-											showLabelsIn2D);
-}
-
-struct cloudAttributesDescriptor
-{
-	ccPointCloud* cloud;
-	static const unsigned c_attribCount = 13;
-	union
+	AsciiFilter::ColumnLayout AsciiFilter::GuessLayout(const std::vector<double>& values)
 	{
-		struct{	int xCoordIndex;
-				int yCoordIndex;
-				int zCoordIndex;
-				int xNormIndex;
-				int yNormIndex;
-				int zNormIndex;
-				int redIndex;
-				int greenIndex;
-				int blueIndex;
-				int iRgbaIndex;
-				int fRgbaIndex;
-				int greyIndex;
-				int labelIndex;
-		};
-		int indexes[c_attribCount];
-	};
-	std::vector<int> scalarIndexes;
-	std::vector<CCLib::ScalarField*> scalarFields;
-	bool hasNorms;
-	bool hasRGBColors;
-	bool hasFloatRGBColors[3];
+		ColumnLayout layout;
+		layout.columns = static_cast<int>(values.size());
 
-	cloudAttributesDescriptor()
-	{
-		reset();
-	}
+		int col = 3;
+		if (layout.columns > 3 && (layout.columns - 3) % 3 == 1)
+			layout.intensity = col++;
 
-	void reset()
-	{
-		cloud = nullptr;
-		for (unsigned i = 0; i < c_attribCount; ++i)
+		while (col + 3 <= layout.columns && (layout.normals < 0 || layout.colors < 0))
 		{
-			indexes[i] = -1;
+			if (layout.normals < 0 && IsUnitTriple(&values[col]))
+				layout.normals = col;
+			else if (layout.colors < 0 && IsColorTriple(&values[col]))
+				layout.colors = col;
+			else
+				break;
+			col += 3;
 		}
-		hasNorms = false;
-		hasRGBColors = false;
-		hasFloatRGBColors[0] = hasFloatRGBColors[1] = hasFloatRGBColors[2] = false;
-		
-		scalarIndexes.clear();
-		scalarFields.clear();
-	}
 
-	void updateMaxIndex(int& maxIndex)
-	{
-		for (int attribIndex : indexes)
-			if (attribIndex > maxIndex)
-				maxIndex = attribIndex;
+		for (; col < layout.columns; ++col)
+			layout.scalars.push_back(col);
 
-		for (int sfIndex : scalarIndexes)
-			if (sfIndex > maxIndex)
-				maxIndex = sfIndex;
+		return layout;
 	}
 
-};
-
-void clearStructure(cloudAttributesDescriptor &cloudDesc)
-{
-	delete cloudDesc.cloud;
-	cloudDesc.cloud = nullptr;
-	cloudDesc.reset();
-}
-
-cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequence,
-										unsigned numberOfPoints,
-										int& maxIndex,
-										char separator,
-										unsigned step = 1)
-{
-	ccPointCloud* cloud = new ccPointCloud();
-	if (!cloud || !cloud->reserveThePointsTable(numberOfPoints))
+	bool AsciiFilter::ParseHeader(const char* begin, const char* end, ColumnLayout& layout, std::vector<std::string>& names)
 	{
-		delete cloud;
-		return cloudAttributesDescriptor();
-	}
-
-	if (step == 1)
-		cloud->setName("unnamed - Cloud");
-	else
-		cloud->setName(QString("unnamed - Cloud (part %1)").arg(step));
-
-	cloudAttributesDescriptor cloudDesc;
-	cloudDesc.cloud = cloud;
+		while (begin < end && (*begin == '#' || *begin == '/'))
+			++begin;
+		std::vector<std::string> tokens, keys;
+		for (const char* p = begin; p < end;)
+		{
+			while (p < end && IsSeparator(*p))
+				++p;
+			const char* q = p;
+			while (q < end && !IsSeparator(*q))
+				++q;
+			if (q > p)
+			{
+				tokens.push_back(std::string(p, q));
+				keys.push_back(tokens.back());
+				std::transform(keys.back().begin(), keys.back().end(), keys.back().begin(), ::tolower);
+			}
+			p = q;
+		}
+		if (keys.size() < 3 || keys[0] != "x" || keys[1] != "y" || keys[2] != "z")
+			return false;
 
-	int seqSize = static_cast<int>(openSequence.size());
-	for (int i = 0; i < seqSize; ++i)
-	{
-		switch (openSequence[i].type)
+		auto isTriple = [&keys](size_t col, const char* a, const char* b, const char* c)
 		{
-		case ASCII_OPEN_DLG_None:
-			break;
-		case ASCII_OPEN_DLG_X:
-			cloudDesc.xCoordIndex = i;
-			break;
-		case ASCII_OPEN_DLG_Y:
-			cloudDesc.yCoordIndex = i;
-			break;
-		case ASCII_OPEN_DLG_Z:
-			cloudDesc.zCoordIndex = i;
-			break;
-		case ASCII_OPEN_DLG_NX:
-			if (cloud->reserveTheNormsTable())
+			return col + 2 < keys.size() && keys[col] == a && keys[col + 1] == b && keys[col + 2] == c;
+		};
+		ColumnLayout parsed;
+		std::vector<std::string> parsedNames;
+		parsed.columns = static_cast<int>(keys.size());
+		for (size_t col = 3; col < keys.size();)
+		{
+			if (parsed.intensity < 0 && keys[col] == "intensity")
 			{
-				cloudDesc.xNormIndex = i;
-				cloudDesc.hasNorms = true;
-				cloud->showNormals(true);
+				parsed.intensity = static_cast<int>(col++);
 			}
-			else
+			else if (parsed.colors < 0 && (isTriple(col, "r", "g", "b") || isTriple(col, "red", "green", "blue")))
 			{
-				ccLog::Warning("Failed to allocate memory for normals! (skipped)");
+				parsed.colors = static_cast<int>(col);
+				col += 3;
 			}
-			break;
-		case ASCII_OPEN_DLG_NY:
-			if (cloud->reserveTheNormsTable())
+			else if (parsed.normals < 0 && isTriple(col, "nx", "ny", "nz"))
 			{
-				cloudDesc.yNormIndex = i;
-				cloudDesc.hasNorms = true;
-				cloud->showNormals(true);
+				parsed.normals = static_cast<int>(col);
+				col += 3;
 			}
 			else
 			{
-				ccLog::Warning("Failed to allocate memory for normals! (skipped)");
-			}
-			break;
-		case ASCII_OPEN_DLG_NZ:
-			if (cloud->reserveTheNormsTable())
-			{
-				cloudDesc.zNormIndex = i;
-				cloudDesc.hasNorms = true;
-				cloud->showNormals(true);
+				parsed.scalars.push_back(static_cast<int>(col));
+				parsedNames.push_back(tokens[col++]);
 			}
-			else
+		}
+		layout = parsed;
+		names.swap(parsedNames);
+		return true;
+	}
+
+	DAMONS_FILE_ERROR AsciiFilter::loadFile(const std::string& filename, DMeshLib::ModelObject *&container, LoadParameters& parameters)
+	{
+		FILE* fp = fopen(filename.c_str(), "rb");
+		if (!fp)
+			return CC_FERR_READING;
+
+		fseek(fp, 0, SEEK_END);
+		const long fileSize = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+
+		DMeshLib::PointCloudModel* cloud = nullptr;
+		ColumnLayout layout;
+		bool hasHeader = false;
+		std::vector<std::string> sfNames;
+		std::vector<std::vector<DMeshLib::cloud_type>*> sfArrays;
+		std::vector<double> values;
+		size_t announcedCount = 0;
+		unsigned skippedLines = 0;
+
+		auto handleLine = [&](const char* b, const char* e)
+		{
+			while (b < e && (*b == ' ' || *b == '\t'))
+				++b;
+			if (b >= e || *b == '\r')
+				return true;
+
+			const bool comment = (*b == '#' || (e - b > 1 && b[0] == '/' && b[1] == '/'));
+			if (comment || !ParseNumbers(b, e, values))
 			{
-				ccLog::Warning("Failed to allocate memory for normals! (skipped)");
+				//header line before the data, e.g. "//X Y Z Intensity"
+				if (!cloud)
+					hasHeader = ParseHeader(b, e, layout, sfNames) || hasHeader;
+				else if (!comment)
+					++skippedLines;
+				return true;
 			}
-			break;
-		case ASCII_OPEN_DLG_Scalar:
+
+			if (!cloud)
 			{
-				int sfIndex = cloud->getNumberOfScalarFields() + 1;
-				QString sfName = openSequence[i].header;
-				if (sfName.isEmpty())
+				//PTS files start with the number of points
+				if (values.size() == 1)
 				{
-					sfName = "Scalar field";
-					if (sfIndex > 1)
-						sfName += QString(" #%1").arg(sfIndex);
-					//if (isPositive)
-					//	sfName += QString(" (positive)");
+					announcedCount = static_cast<size_t>(values[0]);
+					return true;
 				}
-				else
+				if (values.size() < 3)
 				{
-					sfName.replace('_',separator);
+					++skippedLines;
+					return true;
 				}
 
-				ccScalarField* sf = new ccScalarField(qPrintable(sfName));
-				int sfIdx = cloud->addScalarField(sf);
-				if (sfIdx >= 0)
-				{
-					cloudDesc.scalarIndexes.push_back(i);
-					cloudDesc.scalarFields.push_back(sf);
-				}
-				else
+				if (!hasHeader)
 				{
-					ccLog::Warning("Failed to add scalar field #%i to cloud #%i! (skipped)", sfIndex);
-					sf->release();
-					sf = nullptr;
+					layout = GuessLayout(values);
+					sfNames.clear();
+					for (size_t k = 0; k < layout.scalars.size(); ++k)
+						sfNames.push_back("Scalar #" + std::to_string(k));
 				}
+				cloud = new DMeshLib::PointCloudModel("unnamed-cloud");
+				for (size_t k = 0; k < sfNames.size(); ++k)
+					cloud->addScalarField(sfNames[k]);
+				for (unsigned k = 0; k < cloud->getScalarFieldNumber(); ++k)
+					sfArrays.push_back(&cloud->getScalarField(k).values);
+
+				size_t expected = announcedCount;
+				if (expected == 0)
+					expected = static_cast<size_t>(fileSize / std::max<long>(1, static_cast<long>(e - b + 1)));
+				cloud->reserve(expected);
 			}
-			break;
-		case ASCII_OPEN_DLG_Rf:
-			cloudDesc.hasFloatRGBColors[0] = true;
-		case ASCII_OPEN_DLG_R:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.redIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
-			break;
-		case ASCII_OPEN_DLG_Gf:
-			cloudDesc.hasFloatRGBColors[1] = true;
-		case ASCII_OPEN_DLG_G:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.greenIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
-			break;
-		case ASCII_OPEN_DLG_Bf:
-			cloudDesc.hasFloatRGBColors[2] = true;
-		case ASCII_OPEN_DLG_B:
-			if (cloud->reserveTheRGBTable())
-			{
-				cloudDesc.blueIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
-			break;
-		case ASCII_OPEN_DLG_RGB32i:
-		case ASCII_OPEN_DLG_RGB32f:
-			if (cloud->reserveTheRGBTable())
-			{
-				if (openSequence[i].type == ASCII_OPEN_DLG_RGB32i)
-					cloudDesc.iRgbaIndex = i;
-				else
-					cloudDesc.fRgbaIndex = i;
-				cloudDesc.hasRGBColors = true;
-				cloud->showColors(true);
-			}
-			else
-			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
-			}
-			break;
-		case ASCII_OPEN_DLG_Grey:
-			if (cloud->reserveTheRGBTable())
+
+			if (values.size() < 3)
 			{
-				cloudDesc.greyIndex = i;
-				cloud->showColors(true);
+				++skippedLines;
+				return true;
 			}
-			else
+			//missing columns are read as 0
+			values.resize(std::max<size_t>(values.size(), layout.columns), 0.0);
+
+			cloud->addPoint(static_cast<DMeshLib::cloud_type>(values[0]), static_cast<DMeshLib::cloud_type>(values[1]), static_cast<DMeshLib::cloud_type>(values[2]));
+			if (layout.intensity >= 0)
+				cloud->addPointIntensity(static_cast<DMeshLib::cloud_type>(values[layout.intensity]));
+			if (layout.colors >= 0)
 			{
-				ccLog::Warning("Failed to allocate memory for colors! (skipped)");
+				DMeshLib::color_type rgb[3];
+				for (int k = 0; k < 3; ++k)
+					rgb[k] = static_cast<DMeshLib::color_type>(std::min(std::max(values[layout.colors + k], 0.0), 255.0));
+				cloud->addPointColor(rgb[0], rgb[1], rgb[2]);
 			}
-			break;
-		case ASCII_OPEN_DLG_Label:
-			assert(cloudDesc.labelIndex < 0); //There Can Be Only One
-			cloudDesc.labelIndex = i;
-			break;
-		default:
-			//unhandled case?
-			assert(false);
-			break;
-		}
-	}
-
-	//we compute the max index for each cloud descriptor
-	maxIndex = -1;
-	cloudDesc.updateMaxIndex(maxIndex);
-
-	return cloudDesc;
-}
-
-CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filename,
-															ccHObject& container,
-															const AsciiOpenDlg::Sequence& openSequence,
-															char separator,
-															unsigned approximateNumberOfLines,
-															qint64 fileSize,
-															unsigned maxCloudSize,
-															unsigned skipLines,
-															LoadParameters& parameters,
-															bool showLabelsIn2D/*=false*/)
-{
-	//we may have to "slice" clouds when opening them if they are too big!
-	maxCloudSize = std::min(maxCloudSize, CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
-	unsigned cloudChunkSize = std::min(maxCloudSize, approximateNumberOfLines);
-	unsigned cloudChunkPos = 0;
-	unsigned chunkRank = 1;
-
-	//we initialize the loading accelerator structure and point cloud
-	int maxPartIndex = -1;
-	cloudAttributesDescriptor cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, separator, chunkRank);
-
-	if (!cloudDesc.cloud)
-	{
-		return CC_FERR_NOT_ENOUGH_MEMORY;
-	}
-
-	//we re-open the file (ASCII mode)
-	QFile file(filename);
-	if (!file.open(QFile::ReadOnly))
-	{
-		//we clear already initialized data
-		clearStructure(cloudDesc);
-		return CC_FERR_READING;
-	}
-	QTextStream stream(&file);
+			if (layout.normals >= 0)
+				cloud->addPointNormal(static_cast<DMeshLib::cloud_type>(values[layout.normals]), static_cast<DMeshLib::cloud_type>(values[layout.normals + 1]), static_cast<DMeshLib::cloud_type>(values[layout.normals + 2]));
+			for (size_t k = 0; k < sfArrays.size(); ++k)
+				sfArrays[k]->push_back(static_cast<DMeshLib::cloud_type>(values[layout.scalars[k]]));
+			return true;
+		};
 
-	//we skip lines as defined on input
-	{
-		for (unsigned i = 0; i < skipLines;)
+		try
 		{
-			QString currentLine = stream.readLine();
-			if (currentLine.isEmpty())
-			{
-				//empty lines are ignored
-				continue;
-			}
-			++i;
+			ForEachLine(fp, handleLine);
 		}
-	}
-
-	//progress indicator
-	QScopedPointer<ccProgressDialog> pDlg(nullptr);
-	if (parameters.parentWidget)
-	{
-		pDlg.reset(new ccProgressDialog(true, parameters.parentWidget));
-		pDlg->setMethodTitle(QObject::tr("Open ASCII file [%1]").arg(filename));
-		pDlg->setInfo(QObject::tr("Approximate number of points: %1").arg(approximateNumberOfLines));
-		pDlg->start();
-	}
-	CCLib::NormalizedProgress nprogress(pDlg.data(), approximateNumberOfLines);
-
-	//buffers
-	ScalarType D = 0;
-	CCVector3d P(0, 0, 0);
-	CCVector3d Pshift(0, 0, 0);
-	CCVector3 N(0, 0, 0);
-	ccColor::Rgb col;
-	bool preserveCoordinateShift = true;
-
-	//other useful variables
-	unsigned linesRead = 0;
-	unsigned pointsRead = 0;
-
-	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
-
-	//main process
-	unsigned nextLimit = /*cloudChunkPos+*/cloudChunkSize;
-	while (true)
-	{
-		//read next line
-		QString currentLine = stream.readLine();
-		if (currentLine.isNull())
+		catch (const std::bad_alloc&)
 		{
-			//end of file
-			break;
+			fclose(fp);
+			if (cloud)
+				delete cloud;
+			return CC_FERR_NOT_ENOUGH_MEMORY;
 		}
-		++linesRead;
+		fclose(fp);
 
-		if (currentLine.isEmpty() || currentLine.startsWith("//"))
+		if (!cloud || cloud->empty())
 		{
-			//empty lines and comments are ignored
-			continue;
+			if (cloud)
+				delete cloud;
+			container = nullptr;
+			return CC_FERR_NO_LOAD;
 		}
 
-		//if we have reached the max. number of points per cloud
-		if (pointsRead == nextLimit)
+		if (skippedLines > 0)
 		{
-			ccLog::PrintDebug("[ASCII] Point %i -> end of chunk (%i points)",pointsRead,cloudChunkSize);
+			std::cout << "[ASCII] " << skippedLines << " malformed lines were skipped" << std::endl;
+		}
 
-			//we re-evaluate the average line size
-			{
-				double averageLineSize = static_cast<double>(file.pos()) / (pointsRead + skipLines);
-				double newNbOfLinesApproximation = std::max(1.0, static_cast<double>(fileSize) / averageLineSize - static_cast<double>(skipLines));
+		cloud->refreshBoundBox();
+		container = cloud;
 
-				//if approximation is smaller than actual one, we add 2% by default
-				if (newNbOfLinesApproximation <= pointsRead)
-				{
-					newNbOfLinesApproximation = std::max(static_cast<double>(cloudChunkPos + cloudChunkSize) + 1.0, static_cast<double>(pointsRead)* 1.02);
-				}
-				approximateNumberOfLines = static_cast<unsigned>(ceil(newNbOfLinesApproximation));
-				ccLog::PrintDebug("[ASCII] New approximate nb of lines: %i", approximateNumberOfLines);
-			}
+		return CC_FERR_NO_ERROR;
+	}
 
-			//we try to resize actual clouds
-			if (cloudChunkSize < maxCloudSize || approximateNumberOfLines - cloudChunkPos <= maxCloudSize)
-			{
-				ccLog::PrintDebug("[ASCII] We choose to enlarge existing clouds");
+	DAMONS_FILE_ERROR AsciiFilter::StreamPoints(const std::string& filename, size_t chunkSize, const PointChunkCallback& callback)
+	{
+		FILE* fp = fopen(filename.c_str(), "rb");
+		if (!fp)
+			return CC_FERR_READING;
+
+		ColumnLayout layout;
+		bool hasHeader = false;
+		std::vector<std::string> sfNames;
+		bool started = false;
+		size_t total = 0;
+		std::vector<double> values;
+		PointChunk chunk;
+
+		auto flush = [&]()
+		{
+			total += chunk.size();
+			const bool goOn = callback(chunk);
+			chunk.clear();
+			return goOn;
+		};
 
-				cloudChunkSize = std::min(maxCloudSize, approximateNumberOfLines - cloudChunkPos);
-				if (!cloudDesc.cloud->reserve(cloudChunkSize))
-				{
-					ccLog::Error("Not enough memory! Process stopped ...");
-					result = CC_FERR_NOT_ENOUGH_MEMORY;
-					break;
-				}
-			}
-			else //otherwise we have to create new clouds
+		auto handleLine = [&](const char* b, const char* e)
+		{
+			while (b < e && (*b == ' ' || *b == '\t'))
+				++b;
+			if (b >= e || *b == '\r')
+				return true;
+			//header lines and the point count of PTS files
+			const bool comment = (*b == '#' || (e - b > 1 && b[0] == '/' && b[1] == '/'));
+			const bool numbers = !comment && ParseNumbers(b, e, values);
+			if (!numbers || values.size() < 3)
 			{
-				ccLog::PrintDebug("[ASCII] We choose to instantiate new clouds");
-
-				//we store (and resize) actual cloud
-				if (!cloudDesc.cloud->resize(cloudChunkSize))
-					ccLog::Warning("Memory reallocation failed ... some memory may have been wasted ...");
-				if (!cloudDesc.scalarFields.empty())
-				{
-					for (unsigned k = 0; k < cloudDesc.scalarFields.size(); ++k)
-						cloudDesc.scalarFields[k]->computeMinAndMax();
-					cloudDesc.cloud->setCurrentDisplayedScalarField(0);
-					cloudDesc.cloud->showSF(true);
-				}
-				//we add this cloud to the output container
-				container.addChild(cloudDesc.cloud);
-				cloudDesc.reset();
+				if (!started && !numbers)
+					hasHeader = ParseHeader(b, e, layout, sfNames) || hasHeader;
+				return true;
+			}
 
-				//and create new one
-				cloudChunkPos = pointsRead;
-				cloudChunkSize = std::min(maxCloudSize, approximateNumberOfLines - cloudChunkPos);
-				cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, separator, ++chunkRank);
-				if (!cloudDesc.cloud)
-				{
-					ccLog::Error("Not enough memory! Process stopped ...");
-					break;
-				}
-				if (preserveCoordinateShift)
-				{
-					cloudDesc.cloud->setGlobalShift(Pshift);
-				}
+			if (!started)
+			{
+				if (!hasHeader)
+					layout = GuessLayout(values);
+				started = true;
 			}
+			values.resize(std::max<size_t>(values.size(), layout.columns), 0.0);
 
-			//we update the progress info
-			if (pDlg)
+			chunk.xyz.insert(chunk.xyz.end(), values.begin(), values.begin() + 3);
+			if (layout.intensity >= 0)
+				chunk.intensity.push_back(static_cast<float>(values[layout.intensity]));
+			if (layout.colors >= 0)
 			{
-				nprogress.scale(approximateNumberOfLines, 100, true);
-				pDlg->setInfo(QObject::tr("Approximate number of points: %1").arg(approximateNumberOfLines));
+				for (int k = 0; k < 3; ++k)
+					chunk.rgb.push_back(static_cast<unsigned char>(std::min(std::max(values[layout.colors + k], 0.0), 255.0)));
 			}
+			return chunk.size() < chunkSize || flush();
+		};
 
-			nextLimit = cloudChunkPos+cloudChunkSize;
+		bool completed = false;
+		try
+		{
+			completed = ForEachLine(fp, handleLine) && (chunk.size() == 0 || flush());
 		}
-
-		//we split current line
-		QStringList parts = currentLine.split(separator, QString::SkipEmptyParts);
-
-		int nParts = parts.size();
-		if (nParts > maxPartIndex) //fake loop for easy break
+		catch (const std::bad_alloc&)
 		{
-			//read the point coordinates
-			bool lineIsCorrupted = true;
-			for (int step = 0; step < 1; ++step) //fake loop for easy break
-			{
-				bool ok = true;
-				if (cloudDesc.xCoordIndex >= 0)
-				{
-					P.x = parts[cloudDesc.xCoordIndex].toDouble(&ok);
-					if (!ok)
-					{
-						break;
-					}
-				}
-				if (cloudDesc.yCoordIndex >= 0)
-				{
-					P.y = parts[cloudDesc.yCoordIndex].toDouble(&ok);
-					if (!ok)
-					{
-						break;
-					}
-				}
-				if (cloudDesc.zCoordIndex >= 0)
-				{
-					P.z = parts[cloudDesc.zCoordIndex].toDouble(&ok);
-					if (!ok)
-					{
-						break;
-					}
-				}
-
-				lineIsCorrupted = false;
-			}
+			fclose(fp);
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+		fclose(fp);
 
-			if (lineIsCorrupted)
-			{
-				ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (non numerical value found)", linesRead);
-				continue;
-			}
+		if (!completed)
+			return CC_FERR_CANCELED_BY_USER;
 
-			//first point: check for 'big' coordinates
-			if (pointsRead == 0)
-			{
-				if (HandleGlobalShift(P, Pshift, preserveCoordinateShift, parameters))
-				{
-					if (preserveCoordinateShift)
-					{
-						cloudDesc.cloud->setGlobalShift(Pshift);
-					}
-					ccLog::Warning("[ASCIIFilter::loadFile] Cloud has been recentered! Translation: (%.2f ; %.2f ; %.2f)", Pshift.x, Pshift.y, Pshift.z);
-				}
-			}
+		return total > 0 ? CC_FERR_NO_ERROR : CC_FERR_NO_LOAD;
+	}
 
-			//add point
-			cloudDesc.cloud->addPoint(CCVector3::fromArray((P + Pshift).u));
+	DAMONS_FILE_ERROR AsciiFilter::saveToFile(DMeshLib::ModelObject* entity, const std::string& filename, const SaveParameters& parameters)
+	{
+		if (!entity || filename.empty())
+			return CC_FERR_BAD_ARGUMENT;
 
-			//Normal vector
-			if (cloudDesc.hasNorms)
-			{
-				if (cloudDesc.xNormIndex >= 0)
-					N.x = static_cast<PointCoordinateType>(parts[cloudDesc.xNormIndex].toDouble());
-				if (cloudDesc.yNormIndex >= 0)
-					N.y = static_cast<PointCoordinateType>(parts[cloudDesc.yNormIndex].toDouble());
-				if (cloudDesc.zNormIndex >= 0)
-					N.z = static_cast<PointCoordinateType>(parts[cloudDesc.zNormIndex].toDouble());
-				cloudDesc.cloud->addNorm(N);
-			}
+		if (!entity->isA(DMeshLib::DB_TYPES::POINT_CLOUD) && !entity->isA(DMeshLib::DB_TYPES::MESH))
+		{
+			std::cerr << "[ASCII] This filter can only save point clouds or mesh vertices!";
+			return CC_FERR_BAD_ENTITY_TYPE;
+		}
 
-			//Colors
-			if (cloudDesc.hasRGBColors)
-			{
-				if (cloudDesc.iRgbaIndex >= 0)
-				{
-					const uint32_t rgb = parts[cloudDesc.iRgbaIndex].toInt();
-					col.r = ((rgb >> 16) & 0x0000ff);
-					col.g = ((rgb >>  8) & 0x0000ff);
-					col.b = ((rgb      ) & 0x0000ff);
+		FILE* theFile = fopen(filename.c_str(), "w");
+		if (!theFile)
+			return CC_FERR_WRITING;
 
-				}
-				else if (cloudDesc.fRgbaIndex >= 0)
-				{
-					const float rgbf = parts[cloudDesc.fRgbaIndex].toFloat();
-					const uint32_t rgb = *(reinterpret_cast<const uint32_t *>(&rgbf));
-					col.r = ((rgb >> 16) & 0x0000ff);
-					col.g = ((rgb >>  8) & 0x0000ff);
-					col.b = ((rgb      ) & 0x0000ff);
-				}
-				else
-				{
-					if (cloudDesc.redIndex >= 0)
-					{
-						float multiplier = cloudDesc.hasFloatRGBColors[0] ? static_cast<float>(ccColor::MAX) : 1.0f;
-						col.r = static_cast<ColorCompType>(parts[cloudDesc.redIndex].toFloat() * multiplier);
-					}
-					if (cloudDesc.greenIndex >= 0)
-					{
-						float multiplier = cloudDesc.hasFloatRGBColors[1] ? static_cast<float>(ccColor::MAX) : 1.0f;
-						col.g = static_cast<ColorCompType>(parts[cloudDesc.greenIndex].toFloat() * multiplier);
-					}
-					if (cloudDesc.blueIndex >= 0)
-					{
-						float multiplier = cloudDesc.hasFloatRGBColors[2] ? static_cast<float>(ccColor::MAX) : 1.0f;
-						col.b = static_cast<ColorCompType>(parts[cloudDesc.blueIndex].toFloat() * multiplier);
-					}
-				}
-				cloudDesc.cloud->addRGBColor(col);
-			}
-			else if (cloudDesc.greyIndex >= 0)
-			{
-				col.r = col.r = col.b = static_cast<ColorCompType>(parts[cloudDesc.greyIndex].toInt());
-				cloudDesc.cloud->addRGBColor(col);
-			}
+		DAMONS_FILE_ERROR result;
+		if (entity->isA(DMeshLib::DB_TYPES::POINT_CLOUD))
+			result = saveCloud(static_cast<DMeshLib::PointCloudModel*>(entity), theFile);
+		else
+			result = saveMeshVertices(static_cast<DMeshLib::MeshModel*>(entity), theFile);
 
-			//Scalar distance
-			if (!cloudDesc.scalarIndexes.empty())
-			{
-				for (size_t j = 0; j < cloudDesc.scalarIndexes.size(); ++j)
-				{
-					D = static_cast<ScalarType>(parts[cloudDesc.scalarIndexes[j]].toDouble());
-					cloudDesc.scalarFields[j]->emplace_back(D);
-				}
-			}
+		fclose(theFile);
 
-			//Label
-			if (cloudDesc.labelIndex >= 0)
-			{
-				cc2DLabel* label = new cc2DLabel();
-				label->addPoint(cloudDesc.cloud, cloudDesc.cloud->size() - 1);
-				label->setName(parts[cloudDesc.labelIndex]);
-				label->setDisplayedIn2D(showLabelsIn2D);
-				label->displayPointLegend(!showLabelsIn2D);
-				label->setVisible(true);
-				cloudDesc.cloud->addChild(label);
-			}
+		return result;
+	}
 
-			++pointsRead;
-		}
-		else
+	DAMONS_FILE_ERROR AsciiFilter::saveCloud(const DMeshLib::PointCloudModel* cloud, FILE *theFile)
+	{
+		const size_t count = cloud->size();
+		const bool hasNormals = cloud->hasPointNormals();
+		const bool hasColors = cloud->hasPointColors();
+		const bool hasIntensity = cloud->hasPointIntensity();
+
+		//header naming the columns, read back by ParseHeader
+		fprintf(theFile, "//X Y Z");
+		if (hasIntensity)
+			fprintf(theFile, " Intensity");
+		if (hasColors)
+			fprintf(theFile, " R G B");
+		if (hasNormals)
+			fprintf(theFile, " Nx Ny Nz");
+		for (unsigned k = 0; k < cloud->getScalarFieldNumber(); ++k)
 		{
-			ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (found %i part(s) on %i expected)!", linesRead, nParts, maxPartIndex + 1);
+			const std::string& name = cloud->getScalarField(k).name;
+			fprintf(theFile, " %s", HeaderToken(name.empty() ? "Scalar #" + std::to_string(k) : name).c_str());
 		}
+		if (fprintf(theFile, "\n") < 0)
+			return CC_FERR_WRITING;
 
-		if (pDlg && !nprogress.oneStep())
+		const DMeshLib::cloud_type* pts = cloud->getPointData();
+		const DMeshLib::cloud_type* nrm = cloud->getNormalData();
+		const DMeshLib::color_type* col = cloud->getColorData();
+		for (size_t i = 0; i < count; ++i)
 		{
-			//cancel requested
-			result = CC_FERR_CANCELED_BY_USER;
-			break;
+			int ok = fprintf(theFile, "%.8g %.8g %.8g", pts[3 * i], pts[3 * i + 1], pts[3 * i + 2]);
+			if (hasIntensity)
+				ok = fprintf(theFile, " %.8g", cloud->getPointIntensity(i));
+			if (hasColors)
+				ok = fprintf(theFile, " %d %d %d", col[3 * i], col[3 * i + 1], col[3 * i + 2]);
+			if (hasNormals)
+				ok = fprintf(theFile, " %.7g %.7g %.7g", nrm[3 * i], nrm[3 * i + 1], nrm[3 * i + 2]);
+			for (unsigned k = 0; k < cloud->getScalarFieldNumber(); ++k)
+				ok = fprintf(theFile, " %.8g", cloud->getScalarField(k).values[i]);
+			if (ok < 0 || fprintf(theFile, "\n") < 0)
+				return CC_FERR_WRITING;
 		}
-	}
 
-	file.close();
+		return CC_FERR_NO_ERROR;
+	}
 
-	if (cloudDesc.cloud)
+	DAMONS_FILE_ERROR AsciiFilter::saveMeshVertices(DMeshLib::MeshModel* mesh, FILE *theFile)
 	{
-		if (cloudDesc.cloud->size() < cloudDesc.cloud->capacity())
-			cloudDesc.cloud->resize(cloudDesc.cloud->size());
+		const unsigned count = mesh->getPointsNumber();
+		const bool hasNormals = mesh->hasPointNormals();
 
-		//add cloud to output
-		if (!cloudDesc.scalarFields.empty())
-		{
-			for (size_t j = 0; j < cloudDesc.scalarFields.size(); ++j)
-			{
-				cloudDesc.scalarFields[j]->resizeSafe(cloudDesc.cloud->size(), true, NAN_VALUE);
-				cloudDesc.scalarFields[j]->computeMinAndMax();
-			}
-			cloudDesc.cloud->setCurrentDisplayedScalarField(0);
-			cloudDesc.cloud->showSF(true);
-		}
+		if (fprintf(theFile, hasNormals ? "//X Y Z Nx Ny Nz\n" : "//X Y Z\n") < 0)
+			return CC_FERR_WRITING;
 
-		//position the labels
-		if (cloudDesc.labelIndex >= 0)
+		DMeshLib::data_type x, y, z;
+		for (unsigned i = 0; i < count; ++i)
 		{
-			ccHObject::Container labels;
-			cloudDesc.cloud->filterChildren(labels, false, CC_TYPES::LABEL_2D, true);
-
-			if (labels.size() > 1)
+			mesh->getPoint(i, x, y, z);
+			int ok = fprintf(theFile, "%.10g %.10g %.10g", x, y, z);
+			if (hasNormals)
 			{
-				double angle_rad = (M_PI * 2) / labels.size();
-				for (size_t i = 0; i < labels.size(); ++i)
-				{
-					//position the labels on a circle
-					static_cast<cc2DLabel*>(labels[i])->setPosition(0.5 + 0.4 * cos(i * angle_rad), 0.5 + 0.4 * sin(i * angle_rad));
-				}
+				mesh->getPointNormal(i, x, y, z);
+				ok = fprintf(theFile, " %.7g %.7g %.7g", x, y, z);
 			}
+			if (ok < 0 || fprintf(theFile, "\n") < 0)
+				return CC_FERR_WRITING;
 		}
 
-		container.addChild(cloudDesc.cloud);
+		return CC_FERR_NO_ERROR;
 	}
-
-	return result;
 }
@@ -4,12 +4,14 @@
 #include "..\include\PlyFilter.h"
 #include "..\include\ObjFilter.h"
 #include "..\include\3DSFilter.h"
+#include "..\include\AsciiFilter.h"
 
 #include <fstream>
 
 //system
 #include <cassert>
 #include <vector>
+#include <algorithm>
 
 namespace DamonsIO {
 	//! Available filters
@@ -34,7 +36,7 @@ namespace DamonsIO {
 	void FileIOFilter::InitInternalFilters()
 	{
 		//from the most useful to the less one!
-		//Register(Shared(new AsciiFilter()));
+		Register(Shared(new AsciiFilter()));
 		Register(Shared(new PlyFilter()));
 		Register(Shared(new STLFilter()));
 		Register(Shared(new OFFFilter()));
@@ -119,6 +121,15 @@ namespace DamonsIO {
 				return  filter;
 		}
 
+		//not a default extension, ask each filter (e.g. 'xyz' or 'pts' for ASCII clouds)
+		std::string upperEXT = ext;
+		std::transform(upperEXT.begin(), upperEXT.end(), upperEXT.begin(), ::toupper);
+		for (const auto &filter : s_ioFilters)
+		{
+			if (filter->canLoadExtension(upperEXT))
+				return  filter;
+		}
+
 		return FileIOFilter::Shared(nullptr);
 	}
 
@@ -270,4 +281,33 @@ namespace DamonsIO {
 		return SaveToFile(entities, filename, parameters, filter);
 	}
 
+	DAMONS_FILE_ERROR FileIOFilter::StreamPointsFromFile(
+		const std::string& filename,
+		size_t chunkSize,
+		const PointChunkCallback& callback)
+	{
+		if (filename.empty() || chunkSize == 0 || !callback)
+			return CC_FERR_BAD_ARGUMENT;
+
+		std::string::size_type pos = filename.find_last_of(".");
+		if (pos == std::string::npos)
+			return CC_FERR_UNKNOWN_FILE;
+		std::string upperEXT = filename.substr(pos + 1);
+		std::transform(upperEXT.begin(), upperEXT.end(), upperEXT.begin(), ::toupper);
+
+		try
+		{
+			if (PlyFilter().canLoadExtension(upperEXT))
+				return PlyFilter::StreamPoints(filename, chunkSize, callback);
+			if (AsciiFilter().canLoadExtension(upperEXT))
+				return AsciiFilter::StreamPoints(filename, chunkSize, callback);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+
+		return CC_FERR_WRONG_FILE_TYPE;
+	}
+
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include <algorithm>
 
 namespace DamonsIO {
@@ -99,8 +100,6 @@ namespace DamonsIO {
 		std::string tokens = GetNextLine(fin);
 		unsigned vertCount = 0, triCount = 0;
 		std::stringstream ss(tokens);
-		ss >> vertCount >> triCount;
-
 		if (!(ss >> vertCount >> triCount))
 			return CC_FERR_MALFORMED_FILE;
 		
@@ -114,7 +113,6 @@ namespace DamonsIO {
 			{
 				currentLine = GetNextLine(fin);
 				std::stringstream sstrm(currentLine);
-				sstrm >> x >> y >> z;
 				if (!(sstrm >> x >> y >> z))
 				{
 					delete mesh;
@@ -128,7 +126,7 @@ namespace DamonsIO {
 		//mesh->ResizeTriangles(triCount);
 		//load triangles
 		{
-			DMeshLib::index_type indexes[4];
+			std::vector<DMeshLib::index_type> indexes;
 			unsigned polyVertCount;
 
 			bool ignoredPolygons = false;
@@ -137,7 +135,6 @@ namespace DamonsIO {
 				currentLine = GetNextLine(fin);
 				std::stringstream sstrm(currentLine);
 
-				sstrm >> polyVertCount;
 				if (!(sstrm >> polyVertCount))
 				{
 					delete mesh;
@@ -145,21 +142,22 @@ namespace DamonsIO {
 					return CC_FERR_MALFORMED_FILE;
 				}
 
-				if (polyVertCount == 3 || polyVertCount == 4)
+				if (polyVertCount >= 3)
 				{
 					//decode indexes
+					indexes.resize(polyVertCount);
 					for (unsigned j = 0; j < polyVertCount; ++j)
 					{
-						if (!(sstrm >> indexes[j]))
+						if (!(sstrm >> indexes[j]) || indexes[j] >= vertCount)
 						{
 							delete mesh;
+							mesh = nullptr;
+							container = mesh;
 							return CC_FERR_MALFORMED_FILE;
 						}
 					}
-					//triangle or quad only
-					mesh->addTriangle(indexes[0], indexes[1], indexes[2]);
-					if (polyVertCount == 4)
-						mesh->addTriangle(indexes[0], indexes[2], indexes[3]);
+					//any polygon, concave ones too
+					mesh->addPolygon(indexes.data(), polyVertCount);
 				}
 				else
 				{
@@ -169,7 +167,7 @@ namespace DamonsIO {
 
 			if (ignoredPolygons)
 			{
-				std::cerr<<"[OFF] Some polygons with an unhandled size (i.e. > 4) were ignored!";
+				std::cerr<<"[OFF] Some polygons with less than 3 vertices were ignored!";
 			}
 		}
 
@@ -469,27 +469,14 @@ namespace DamonsIO {
 					if (error)
 						break;
 
-					//Now, let's tesselate the whole polygon
-					//FIXME: yeah, we do very ulgy tesselation here!
-					std::vector<facetElement>::const_iterator B = A + 1;
-					std::vector<facetElement>::const_iterator C = B + 1;
-					for (; C != currentFace.end(); ++B, ++C)
-					{
-						//push new triangle
-						mesh->addTriangle(A->vIndex, B->vIndex, C->vIndex);
-						++facesRead;
-						++totalFacesRead;
-						/*
-						if (hasMaterial)
-							baseMesh->addTriangleMtlIndex(currentMaterial);
-
-						if (hasTexCoords)
-							baseMesh->addTriangleTexCoordIndexes(A->tcIndex, B->tcIndex, C->tcIndex);
-
-						if (normalsPerFacet)
-							baseMesh->addTriangleNormalIndexes(A->nIndex, B->nIndex, C->nIndex);
-						*/
-					}
+					//Now, let's tesselate the whole polygon, concave ones too
+					std::vector<DMeshLib::index_type> faceIndexes(currentFace.size());
+					for (size_t k = 0; k < currentFace.size(); ++k)
+						faceIndexes[k] = static_cast<DMeshLib::index_type>(currentFace[k].vIndex);
+					const unsigned int faceTriangles = mesh->addPolygon(faceIndexes.data(), static_cast<unsigned int>(faceIndexes.size()));
+					facesRead += faceTriangles;
+					totalFacesRead += faceTriangles;
+					//MeshModel keeps no material, tex. coord or normal index per triangle, they are checked above but dropped
 
 					std::vector<facetElement>().swap(currentFace);
 				}
@@ -2,6 +2,7 @@
 
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 
 #if defined _WIN32
 #include <windows.h>
@@ -24,11 +25,90 @@ namespace DamonsIO {
 		s_defaultOutputFormat = format;
 	}
 
+	//! write a PointCloudModel: vertices with optional normals, colors, intensity and scalar fields
+	static DAMONS_FILE_ERROR SavePointCloud(const DMeshLib::PointCloudModel* cloud, const std::string& filename, e_ply_storage_mode storageType)
+	{
+		p_ply ply = ply_create(filename.c_str(), storageType, nullptr, 0, nullptr);
+		if (!ply)
+			return CC_FERR_WRITING;
+
+		const unsigned vertCount = cloud->getPointsNumber();
+		const bool hasNormals = cloud->hasPointNormals();
+		const bool hasColors = cloud->hasPointColors();
+		const bool hasIntensity = cloud->hasPointIntensity();
+
+		int result = ply_add_element(ply, "vertex", vertCount);
+		result = result && ply_add_scalar_property(ply, "x", PLY_FLOAT);
+		result = result && ply_add_scalar_property(ply, "y", PLY_FLOAT);
+		result = result && ply_add_scalar_property(ply, "z", PLY_FLOAT);
+		if (hasNormals)
+		{
+			result = result && ply_add_scalar_property(ply, "nx", PLY_FLOAT);
+			result = result && ply_add_scalar_property(ply, "ny", PLY_FLOAT);
+			result = result && ply_add_scalar_property(ply, "nz", PLY_FLOAT);
+		}
+		if (hasColors)
+		{
+			result = result && ply_add_scalar_property(ply, "red", PLY_UCHAR);
+			result = result && ply_add_scalar_property(ply, "green", PLY_UCHAR);
+			result = result && ply_add_scalar_property(ply, "blue", PLY_UCHAR);
+		}
+		if (hasIntensity)
+			result = result && ply_add_scalar_property(ply, "intensity", PLY_FLOAT);
+		std::vector<std::string> sfNames(cloud->getScalarFieldNumber());
+		for (unsigned k = 0; k < cloud->getScalarFieldNumber(); ++k)
+		{
+			//spaces are not allowed in property names
+			sfNames[k] = "scalar_" + cloud->getScalarField(k).name;
+			std::replace(sfNames[k].begin(), sfNames[k].end(), ' ', '_');
+			result = result && ply_add_scalar_property(ply, sfNames[k].c_str(), PLY_FLOAT);
+		}
+
+		ply_add_obj_info(ply, "Generated by Damons!");
+		if (!result || !ply_write_header(ply))
+		{
+			ply_close(ply);
+			return CC_FERR_WRITING;
+		}
+
+		const DMeshLib::cloud_type* pts = cloud->getPointData();
+		const DMeshLib::cloud_type* nrm = cloud->getNormalData();
+		const DMeshLib::color_type* col = cloud->getColorData();
+		for (unsigned i = 0; i < vertCount && result; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+				result = result && ply_write(ply, pts[3 * i + k]);
+			if (hasNormals)
+			{
+				for (int k = 0; k < 3; ++k)
+					result = result && ply_write(ply, nrm[3 * i + k]);
+			}
+			if (hasColors)
+			{
+				for (int k = 0; k < 3; ++k)
+					result = result && ply_write(ply, col[3 * i + k]);
+			}
+			if (hasIntensity)
+				result = result && ply_write(ply, cloud->getPointIntensity(i));
+			for (unsigned k = 0; k < cloud->getScalarFieldNumber(); ++k)
+				result = result && ply_write(ply, cloud->getScalarField(k).values[i]);
+		}
+
+		//closing flushes the last buffered values
+		if (!ply_close(ply) || !result)
+			return CC_FERR_WRITING;
+
+		return CC_FERR_NO_ERROR;
+	}
+
 	DAMONS_FILE_ERROR PlyFilter::saveToFile(DMeshLib::ModelObject* entity, const std::string& filename, const SaveParameters& parameters)
 	{
 		if (!entity || filename.empty())
 			return CC_FERR_BAD_ARGUMENT;
 
+		if (entity->isA(DMeshLib::DB_TYPES::POINT_CLOUD))
+			return SavePointCloud(static_cast<DMeshLib::PointCloudModel*>(entity), filename, s_defaultOutputFormat);
+
 		DMeshLib::MeshModel* mesh = static_cast<DMeshLib::MeshModel*>(entity);
 		e_ply_storage_mode storageType = s_defaultOutputFormat;
 		p_ply ply = ply_create(filename.c_str(), storageType, nullptr, 0, nullptr);
@@ -341,7 +421,7 @@ namespace DamonsIO {
 		long length, value_index;
 		ply_get_argument_property(argument, nullptr, &length, &value_index);
 		//unsupported polygon type!
-		if (length != 3 && length != 4)
+		if (length < 3)
 		{
 			s_unsupportedPolygonType = true;
 			return 1;
@@ -351,25 +431,22 @@ namespace DamonsIO {
 			return 1;
 		}
 
-		static DMeshLib::index_type s_tri[4];
-		s_tri[value_index] = static_cast<unsigned>(ply_get_argument_value(argument));
+		//the polygon is triangulated once all its indexes are read
+		static std::vector<DMeshLib::index_type> s_polygon;
+		if (value_index == 0)
+			s_polygon.clear();
+		s_polygon.push_back(static_cast<unsigned>(ply_get_argument_value(argument)));
 
-		if (value_index < 2)
+		if (value_index + 1 < length)
 		{
 			return 1;
 		}
 
-		if (value_index == 2)
-		{
-			mesh->addTriangle(s_tri[0], s_tri[1], s_tri[2]);
-			++s_triCount;
-		}
-		else if (value_index == 3)
+		if (length == 4)
 		{
 			s_hasQuads = true;
-			mesh->addTriangle(s_tri[0], s_tri[2], s_tri[3]);
-			++s_triCount;
 		}
+		s_triCount += mesh->addPolygon(s_polygon.data(), static_cast<unsigned>(s_polygon.size()));
 
 		return 1;
 	}
@@ -453,6 +530,432 @@ namespace DamonsIO {
 	}
 
 
+	//////////////////////////////////////////////////////////////////////////
+	// point cloud target: arrays are sized from the header, every callback
+	// writes its value at the element instance index
+
+	static int cloud_vertex_cb(p_ply_argument argument)
+	{
+		long flags;
+		DMeshLib::PointCloudModel* cloud;
+		ply_get_argument_user_data(argument, (void**)(&cloud), &flags);
+		p_ply_element element;
+		long instance_index;
+		ply_get_argument_element(argument, &element, &instance_index);
+
+		double val = ply_get_argument_value(argument);
+		if (val != val)
+		{
+			//warning: corrupted data!
+			s_PointDataCorrupted = true;
+			val = 0;
+		}
+		cloud->getPointData()[3 * instance_index + (flags & POS_MASK)] = static_cast<DMeshLib::cloud_type>(val);
+		if (flags & ELEM_EOL)
+			++s_PointCount;
+
+		return 1;
+	}
+
+	static int cloud_normal_cb(p_ply_argument argument)
+	{
+		long flags;
+		DMeshLib::PointCloudModel* cloud;
+		ply_get_argument_user_data(argument, (void**)(&cloud), &flags);
+		p_ply_element element;
+		long instance_index;
+		ply_get_argument_element(argument, &element, &instance_index);
+
+		cloud->getNormalData()[3 * instance_index + (flags & POS_MASK)] = static_cast<DMeshLib::cloud_type>(ply_get_argument_value(argument));
+		if (flags & ELEM_EOL)
+			++s_NormalCount;
+
+		return 1;
+	}
+
+	static int cloud_rgb_cb(p_ply_argument argument)
+	{
+		long flags;
+		DMeshLib::PointCloudModel* cloud;
+		ply_get_argument_user_data(argument, (void**)(&cloud), &flags);
+		p_ply_element element;
+		long instance_index;
+		ply_get_argument_element(argument, &element, &instance_index);
+
+		p_ply_property prop;
+		ply_get_argument_property(argument, &prop, nullptr, nullptr);
+		e_ply_type type;
+		ply_get_property_info(prop, nullptr, &type, nullptr, nullptr);
+
+		double c = ply_get_argument_value(argument);
+		switch (type)
+		{
+		case PLY_FLOAT:
+		case PLY_DOUBLE:
+		case PLY_FLOAT32:
+		case PLY_FLOAT64:
+			//float colors are in [0,1]
+			c = std::min(std::max(0.0, c), 1.0) * 255.0 + 0.5;
+			break;
+		default:
+			c = std::min(std::max(0.0, c), 255.0);
+			break;
+		}
+		cloud->getColorData()[3 * instance_index + (flags & POS_MASK)] = static_cast<DMeshLib::color_type>(c);
+		if (flags & ELEM_EOL)
+			++s_ColorCount;
+
+		return 1;
+	}
+
+	static int cloud_intensity_cb(p_ply_argument argument)
+	{
+		DMeshLib::PointCloudModel* cloud;
+		ply_get_argument_user_data(argument, (void**)(&cloud), nullptr);
+		p_ply_element element;
+		long instance_index;
+		ply_get_argument_element(argument, &element, &instance_index);
+
+		cloud->getIntensityData()[instance_index] = static_cast<DMeshLib::cloud_type>(ply_get_argument_value(argument));
+		++s_IntensityCount;
+
+		return 1;
+	}
+
+	static int cloud_scalar_cb(p_ply_argument argument)
+	{
+		DMeshLib::PointScalarField* sf;
+		ply_get_argument_user_data(argument, (void**)(&sf), nullptr);
+		p_ply_element element;
+		long instance_index;
+		ply_get_argument_element(argument, &element, &instance_index);
+
+		sf->values[instance_index] = static_cast<DMeshLib::cloud_type>(ply_get_argument_value(argument));
+
+		return 1;
+	}
+
+	//! set the callbacks of a x,y,z like triple, the last property read ends the element
+	static bool SetTripleCallbacks(p_ply ply, const int indexes[3], std::vector<plyElement>& pointElements,
+		std::vector<plyProperty>& stdProperties, p_ply_read_cb cb, void* userData, long numberOfPoints)
+	{
+		const int last = std::max(indexes[0], std::max(indexes[1], indexes[2]));
+		for (int k = 0; k < 3; ++k)
+		{
+			if (indexes[k] <= 0)
+				continue;
+			plyProperty& pp = stdProperties[indexes[k] - 1];
+			if (pointElements[pp.elemIndex].elementInstances != numberOfPoints)
+				return false;
+			long flags = k;
+			if (indexes[k] == last)
+				flags |= ELEM_EOL;
+			ply_set_read_cb(ply, pointElements[pp.elemIndex].elementName, pp.propName, cb, userData, flags);
+		}
+		return true;
+	}
+
+	//! read the point-like elements of a PLY file into a PointCloudModel
+	static DAMONS_FILE_ERROR LoadPointCloud(p_ply ply,
+		std::vector<plyElement>& pointElements,
+		std::vector<plyProperty>& stdProperties,
+		const int stdPropIndexes[],
+		const std::vector<int>& sfPropIndexes,
+		DMeshLib::ModelObject *&container)
+	{
+		const int xyz[3] = { stdPropIndexes[0], stdPropIndexes[1], stdPropIndexes[2] };
+		const int nxyz[3] = { stdPropIndexes[3], stdPropIndexes[4], stdPropIndexes[5] };
+		const int rgb[3] = { stdPropIndexes[6], stdPropIndexes[7], stdPropIndexes[8] };
+
+		if (xyz[0] <= 0 || xyz[1] <= 0 || xyz[2] <= 0)
+		{
+			ply_close(ply);
+			return CC_FERR_NO_LOAD;
+		}
+		const long numberOfPoints = pointElements[stdProperties[xyz[0] - 1].elemIndex].elementInstances;
+
+		DMeshLib::PointCloudModel* cloud = new DMeshLib::PointCloudModel("unnamed-cloud");
+		try
+		{
+			cloud->resize(numberOfPoints);
+			if (nxyz[0] > 0 || nxyz[1] > 0 || nxyz[2] > 0)
+				cloud->enableNormals();
+			if (rgb[0] > 0 || rgb[1] > 0 || rgb[2] > 0)
+				cloud->enableColors();
+		}
+		catch (const std::bad_alloc&)
+		{
+			delete cloud;
+			ply_close(ply);
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+
+		if (!SetTripleCallbacks(ply, xyz, pointElements, stdProperties, cloud_vertex_cb, cloud, numberOfPoints)
+			|| !SetTripleCallbacks(ply, nxyz, pointElements, stdProperties, cloud_normal_cb, cloud, numberOfPoints)
+			|| !SetTripleCallbacks(ply, rgb, pointElements, stdProperties, cloud_rgb_cb, cloud, numberOfPoints))
+		{
+			delete cloud;
+			ply_close(ply);
+			return CC_FERR_BAD_ENTITY_TYPE;
+		}
+
+		//the first intensity like property goes to the intensity array, the others to scalar fields
+		std::vector<int> sfFieldIndexes(sfPropIndexes.size(), -1);
+		for (size_t i = 0; i < sfPropIndexes.size(); ++i)
+		{
+			plyProperty& pp = stdProperties[sfPropIndexes[i] - 1];
+			if (pointElements[pp.elemIndex].elementInstances != numberOfPoints)
+				continue;
+
+			std::string propName(pp.propName);
+			std::string upperName = propName;
+			std::transform(upperName.begin(), upperName.end(), upperName.begin(), ::toupper);
+			bool isIntensity = std::string::npos != upperName.find("INTENSITY") || std::string::npos != upperName.find("GRAY") || std::string::npos != upperName.find("GREY");
+			if (isIntensity && !cloud->hasPointIntensity())
+			{
+				cloud->enableIntensity();
+				ply_set_read_cb(ply, pointElements[pp.elemIndex].elementName, pp.propName, cloud_intensity_cb, cloud, 0);
+				continue;
+			}
+
+			//remove the 'scalar_' prefix added when saving scalar fields
+			if (propName.compare(0, 7, "scalar_") == 0 && propName.length() > 7)
+				propName = propName.substr(7);
+			sfFieldIndexes[i] = cloud->addScalarField(propName);
+		}
+		//fields are all created now, their addresses are stable
+		for (size_t i = 0; i < sfPropIndexes.size(); ++i)
+		{
+			if (sfFieldIndexes[i] < 0)
+				continue;
+			plyProperty& pp = stdProperties[sfPropIndexes[i] - 1];
+			ply_set_read_cb(ply, pointElements[pp.elemIndex].elementName, pp.propName, cloud_scalar_cb, &cloud->getScalarField(sfFieldIndexes[i]), 0);
+		}
+
+		int success = 0;
+		try
+		{
+			success = ply_read(ply);
+		}
+		catch (...)
+		{
+			success = -1;
+		}
+		ply_close(ply);
+
+		if (success < 1)
+		{
+			delete cloud;
+			return CC_FERR_READING;
+		}
+		if (s_PointDataCorrupted)
+		{
+			std::cout << "[PLY] Some points are corrupted (NaN), set to 0" << std::endl;
+		}
+
+		cloud->refreshBoundBox();
+		container = cloud;
+
+		return CC_FERR_NO_ERROR;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// streaming target: the values of a vertex are gathered in a chunk which
+	// is handed over when full. the slot of a property (x y z r g b i) is
+	// stored above the ELEM_EOL bit of the flags
+
+#define STREAM_SLOT_SHIFT	3
+
+	struct PlyPointStream
+	{
+		PointChunk chunk;
+		size_t chunkSize;
+		const PointChunkCallback* callback;
+		double values[7];
+		bool hasColors;
+		bool hasIntensity;
+		bool canceled;
+		size_t total;
+	};
+
+	static int stream_cb(p_ply_argument argument)
+	{
+		long flags;
+		PlyPointStream* stream;
+		ply_get_argument_user_data(argument, (void**)(&stream), &flags);
+
+		const long slot = flags >> STREAM_SLOT_SHIFT;
+		double val = ply_get_argument_value(argument);
+		if (val != val)
+		{
+			s_PointDataCorrupted = true;
+			val = 0;
+		}
+		if (slot >= 3 && slot < 6)
+		{
+			p_ply_property prop;
+			ply_get_argument_property(argument, &prop, nullptr, nullptr);
+			e_ply_type type;
+			ply_get_property_info(prop, nullptr, &type, nullptr, nullptr);
+			if (type == PLY_FLOAT || type == PLY_DOUBLE || type == PLY_FLOAT32 || type == PLY_FLOAT64)
+				val = std::min(std::max(0.0, val), 1.0) * 255.0 + 0.5;
+			else
+				val = std::min(std::max(0.0, val), 255.0);
+		}
+		stream->values[slot] = val;
+
+		if (flags & ELEM_EOL)
+		{
+			PointChunk& chunk = stream->chunk;
+			chunk.xyz.insert(chunk.xyz.end(), stream->values, stream->values + 3);
+			if (stream->hasColors)
+			{
+				for (int k = 3; k < 6; ++k)
+					chunk.rgb.push_back(static_cast<unsigned char>(stream->values[k]));
+			}
+			if (stream->hasIntensity)
+				chunk.intensity.push_back(static_cast<float>(stream->values[6]));
+
+			if (chunk.size() >= stream->chunkSize)
+			{
+				stream->total += chunk.size();
+				stream->canceled = !(*stream->callback)(chunk);
+				chunk.clear();
+				if (stream->canceled)
+					return 0;
+			}
+		}
+
+		return 1;
+	}
+
+	DAMONS_FILE_ERROR PlyFilter::StreamPoints(const std::string& filename, size_t chunkSize, const PointChunkCallback& callback)
+	{
+		s_PointDataCorrupted = false;
+
+		p_ply ply = ply_open(filename.c_str(), nullptr, 0, nullptr);
+		if (!ply)
+			return CC_FERR_READING;
+		if (!ply_read_header(ply))
+		{
+			ply_close(ply);
+			return CC_FERR_WRONG_FILE_TYPE;
+		}
+
+		//the first vertex like element with x, y and z
+		p_ply_element elem = nullptr;
+		const char* elementName = nullptr;
+		p_ply_property props[7] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+		int order[7] = { -1, -1, -1, -1, -1, -1, -1 };
+		while ((elem = ply_get_next_element(ply, elem)))
+		{
+			long instances = 0;
+			ply_get_element_info(elem, &elementName, &instances);
+			std::string upperElement(elementName);
+			std::transform(upperElement.begin(), upperElement.end(), upperElement.begin(), ::toupper);
+			if (instances == 0 || (std::string::npos == upperElement.find("VERT") && std::string::npos == upperElement.find("POINT")))
+				continue;
+
+			std::fill(props, props + 7, nullptr);
+			p_ply_property prop = nullptr;
+			int index = 0;
+			while ((prop = ply_get_next_property(elem, prop)))
+			{
+				const char* propName;
+				e_ply_type type;
+				ply_get_property_info(prop, &propName, &type, nullptr, nullptr);
+				std::string upperName(propName);
+				std::transform(upperName.begin(), upperName.end(), upperName.begin(), ::toupper);
+
+				int slot = -1;
+				if (type == PLY_LIST)
+					slot = -1;
+				else if (upperName == "X" || upperName == "Y" || upperName == "Z")
+					slot = upperName[0] - 'X';
+				else if (std::string::npos != upperName.find("RED"))
+					slot = 3;
+				else if (std::string::npos != upperName.find("GREEN"))
+					slot = 4;
+				else if (std::string::npos != upperName.find("BLUE"))
+					slot = 5;
+				else if (std::string::npos != upperName.find("INTENSITY") || std::string::npos != upperName.find("GRAY") || std::string::npos != upperName.find("GREY"))
+					slot = 6;
+				if (slot >= 0 && !props[slot])
+				{
+					props[slot] = prop;
+					order[slot] = index;
+				}
+				++index;
+			}
+			if (props[0] && props[1] && props[2])
+				break;
+		}
+		if (!elem)
+		{
+			ply_close(ply);
+			return CC_FERR_NO_LOAD;
+		}
+
+		PlyPointStream stream;
+		stream.chunkSize = chunkSize;
+		stream.callback = &callback;
+		std::fill(stream.values, stream.values + 7, 0.0);
+		stream.hasColors = props[3] && props[4] && props[5];
+		stream.hasIntensity = props[6] != nullptr;
+		stream.canceled = false;
+		stream.total = 0;
+		if (!stream.hasColors)
+			props[3] = props[4] = props[5] = nullptr;
+
+		//the last property read ends the vertex
+		int last = 0;
+		for (int k = 1; k < 7; ++k)
+		{
+			if (props[k] && order[k] > order[last])
+				last = k;
+		}
+		for (int k = 0; k < 7; ++k)
+		{
+			if (!props[k])
+				continue;
+			const char* propName;
+			ply_get_property_info(props[k], &propName, nullptr, nullptr, nullptr);
+			long flags = static_cast<long>(k) << STREAM_SLOT_SHIFT;
+			if (k == last)
+				flags |= ELEM_EOL;
+			ply_set_read_cb(ply, elementName, propName, stream_cb, &stream, flags);
+		}
+
+		int success = 0;
+		try
+		{
+			success = ply_read(ply);
+		}
+		catch (const std::bad_alloc&)
+		{
+			ply_close(ply);
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+		ply_close(ply);
+
+		if (stream.canceled)
+			return CC_FERR_CANCELED_BY_USER;
+		if (success < 1)
+			return CC_FERR_READING;
+		if (stream.chunk.size() > 0)
+		{
+			stream.total += stream.chunk.size();
+			if (!callback(stream.chunk))
+				return CC_FERR_CANCELED_BY_USER;
+		}
+		if (s_PointDataCorrupted)
+		{
+			std::cout << "[PLY] Some points are corrupted (NaN), set to 0" << std::endl;
+		}
+
+		return stream.total > 0 ? CC_FERR_NO_ERROR : CC_FERR_NO_LOAD;
+	}
+
 	DAMONS_FILE_ERROR PlyFilter::loadFile(const std::string& filename, DMeshLib::ModelObject *&container, LoadParameters& parameters) 
 	{
 		//reset statics!
@@ -727,6 +1230,15 @@ namespace DamonsIO {
 		/***  Callbacks setup  ***/
 		/*************************/
 
+		//point-only files, or point cloud requested: vertices go into a PointCloudModel
+		if (facesIndex == 0 || parameters.loadAsPointCloud)
+		{
+			s_loadParameters.loadAsPointCloud = true;
+			DAMONS_FILE_ERROR error = LoadPointCloud(ply, pointElements, stdProperties, stdPropIndexes, sfPropIndexes, container);
+			parameters = s_loadParameters;
+			return error;
+		}
+
 		//Main point cloud
 		DMeshLib::MeshModel* mesh = new DMeshLib::MeshModel("unnamed-mesh");
 
@@ -1010,7 +1522,7 @@ namespace DamonsIO {
 			{
 				if (s_unsupportedPolygonType)
 				{
-					std::cout<<"Mesh is not triangular! (unsupported)"<<std::endl;
+					std::cout<<"Mesh only has polygons with less than 3 vertices!"<<std::endl;
 				}
 				else
 				{
@@ -1023,7 +1535,7 @@ namespace DamonsIO {
 			{
 				if (s_unsupportedPolygonType)
 				{
-					std::cout << "Some facets are not triangular! (unsupported)" << std::endl;
+					std::cout << "Some facets have less than 3 vertices! (ignored)" << std::endl;
 				}
 			}
 		}
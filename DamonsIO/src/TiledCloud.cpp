@@ -0,0 +1,1132 @@
+#include "..\include\TiledCloud.h"
+#include "..\..\DamonsMath\include\DamonsParallel.h"
+#include "..\..\DamonsMath\include\utilities.h"
+
+//System
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#if defined _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace DamonsIO {
+
+	//! bits of the Morton keys per axis
+	static const unsigned s_keyDepth = 21;
+	//! deepest level of the bins counted in memory, denser bins are split on disk
+	static const unsigned s_binDepth = 7;
+	//! bin files kept open while the points are distributed
+	static const size_t s_openBinFiles = 256;
+	//! level of a point equal to its predecessor, it stays in its leaf
+	static const unsigned char s_duplicate = 0xff;
+
+	static const char s_magic[4] = { 'D', 'T', 'C', 'L' };
+	static const uint32_t s_version = 1;
+	static const uint32_t s_colorsFlag = 1;
+	static const uint32_t s_intensityFlag = 2;
+
+	//! header of the hierarchy file, the nodes follow
+	struct TiledCloudHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t attributes;
+		uint32_t sampleDepth;
+		double origin[3];
+		double size;
+		double step;
+		uint64_t pointCount;
+		uint64_t nodeCount;
+		uint32_t tileCount;
+		uint32_t reserved;
+	};
+
+	//! point of the raw copy of the input
+	struct RawPoint
+	{
+		double xyz[3];
+		float intensity;
+		unsigned char rgb[3];
+		unsigned char pad;
+	};
+
+	//! point of the bins, coordinates are quantized
+	struct QuantizedPoint
+	{
+		int32_t xyz[3];
+		float intensity;
+		unsigned char rgb[3];
+		unsigned char pad;
+	};
+
+	//! cube of the Morton keys and quantization of the coordinates
+	struct TiledCloudGrid
+	{
+		double origin[3];
+		double size;
+		double step;
+
+		void quantize(const double* xyz, int32_t* q) const
+		{
+			const double maxQ = std::floor(size / step);
+			for (int a = 0; a < 3; ++a)
+				q[a] = static_cast<int32_t>(std::min(std::max(std::floor((xyz[a] - origin[a]) / step + 0.5), 0.0), maxQ));
+		}
+
+		uint64_t key(const int32_t* q) const
+		{
+			const double cells = double(1u << s_keyDepth);
+			const double scale = step / size * cells;
+			uint32_t c[3];
+			for (int a = 0; a < 3; ++a)
+				c[a] = static_cast<uint32_t>(std::min(q[a] * scale, cells - 1));
+			return DMath::MortonEncode3(c[0], c[1], c[2]);
+		}
+	};
+
+	//! node of a bin while it is split
+	struct TiledBuildNode
+	{
+		uint64_t code;
+		unsigned depth;
+		int parent;
+	};
+
+	//! cell of the coarse grid whose points are sorted at once
+	struct TiledBin
+	{
+		uint64_t code;
+		unsigned depth;
+		uint64_t count;
+		//! number of its temporary file
+		size_t file;
+	};
+
+	static std::string JoinPath(const std::string& directory, const std::string& name)
+	{
+		if (directory.empty())
+			return name;
+		const char last = directory[directory.size() - 1];
+		return (last == '/' || last == '\\') ? directory + name : directory + "/" + name;
+	}
+
+	static std::string NumberedPath(const std::string& directory, const char* prefix, size_t n, const char* ext)
+	{
+		return JoinPath(directory, std::string(prefix) + std::to_string(n) + ext);
+	}
+
+	static void MakeDirectory(const std::string& directory)
+	{
+#if defined _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+
+	//! append only temporary files of the bins
+	/** the handles stay open between two appends, past maxOpen files the
+		least recently used one is closed and reopened when needed
+	**/
+	class TiledBinFiles
+	{
+	public:
+		TiledBinFiles(const std::string& directory, size_t maxOpen)
+			: m_directory(directory)
+			, m_maxOpen(std::max<size_t>(maxOpen, 1))
+			, m_clock(0)
+		{}
+
+		~TiledBinFiles() { closeAll(); }
+
+		static std::string path(const std::string& directory, size_t file)
+		{
+			return NumberedPath(directory, "bin_", file, ".tmp");
+		}
+
+		bool append(size_t file, const std::vector<QuantizedPoint>& points)
+		{
+			FILE* fp = handle(file);
+			return fp && fwrite(points.data(), sizeof(QuantizedPoint), points.size(), fp) == points.size();
+		}
+
+		//! close every handle, false when some data could not be written
+		bool closeAll()
+		{
+			bool ok = true;
+			for (size_t file : m_open)
+			{
+				ok = fclose(m_files[file]) == 0 && ok;
+				m_files[file] = nullptr;
+			}
+			m_open.clear();
+			return ok;
+		}
+
+	protected:
+		FILE* handle(size_t file)
+		{
+			if (file >= m_files.size())
+			{
+				m_files.resize(file + 1, nullptr);
+				m_used.resize(file + 1, 0);
+				m_started.resize(file + 1, false);
+			}
+			m_used[file] = ++m_clock;
+			if (m_files[file])
+				return m_files[file];
+
+			if (m_open.size() >= m_maxOpen)
+			{
+				size_t oldest = 0;
+				for (size_t k = 1; k < m_open.size(); ++k)
+				{
+					if (m_used[m_open[k]] < m_used[m_open[oldest]])
+						oldest = k;
+				}
+				const size_t victim = m_open[oldest];
+				m_open[oldest] = m_open.back();
+				m_open.pop_back();
+				const bool closed = fclose(m_files[victim]) == 0;
+				m_files[victim] = nullptr;
+				if (!closed)
+					return nullptr;
+			}
+			FILE* fp = fopen(path(m_directory, file).c_str(), m_started[file] ? "ab" : "wb");
+			if (!fp)
+				return nullptr;
+			m_files[file] = fp;
+			m_started[file] = true;
+			m_open.push_back(file);
+			return fp;
+		}
+
+	protected:
+		std::string m_directory;
+		size_t m_maxOpen;
+		uint64_t m_clock;
+		std::vector<FILE*> m_files;
+		std::vector<uint64_t> m_used;
+		std::vector<bool> m_started;
+		//! files with an open handle
+		std::vector<size_t> m_open;
+	};
+
+	//! call func(records, n) on the records of a file, block by block
+	template<class Record, class Func>
+	static bool ForEachBlock(const std::string& path, size_t blockSize, Func func)
+	{
+		FILE* fp = fopen(path.c_str(), "rb");
+		if (!fp)
+			return false;
+		std::vector<Record> block(blockSize);
+		size_t n;
+		while ((n = fread(block.data(), sizeof(Record), blockSize, fp)) > 0)
+			func(block.data(), n);
+		const bool ok = !ferror(fp);
+		fclose(fp);
+		return ok;
+	}
+
+	//! level of a sorted point: first depth where it starts a new sample cell
+	static unsigned char SampleLevel(uint64_t key, uint64_t previous, unsigned sampleDepth)
+	{
+		const uint64_t diff = key ^ previous;
+		if (diff == 0)
+			return s_duplicate;
+		int high = 63;
+		while (!((diff >> high) & 1))
+			--high;
+		const unsigned first = s_keyDepth - high / 3;
+		return static_cast<unsigned char>(first > sampleDepth ? first - sampleDepth : 0);
+	}
+
+	//! cut the cells of the coarse grid until they hold at most budget points,
+	//! the cells of binDepth are kept whatever their count
+	static void CutBins(const std::vector<uint64_t>& prefix, unsigned binDepth, unsigned depth, uint64_t code, size_t budget, std::vector<TiledBin>& bins)
+	{
+		const unsigned shift = 3 * (binDepth - depth);
+		const uint64_t count = prefix[(code + 1) << shift] - prefix[code << shift];
+		if (count == 0)
+			return;
+		if (count <= budget || depth == binDepth)
+		{
+			TiledBin bin;
+			bin.code = code;
+			bin.depth = depth;
+			bin.count = count;
+			bin.file = bins.size();
+			bins.push_back(bin);
+			return;
+		}
+		for (uint64_t c = 0; c < 8; ++c)
+			CutBins(prefix, binDepth, depth + 1, (code << 3) | c, budget, bins);
+	}
+
+	//! move the points of a bin file to the files of its 8 children, the bin
+	//! is replaced by the children holding points
+	static DAMONS_FILE_ERROR SplitBin(const std::string& directory, const TiledCloudGrid& grid, size_t blockSize, size_t bufferSize,
+		const TiledBin& bin, size_t& nextFile, std::vector<TiledBin>& children)
+	{
+		children.resize(8);
+		for (unsigned c = 0; c < 8; ++c)
+		{
+			children[c].code = (bin.code << 3) | c;
+			children[c].depth = bin.depth + 1;
+			children[c].count = 0;
+			children[c].file = nextFile++;
+		}
+
+		const unsigned shift = 3 * (s_keyDepth - bin.depth - 1);
+		TiledBinFiles files(directory, 8);
+		std::vector<std::vector<QuantizedPoint> > buffers(8);
+		bool written = true;
+		const std::string binPath = TiledBinFiles::path(directory, bin.file);
+		const bool read = ForEachBlock<QuantizedPoint>(binPath, blockSize, [&](const QuantizedPoint* points, size_t n)
+		{
+			for (size_t i = 0; i < n && written; ++i)
+			{
+				const unsigned c = static_cast<unsigned>((grid.key(points[i].xyz) >> shift) & 7);
+				buffers[c].push_back(points[i]);
+				++children[c].count;
+				if (buffers[c].size() >= bufferSize)
+				{
+					written = files.append(children[c].file, buffers[c]);
+					buffers[c].clear();
+				}
+			}
+		});
+		for (unsigned c = 0; c < 8 && written; ++c)
+		{
+			if (!buffers[c].empty())
+				written = files.append(children[c].file, buffers[c]);
+		}
+		written = files.closeAll() && written;
+		remove(binPath.c_str());
+
+		children.erase(std::remove_if(children.begin(), children.end(), [](const TiledBin& child)
+		{
+			return child.count == 0;
+		}), children.end());
+		if (!read)
+			return CC_FERR_READING;
+		return written ? CC_FERR_NO_ERROR : CC_FERR_WRITING;
+	}
+
+	//! split the sorted points [b, e) of a cell like DLodOctree, leaves own their range
+	static void SplitNodes(const std::vector<uint64_t>& keys, size_t b, size_t e, unsigned depth, int parent,
+		const TiledCloudConverter::Parameters& params, std::vector<TiledBuildNode>& nodes, std::vector<unsigned>& owner)
+	{
+		const unsigned shift = 3 * (s_keyDepth - depth);
+		const unsigned index = static_cast<unsigned>(nodes.size());
+		TiledBuildNode node;
+		node.code = keys[b] >> shift;
+		node.depth = depth;
+		node.parent = parent;
+		nodes.push_back(node);
+
+		if (e - b <= params.leafCapacity || depth >= params.maxDepth)
+		{
+			std::fill(owner.begin() + b, owner.begin() + e, index);
+			return;
+		}
+		const unsigned childShift = shift - 3;
+		for (size_t cb = b; cb < e;)
+		{
+			const uint64_t next = ((keys[cb] >> childShift) + 1) << childShift;
+			const size_t ce = std::lower_bound(keys.begin() + cb, keys.begin() + e, next) - keys.begin();
+			SplitNodes(keys, cb, ce, depth + 1, static_cast<int>(index), params, nodes, owner);
+			cb = ce;
+		}
+	}
+
+	//! write the points of a node: x y z, intensities, colors, padded to 4 bytes
+	static bool WriteNodePoints(FILE* fp, const std::vector<QuantizedPoint>& points, bool hasColors, bool hasIntensity, uint64_t& offset)
+	{
+		const size_t n = points.size();
+		std::vector<unsigned char> buffer(12 * n + (hasIntensity ? 4 * n : 0) + (hasColors ? 3 * n : 0) + 3, 0);
+		unsigned char* p = buffer.data();
+		for (size_t i = 0; i < n; ++i, p += 12)
+			memcpy(p, points[i].xyz, 12);
+		if (hasIntensity)
+		{
+			for (size_t i = 0; i < n; ++i, p += 4)
+				memcpy(p, &points[i].intensity, 4);
+		}
+		if (hasColors)
+		{
+			for (size_t i = 0; i < n; ++i, p += 3)
+				memcpy(p, points[i].rgb, 3);
+		}
+		const size_t bytes = (static_cast<size_t>(p - buffer.data()) + 3) & ~size_t(3);
+		if (bytes > 0 && fwrite(buffer.data(), 1, bytes, fp) != bytes)
+			return false;
+		offset += bytes;
+		return true;
+	}
+
+	static bool NodeLess(const TiledCloudNode& a, const TiledCloudNode& b)
+	{
+		return a.depth != b.depth ? a.depth < b.depth : a.code < b.code;
+	}
+
+	//! sort the nodes level by level, add the missing ancestors and link them
+	static void LinkNodes(std::vector<TiledCloudNode>& nodes)
+	{
+		std::sort(nodes.begin(), nodes.end(), NodeLess);
+		for (;;)
+		{
+			std::vector<TiledCloudNode> missing;
+			for (size_t i = 0; i < nodes.size(); ++i)
+			{
+				if (nodes[i].depth == 0)
+					continue;
+				TiledCloudNode parent;
+				memset(&parent, 0, sizeof(parent));
+				parent.depth = nodes[i].depth - 1;
+				parent.code = nodes[i].code >> 3;
+				if (!missing.empty() && !NodeLess(missing.back(), parent) && !NodeLess(parent, missing.back()))
+					continue;
+				if (!std::binary_search(nodes.begin(), nodes.end(), parent, NodeLess))
+					missing.push_back(parent);
+			}
+			if (missing.empty())
+				break;
+			nodes.insert(nodes.end(), missing.begin(), missing.end());
+			std::sort(nodes.begin(), nodes.end(), NodeLess);
+		}
+
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			nodes[i].parent = -1;
+			nodes[i].firstChild = -1;
+			nodes[i].childCount = 0;
+			nodes[i].total = nodes[i].count;
+			if (nodes[i].depth == 0)
+				continue;
+			TiledCloudNode key;
+			key.depth = nodes[i].depth - 1;
+			key.code = nodes[i].code >> 3;
+			const size_t p = std::lower_bound(nodes.begin(), nodes.begin() + i, key, NodeLess) - nodes.begin();
+			nodes[i].parent = static_cast<int32_t>(p);
+			if (nodes[p].firstChild < 0)
+				nodes[p].firstChild = static_cast<int32_t>(i);
+			++nodes[p].childCount;
+		}
+		for (size_t i = nodes.size(); i-- > 1;)
+			nodes[nodes[i].parent].total += nodes[i].total;
+	}
+
+	DAMONS_FILE_ERROR TiledCloudConverter::convert(const std::string& filename, const std::string& directory, const Parameters& parameters)
+	{
+		Parameters params = parameters;
+		params.sampleDepth = std::min(params.sampleDepth, s_keyDepth);
+		params.maxDepth = std::min(params.maxDepth, s_keyDepth - params.sampleDepth);
+		params.leafCapacity = std::max(1u, params.leafCapacity);
+		params.memoryBudget = std::max<size_t>(params.memoryBudget, params.leafCapacity);
+		params.chunkSize = std::max<size_t>(params.chunkSize, 1);
+		if (!(params.precision > 0))
+			params.precision = 0.001;
+
+		MakeDirectory(directory);
+		const std::string rawPath = JoinPath(directory, "points.tmp");
+
+		/*******************************/
+		/***  raw copy and bounding  ***/
+		/*******************************/
+		FILE* raw = fopen(rawPath.c_str(), "wb");
+		if (!raw)
+			return CC_FERR_WRITING;
+
+		double lo[3], hi[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			lo[a] = std::numeric_limits<double>::max();
+			hi[a] = -std::numeric_limits<double>::max();
+		}
+		uint64_t pointCount = 0;
+		bool hasColors = false, hasIntensity = false, writeError = false;
+		std::vector<RawPoint> block;
+		DAMONS_FILE_ERROR error = FileIOFilter::StreamPointsFromFile(filename, params.chunkSize, [&](const PointChunk& chunk)
+		{
+			const size_t n = chunk.size();
+			if (pointCount == 0)
+			{
+				hasColors = !chunk.rgb.empty();
+				hasIntensity = !chunk.intensity.empty();
+			}
+			const bool chunkColors = chunk.rgb.size() == 3 * n;
+			const bool chunkIntensity = chunk.intensity.size() == n;
+			block.resize(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				RawPoint& p = block[i];
+				for (int a = 0; a < 3; ++a)
+				{
+					p.xyz[a] = chunk.xyz[3 * i + a];
+					lo[a] = std::min(lo[a], p.xyz[a]);
+					hi[a] = std::max(hi[a], p.xyz[a]);
+					p.rgb[a] = chunkColors ? chunk.rgb[3 * i + a] : 0;
+				}
+				p.intensity = chunkIntensity ? chunk.intensity[i] : 0.0f;
+				p.pad = 0;
+			}
+			if (fwrite(block.data(), sizeof(RawPoint), n, raw) != n)
+			{
+				writeError = true;
+				return false;
+			}
+			pointCount += n;
+			return true;
+		});
+		fclose(raw);
+		std::vector<RawPoint>().swap(block);
+		if (writeError)
+			error = CC_FERR_WRITING;
+		if (error != CC_FERR_NO_ERROR)
+		{
+			remove(rawPath.c_str());
+			return error;
+		}
+
+		TiledCloudGrid grid;
+		grid.size = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+		if (!(grid.size > 0))
+			grid.size = 1.0;
+		for (int a = 0; a < 3; ++a)
+			grid.origin[a] = lo[a];
+		//the quantized coordinates must fit in 31 bits
+		grid.step = std::max(params.precision, grid.size / 2147483000.0);
+
+		/**************************/
+		/***  bins of the grid  ***/
+		/**************************/
+		const unsigned binDepth = std::min(s_binDepth, params.maxDepth);
+		const unsigned binShift = 3 * (s_keyDepth - binDepth);
+		const size_t cellCount = size_t(1) << (3 * binDepth);
+		std::vector<uint64_t> prefix(cellCount + 1, 0);
+		const size_t blockSize = params.chunkSize;
+		bool ok = ForEachBlock<RawPoint>(rawPath, blockSize, [&](const RawPoint* points, size_t n)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				int32_t q[3];
+				grid.quantize(points[i].xyz, q);
+				++prefix[(grid.key(q) >> binShift) + 1];
+			}
+		});
+		if (!ok)
+		{
+			remove(rawPath.c_str());
+			return CC_FERR_READING;
+		}
+		for (size_t c = 0; c < cellCount; ++c)
+			prefix[c + 1] += prefix[c];
+
+		std::vector<TiledBin> bins;
+		CutBins(prefix, binDepth, 0, 0, params.memoryBudget, bins);
+		size_t nextFile = bins.size();
+		std::vector<unsigned> binOfCell(cellCount, 0);
+		for (size_t b = 0; b < bins.size(); ++b)
+		{
+			const unsigned shift = 3 * (binDepth - bins[b].depth);
+			std::fill(binOfCell.begin() + (bins[b].code << shift), binOfCell.begin() + ((bins[b].code + 1) << shift), static_cast<unsigned>(b));
+		}
+		std::vector<uint64_t>().swap(prefix);
+
+		auto cleanup = [&]()
+		{
+			remove(rawPath.c_str());
+			for (size_t file = 0; file < nextFile; ++file)
+				remove(TiledBinFiles::path(directory, file).c_str());
+			for (unsigned d = 0; d < params.maxDepth; ++d)
+				remove(NumberedPath(directory, "level_", d, ".tmp").c_str());
+		};
+
+		//quantized points are appended to their bin through small buffers
+		const size_t bufferSize = std::min<size_t>(std::max<size_t>(params.memoryBudget / (4 * bins.size()), 256), 1 << 16);
+		{
+			TiledBinFiles files(directory, s_openBinFiles);
+			std::vector<std::vector<QuantizedPoint> > buffers(bins.size());
+			auto flush = [&](size_t b)
+			{
+				const bool written = files.append(bins[b].file, buffers[b]);
+				buffers[b].clear();
+				return written;
+			};
+
+			ok = ForEachBlock<RawPoint>(rawPath, blockSize, [&](const RawPoint* points, size_t n)
+			{
+				for (size_t i = 0; i < n && !writeError; ++i)
+				{
+					QuantizedPoint p;
+					grid.quantize(points[i].xyz, p.xyz);
+					p.intensity = points[i].intensity;
+					memcpy(p.rgb, points[i].rgb, 3);
+					p.pad = 0;
+					const unsigned b = binOfCell[grid.key(p.xyz) >> binShift];
+					buffers[b].push_back(p);
+					if (buffers[b].size() >= bufferSize)
+						writeError = !flush(b);
+				}
+			});
+			for (size_t b = 0; b < bins.size() && !writeError; ++b)
+			{
+				if (!buffers[b].empty())
+					writeError = !flush(b);
+			}
+			writeError = !files.closeAll() || writeError;
+		}
+		remove(rawPath.c_str());
+		if (!ok || writeError)
+		{
+			cleanup();
+			return ok ? CC_FERR_WRITING : CC_FERR_READING;
+		}
+
+		/****************************/
+		/***  tiles, bin by bin  ***/
+		/****************************/
+		std::vector<TiledCloudNode> nodes;
+		//the samples above a bin, split bins are deeper than binDepth
+		std::vector<FILE*> levelFiles(params.maxDepth, nullptr);
+		auto levelFile = [&](unsigned d)
+		{
+			if (!levelFiles[d])
+				levelFiles[d] = fopen(NumberedPath(directory, "level_", d, ".tmp").c_str(), "wb");
+			return levelFiles[d];
+		};
+
+		uint64_t previousKey = 0;
+		error = CC_FERR_NO_ERROR;
+		for (size_t b = 0; b < bins.size() && !writeError && error == CC_FERR_NO_ERROR; ++b)
+		{
+			//a bin over the budget is split on disk until it fits, a cell of
+			//maxDepth is never split by SplitNodes either and is loaded whole
+			while (bins[b].count > params.memoryBudget && bins[b].depth < params.maxDepth)
+			{
+				std::vector<TiledBin> children;
+				error = SplitBin(directory, grid, blockSize, bufferSize, bins[b], nextFile, children);
+				if (error != CC_FERR_NO_ERROR)
+					break;
+				bins.erase(bins.begin() + b);
+				bins.insert(bins.begin() + b, children.begin(), children.end());
+			}
+			if (error != CC_FERR_NO_ERROR)
+				break;
+
+			const TiledBin& bin = bins[b];
+			const size_t n = static_cast<size_t>(bin.count);
+			std::vector<QuantizedPoint> points;
+			std::vector<uint64_t> keys;
+			std::vector<unsigned> order;
+			try
+			{
+				points.resize(n);
+				keys.resize(n);
+				order.resize(n);
+			}
+			catch (const std::bad_alloc&)
+			{
+				error = CC_FERR_NOT_ENOUGH_MEMORY;
+				break;
+			}
+
+			const std::string binPath = TiledBinFiles::path(directory, bin.file);
+			FILE* fp = fopen(binPath.c_str(), "rb");
+			if (!fp || fread(points.data(), sizeof(QuantizedPoint), n, fp) != n)
+				error = CC_FERR_READING;
+			if (fp)
+				fclose(fp);
+			remove(binPath.c_str());
+			if (error != CC_FERR_NO_ERROR)
+				break;
+
+			DMath::ParallelFor(0, n, [&](size_t i)
+			{
+				keys[i] = grid.key(points[i].xyz);
+				order[i] = static_cast<unsigned>(i);
+			}, 1 << 14);
+			DMath::ParallelRadixSort(keys, order, 3 * s_keyDepth);
+
+			//levels follow the Morton order of the whole cloud
+			std::vector<unsigned char> levels(n);
+			for (size_t s = 0; s < n; ++s)
+			{
+				if (s == 0 && b == 0)
+					levels[s] = 0;
+				else
+					levels[s] = SampleLevel(keys[s], s > 0 ? keys[s - 1] : previousKey, params.sampleDepth);
+			}
+			previousKey = keys[n - 1];
+
+			//samples of the cells above the bin go to the coarse levels
+			for (size_t s = 0; s < n && !writeError; ++s)
+			{
+				if (levels[s] < bin.depth)
+				{
+					FILE* lf = levelFile(levels[s]);
+					writeError = !lf || fwrite(&points[order[s]], sizeof(QuantizedPoint), 1, lf) != 1;
+				}
+			}
+
+			std::vector<TiledBuildNode> local;
+			std::vector<unsigned> owner(n);
+			SplitNodes(keys, 0, n, bin.depth, -1, params, local, owner);
+			std::vector<size_t> counts(local.size() + 1, 0);
+			for (size_t s = 0; s < n; ++s)
+			{
+				if (levels[s] < bin.depth)
+					continue;
+				unsigned o = owner[s];
+				while (local[o].depth > levels[s])
+					o = static_cast<unsigned>(local[o].parent);
+				owner[s] = o;
+				++counts[o + 1];
+			}
+			for (size_t k = 0; k < local.size(); ++k)
+				counts[k + 1] += counts[k];
+			std::vector<unsigned> sorted(counts[local.size()]);
+			{
+				std::vector<size_t> next(counts.begin(), counts.end() - 1);
+				for (size_t s = 0; s < n; ++s)
+				{
+					if (levels[s] >= bin.depth)
+						sorted[next[owner[s]]++] = order[s];
+				}
+			}
+
+			const unsigned tile = static_cast<unsigned>(b + 1);
+			FILE* tf = fopen(NumberedPath(directory, "tile_", tile, ".bin").c_str(), "wb");
+			if (!tf)
+			{
+				writeError = true;
+				break;
+			}
+			uint64_t offset = 0;
+			std::vector<QuantizedPoint> nodePoints;
+			for (size_t k = 0; k < local.size() && !writeError; ++k)
+			{
+				nodePoints.clear();
+				for (size_t s = counts[k]; s < counts[k + 1]; ++s)
+					nodePoints.push_back(points[sorted[s]]);
+				TiledCloudNode node;
+				memset(&node, 0, sizeof(node));
+				node.code = local[k].code;
+				node.depth = local[k].depth;
+				node.tile = tile;
+				node.offset = offset;
+				node.count = nodePoints.size();
+				writeError = !WriteNodePoints(tf, nodePoints, hasColors, hasIntensity, offset);
+				nodes.push_back(node);
+			}
+			fclose(tf);
+		}
+		std::vector<bool> levelUsed(levelFiles.size(), false);
+		for (unsigned d = 0; d < levelFiles.size(); ++d)
+		{
+			if (!levelFiles[d])
+				continue;
+			levelUsed[d] = true;
+			writeError = fclose(levelFiles[d]) != 0 || writeError;
+		}
+
+		/************************/
+		/***  coarse levels  ***/
+		/************************/
+		//the points of a level are in Morton order, a node is a run of equal cells
+		if (!writeError && error == CC_FERR_NO_ERROR)
+		{
+			FILE* tf = fopen(NumberedPath(directory, "tile_", 0, ".bin").c_str(), "wb");
+			writeError = !tf;
+			uint64_t offset = 0;
+			for (unsigned d = 0; d < levelUsed.size() && !writeError && error == CC_FERR_NO_ERROR; ++d)
+			{
+				if (!levelUsed[d])
+					continue;
+				const unsigned shift = 3 * (s_keyDepth - d);
+				std::vector<QuantizedPoint> nodePoints;
+				uint64_t code = 0;
+				auto flushNode = [&]()
+				{
+					if (nodePoints.empty())
+						return;
+					TiledCloudNode node;
+					memset(&node, 0, sizeof(node));
+					node.code = code;
+					node.depth = d;
+					node.tile = 0;
+					node.offset = offset;
+					node.count = nodePoints.size();
+					writeError = writeError || !WriteNodePoints(tf, nodePoints, hasColors, hasIntensity, offset);
+					nodes.push_back(node);
+					nodePoints.clear();
+				};
+				ok = ForEachBlock<QuantizedPoint>(NumberedPath(directory, "level_", d, ".tmp"), blockSize, [&](const QuantizedPoint* points, size_t n)
+				{
+					for (size_t i = 0; i < n; ++i)
+					{
+						const uint64_t c = grid.key(points[i].xyz) >> shift;
+						if (c != code)
+							flushNode();
+						code = c;
+						nodePoints.push_back(points[i]);
+					}
+				});
+				flushNode();
+				if (!ok)
+					error = CC_FERR_READING;
+			}
+			if (tf)
+				fclose(tf);
+		}
+		cleanup();
+		if (writeError)
+			return CC_FERR_WRITING;
+		if (error != CC_FERR_NO_ERROR)
+			return error;
+
+		/********************/
+		/***  hierarchy  ***/
+		/********************/
+		LinkNodes(nodes);
+
+		TiledCloudHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, s_magic, 4);
+		header.version = s_version;
+		header.attributes = (hasColors ? s_colorsFlag : 0) | (hasIntensity ? s_intensityFlag : 0);
+		header.sampleDepth = params.sampleDepth;
+		for (int a = 0; a < 3; ++a)
+			header.origin[a] = grid.origin[a];
+		header.size = grid.size;
+		header.step = grid.step;
+		header.pointCount = pointCount;
+		header.nodeCount = nodes.size();
+		header.tileCount = static_cast<uint32_t>(bins.size() + 1);
+
+		FILE* hf = fopen(JoinPath(directory, "cloud.hierarchy").c_str(), "wb");
+		if (!hf)
+			return CC_FERR_WRITING;
+		const bool written = fwrite(&header, sizeof(header), 1, hf) == 1
+			&& fwrite(nodes.data(), sizeof(TiledCloudNode), nodes.size(), hf) == nodes.size();
+		fclose(hf);
+
+		return written ? CC_FERR_NO_ERROR : CC_FERR_WRITING;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
+	//! read only mapping of a whole file
+	class TiledCloudReader::MappedFile
+	{
+	public:
+		MappedFile() : m_data(nullptr), m_length(0)
+#if defined _WIN32
+			, m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+		{}
+
+		~MappedFile()
+		{
+#if defined _WIN32
+			if (m_data)
+				UnmapViewOfFile(m_data);
+			if (m_mapping)
+				CloseHandle(m_mapping);
+			if (m_file != INVALID_HANDLE_VALUE)
+				CloseHandle(m_file);
+#else
+			if (m_data)
+				munmap(m_data, m_length);
+#endif
+		}
+
+		bool open(const std::string& path)
+		{
+#if defined _WIN32
+			m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size))
+				return false;
+			m_length = static_cast<size_t>(size.QuadPart);
+			if (m_length == 0)
+				return true;
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_mapping)
+				return false;
+			m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			return m_data != nullptr;
+#else
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat info;
+			if (fstat(fd, &info) != 0)
+			{
+				::close(fd);
+				return false;
+			}
+			m_length = static_cast<size_t>(info.st_size);
+			if (m_length > 0)
+			{
+				void* data = mmap(nullptr, m_length, PROT_READ, MAP_SHARED, fd, 0);
+				m_data = (data == MAP_FAILED) ? nullptr : data;
+			}
+			::close(fd);
+			return m_length == 0 || m_data != nullptr;
+#endif
+		}
+
+		const unsigned char* data() const { return static_cast<const unsigned char*>(m_data); }
+		size_t length() const { return m_length; }
+
+	protected:
+		void* m_data;
+		size_t m_length;
+#if defined _WIN32
+		HANDLE m_file;
+		HANDLE m_mapping;
+#endif
+	};
+
+	TiledCloudReader::TiledCloudReader()
+		: m_size(1.0)
+		, m_step(1.0)
+		, m_pointCount(0)
+		, m_sampleDepth(0)
+		, m_hasColors(false)
+		, m_hasIntensity(false)
+	{
+		m_origin[0] = m_origin[1] = m_origin[2] = 0.0;
+	}
+
+	TiledCloudReader::~TiledCloudReader()
+	{
+		close();
+	}
+
+	void TiledCloudReader::close()
+	{
+		m_tiles.clear();
+		m_nodes.clear();
+		m_directory.clear();
+		m_pointCount = 0;
+	}
+
+	DAMONS_FILE_ERROR TiledCloudReader::open(const std::string& directory)
+	{
+		close();
+
+		FILE* fp = fopen(JoinPath(directory, "cloud.hierarchy").c_str(), "rb");
+		if (!fp)
+			return CC_FERR_READING;
+
+		TiledCloudHeader header;
+		if (fread(&header, sizeof(header), 1, fp) != 1)
+		{
+			fclose(fp);
+			return CC_FERR_MALFORMED_FILE;
+		}
+		if (memcmp(header.magic, s_magic, 4) != 0 || header.version != s_version)
+		{
+			fclose(fp);
+			return CC_FERR_WRONG_FILE_TYPE;
+		}
+		try
+		{
+			m_nodes.resize(static_cast<size_t>(header.nodeCount));
+		}
+		catch (const std::bad_alloc&)
+		{
+			fclose(fp);
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+		const bool complete = fread(m_nodes.data(), sizeof(TiledCloudNode), m_nodes.size(), fp) == m_nodes.size();
+		fclose(fp);
+		if (!complete || m_nodes.empty())
+		{
+			m_nodes.clear();
+			return CC_FERR_MALFORMED_FILE;
+		}
+
+		m_directory = directory;
+		m_tiles.assign(header.tileCount, std::shared_ptr<MappedFile>());
+		for (int a = 0; a < 3; ++a)
+			m_origin[a] = header.origin[a];
+		m_size = header.size;
+		m_step = header.step;
+		m_pointCount = header.pointCount;
+		m_sampleDepth = header.sampleDepth;
+		m_hasColors = (header.attributes & s_colorsFlag) != 0;
+		m_hasIntensity = (header.attributes & s_intensityFlag) != 0;
+
+		return CC_FERR_NO_ERROR;
+	}
+
+	void TiledCloudReader::getNodeBox(size_t node, double minCorner[3], double maxCorner[3]) const
+	{
+		const TiledCloudNode& nd = m_nodes[node];
+		uint32_t c[3];
+		DMath::MortonDecode3(nd.code, c[0], c[1], c[2]);
+		const double cell = m_size / double(uint64_t(1) << nd.depth);
+		for (int a = 0; a < 3; ++a)
+		{
+			minCorner[a] = m_origin[a] + c[a] * cell;
+			maxCorner[a] = minCorner[a] + cell;
+		}
+	}
+
+	double TiledCloudReader::getNodeSpacing(size_t node) const
+	{
+		return m_size / double(uint64_t(1) << (m_nodes[node].depth + m_sampleDepth));
+	}
+
+	uint64_t TiledCloudReader::queryNodes(const double minCorner[3], const double maxCorner[3], unsigned maxDepth, std::vector<unsigned>& nodes) const
+	{
+		nodes.clear();
+		if (m_nodes.empty())
+			return 0;
+
+		//breadth first, a node is kept when its cell meets the box
+		uint64_t points = 0;
+		std::vector<unsigned> front(1, 0u);
+		while (!front.empty())
+		{
+			std::vector<unsigned> next;
+			for (size_t k = 0; k < front.size(); ++k)
+			{
+				const unsigned n = front[k];
+				double lo[3], hi[3];
+				getNodeBox(n, lo, hi);
+				bool inside = true;
+				for (int a = 0; a < 3 && inside; ++a)
+					inside = lo[a] <= maxCorner[a] && hi[a] >= minCorner[a];
+				if (!inside)
+					continue;
+				nodes.push_back(n);
+				points += m_nodes[n].count;
+				if (m_nodes[n].depth >= maxDepth || m_nodes[n].firstChild < 0)
+					continue;
+				for (uint32_t c = 0; c < m_nodes[n].childCount; ++c)
+					next.push_back(static_cast<unsigned>(m_nodes[n].firstChild + c));
+			}
+			front.swap(next);
+		}
+		return points;
+	}
+
+	const unsigned char* TiledCloudReader::mapTile(unsigned tile, size_t& length)
+	{
+		length = 0;
+		if (tile >= m_tiles.size())
+			return nullptr;
+		if (!m_tiles[tile])
+		{
+			std::shared_ptr<MappedFile> file(new MappedFile);
+			if (!file->open(NumberedPath(m_directory, "tile_", tile, ".bin")))
+				return nullptr;
+			m_tiles[tile] = file;
+		}
+		length = m_tiles[tile]->length();
+		return m_tiles[tile]->data();
+	}
+
+	DMeshLib::PointCloudModel* TiledCloudReader::loadNodes(const std::vector<unsigned>& nodes, const double* minCorner, const double* maxCorner)
+	{
+		uint64_t count = 0;
+		for (size_t k = 0; k < nodes.size(); ++k)
+		{
+			if (nodes[k] >= m_nodes.size())
+				return nullptr;
+			count += m_nodes[nodes[k]].count;
+		}
+
+		DMeshLib::PointCloudModel* cloud = new DMeshLib::PointCloudModel("tiled-cloud");
+		try
+		{
+			cloud->reserve(static_cast<size_t>(count));
+		}
+		catch (const std::bad_alloc&)
+		{
+			delete cloud;
+			return nullptr;
+		}
+
+		for (size_t k = 0; k < nodes.size(); ++k)
+		{
+			const TiledCloudNode& node = m_nodes[nodes[k]];
+			if (node.count == 0)
+				continue;
+			const size_t n = static_cast<size_t>(node.count);
+			const size_t bytes = n * (12 + (m_hasIntensity ? 4 : 0) + (m_hasColors ? 3 : 0));
+			size_t length = 0;
+			const unsigned char* data = mapTile(node.tile, length);
+			if (!data || node.offset + bytes > length)
+			{
+				delete cloud;
+				return nullptr;
+			}
+
+			const unsigned char* xyz = data + node.offset;
+			const unsigned char* intensity = xyz + 12 * n;
+			const unsigned char* rgb = intensity + (m_hasIntensity ? 4 * n : 0);
+			for (size_t i = 0; i < n; ++i)
+			{
+				int32_t q[3];
+				memcpy(q, xyz + 12 * i, 12);
+				double p[3];
+				bool inside = true;
+				for (int a = 0; a < 3; ++a)
+				{
+					p[a] = m_origin[a] + q[a] * m_step;
+					if (minCorner && maxCorner)
+						inside = inside && p[a] >= minCorner[a] && p[a] <= maxCorner[a];
+				}
+				if (!inside)
+					continue;
+
+				cloud->addPoint(static_cast<DMeshLib::cloud_type>(p[0]), static_cast<DMeshLib::cloud_type>(p[1]), static_cast<DMeshLib::cloud_type>(p[2]));
+				if (m_hasIntensity)
+				{
+					float v;
+					memcpy(&v, intensity + 4 * i, 4);
+					cloud->addPointIntensity(static_cast<DMeshLib::cloud_type>(v));
+				}
+				if (m_hasColors)
+					cloud->addPointColor(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+			}
+		}
+
+		cloud->refreshBoundBox();
+		return cloud;
+	}
+
+	DMeshLib::PointCloudModel* TiledCloudReader::loadBox(const double minCorner[3], const double maxCorner[3], unsigned maxDepth)
+	{
+		std::vector<unsigned> nodes;
+		queryNodes(minCorner, maxCorner, maxDepth, nodes);
+		return loadNodes(nodes, minCorner, maxCorner);
+	}
+
+	DMeshLib::PointCloudModel* TiledCloudReader::loadLevel(unsigned maxDepth)
+	{
+		std::vector<unsigned> nodes;
+		const double lo[3] = { -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max() };
+		const double hi[3] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		queryNodes(lo, hi, maxDepth, nodes);
+		return loadNodes(nodes);
+	}
+}
@@ -1,9 +1,75 @@
 #include "..\include\FileIOFilter.h"
+#include "..\include\AsciiFilter.h"
 #include "..\..\DamonsDataBase\include\MeshModel.h"
+#include "..\..\DamonsDataBase\include\PointCloudModel.h"
 #include<iostream>
+#include<cmath>
 using namespace DMeshLib;
+
+//save clouds with every combination of columns to ASCII and read them back
+static bool CheckAsciiRoundTrip() {
+	bool ok = true;
+	for (int mask = 0; mask < 16; ++mask) {
+		PointCloudModel cloud("round_trip");
+		const bool intensity = (mask & 1) != 0, colors = (mask & 2) != 0, normals = (mask & 4) != 0;
+		const int sfCount = (mask & 8) ? 2 : 1;
+		for (int k = 0; k < sfCount; ++k)
+			cloud.addScalarField(k ? "second field" : "height");
+		for (int i = 0; i < 100; ++i) {
+			cloud.addPoint(cloud_type(i), cloud_type(0.5 * i), cloud_type(-i));
+			if (intensity)
+				cloud.addPointIntensity(cloud_type(i % 7));
+			if (colors)
+				cloud.addPointColor(color_type(i), color_type(2 * i), color_type(255 - i));
+			if (normals)
+				cloud.addPointNormal(0, 0, 1);
+			for (int k = 0; k < sfCount; ++k)
+				cloud.getScalarField(k).values.push_back(cloud_type(i + k));
+		}
+
+		DamonsIO::AsciiFilter filter;
+		DamonsIO::FileIOFilter::SaveParameters saveParameters;
+		DamonsIO::FileIOFilter::LoadParameters loadParameters;
+		ModelObject* loaded = nullptr;
+		const std::string filename = "../data/round_trip.asc";
+		if (filter.saveToFile(&cloud, filename, saveParameters) != DamonsIO::CC_FERR_NO_ERROR
+			|| filter.loadFile(filename, loaded, loadParameters) != DamonsIO::CC_FERR_NO_ERROR || !loaded) {
+			std::cout << "ascii round trip " << mask << ": save or load failed" << std::endl;
+			ok = false;
+			continue;
+		}
+		std::remove(filename.c_str());
+
+		PointCloudModel* back = static_cast<PointCloudModel*>(loaded);
+		bool same = back->size() == cloud.size() && back->hasPointIntensity() == intensity
+			&& back->hasPointColors() == colors && back->hasPointNormals() == normals
+			&& back->getScalarFieldNumber() == cloud.getScalarFieldNumber();
+		for (unsigned k = 0; same && k < cloud.getScalarFieldNumber(); ++k) {
+			same = back->getScalarField(k).values == cloud.getScalarField(k).values;
+			if (k == 0)
+				same = same && back->getScalarField(k).name == "height";
+		}
+		for (size_t i = 0; same && i < cloud.size(); ++i) {
+			for (int a = 0; a < 3; ++a)
+				same = same && back->getPointData()[3 * i + a] == cloud.getPointData()[3 * i + a];
+			if (intensity)
+				same = same && back->getPointIntensity(i) == cloud.getPointIntensity(i);
+			if (colors)
+				same = same && back->getColorData()[3 * i + 2] == cloud.getColorData()[3 * i + 2];
+		}
+		if (!same) {
+			std::cout << "ascii round trip " << mask << ": the cloud read back differs" << std::endl;
+			ok = false;
+		}
+		delete loaded;
+	}
+	return ok;
+}
+
 int main(int argc, char **argv) {
 
+	std::cout << "ascii round trip " << (CheckAsciiRoundTrip() ? "passed" : "FAILED") << std::endl;
+
 	DamonsIO::FileIOFilter::InitInternalFilters();
 	
 	auto curfilter = DamonsIO::FileIOFilter::FindBestFilterForExtension("3ds");
@@ -0,0 +1,586 @@
+//
+//  DamonsConstrainedDelaunay.h
+//  DPolygonTest
+//
+
+#ifndef DamonsConstrainedDelaunay_h
+#define DamonsConstrainedDelaunay_h
+
+#include "DamonsDelaunay.h"
+#include "DamonsPolygon.h"
+#include <map>
+
+/// constrained Delaunay triangulation: segments (breaklines) and polygon
+/// rings are edges of the triangulation, the other edges are Delaunay as far
+/// as the constraints allow. the triangles out of the rings are removed.
+template < class T = double>
+class DConstrainedDelaunay : public DDelaunay<T>{
+public:
+    using typename DDelaunay<T>::DPoint2;
+protected:
+    using typename DDelaunay<T>::Face;
+    using DDelaunay<T>::Ghost;
+    using DDelaunay<T>::m_points;
+    using DDelaunay<T>::m_faces;
+    using DDelaunay<T>::m_fixed;
+    using DDelaunay<T>::m_start;
+    using DDelaunay<T>::m_mark;
+    using DDelaunay<T>::m_stamp;
+
+    /// constraint flags of an edge
+    enum { FixedEdge = 1, BorderEdge = 2 };
+
+    struct Segment {
+        unsigned int a;
+        unsigned int b;
+        unsigned int flags;
+    };
+
+public:
+    DConstrainedDelaunay(){}
+    DConstrainedDelaunay(std::vector<DPoint2 > &points) : DDelaunay<T>(points) {}
+
+    /// @brief add a point
+    /// @return its index, for AddSegment and GetTriangle
+    unsigned int AddPoint(const DPoint2 &p){
+        if(m_points.size() < 3)
+            m_points.resize(3);
+        m_points.push_back(p);
+        return static_cast<unsigned int >(m_points.size() - 4);
+    }
+
+    /// @brief a breakline between two points, kept as edges of the triangles
+    void AddSegment(unsigned int a, unsigned int b){
+        Segment s = { a + 3, b + 3, FixedEdge };
+        m_segments.push_back(s);
+    }
+
+    /// @brief a ring of the domain border: an outline, a hole, an island in
+    /// a hole... the domain is the part inside an odd number of rings, the
+    /// ring orientation does not matter
+    void AddPolygon(const DGraphic::DPolygon<T> &ring){
+        const unsigned int count = ring.GetPolygonPointSize();
+        if(count < 3)
+            return;
+        const unsigned int first = AddPoint(ring.GetPolygonPoint(0));
+        for(unsigned int i = 1; i < count; ++i)
+            AddPoint(ring.GetPolygonPoint(i));
+        for(unsigned int i = 0; i < count; ++i){
+            Segment s = { first + i + 3, first + (i + 1) % count + 3, FixedEdge | BorderEdge };
+            m_segments.push_back(s);
+        }
+    }
+
+    /// @brief constrained Delaunay triangulation of the points and segments
+    ///
+    /// the points are triangulated first, then every segment is inserted on
+    /// its own: the triangles it crosses are found by a walk from its first
+    /// end and removed, and the two sides of the segment are triangulated
+    /// again, so the cost follows the number of crossed triangles. a segment
+    /// through a point is split there, a segment crossing a constrained
+    /// edge is split at a new point where they meet (GetPointCount grows).
+    /// when rings were added, the triangles are flooded from out of the hull
+    /// and only those inside an odd number of rings are kept.
+    void ConstrainedTriangulate(){
+        m_faces.clear();
+        m_fixed.clear();
+        if(!this->Build()){
+            m_faces.clear();
+            Release();
+            return;
+        }
+        m_fixed.assign(m_faces.size(), 0);
+
+        std::vector<unsigned int > alias;
+        Aliases(alias);
+        bool border = false;
+        for(size_t i = 0; i < m_segments.size(); ++i){
+            const Segment &s = m_segments[i];
+            InsertSegment(alias[s.a], alias[s.b], s.flags);
+            border = border || (s.flags & BorderEdge);
+        }
+
+        std::vector<char > keep(m_faces.size());
+        if(border)
+            Domain(keep);
+        else{
+            for(size_t f = 0; f < m_faces.size(); ++f)
+                keep[f] = DDelaunay<T>::GhostCorner(m_faces[f]) < 0;
+        }
+        this->KeepTriangles(keep);
+        Release();
+    }
+
+protected:
+    /// @brief the inserted copy of every point, duplicates are skipped by the insertion
+    void Aliases(std::vector<unsigned int > &alias) const {
+        alias.resize(m_points.size());
+        std::iota(alias.begin(), alias.end(), 0u);
+        bool duplicates = false;
+        for(size_t v = 3; v < m_points.size() && !duplicates; ++v)
+            duplicates = m_start[v] < 0;
+        if(!duplicates)
+            return;
+        std::map<std::pair<T, T>, unsigned int > inserted;
+        for(size_t v = 3; v < m_points.size(); ++v){
+            if(m_start[v] >= 0)
+                inserted[std::make_pair(m_points[v].x(), m_points[v].y())] = static_cast<unsigned int >(v);
+        }
+        for(size_t v = 3; v < m_points.size(); ++v){
+            if(m_start[v] < 0)
+                alias[v] = inserted[std::make_pair(m_points[v].x(), m_points[v].y())];
+        }
+    }
+
+    /// @brief true when v, on the line ab, is on the side of b from a
+    bool Ahead(unsigned int a, unsigned int b, unsigned int v) const {
+        const DPoint2 &pa = m_points[a], &pb = m_points[b], &pv = m_points[v];
+        if(pa.x() != pb.x())
+            return pv.x() != pa.x() && ((pv.x() > pa.x()) == (pb.x() > pa.x()));
+        return pv.y() != pa.y() && ((pv.y() > pa.y()) == (pb.y() > pa.y()));
+    }
+
+    /// @brief corner of a vertex in a triangle
+    int Corner(int f, unsigned int v) const {
+        const Face &face = m_faces[f];
+        return face.v[0] == v ? 0 : (face.v[1] == v ? 1 : 2);
+    }
+
+    /// @brief set the constraint flags of the edge opposite to corner k, on both sides
+    void MarkEdge(int f, int k, unsigned int flags){
+        this->SetEdgeFlags(f, k, flags);
+        const Face &face = m_faces[f];
+        const int nb = face.n[k];
+        if(nb < 0)
+            return;
+        const unsigned int a = face.v[(k + 1) % 3], b = face.v[(k + 2) % 3];
+        const Face &other = m_faces[nb];
+        for(int j = 0; j < 3; ++j){
+            if(other.v[j] != a && other.v[j] != b)
+                this->SetEdgeFlags(nb, j, flags);
+        }
+    }
+
+    /// @brief add constraint flags to the edge opposite to corner k
+    void FixEdge(int f, int k, unsigned int flags){
+        MarkEdge(f, k, this->EdgeFlags(f, k) | flags);
+    }
+
+    void Push(unsigned int a, unsigned int b, unsigned int flags){
+        Segment s = { a, b, flags };
+        m_pending.push_back(s);
+    }
+
+    /// @brief flip the edge opposite to corner k and the free edges around
+    /// it until they are Delaunay again
+    void Legalize(int f0, int k0){
+        m_flips.clear();
+        m_flips.push_back(std::make_pair(f0, k0));
+        while(!m_flips.empty()){
+            const int f = m_flips.back().first, k = m_flips.back().second;
+            m_flips.pop_back();
+            const int g = m_faces[f].n[k];
+            if(g < 0 || this->EdgeFlags(f, k) != 0 || DDelaunay<T>::GhostCorner(m_faces[f]) >= 0 || DDelaunay<T>::GhostCorner(m_faces[g]) >= 0)
+                continue;
+            const Face F = m_faces[f], G = m_faces[g];
+            int j = 0;
+            while(G.n[j] != f)
+                ++j;
+            const unsigned int p = F.v[k], q = F.v[(k + 1) % 3], r = F.v[(k + 2) % 3], s = G.v[j];
+            if(this->InCircle(m_points[p], m_points[q], m_points[r], m_points[s]) <= 0)
+                continue;
+            // p q r and s r q become p q s and p s r
+            const int rp = F.n[(k + 1) % 3], pq = F.n[(k + 2) % 3];
+            const int qs = G.n[(j + 1) % 3], sr = G.n[(j + 2) % 3];
+            const unsigned int frp = this->EdgeFlags(f, (k + 1) % 3), fpq = this->EdgeFlags(f, (k + 2) % 3);
+            const unsigned int fqs = this->EdgeFlags(g, (j + 1) % 3), fsr = this->EdgeFlags(g, (j + 2) % 3);
+            Face &nf = m_faces[f];
+            nf.v[0] = p; nf.v[1] = q; nf.v[2] = s;
+            nf.n[0] = qs; nf.n[1] = g; nf.n[2] = pq;
+            Face &ng = m_faces[g];
+            ng.v[0] = p; ng.v[1] = s; ng.v[2] = r;
+            ng.n[0] = sr; ng.n[1] = rp; ng.n[2] = f;
+            m_fixed[f] = m_fixed[g] = 0;
+            this->SetEdgeFlags(f, 0, fqs);
+            this->SetEdgeFlags(f, 2, fpq);
+            this->SetEdgeFlags(g, 0, fsr);
+            this->SetEdgeFlags(g, 1, frp);
+            if(rp >= 0){
+                for(int i = 0; i < 3; ++i){
+                    if(m_faces[rp].n[i] == f)
+                        m_faces[rp].n[i] = g;
+                }
+            }
+            if(qs >= 0){
+                for(int i = 0; i < 3; ++i){
+                    if(m_faces[qs].n[i] == g)
+                        m_faces[qs].n[i] = f;
+                }
+            }
+            m_start[p] = m_start[q] = m_start[s] = f;
+            m_start[r] = g;
+            m_flips.push_back(std::make_pair(f, 0));
+            m_flips.push_back(std::make_pair(f, 2));
+            m_flips.push_back(std::make_pair(g, 0));
+            m_flips.push_back(std::make_pair(g, 1));
+        }
+    }
+
+    /// @brief Ghost when p is strictly inside the two triangles of the edge
+    /// opposite to corner k, else the closest of their corners
+    unsigned int Snap(const DPoint2 &p, int f, int k) const {
+        const int faces[2] = { f, m_faces[f].n[k] };
+        bool inside = true;
+        unsigned int closest = Ghost;
+        double best = std::numeric_limits<double >::max();
+        for(int i = 0; i < 2; ++i){
+            const Face &face = m_faces[faces[i]];
+            // the corner out of the edge
+            int apex = k;
+            if(i == 1){
+                for(int j = 0; j < 3; ++j){
+                    if(face.n[j] == f)
+                        apex = j;
+                }
+            }
+            for(int j = 0; j < 3; ++j){
+                const DPoint2 &q = m_points[face.v[j]];
+                const double dx = double(q.x()) - p.x(), dy = double(q.y()) - p.y();
+                if(dx * dx + dy * dy < best){
+                    best = dx * dx + dy * dy;
+                    closest = face.v[j];
+                }
+                if(j != apex && this->Orient(m_points[face.v[(j + 1) % 3]], m_points[face.v[(j + 2) % 3]], p) <= 0)
+                    inside = false;
+            }
+        }
+        return inside ? Ghost : closest;
+    }
+
+    /// @brief make the segment a b an edge of the triangulation
+    void InsertSegment(unsigned int a0, unsigned int b0, unsigned int flags0){
+        m_pending.clear();
+        Push(a0, b0, flags0);
+        while(!m_pending.empty()){
+            const unsigned int a = m_pending.back().a, b = m_pending.back().b, flags = m_pending.back().flags;
+            m_pending.pop_back();
+            if(a == b)
+                continue;
+
+            // turn around a up to the triangle the segment leaves a through
+            int f = m_start[a], i = Corner(f, a);
+            bool wedge = false;
+            for(size_t turn = 0; turn < m_faces.size(); ++turn){
+                const Face &face = m_faces[f];
+                i = Corner(f, a);
+                const unsigned int v1 = face.v[(i + 1) % 3], v2 = face.v[(i + 2) % 3];
+                if(v1 != Ghost && v2 != Ghost){
+                    if(v1 == b || v2 == b){
+                        FixEdge(f, v1 == b ? (i + 2) % 3 : (i + 1) % 3, flags);
+                        break;
+                    }
+                    const double o1 = this->Orient(m_points[a], m_points[b], m_points[v1]);
+                    const double o2 = this->Orient(m_points[a], m_points[b], m_points[v2]);
+                    // an edge of a along the segment, the rest starts from its other end
+                    if(o1 == 0 && Ahead(a, b, v1)){
+                        FixEdge(f, (i + 2) % 3, flags);
+                        Push(v1, b, flags);
+                        break;
+                    }
+                    if(o2 == 0 && Ahead(a, b, v2)){
+                        FixEdge(f, (i + 1) % 3, flags);
+                        Push(v2, b, flags);
+                        break;
+                    }
+                    if(o1 < 0 && o2 > 0){
+                        wedge = true;
+                        break;
+                    }
+                }
+                f = face.n[(i + 1) % 3];
+            }
+            if(wedge)
+                CrossTriangles(a, b, f, i, flags);
+        }
+    }
+
+    /// @brief remove the triangles crossed by a b from the wedge (f, i) at a
+    /// and triangulate both sides again, or split the segment
+    void CrossTriangles(unsigned int a, unsigned int b, int f, int i, unsigned int flags){
+        m_deleted.clear();
+        m_left.clear();
+        m_right.clear();
+        m_right.push_back(m_faces[f].v[(i + 1) % 3]);
+        m_left.push_back(m_faces[f].v[(i + 2) % 3]);
+        int current = f, corner = i;
+        unsigned int end = b;
+        for(;;){
+            const unsigned int r = m_right.back(), l = m_left.back();
+            if(this->EdgeFlags(current, corner) & FixedEdge){
+                // a constrained edge is in the way, both are split where they meet
+                const unsigned int crossed = this->EdgeFlags(current, corner);
+                const double orr = this->Orient(m_points[a], m_points[b], m_points[r]);
+                const double ol = this->Orient(m_points[a], m_points[b], m_points[l]);
+                const double s = orr / (orr - ol);
+                const DPoint2 &pr = m_points[r], &pl = m_points[l];
+                const DPoint2 p(T(pr.x() + s * (double(pl.x()) - pr.x())), T(pr.y() + s * (double(pl.y()) - pr.y())));
+                // the point rounds out of the two triangles of the edge: it is
+                // replaced by the closest of their corners
+                unsigned int x = p == m_points[a] ? a : (p == m_points[b] ? b : Snap(p, current, corner));
+                if(x == Ghost){
+                    x = static_cast<unsigned int >(m_points.size());
+                    m_points.push_back(p);
+                    m_start.push_back(-1);
+                    this->InsertPoint(x, current, current, corner);
+                }
+                else if(x != r && x != l){
+                    // the edge goes through the corner instead
+                    MarkEdge(current, corner, 0);
+                    Legalize(current, corner);
+                    if(x == a || x == b)
+                        Push(a, b, flags);
+                    else{
+                        Push(x, b, flags);
+                        Push(a, x, flags);
+                    }
+                    Push(x, l, crossed);
+                    Push(r, x, crossed);
+                    return;
+                }
+                Push(x, b, flags);
+                Push(a, x, flags);
+                return;
+            }
+            m_deleted.push_back(current);
+            const int next = m_faces[current].n[corner];
+            const Face &face = m_faces[next];
+            int j = 0;
+            while(face.v[j] == r || face.v[j] == l)
+                ++j;
+            const unsigned int w = face.v[j];
+            if(w == b){
+                m_deleted.push_back(next);
+                break;
+            }
+            const double ow = this->Orient(m_points[a], m_points[b], m_points[w]);
+            if(ow == 0){
+                // the segment runs through w, the rest starts from there
+                m_deleted.push_back(next);
+                end = w;
+                Push(w, b, flags);
+                break;
+            }
+            if(ow > 0){
+                m_left.push_back(w);
+                corner = Corner(next, l);
+            }
+            else{
+                m_right.push_back(w);
+                corner = Corner(next, r);
+            }
+            current = next;
+        }
+
+        // the cavity border, by undirected edge, with the triangle out of it
+        m_stamp += 2;
+        const unsigned int removed = m_stamp;
+        m_mark.resize(m_faces.size(), 0);
+        for(size_t d = 0; d < m_deleted.size(); ++d)
+            m_mark[m_deleted[d]] = removed;
+        m_border.clear();
+        for(size_t d = 0; d < m_deleted.size(); ++d){
+            const Face &face = m_faces[m_deleted[d]];
+            for(int k = 0; k < 3; ++k){
+                const int nb = face.n[k];
+                if(nb >= 0 && m_mark[nb] == removed)
+                    continue;
+                HalfEdge h;
+                h.key = UndirectedKey(face.v[(k + 1) % 3], face.v[(k + 2) % 3]);
+                h.face = nb;
+                h.flags = this->EdgeFlags(m_deleted[d], k);
+                m_border.push_back(h);
+            }
+        }
+        std::sort(m_border.begin(), m_border.end());
+
+        // both sides again, in the slots of the removed triangles
+        m_triangles.clear();
+        TriangulateChain(a, end, m_left);
+        std::reverse(m_right.begin(), m_right.end());
+        TriangulateChain(end, a, m_right);
+        assert(m_triangles.size() == 3 * m_deleted.size());
+
+        m_edges.clear();
+        for(size_t t = 0; t < m_deleted.size(); ++t){
+            const int s = m_deleted[t];
+            Face &face = m_faces[s];
+            m_fixed[s] = 0;
+            for(int k = 0; k < 3; ++k){
+                face.v[k] = m_triangles[3 * t + k];
+                face.n[k] = -1;
+                m_start[face.v[k]] = s;
+            }
+            for(int k = 0; k < 3; ++k){
+                HalfEdge h;
+                h.key = UndirectedKey(face.v[(k + 1) % 3], face.v[(k + 2) % 3]);
+                h.face = 3 * s + k;
+                h.flags = 0;
+                m_edges.push_back(h);
+            }
+        }
+        std::sort(m_edges.begin(), m_edges.end());
+        for(size_t e = 0; e < m_edges.size(); ){
+            const HalfEdge &h = m_edges[e];
+            const int s = h.face / 3, k = h.face % 3;
+            if(e + 1 < m_edges.size() && m_edges[e + 1].key == h.key){
+                // inside the cavity
+                const int s2 = m_edges[e + 1].face / 3, k2 = m_edges[e + 1].face % 3;
+                m_faces[s].n[k] = s2;
+                m_faces[s2].n[k2] = s;
+                e += 2;
+                continue;
+            }
+            // on the cavity border
+            HalfEdge probe;
+            probe.key = h.key;
+            const HalfEdge &outer = *std::lower_bound(m_border.begin(), m_border.end(), probe);
+            m_faces[s].n[k] = outer.face;
+            this->SetEdgeFlags(s, k, outer.flags);
+            if(outer.face >= 0){
+                const Face &face = m_faces[s];
+                const unsigned int u = face.v[(k + 1) % 3], v = face.v[(k + 2) % 3];
+                Face &other = m_faces[outer.face];
+                for(int j = 0; j < 3; ++j){
+                    if(other.v[j] != u && other.v[j] != v)
+                        other.n[j] = s;
+                }
+            }
+            ++e;
+        }
+
+        // the segment itself
+        const int s = m_deleted[0];
+        for(int k = 0; k < 3; ++k){
+            const Face &face = m_faces[s];
+            const unsigned int u = face.v[(k + 1) % 3], v = face.v[(k + 2) % 3];
+            if((u == a && v == end) || (u == end && v == a)){
+                FixEdge(s, k, flags);
+                return;
+            }
+        }
+        for(size_t t = 1; t < m_deleted.size(); ++t){
+            const Face &face = m_faces[m_deleted[t]];
+            for(int k = 0; k < 3; ++k){
+                if(face.v[(k + 1) % 3] == a && face.v[(k + 2) % 3] == end){
+                    FixEdge(m_deleted[t], k, flags);
+                    return;
+                }
+            }
+        }
+    }
+
+    /// @brief Delaunay triangles of the pseudo polygon u w and a chain on the
+    /// left of u -> w, ordered from u to w
+    void TriangulateChain(unsigned int u, unsigned int w, const std::vector<unsigned int > &chain){
+        m_ranges.clear();
+        Range all = { u, w, 0, chain.size() };
+        m_ranges.push_back(all);
+        while(!m_ranges.empty()){
+            const Range r = m_ranges.back();
+            m_ranges.pop_back();
+            if(r.begin >= r.end)
+                continue;
+            // the chain point whose circle through u w holds no other
+            size_t c = r.begin;
+            for(size_t j = r.begin + 1; j < r.end; ++j){
+                if(this->InCircle(m_points[r.u], m_points[r.w], m_points[chain[c]], m_points[chain[j]]) > 0)
+                    c = j;
+            }
+            m_triangles.push_back(r.u);
+            m_triangles.push_back(r.w);
+            m_triangles.push_back(chain[c]);
+            Range before = { r.u, chain[c], r.begin, c };
+            Range after = { chain[c], r.w, c + 1, r.end };
+            m_ranges.push_back(before);
+            m_ranges.push_back(after);
+        }
+    }
+
+    /// @brief keep the triangles inside an odd number of border rings
+    void Domain(std::vector<char > &keep) const {
+        std::vector<int > depth(m_faces.size(), -1);
+        std::vector<int > current, next;
+        for(size_t f = 0; f < m_faces.size(); ++f){
+            if(DDelaunay<T>::GhostCorner(m_faces[f]) >= 0){
+                depth[f] = 0;
+                current.push_back(static_cast<int >(f));
+            }
+        }
+        // flood without crossing a border, then one more ring inside
+        for(int level = 0; !current.empty(); ++level){
+            for(size_t c = 0; c < current.size(); ++c){
+                const int f = current[c];
+                for(int k = 0; k < 3; ++k){
+                    const int nb = m_faces[f].n[k];
+                    if(nb < 0 || depth[nb] >= 0)
+                        continue;
+                    if(this->EdgeFlags(f, k) & BorderEdge)
+                        next.push_back(nb);
+                    else{
+                        depth[nb] = level;
+                        current.push_back(nb);
+                    }
+                }
+            }
+            current.clear();
+            for(size_t c = 0; c < next.size(); ++c){
+                if(depth[next[c]] < 0){
+                    depth[next[c]] = level + 1;
+                    current.push_back(next[c]);
+                }
+            }
+            next.clear();
+        }
+        for(size_t f = 0; f < m_faces.size(); ++f)
+            keep[f] = depth[f] % 2 == 1;
+    }
+
+    static uint64_t UndirectedKey(unsigned int a, unsigned int b){
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    void Release(){
+        std::vector<unsigned int >().swap(m_mark);
+        std::vector<int >().swap(m_start);
+    }
+
+protected:
+    /// an edge of the cavity: 3 * triangle + corner, or the triangle out of the border
+    struct HalfEdge {
+        uint64_t key;
+        int face;
+        unsigned int flags;
+        bool operator<(const HalfEdge &h) const { return key < h.key; }
+    };
+    /// pseudo polygon u w with chain[begin, end)
+    struct Range {
+        unsigned int u;
+        unsigned int w;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<Segment > m_segments;
+
+    // segment insertion scratch
+    std::vector<Segment > m_pending;
+    std::vector<std::pair<int, int > > m_flips;
+    std::vector<int > m_deleted;
+    std::vector<unsigned int > m_left;
+    std::vector<unsigned int > m_right;
+    std::vector<unsigned int > m_triangles;
+    std::vector<HalfEdge > m_border;
+    std::vector<HalfEdge > m_edges;
+    std::vector<Range > m_ranges;
+};
+#endif /* DamonsConstrainedDelaunay_h */
@@ -10,11 +10,17 @@
 #define DamonsDelaunay_h
 
 #include "DamonsVector.h"
+#include "DamonsParallel.h"
+#include "utilities.h"
+#include "DamonsPredicates.h"
 #include <random>
-#include <map>
 #include <numeric>
 #include <fstream>
+#include <iostream>
 #include <functional>
+#include <limits>
+#include <cstring>
+#include <unordered_map>
 
 using namespace DMath;
 
@@ -22,77 +28,15 @@ template < class T = double>
 class DDelaunay{
 public:
     using DPoint2 = DVector<T,2>;
-    class Edge
-    {
-    public:
-        Edge( DPoint2 *p1, DPoint2 *p2) : p1(p1), p2(p2), isBad(false) {};
-        Edge(const Edge &e) : p1(e.p1), p2(e.p2), isBad(false) {};
-        DPoint2 *p1;
-        DPoint2 *p2;
-        bool isBad;
-    public:
-        bool isEqual(Edge &ed){
-            bool e1 =  (*p1 - *ed.p1).LengthSquared() < DEplision;
-            bool e2 =  (*p1 - *ed.p2).LengthSquared() < DEplision;
-            bool e3 =  (*p2 - *ed.p1).LengthSquared() < DEplision;
-            bool e4 =  (*p2 - *ed.p2).LengthSquared() < DEplision;
-            
-            return (e1&&e4) || (e2&&e3);
-        }
-        void print(){
-            std::cout<<"pt1 : "<<p1->x()<<","<<p1->y()<<std::endl;
-            std::cout<<"pt2 : "<<p2->x()<<","<<p2->y()<<std::endl;
-           
-        }
-    };
-    class Triangle
-    {
-    public:
-        Triangle( DPoint2 *_p1,  DPoint2 *_p2,  DPoint2 *_p3)
-        :    p1(_p1), p2(_p2), p3(_p3),
-        e1(_p1, _p2), e2(_p2, _p3), e3(_p3, _p1), isBad(false)
-        {}
-        
-        bool containsVertex(const DPoint2 *v) const
-        {
-            // return p1 == v || p2 == v || p3 == v;
-            T l1 =  (*p1 - *v).LengthSquared();
-            T l2 =  (*p2 - *v).LengthSquared();
-            T l3 =  (*p3 - *v).LengthSquared();
-            
-            return l1< DEplision*DEplision || l2< DEplision*DEplision || l3 < DEplision*DEplision;
-        }
-        
-        bool circumCircleContains(const DPoint2 *v) const
-        {
-            const T ab = p1->LengthSquared();
-            const T cd = p2->LengthSquared();
-            const T ef = p3->LengthSquared();
-            
-            const T circum_x = (ab * (p3->y() - p2->y()) + cd * (p1->y() - p3->y()) + ef * (p2->y() - p1->y())) / (p1->x() * (p3->y() - p2->y()) + p2->x() * (p1->y() - p3->y()) + p3->x() * (p2->y() - p1->y()));
-            
-            const T circum_y = (ab * (p3->x() - p2->x()) + cd * (p1->x() - p3->x()) + ef * (p2->x() - p1->x())) / (p1->y()* (p3->x() - p2->x()) + p2->y() * (p1->x() - p3->x()) + p3->y() * (p2->x() - p1->x()));
-            
-            const DPoint2 circum(circum_x*0.5, circum_y*0.5);
-            const T circum_radius = (*p1 - circum).Length();
-            const T dist = (*v - circum).Length();
-            return dist <= circum_radius;
-        }
-        void print(){
-            std::cout<<"pt1 : "<<p1->x()<<","<<p1->y()<<std::endl;
-            std::cout<<"pt2 : "<<p2->x()<<","<<p2->y()<<std::endl;
-            std::cout<<"pt3 : "<<p3->x()<<","<<p3->y()<<std::endl;
-        }
-        DPoint2 *p1;
-        DPoint2 *p2;
-        DPoint2 *p3;
-        Edge e1;
-        Edge e2;
-        Edge e3;
-        bool isBad;
+protected:
+    /// index triangle: vertices counter clockwise, n[k] is the neighbor
+    /// across the edge opposite to v[k], -1 on the hull
+    struct Face {
+        unsigned int v[3];
+        int n[3];
     };
-
-    
+    /// vertex at infinity of the ghost triangles, in the first reserved point slot
+    static const unsigned int Ghost = 0;
 public:
     DDelaunay(){}
     DDelaunay(std::vector<DPoint2 > &points){
@@ -102,21 +46,22 @@ public:
         m_points[2] = points[2];
         std::copy(points.begin(),points.end(),m_points.begin()+3);
     }
+    /// @brief take the points from an array, x and y first in each record
+    ///
+    /// @param coords first coordinate of the first point
+    /// @param count number of points
+    /// @param stride coordinates from one point to the next
+    void SetPoints(const T *coords, size_t count, size_t stride = 2){
+        m_points.resize(count + 3);
+        ParallelFor(0, count, [&](size_t i){
+            m_points[i + 3] = DPoint2(coords[i * stride], coords[i * stride + 1]);
+        }, 1 << 14);
+    }
     ~DDelaunay(){
         std::vector<DPoint2 >().swap(m_points);
-        std::vector<Triangle >().swap(m_triangles);
-        std::vector<Edge >().swap(m_edges);
-        m_pairs.clear();
+        std::vector<Face >().swap(m_faces);
     }
 public:
-    void test(){
-        m_points.push_back(DPoint2(0,0));
-        m_points.push_back(DPoint2(5,5*std::sqrt(5.0)));
-        m_points.push_back(DPoint2(10,0));
-        Triangle t(&m_points[0],&m_points[1],&m_points[2]);
-        DPoint2 p(11,1);
-        t.circumCircleContains(&p);
-    }
     void RandomlizePoints(unsigned int _ptnumber){
         std::uniform_real_distribution<double > generator(1,1000.0);
         std::random_device rd;
@@ -131,85 +76,757 @@ public:
         }
     }
     
-protected:
-    void CalculateSuperTriangle(){
-        T min_x =  std::numeric_limits<T>::max();
-        T min_y =  std::numeric_limits<T>::max();
-        T max_x =  std::numeric_limits<T>::lowest();
-        T max_y =  std::numeric_limits<T>::lowest();
-        
-        for (auto &p:m_points) {
-            if( p.x() < min_x)
-                min_x = p.x();
-            if( p.y() < min_y)
-                min_y = p.y();
-            if( p.x() > max_x)
-                max_x = p.x();
-            if( p.y() > max_y)
-                max_y = p.y();
-        }
-
-		const T dx = max_x - min_x;
-		const T dy = max_y - min_y;
-		const T deltaMax = std::max(dx, dy);
-		const T midx = 0.5*(max_x + min_x);
-		const T midy = 0.5*(max_y + min_y);
-
-        m_points[0] = DPoint2(midx - 20 * deltaMax, midy - deltaMax);
-        m_points[1] = DPoint2(midx, midy + 20 * deltaMax);
-        m_points[2] = DPoint2(midx + 20 * deltaMax, midy - deltaMax);
-    }
 public:
+    /// @brief Delaunay triangulation of the points
+    ///
+    /// incremental Bowyer-Watson on an index based triangulation with
+    /// neighbor links. the points are inserted in a biased randomized order
+    /// (BRIO): rounds of doubling size, each sorted along a Hilbert curve, so
+    /// the point to insert is close to the last created triangle. it is found
+    /// by a visibility walk from there, the triangles whose circumcircle
+    /// holds it are collected by a walk over the neighbors and the cavity is
+    /// filled with a fan, in expected O(n log n) overall.
+    /// the outside of the hull is covered by ghost triangles joining each hull
+    /// edge to a vertex at infinity, instead of a finite super triangle whose
+    /// vertices could hide the flat triangles of the hull.
+    /// duplicated points are skipped.
     void DelaunayTriangulate(){
-        CalculateSuperTriangle();
-        m_triangles.push_back(Triangle(&m_points[0],&m_points[1],&m_points[2]));
-        for(int i = 3;i < m_points.size();++i){
-            m_pairs[&m_points[i]] = i-3;
-            std::vector<Edge > _polygon;
-            for(auto &tri : m_triangles){
-                if(tri.circumCircleContains(&m_points[i])){
-                    tri.isBad = true;
-                    _polygon.push_back(tri.e1);
-                    _polygon.push_back(tri.e2);
-                    _polygon.push_back(tri.e3);
+        m_faces.clear();
+        m_fixed.clear();
+        if(Build())
+            RemoveGhostTriangles();
+        std::vector<unsigned int >().swap(m_mark);
+        std::vector<int >().swap(m_start);
+    }
+
+    /// @brief Delaunay triangulation computed on several threads
+    ///
+    /// the points are cut in vertical strips of equal size at median x
+    /// values and each strip is triangulated on its own thread. a triangle of
+    /// a strip whose circumcircle stays strictly inside the strip is final:
+    /// no point of another strip can fall in it. the vertices of the other
+    /// triangles and of the strip hulls are triangulated once more, and the
+    /// triangles of that seam triangulation lying out of the final ones,
+    /// found by a flood fill from the border of the final triangles, close
+    /// the seams. InCircle breaks cocircular ties by the point coordinates,
+    /// so the triangulation is unique and the result is the one of
+    /// DelaunayTriangulate. duplicated points are skipped.
+    ///
+    /// @param partitions number of strips, 0 for one per thread. strips keep
+    /// at least 1024 points, fewer strips are used on small inputs.
+    void ParallelDelaunayTriangulate(unsigned int partitions = 0){
+        m_faces.clear();
+        m_fixed.clear();
+        const size_t n = m_points.size() > 3 ? m_points.size() - 3 : 0;
+        if(partitions == 0)
+            partitions = ParallelThreadCount();
+        partitions = static_cast<unsigned int >(std::min<size_t >(partitions, n / 1024));
+        if(partitions < 2){
+            DelaunayTriangulate();
+            return;
+        }
+
+        // lexicographic order by two stable sorts, equal points end up next
+        // to each other and only the first one is kept
+        std::vector<uint64_t > keys(n);
+        std::vector<unsigned int > order(n);
+        ParallelFor(0, n, [&](size_t i){
+            keys[i] = OrderedKey(double(m_points[i + 3].y()));
+            order[i] = static_cast<unsigned int >(i + 3);
+        }, 1 << 14);
+        ParallelRadixSort(keys, order, 64);
+        ParallelFor(0, n, [&](size_t i){
+            keys[i] = OrderedKey(double(m_points[order[i]].x()));
+        }, 1 << 14);
+        ParallelRadixSort(keys, order, 64);
+        size_t unique = 0;
+        for(size_t i = 0; i < n; ++i){
+            if(unique > 0 && m_points[order[i]] == m_points[order[unique - 1]])
+                continue;
+            keys[unique] = keys[i];
+            order[unique++] = order[i];
+        }
+
+        // a cut is moved to the next change of x so no two strips share an x
+        std::vector<size_t > cuts(1, 0);
+        for(unsigned int p = 1; p < partitions; ++p){
+            size_t c = std::max(unique * p / partitions, cuts.back() + 1);
+            while(c < unique && keys[c] == keys[c - 1])
+                ++c;
+            if(c < unique)
+                cuts.push_back(c);
+        }
+        cuts.push_back(unique);
+        std::vector<uint64_t >().swap(keys);
+        const size_t count = cuts.size() - 1;
+        if(count < 2){
+            DelaunayTriangulate();
+            return;
+        }
+
+        // every strip on its own, the vertices of the triangles which are not
+        // final and of the strip hulls go to the seam triangulation
+        std::vector<DDelaunay > strips(count);
+        std::vector<std::vector<int > > remap(count);
+        std::vector<char > seamVertex(m_points.size(), 0);
+        ParallelFor(0, count, [&](size_t p){
+            DDelaunay &strip = strips[p];
+            const size_t begin = cuts[p], end = cuts[p + 1];
+            strip.m_points.resize(end - begin + 3);
+            for(size_t i = begin; i < end; ++i)
+                strip.m_points[i - begin + 3] = m_points[order[i]];
+            strip.DelaunayTriangulate();
+
+            const double left = p > 0 ? double(m_points[order[begin - 1]].x()) : -std::numeric_limits<double >::infinity();
+            const double right = p + 1 < count ? double(m_points[order[end]].x()) : std::numeric_limits<double >::infinity();
+            std::vector<char > used(end - begin, 0);
+            std::vector<int > &isFinal = remap[p];
+            isFinal.assign(strip.m_faces.size(), 0);
+            for(size_t f = 0; f < strip.m_faces.size(); ++f)
+                isFinal[f] = strip.CircleInside(f, left, right) ? 1 : 0;
+            for(size_t f = 0; f < strip.m_faces.size(); ++f){
+                const Face &face = strip.m_faces[f];
+                for(int k = 0; k < 3; ++k){
+                    used[face.v[k] - 3] = 1;
+                    if(!isFinal[f] || face.n[k] < 0)
+                        seamVertex[order[begin + face.v[(k + 1) % 3] - 3]] = 1;
+                }
+            }
+            // points left out of the strip triangles, when they are collinear
+            for(size_t i = begin; i < end; ++i){
+                if(!used[i - begin])
+                    seamVertex[order[i]] = 1;
+            }
+        }, 1);
+
+        std::vector<unsigned int > ids;
+        for(size_t i = 3; i < seamVertex.size(); ++i){
+            if(seamVertex[i])
+                ids.push_back(static_cast<unsigned int >(i));
+        }
+        std::vector<char >().swap(seamVertex);
+        DDelaunay seam;
+        seam.m_points.resize(ids.size() + 3);
+        for(size_t i = 0; i < ids.size(); ++i)
+            seam.m_points[i + 3] = m_points[ids[i]];
+        seam.DelaunayTriangulate();
+
+        // new index of the final triangles
+        size_t finalCount = 0;
+        for(size_t p = 0; p < count; ++p){
+            for(size_t f = 0; f < remap[p].size(); ++f)
+                remap[p][f] = remap[p][f] ? static_cast<int >(finalCount++) : -1;
+        }
+
+        // seam half-edges by their end points
+        const size_t seamFaces = seam.m_faces.size();
+        std::unordered_map<uint64_t, unsigned int > seamEdges;
+        seamEdges.reserve(3 * seamFaces);
+        for(size_t g = 0; g < seamFaces; ++g){
+            const Face &face = seam.m_faces[g];
+            for(int k = 0; k < 3; ++k)
+                seamEdges[EdgeKey(ids[face.v[(k + 1) % 3] - 3], ids[face.v[(k + 2) % 3] - 3])] = static_cast<unsigned int >(3 * g + k);
+        }
+
+        // the seam triangles across the border of the final triangles
+        std::vector<int > across(3 * seamFaces, -1);
+        ParallelFor(0, count, [&](size_t p){
+            const DDelaunay &strip = strips[p];
+            const size_t begin = cuts[p];
+            for(size_t f = 0; f < strip.m_faces.size(); ++f){
+                if(remap[p][f] < 0)
+                    continue;
+                const Face &face = strip.m_faces[f];
+                for(int k = 0; k < 3; ++k){
+                    if(face.n[k] >= 0 && remap[p][face.n[k]] >= 0)
+                        continue;
+                    const unsigned int a = order[begin + face.v[(k + 1) % 3] - 3];
+                    const unsigned int b = order[begin + face.v[(k + 2) % 3] - 3];
+                    auto it = seamEdges.find(EdgeKey(b, a));
+                    if(it != seamEdges.end())
+                        across[it->second] = remap[p][f];
+                }
+            }
+        }, 1);
+
+        // the seam triangles out of the final ones are reached from that
+        // border without crossing it, they all are when nothing is final
+        std::vector<int > seamRemap(seamFaces, -1);
+        std::vector<int > stack;
+        for(size_t g = 0; g < seamFaces; ++g){
+            if(finalCount == 0 || across[3 * g] >= 0 || across[3 * g + 1] >= 0 || across[3 * g + 2] >= 0){
+                seamRemap[g] = 0;
+                stack.push_back(static_cast<int >(g));
+            }
+        }
+        while(!stack.empty()){
+            const int g = stack.back();
+            stack.pop_back();
+            for(int k = 0; k < 3; ++k){
+                const int nb = seam.m_faces[g].n[k];
+                if(across[3 * g + k] >= 0 || nb < 0 || seamRemap[nb] >= 0)
+                    continue;
+                seamRemap[nb] = 0;
+                stack.push_back(nb);
+            }
+        }
+        size_t total = finalCount;
+        for(size_t g = 0; g < seamFaces; ++g){
+            if(seamRemap[g] >= 0)
+                seamRemap[g] = static_cast<int >(total++);
+        }
+
+        m_faces.resize(total);
+        ParallelFor(0, count, [&](size_t p){
+            DDelaunay &strip = strips[p];
+            const size_t begin = cuts[p];
+            for(size_t f = 0; f < strip.m_faces.size(); ++f){
+                if(remap[p][f] < 0)
+                    continue;
+                const Face &face = strip.m_faces[f];
+                Face &out = m_faces[remap[p][f]];
+                for(int k = 0; k < 3; ++k){
+                    out.v[k] = order[begin + face.v[k] - 3];
+                    const int nb = face.n[k];
+                    out.n[k] = nb >= 0 ? remap[p][nb] : -1;
                 }
+                for(int k = 0; k < 3; ++k){
+                    if(out.n[k] >= 0)
+                        continue;
+                    auto it = seamEdges.find(EdgeKey(order[begin + face.v[(k + 2) % 3] - 3], order[begin + face.v[(k + 1) % 3] - 3]));
+                    if(it != seamEdges.end())
+                        out.n[k] = seamRemap[it->second / 3];
+                }
+            }
+            std::vector<Face >().swap(strip.m_faces);
+            std::vector<DPoint2 >().swap(strip.m_points);
+        }, 1);
+        ParallelFor(0, seamFaces, [&](size_t g){
+            if(seamRemap[g] < 0)
+                return;
+            const Face &face = seam.m_faces[g];
+            Face &out = m_faces[seamRemap[g]];
+            for(int k = 0; k < 3; ++k){
+                out.v[k] = ids[face.v[k] - 3];
+                const int nb = face.n[k];
+                if(across[3 * g + k] >= 0)
+                    out.n[k] = across[3 * g + k];
+                else
+                    out.n[k] = nb >= 0 ? seamRemap[nb] : -1;
             }
-            m_triangles.erase(std::remove_if(m_triangles.begin(),m_triangles.end(), [](Triangle &t){return t.isBad;}), end(m_triangles));
-
-            for(int  e1 = 0; e1 < _polygon.size(); ++e1)
-            {
-                for(int  e2 = e1+1; e2 < _polygon.size(); ++e2)
-                {
-                    auto &edge1 = _polygon[e1];
-                    auto &edge2 = _polygon[e2];
-
-                    if(edge1.isEqual(edge2))
-                    {
-                        edge1.isBad = true;
-                        edge2.isBad = true;
+        }, 1 << 12);
+    }
+
+    /// @brief number of triangles of the last DelaunayTriangulate
+    size_t GetTriangleCount() const { return m_faces.size(); }
+    /// @brief input indices of the corners of a triangle, counter clockwise
+    void GetTriangle(size_t t, unsigned int &a, unsigned int &b, unsigned int &c) const {
+        a = m_faces[t].v[0] - 3;
+        b = m_faces[t].v[1] - 3;
+        c = m_faces[t].v[2] - 3;
+    }
+    /// @brief triangle across the edge opposite to corner k, -1 on the hull
+    int GetNeighbor(size_t t, int k) const { return m_faces[t].n[k]; }
+    /// @brief opposite half-edges, from the neighbor links
+    ///
+    /// half-edge 3 * t + k goes from corner k to corner k + 1 of triangle t,
+    /// as in GetTriangle. its opposite is the half-edge of the neighbor
+    /// across it starting at corner k + 1, -1 on the hull.
+    void GetHalfEdgePairs(std::vector<int > &pairs) const {
+        pairs.resize(3 * m_faces.size());
+        ParallelFor(0, m_faces.size(), [&](size_t t){
+            const Face &face = m_faces[t];
+            for(int k = 0; k < 3; ++k){
+                const int nb = face.n[(k + 2) % 3];
+                int pair = -1;
+                if(nb >= 0){
+                    const Face &other = m_faces[nb];
+                    const unsigned int b = face.v[(k + 1) % 3];
+                    for(int j = 0; j < 3; ++j){
+                        if(other.v[j] == b)
+                            pair = 3 * nb + j;
                     }
                 }
+                pairs[3 * t + k] = pair;
             }
-            
-            _polygon.erase(std::remove_if(_polygon.begin(), _polygon.end(), [](Edge &e){
-                return e.isBad;
-            }), end(_polygon));
+        }, 1 << 12);
+    }
+    /// @brief true when the edge opposite to corner k of a triangle is constrained
+    bool IsConstrained(size_t t, int k) const { return !m_fixed.empty() && EdgeFlags(static_cast<int >(t), k) != 0; }
+    /// @brief number of points, the input ones then the ones added by the triangulation
+    size_t GetPointCount() const { return m_points.size() > 3 ? m_points.size() - 3 : 0; }
+    /// @brief a point, by the index of GetTriangle
+    const DPoint2 &GetPoint(size_t i) const { return m_points[i + 3]; }
 
-            for(const auto &e : _polygon){
-                m_triangles.push_back(Triangle(e.p1, e.p2, &m_points[i]));
+protected:
+    /// @brief key of the half-edge a -> b
+    static uint64_t EdgeKey(unsigned int a, unsigned int b){
+        return (uint64_t(a) << 32) | b;
+    }
+
+    /// @brief unsigned key sorting as the double, -0 and +0 get the same key
+    static uint64_t OrderedKey(double x){
+        x += 0.0;
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        return (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+    }
+
+    /// @brief true when the circumcircle of a triangle lies strictly between two x
+    bool CircleInside(size_t f, double left, double right) const {
+        return (left == -std::numeric_limits<double >::infinity() || CircleSide(f, left) > 0)
+            && (right == std::numeric_limits<double >::infinity() || CircleSide(f, right) < 0);
+    }
+
+    /// @brief side of the circumcircle of a triangle against the line x = l,
+    /// 1 strictly right of it, -1 strictly left, 0 when they meet, exact
+    ///
+    /// with the points moved by (-l, -a.y) and w = x^2 + y^2, the circle is
+    /// O (X^2 + Y^2) + B X + C Y + D = 0 where O = |x y 1|, B = -|w y 1|,
+    /// C = |w x 1| and D = -|w x y| over the 3 points. its center is on the
+    /// side of the sign of -B O and it misses the line X = 0 when the
+    /// discriminant C^2 - 4 D O is negative. both are first evaluated in
+    /// floating point and only computed exactly when within their rounding
+    /// bound, in units of the permanent as for the predicates.
+    int CircleSide(size_t f, double l) const {
+        const Face &face = m_faces[f];
+        const DPoint2 *p[3] = { &m_points[face.v[0]], &m_points[face.v[1]], &m_points[face.v[2]] };
+        const double ay = double(p[0]->y());
+
+        double x[3], y[3], w[3], xa[3], ya[3], wa[3];
+        for(int k = 0; k < 3; ++k){
+            x[k] = double(p[k]->x()) - l;
+            y[k] = double(p[k]->y()) - ay;
+            w[k] = x[k] * x[k] + y[k] * y[k];
+            xa[k] = std::fabs(x[k]);
+            ya[k] = std::fabs(y[k]);
+            wa[k] = w[k];
+        }
+        // |u v 1| and its permanent
+        auto det1 = [](const double *u, const double *v, const double *ua, const double *va, double &perm){
+            perm = (ua[1] + ua[0]) * (va[2] + va[0]) + (va[1] + va[0]) * (ua[2] + ua[0]);
+            return (u[1] - u[0]) * (v[2] - v[0]) - (v[1] - v[0]) * (u[2] - u[0]);
+        };
+        double po, pb, pc;
+        const double o = det1(x, y, xa, ya, po);
+        const double b = -det1(w, y, wa, ya, pb);
+        const double c = det1(w, x, wa, xa, pc);
+        const double d = -(w[0] * (x[1] * y[2] - y[1] * x[2]) - w[1] * (x[0] * y[2] - y[0] * x[2]) + w[2] * (x[0] * y[1] - y[0] * x[1]));
+        const double pd = wa[0] * (xa[1] * ya[2] + ya[1] * xa[2]) + wa[1] * (xa[0] * ya[2] + ya[0] * xa[2]) + wa[2] * (xa[0] * ya[1] + ya[0] * xa[1]);
+
+        const double bound = 64 * DMath::DPredicateBounds::Epsilon();
+        double side = -b * o, disc = c * c - 4 * d * o;
+        const bool sure = std::fabs(side) > bound * pb * po && std::fabs(disc) > bound * (pc * pc + 4 * pd * po);
+        if(!sure){
+            using namespace DMath::DExact;
+            Expansion ex[3], ey[3], ew[3];
+            for(int k = 0; k < 3; ++k){
+                ex[k] = Difference(double(p[k]->x()), l);
+                ey[k] = Difference(double(p[k]->y()), ay);
+                ew[k] = Lift(ex[k], ey[k]);
             }
+            auto det = [](const Expansion *u, const Expansion *v){
+                const Expansion u1 = Sum(u[1], Negate(u[0])), u2 = Sum(u[2], Negate(u[0]));
+                const Expansion v1 = Sum(v[1], Negate(v[0])), v2 = Sum(v[2], Negate(v[0]));
+                return Cross(u1, v1, u2, v2);
+            };
+            const Expansion eo = det(ex, ey), eb = det(ew, ey), ec = det(ew, ex);
+            Expansion ed = Product(ew[0], Cross(ex[1], ey[1], ex[2], ey[2]));
+            ed = Sum(ed, Negate(Product(ew[1], Cross(ex[0], ey[0], ex[2], ey[2]))));
+            ed = Sum(ed, Product(ew[2], Cross(ex[0], ey[0], ex[1], ey[1])));
+            // B = -eb and D = -ed
+            side = Estimate(Product(eb, eo));
+            disc = Estimate(Sum(Product(ec, ec), Scale(Product(ed, eo), 4.0)));
         }
-        
-        m_triangles.erase(std::remove_if(m_triangles.begin(), m_triangles.end(), [&](Triangle &t){
-            return t.containsVertex(&m_points[0]) || t.containsVertex(&m_points[1]) || t.containsVertex(&m_points[2]);
-        }), end(m_triangles));
-        
-        for(const auto &t : m_triangles)
-        {
-            m_edges.push_back(t.e1);
-            m_edges.push_back(t.e2);
-            m_edges.push_back(t.e3);
+        if(!(disc < 0))
+            return 0;
+        return side > 0 ? 1 : (side < 0 ? -1 : 0);
+    }
+
+    /// @brief twice the signed area of abc, positive when counter clockwise, exact sign
+    static double Orient(const DPoint2 &a, const DPoint2 &b, const DPoint2 &c){
+        const double pa[2] = { double(a.x()), double(a.y()) };
+        const double pb[2] = { double(b.x()), double(b.y()) };
+        const double pc[2] = { double(c.x()), double(c.y()) };
+        return DMath::Orient2D(pa, pb, pc);
+    }
+
+    /// @brief positive when d is inside the circumcircle of the counter clockwise abc, exact sign
+    ///
+    /// cocircular points are told apart by simulation of simplicity: the
+    /// lifting x^2 + y^2 of every point is raised by an infinitesimal, larger
+    /// for lexicographically smaller points. 0 is only returned when the four
+    /// points are collinear, and the triangulation of cocircular points does
+    /// not depend on the insertion order.
+    static double InCircle(const DPoint2 &a, const DPoint2 &b, const DPoint2 &c, const DPoint2 &d){
+        const double pa[2] = { double(a.x()), double(a.y()) };
+        const double pb[2] = { double(b.x()), double(b.y()) };
+        const double pc[2] = { double(c.x()), double(c.y()) };
+        const double pd[2] = { double(d.x()), double(d.y()) };
+        const double det = DMath::InCircle(pa, pb, pc, pd);
+        if(det != 0)
+            return det;
+
+        const double *p[4] = { pa, pb, pc, pd };
+        int rank[4] = { 0, 1, 2, 3 };
+        std::sort(rank, rank + 4, [&](int i, int j){
+            return p[i][0] < p[j][0] || (p[i][0] == p[j][0] && p[i][1] < p[j][1]);
+        });
+        for(int r = 0; r < 4; ++r){
+            // derivative of the determinant along the lifting of point i, the
+            // orientation of the three others with an alternating sign
+            const int i = rank[r];
+            const double *q[3];
+            for(int j = 0, m = 0; j < 4; ++j){
+                if(j != i)
+                    q[m++] = p[j];
+            }
+            const double cofactor = DMath::Orient2D(q[0], q[1], q[2]);
+            if(cofactor != 0)
+                return i % 2 == 0 ? cofactor : -cofactor;
+        }
+        return 0;
+    }
+
+    /// @brief BRIO: shuffled rounds of doubling size, each along a Hilbert curve
+    void InsertionOrder(std::vector<unsigned int > &order) const {
+        const size_t n = m_points.size() - 3;
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 3u);
+        std::mt19937 seed(5489u);
+        std::shuffle(order.begin(), order.end(), seed);
+
+        T min_x = std::numeric_limits<T>::max(), min_y = std::numeric_limits<T>::max();
+        T max_x = std::numeric_limits<T>::lowest(), max_y = std::numeric_limits<T>::lowest();
+        for(size_t i = 3; i < m_points.size(); ++i){
+            min_x = std::min(min_x, m_points[i].x());
+            min_y = std::min(min_y, m_points[i].y());
+            max_x = std::max(max_x, m_points[i].x());
+            max_y = std::max(max_y, m_points[i].y());
+        }
+        const double extent = std::max(double(max_x) - min_x, double(max_y) - min_y);
+        const unsigned int bits = 16;
+        const double scale = extent > 0 ? ((1u << bits) - 1) / extent : 0.0;
+
+        std::vector<uint64_t > keys;
+        std::vector<unsigned int > values;
+        size_t end = n;
+        while(end > 0){
+            const size_t begin = end > 64 ? end / 2 : 0;
+            keys.resize(end - begin);
+            values.assign(order.begin() + begin, order.begin() + end);
+            ParallelFor(0, end - begin, [&](size_t k){
+                const DPoint2 &p = m_points[values[k]];
+                keys[k] = HilbertEncode2(static_cast<uint32_t >((p.x() - min_x) * scale), static_cast<uint32_t >((p.y() - min_y) * scale), bits);
+            }, 1 << 14);
+            ParallelRadixSort(keys, values, 2 * bits);
+            std::copy(values.begin(), values.end(), order.begin() + begin);
+            end = begin;
+        }
+    }
+
+    /// @brief triangulation of all the points with the ghost triangles of the
+    /// hull, m_start holds a triangle of every inserted point and -1 for the
+    /// skipped duplicates. false when the points are collinear
+    bool Build(){
+        m_faces.clear();
+        if(m_points.size() < 4)
+            return false;
+
+        // the first triangle joins the first three points of the order which
+        // are not collinear, nothing is built when they all are
+        std::vector<unsigned int > order;
+        InsertionOrder(order);
+        size_t second = 1;
+        while(second < order.size() && m_points[order[second]] == m_points[order[0]])
+            ++second;
+        size_t third = second + 1;
+        while(third < order.size() && Orient(m_points[order[0]], m_points[order[second]], m_points[order[third]]) == 0)
+            ++third;
+        if(third >= order.size())
+            return false;
+        unsigned int a = order[0], b = order[second], c = order[third];
+        if(Orient(m_points[a], m_points[b], m_points[c]) < 0)
+            std::swap(b, c);
+
+        m_start.assign(m_points.size(), -1);
+        FirstTriangle(a, b, c);
+        m_mark.assign(m_faces.size(), 0);
+        m_stamp = 0;
+        int last = 0;
+        for(size_t i = 1; i < order.size(); ++i){
+            if(i != second && i != third)
+                last = InsertPoint(order[i], last);
+        }
+        return true;
+    }
+
+    /// @brief the triangle abc, counter clockwise, and the ghost triangles of its edges
+    void FirstTriangle(unsigned int a, unsigned int b, unsigned int c){
+        const unsigned int v[3] = { a, b, c };
+        Face face;
+        for(int k = 0; k < 3; ++k){
+            face.v[k] = v[k];
+            face.n[k] = 1 + k;
+        }
+        m_faces.push_back(face);
+        // ghost 1 + k lies across the edge opposite to corner k
+        for(int k = 0; k < 3; ++k){
+            Face ghost;
+            ghost.v[0] = v[(k + 2) % 3];
+            ghost.v[1] = v[(k + 1) % 3];
+            ghost.v[2] = Ghost;
+            ghost.n[0] = 1 + (k + 2) % 3;
+            ghost.n[1] = 1 + (k + 1) % 3;
+            ghost.n[2] = 0;
+            m_faces.push_back(ghost);
+        }
+        m_start[a] = m_start[b] = m_start[c] = 0;
+        m_start[Ghost] = 1;
+    }
+
+    /// @brief corner of the vertex at infinity, -1 for a finite triangle
+    static int GhostCorner(const Face &face){
+        for(int k = 0; k < 3; ++k){
+            if(face.v[k] == Ghost)
+                return k;
+        }
+        return -1;
+    }
+
+    /// @brief true when p is in the circumcircle of a triangle
+    ///
+    /// the circle of a ghost triangle is the open half plane out of its hull
+    /// edge, and the edge without its ends.
+    bool Conflict(int t, const DPoint2 &p) const {
+        const Face &face = m_faces[t];
+        const int g = GhostCorner(face);
+        if(g < 0)
+            return InCircle(m_points[face.v[0]], m_points[face.v[1]], m_points[face.v[2]], p) > 0;
+        const DPoint2 &u = m_points[face.v[(g + 1) % 3]], &w = m_points[face.v[(g + 2) % 3]];
+        const double o = Orient(u, w, p);
+        if(o != 0)
+            return o > 0;
+        if(u.x() != w.x())
+            return (u.x() < p.x() && p.x() < w.x()) || (w.x() < p.x() && p.x() < u.x());
+        return (u.y() < p.y() && p.y() < w.y()) || (w.y() < p.y() && p.y() < u.y());
+    }
+
+    /// @brief triangle holding p, by a visibility walk from a triangle
+    ///
+    /// a ghost triangle is returned when p is out of the hull.
+    int Locate(const DPoint2 &p, int start){
+        int t = start, previous = -1;
+        size_t steps = 0;
+        for(;;){
+            const Face &f = m_faces[t];
+            int next = -1;
+            const int g = GhostCorner(f);
+            if(g >= 0){
+                // out of the hull edge, or back to the finite triangle behind it
+                if(Conflict(t, p))
+                    return t;
+                next = f.n[g];
+            }
+            else{
+                // a random first edge keeps the walk from cycling
+                m_random = m_random * 1103515245u + 12345u;
+                const unsigned int r = (m_random >> 16) % 3;
+                for(unsigned int j = 0; j < 3; ++j){
+                    const unsigned int k = (r + j) % 3;
+                    const int nb = f.n[k];
+                    if(nb < 0 || nb == previous)
+                        continue;
+                    if(Orient(m_points[f.v[(k + 1) % 3]], m_points[f.v[(k + 2) % 3]], p) < 0){
+                        next = nb;
+                        break;
+                    }
+                }
+                if(next < 0)
+                    return t;
+            }
+            previous = t;
+            t = next;
+            if(++steps > m_faces.size())
+                break;
+        }
+        // the walk should not loop with exact predicates, scan every triangle then
+        for(size_t f = 0; f < m_faces.size(); ++f){
+            const Face &face = m_faces[f];
+            if(GhostCorner(face) >= 0){
+                if(Conflict(static_cast<int >(f), p))
+                    return static_cast<int >(f);
+            }
+            else if(Orient(m_points[face.v[0]], m_points[face.v[1]], p) >= 0 &&
+                    Orient(m_points[face.v[1]], m_points[face.v[2]], p) >= 0 &&
+                    Orient(m_points[face.v[2]], m_points[face.v[0]], p) >= 0)
+                return static_cast<int >(f);
+        }
+        return t;
+    }
+
+    /// @brief insert a point, returns a triangle next to it
+    ///
+    /// when constraints are set, the cavity does not grow over the
+    /// constrained edges, which keeps the triangulation constrained Delaunay.
+    ///
+    /// @param pi point to insert
+    /// @param start triangle to start the search from
+    /// @param splitFace splitCorner when splitFace is not -1, pi splits the
+    /// edge opposite to splitCorner in splitFace, the two halves keep its
+    /// constraint. pi must lie in one of the two triangles of the edge, the
+    /// edge may have no triangle on the other side.
+    int InsertPoint(unsigned int pi, int start, int splitFace = -1, int splitCorner = 0){
+        const DPoint2 &p = m_points[pi];
+        const bool constrained = !m_fixed.empty();
+        m_stamp += 2;
+        const unsigned int inside = m_stamp, outside = m_stamp + 1;
+        m_mark.resize(m_faces.size(), 0);
+        m_cavity.clear();
+        m_boundary.clear();
+
+        unsigned int splitA = Ghost, splitB = Ghost, splitFlags = 0;
+        bool open = false;
+        if(splitFace >= 0){
+            const Face &f = m_faces[splitFace];
+            splitA = f.v[(splitCorner + 1) % 3];
+            splitB = f.v[(splitCorner + 2) % 3];
+            splitFlags = EdgeFlags(splitFace, splitCorner);
+            m_cavity.push_back(splitFace);
+            m_mark[splitFace] = inside;
+            open = f.n[splitCorner] < 0;
+            if(!open){
+                m_cavity.push_back(f.n[splitCorner]);
+                m_mark[f.n[splitCorner]] = inside;
+            }
+        }
+        else{
+            const int t = Locate(p, start);
+            for(int k = 0; k < 3; ++k){
+                if(m_faces[t].v[k] != Ghost && m_points[m_faces[t].v[k]] == p)
+                    return t;
+            }
+            m_cavity.push_back(t);
+            m_mark[t] = inside;
+        }
+
+        // the cavity grows over the neighbors whose circumcircle holds p
+        for(size_t c = 0; c < m_cavity.size(); ++c){
+            const int cf = m_cavity[c];
+            const Face &f = m_faces[cf];
+            for(int k = 0; k < 3; ++k){
+                const int nb = f.n[k];
+                if((nb >= 0 && m_mark[nb] == inside) || (cf == splitFace && k == splitCorner))
+                    continue;
+                const unsigned int flags = constrained ? EdgeFlags(cf, k) : 0;
+                if(nb >= 0 && m_mark[nb] != outside && flags == 0){
+                    if(Conflict(nb, p)){
+                        m_mark[nb] = inside;
+                        m_cavity.push_back(nb);
+                        continue;
+                    }
+                    m_mark[nb] = outside;
+                }
+                BoundaryEdge e;
+                e.a = f.v[(k + 1) % 3];
+                e.b = f.v[(k + 2) % 3];
+                e.outer = nb;
+                e.flags = flags;
+                m_boundary.push_back(e);
+            }
+        }
+
+        // a fan from p over the boundary, the cavity slots are reused first
+        const size_t count = m_boundary.size();
+        m_slots.assign(m_cavity.begin(), m_cavity.end());
+        while(m_slots.size() < count){
+            m_slots.push_back(static_cast<int >(m_faces.size()));
+            m_faces.push_back(Face());
+            if(constrained)
+                m_fixed.push_back(0);
+        }
+        for(size_t i = 0; i < count; ++i){
+            const BoundaryEdge &e = m_boundary[i];
+            const int s = m_slots[i];
+            Face &f = m_faces[s];
+            f.v[0] = e.a;
+            f.v[1] = e.b;
+            f.v[2] = pi;
+            f.n[0] = f.n[1] = -1;
+            f.n[2] = e.outer;
+            m_start[e.a] = s;
+            if(constrained){
+                m_fixed[s] = 0;
+                SetEdgeFlags(s, 2, e.flags);
+                if(splitFace >= 0 && (e.b == splitA || e.b == splitB))
+                    SetEdgeFlags(s, 0, splitFlags);
+                if(splitFace >= 0 && (e.a == splitA || e.a == splitB))
+                    SetEdgeFlags(s, 1, splitFlags);
+            }
+            if(e.outer >= 0){
+                Face &g = m_faces[e.outer];
+                for(int k = 0; k < 3; ++k){
+                    if(g.v[k] != e.a && g.v[k] != e.b)
+                        g.n[k] = s;
+                }
+            }
+        }
+        // an edge split on the border leaves the fan open at one of its ends
+        for(size_t i = 0; i < count; ++i){
+            const int s = m_slots[i];
+            if(open && m_faces[s].v[1] == splitA){
+                m_start[splitA] = s;
+                continue;
+            }
+            const int next = m_start[m_faces[s].v[1]];
+            m_faces[s].n[0] = next;
+            m_faces[next].n[1] = s;
+        }
+        m_start[pi] = m_slots[0];
+        return m_slots[0];
+    }
+
+    /// @brief constraint flags of the edge opposite to corner k: 1 fixed, 2 domain border
+    unsigned int EdgeFlags(int f, int k) const {
+        const unsigned int bits = m_fixed[f];
+        return ((bits >> k) & 1) | (((bits >> (k + 3)) & 1) << 1);
+    }
+
+    /// @brief set the constraint flags of the edge opposite to corner k, on this side only
+    void SetEdgeFlags(int f, int k, unsigned int flags){
+        unsigned char &bits = m_fixed[f];
+        bits = static_cast<unsigned char >((bits & ~((1u << k) | (8u << k))) | ((flags & 1) << k) | (((flags >> 1) & 1) << (k + 3)));
+    }
+
+    /// @brief keep some triangles, the others are dropped and their neighbors get -1
+    void KeepTriangles(const std::vector<char > &keep){
+        std::vector<int > remap(m_faces.size(), -1);
+        int kept = 0;
+        for(size_t f = 0; f < m_faces.size(); ++f){
+            if(keep[f])
+                remap[f] = kept++;
         }
+        for(size_t f = 0; f < m_faces.size(); ++f){
+            if(remap[f] < 0)
+                continue;
+            Face face = m_faces[f];
+            for(int k = 0; k < 3; ++k)
+                face.n[k] = face.n[k] >= 0 ? remap[face.n[k]] : -1;
+            m_faces[remap[f]] = face;
+            if(!m_fixed.empty())
+                m_fixed[remap[f]] = m_fixed[f];
+        }
+        m_faces.resize(kept);
+        if(!m_fixed.empty())
+            m_fixed.resize(kept);
+    }
+
+    /// @brief drop the ghost triangles, the hull edges get no neighbor
+    void RemoveGhostTriangles(){
+        std::vector<char > keep(m_faces.size());
+        for(size_t f = 0; f < m_faces.size(); ++f)
+            keep[f] = GhostCorner(m_faces[f]) < 0;
+        KeepTriangles(keep);
     }
 
 public:
@@ -228,7 +845,7 @@ public:
     void PrintTriangleToOff(std::string _filename){
         std::ofstream m_out_strm(_filename);
         m_out_strm<<"OFF"<<std::endl;
-		m_out_strm << m_points.size() - 3<< "  " << m_triangles.size() << " " << 0 << std::endl;
+		m_out_strm << m_points.size() - 3<< "  " << m_faces.size() << " " << 0 << std::endl;
 
         m_out_strm.setf(std::ios::fixed);
         m_out_strm.width(10);
@@ -239,18 +856,33 @@ public:
             m_out_strm<<pt.x()<<"  "<<pt.y()<<"  "<<z<<std::endl;
         }
         int num = 3;
-        for (auto &tri:m_triangles) {
-            unsigned int ind1 = m_pairs[ tri.p1 ];
-            unsigned int ind2 = m_pairs[ tri.p2 ];
-            unsigned int ind3 = m_pairs[ tri.p3 ];
-            m_out_strm<<num<<" "<<ind1<<" "<<ind2<<"  "<<ind3<<std::endl;
+        for (auto &f:m_faces) {
+            m_out_strm<<num<<" "<<f.v[0] - 3<<" "<<f.v[1] - 3<<"  "<<f.v[2] - 3<<std::endl;
         }
         m_out_strm.close();
     }
 protected:
+    /// cavity edge a -> b, counter clockwise around the cavity
+    struct BoundaryEdge {
+        unsigned int a;
+        unsigned int b;
+        int outer;
+        unsigned int flags;
+    };
+
     std::vector<DPoint2 > m_points;
-    std::vector<Triangle > m_triangles;
-    std::vector<Edge > m_edges;
-    std::map<DPoint2*,unsigned int > m_pairs;
+    std::vector<Face > m_faces;
+    /// constraint flags per triangle, bit k for a fixed edge opposite to v[k],
+    /// bit k + 3 for a domain border. empty for an unconstrained triangulation
+    std::vector<unsigned char > m_fixed;
+
+    // insertion scratch
+    std::vector<unsigned int > m_mark;
+    std::vector<int > m_start;
+    std::vector<int > m_cavity;
+    std::vector<int > m_slots;
+    std::vector<BoundaryEdge > m_boundary;
+    unsigned int m_stamp = 0;
+    unsigned int m_random = 1u;
 };
 #endif /* DamonsDelaunay_h */
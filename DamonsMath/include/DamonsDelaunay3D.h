@@ -0,0 +1,524 @@
+//
+//  DamonsDelaunay3D.h
+//  DPolygonTest
+//
+
+#ifndef DamonsDelaunay3D_h
+#define DamonsDelaunay3D_h
+
+#include "DamonsVector.h"
+#include "DamonsParallel.h"
+#include "utilities.h"
+#include "DamonsPredicates.h"
+#include <random>
+#include <numeric>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+using namespace DMath;
+
+/// Delaunay tetrahedralization of points in space
+template < class T = double>
+class DDelaunay3D{
+public:
+    using DPoint3 = DVector<T,3>;
+protected:
+    /// tetrahedron with Orient3D(v[0], v[1], v[2], v[3]) > 0, n[k] is the
+    /// tetrahedron across the face opposite to v[k]
+    struct Tet {
+        unsigned int v[4];
+        int n[4];
+    };
+    /// m_points[0] is the vertex at infinity of the ghost tetrahedra
+    static const unsigned int Ghost = 0;
+
+public:
+    DDelaunay3D(){}
+    DDelaunay3D(const std::vector<DPoint3 > &points){
+        m_points.resize(points.size() + 1);
+        std::copy(points.begin(), points.end(), m_points.begin() + 1);
+    }
+    /// @brief take the points from an array, x y z first in each record
+    ///
+    /// @param coords first coordinate of the first point
+    /// @param count number of points
+    /// @param stride coordinates from one point to the next
+    void SetPoints(const T *coords, size_t count, size_t stride = 3){
+        m_points.resize(count + 1);
+        ParallelFor(0, count, [&](size_t i){
+            m_points[i + 1] = DPoint3(coords[i * stride], coords[i * stride + 1], coords[i * stride + 2]);
+        }, 1 << 14);
+    }
+    ~DDelaunay3D(){
+        std::vector<DPoint3 >().swap(m_points);
+        std::vector<Tet >().swap(m_tets);
+    }
+
+    /// @brief Delaunay tetrahedralization of the points
+    ///
+    /// incremental Bowyer-Watson on tetrahedra with neighbor links. the
+    /// points are inserted in a biased randomized order (BRIO): rounds of
+    /// doubling size, each sorted along a Morton curve, so the point to
+    /// insert is close to the last created tetrahedron. it is found by a
+    /// visibility walk from there, the tetrahedra whose circumsphere holds it
+    /// are collected over the neighbors and the cavity is filled with a cone
+    /// from the point to its border faces, in expected O(n log n).
+    /// the outside of the hull is covered by ghost tetrahedra joining each
+    /// hull face to a vertex at infinity, they are dropped at the end.
+    /// duplicated points are skipped, nothing is built for coplanar points.
+    void DelaunayTetrahedralize(){
+        m_tets.clear();
+        if(Build())
+            RemoveGhostTets();
+        std::vector<unsigned int >().swap(m_mark);
+        std::vector<int >().swap(m_cavity);
+        std::vector<int >().swap(m_slots);
+        std::vector<int >().swap(m_free);
+        std::vector<BoundaryFace >().swap(m_boundary);
+        std::vector<Link >().swap(m_links);
+    }
+
+    size_t GetTetCount() const { return m_tets.size(); }
+    /// @brief input indices of the corners of a tetrahedron, Orient3D(a, b, c, d) > 0
+    void GetTet(size_t t, unsigned int &a, unsigned int &b, unsigned int &c, unsigned int &d) const {
+        a = m_tets[t].v[0] - 1;
+        b = m_tets[t].v[1] - 1;
+        c = m_tets[t].v[2] - 1;
+        d = m_tets[t].v[3] - 1;
+    }
+    /// @brief tetrahedron across the face opposite to corner k, -1 on the hull
+    int GetNeighbor(size_t t, int k) const { return m_tets[t].n[k]; }
+    size_t GetPointCount() const { return m_points.empty() ? 0 : m_points.size() - 1; }
+    const DPoint3 &GetPoint(size_t i) const { return m_points[i + 1]; }
+
+protected:
+    /// @brief six times the signed volume of abcd, positive when d is below abc, exact sign
+    static double Orient(const DPoint3 &a, const DPoint3 &b, const DPoint3 &c, const DPoint3 &d){
+        const double pa[3] = { double(a.x()), double(a.y()), double(a.z()) };
+        const double pb[3] = { double(b.x()), double(b.y()), double(b.z()) };
+        const double pc[3] = { double(c.x()), double(c.y()), double(c.z()) };
+        const double pd[3] = { double(d.x()), double(d.y()), double(d.z()) };
+        return DMath::Orient3D(pa, pb, pc, pd);
+    }
+
+    /// @brief positive when e is inside the circumsphere of abcd, exact sign
+    static double InSphere(const DPoint3 &a, const DPoint3 &b, const DPoint3 &c, const DPoint3 &d, const DPoint3 &e){
+        const double pa[3] = { double(a.x()), double(a.y()), double(a.z()) };
+        const double pb[3] = { double(b.x()), double(b.y()), double(b.z()) };
+        const double pc[3] = { double(c.x()), double(c.y()), double(c.z()) };
+        const double pd[3] = { double(d.x()), double(d.y()), double(d.z()) };
+        const double pe[3] = { double(e.x()), double(e.y()), double(e.z()) };
+        return DMath::InSphere(pa, pb, pc, pd, pe);
+    }
+
+    /// @brief true when abc are on a line, exact
+    static bool Collinear(const DPoint3 &a, const DPoint3 &b, const DPoint3 &c){
+        const double xy[3][2] = { { double(a.x()), double(a.y()) }, { double(b.x()), double(b.y()) }, { double(c.x()), double(c.y()) } };
+        const double yz[3][2] = { { double(a.y()), double(a.z()) }, { double(b.y()), double(b.z()) }, { double(c.y()), double(c.z()) } };
+        const double zx[3][2] = { { double(a.z()), double(a.x()) }, { double(b.z()), double(b.x()) }, { double(c.z()), double(c.x()) } };
+        return DMath::Orient2D(xy[0], xy[1], xy[2]) == 0 && DMath::Orient2D(yz[0], yz[1], yz[2]) == 0 && DMath::Orient2D(zx[0], zx[1], zx[2]) == 0;
+    }
+
+    /// @brief orientation of a tetrahedron with its corner k moved to p
+    double OrientWith(const Tet &tet, int k, const DPoint3 &p) const {
+        const DPoint3 *q[4];
+        for(int j = 0; j < 4; ++j)
+            q[j] = j == k ? &p : &m_points[tet.v[j]];
+        return Orient(*q[0], *q[1], *q[2], *q[3]);
+    }
+
+    /// @brief BRIO: shuffled rounds of doubling size, each along a Morton curve
+    void InsertionOrder(std::vector<unsigned int > &order) const {
+        const size_t n = m_points.size() - 1;
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 1u);
+        std::mt19937 seed(5489u);
+        std::shuffle(order.begin(), order.end(), seed);
+
+        DPoint3 low(std::numeric_limits<T>::max(), std::numeric_limits<T>::max(), std::numeric_limits<T>::max());
+        DPoint3 high(std::numeric_limits<T>::lowest(), std::numeric_limits<T>::lowest(), std::numeric_limits<T>::lowest());
+        for(size_t i = 1; i < m_points.size(); ++i){
+            for(int a = 0; a < 3; ++a){
+                low[a] = std::min(low[a], m_points[i][a]);
+                high[a] = std::max(high[a], m_points[i][a]);
+            }
+        }
+        double extent = 0;
+        for(int a = 0; a < 3; ++a)
+            extent = std::max(extent, double(high[a]) - low[a]);
+        const unsigned int bits = 16;
+        const double scale = extent > 0 ? ((1u << bits) - 1) / extent : 0.0;
+
+        std::vector<uint64_t > keys;
+        std::vector<unsigned int > values;
+        size_t end = n;
+        while(end > 0){
+            const size_t begin = end > 64 ? end / 2 : 0;
+            keys.resize(end - begin);
+            values.assign(order.begin() + begin, order.begin() + end);
+            ParallelFor(0, end - begin, [&](size_t k){
+                const DPoint3 &p = m_points[values[k]];
+                keys[k] = MortonEncode3(static_cast<uint32_t >((p.x() - low.x()) * scale), static_cast<uint32_t >((p.y() - low.y()) * scale),
+                    static_cast<uint32_t >((p.z() - low.z()) * scale));
+            }, 1 << 14);
+            ParallelRadixSort(keys, values, 3 * bits);
+            std::copy(values.begin(), values.end(), order.begin() + begin);
+            end = begin;
+        }
+    }
+
+    /// @brief tetrahedralization of all the points with the ghost tetrahedra
+    /// of the hull. false when the points are coplanar
+    bool Build(){
+        m_tets.clear();
+        m_free.clear();
+        if(m_points.size() < 5)
+            return false;
+
+        // the points are moved to the insertion order so the walks and the
+        // cavities stay in nearby memory, they are put back at the end
+        std::vector<unsigned int > order;
+        InsertionOrder(order);
+        const size_t n = order.size();
+        Permute(order, false);
+
+        // the first tetrahedron joins the first four points which are not coplanar
+        size_t i1 = 2;
+        while(i1 <= n && m_points[i1] == m_points[1])
+            ++i1;
+        size_t i2 = i1 + 1;
+        while(i2 <= n && Collinear(m_points[1], m_points[i1], m_points[i2]))
+            ++i2;
+        size_t i3 = i2 + 1;
+        while(i3 <= n && Orient(m_points[1], m_points[i1], m_points[i2], m_points[i3]) == 0)
+            ++i3;
+        if(i3 > n){
+            Permute(order, true);
+            return false;
+        }
+        unsigned int a = 1, b = static_cast<unsigned int >(i1), c = static_cast<unsigned int >(i2), d = static_cast<unsigned int >(i3);
+        if(Orient(m_points[a], m_points[b], m_points[c], m_points[d]) < 0)
+            std::swap(a, b);
+
+        FirstTet(a, b, c, d);
+        m_mark.assign(m_tets.size(), 0);
+        m_stamp = 0;
+        int last = 0;
+        for(size_t i = 2; i <= n; ++i){
+            if(i != i1 && i != i2 && i != i3)
+                last = InsertPoint(static_cast<unsigned int >(i), last);
+        }
+        Permute(order, true);
+        return true;
+    }
+
+    /// @brief move point order[i] to slot i + 1, or back with the corners of the tetrahedra
+    void Permute(const std::vector<unsigned int > &order, bool back){
+        std::vector<DPoint3 > points(m_points.size());
+        ParallelFor(0, order.size(), [&](size_t i){
+            if(back)
+                points[order[i]] = m_points[i + 1];
+            else
+                points[i + 1] = m_points[order[i]];
+        }, 1 << 14);
+        m_points.swap(points);
+        if(!back)
+            return;
+        ParallelFor(0, m_tets.size(), [&](size_t t){
+            for(int k = 0; k < 4; ++k){
+                if(m_tets[t].v[k] != Ghost)
+                    m_tets[t].v[k] = order[m_tets[t].v[k] - 1];
+            }
+        }, 1 << 14);
+    }
+
+    /// @brief the tetrahedron abcd and the ghost tetrahedra of its faces
+    void FirstTet(unsigned int a, unsigned int b, unsigned int c, unsigned int d){
+        Tet tet = { { a, b, c, d }, { 1, 2, 3, 4 } };
+        m_tets.push_back(tet);
+        // ghost 1 + k lies across the face opposite to corner k, two corners
+        // are swapped since the vertex at infinity is on the other side
+        for(int k = 0; k < 4; ++k){
+            Tet ghost = tet;
+            ghost.v[k] = Ghost;
+            std::swap(ghost.v[(k + 1) % 4], ghost.v[(k + 2) % 4]);
+            for(int j = 0; j < 4; ++j)
+                ghost.n[j] = -1;
+            ghost.n[k] = 0;
+            m_tets.push_back(ghost);
+        }
+        // the ghosts share the faces through the vertex at infinity
+        for(int i = 1; i < 5; ++i){
+            for(int j = i + 1; j < 5; ++j){
+                int fi = -1, fj = -1;
+                for(int k = 0; k < 4; ++k){
+                    if(!Has(m_tets[j], m_tets[i].v[k]))
+                        fi = k;
+                    if(!Has(m_tets[i], m_tets[j].v[k]))
+                        fj = k;
+                }
+                m_tets[i].n[fi] = j;
+                m_tets[j].n[fj] = i;
+            }
+        }
+    }
+
+    static bool Has(const Tet &tet, unsigned int v){
+        return tet.v[0] == v || tet.v[1] == v || tet.v[2] == v || tet.v[3] == v;
+    }
+
+    /// @brief true for a slot left by a cavity and not reused yet
+    static bool Free(const Tet &tet){
+        return tet.v[0] == Ghost && tet.v[1] == Ghost;
+    }
+
+    /// @brief corner of the vertex at infinity, -1 for a finite tetrahedron
+    static int GhostCorner(const Tet &tet){
+        for(int k = 0; k < 4; ++k){
+            if(tet.v[k] == Ghost)
+                return k;
+        }
+        return -1;
+    }
+
+    /// @brief true when p is in the circumsphere of a tetrahedron
+    ///
+    /// the sphere of a ghost tetrahedron is the open half space out of its
+    /// hull face, and the disk of the face: a point on the plane of the face
+    /// is inside its circle when it is inside the sphere of the tetrahedron
+    /// behind it.
+    bool Conflict(int t, const DPoint3 &p) const {
+        const Tet &tet = m_tets[t];
+        const int g = GhostCorner(tet);
+        if(g < 0)
+            return InSphere(m_points[tet.v[0]], m_points[tet.v[1]], m_points[tet.v[2]], m_points[tet.v[3]], p) > 0;
+        const double o = OrientWith(tet, g, p);
+        if(o != 0)
+            return o > 0;
+        const Tet &behind = m_tets[tet.n[g]];
+        return InSphere(m_points[behind.v[0]], m_points[behind.v[1]], m_points[behind.v[2]], m_points[behind.v[3]], p) > 0;
+    }
+
+    /// @brief tetrahedron holding p, by a visibility walk from a tetrahedron
+    ///
+    /// a ghost tetrahedron is returned when p is out of the hull.
+    int Locate(const DPoint3 &p, int start){
+        int t = start, previous = -1;
+        size_t steps = 0;
+        for(;;){
+            const Tet &tet = m_tets[t];
+            int next = -1;
+            const int g = GhostCorner(tet);
+            if(g >= 0){
+                if(Conflict(t, p))
+                    return t;
+                next = tet.n[g];
+            }
+            else{
+                // a random first face keeps the walk from cycling
+                m_random = m_random * 1103515245u + 12345u;
+                const unsigned int r = (m_random >> 16) % 4;
+                for(unsigned int j = 0; j < 4; ++j){
+                    const unsigned int k = (r + j) % 4;
+                    if(tet.n[k] == previous)
+                        continue;
+                    if(OrientWith(tet, k, p) < 0){
+                        next = tet.n[k];
+                        break;
+                    }
+                }
+                if(next < 0)
+                    return t;
+            }
+            previous = t;
+            t = next;
+            if(++steps > m_tets.size())
+                break;
+        }
+        // the walk should not loop with exact predicates, scan every tetrahedron then
+        for(size_t f = 0; f < m_tets.size(); ++f){
+            const Tet &tet = m_tets[f];
+            if(Free(tet))
+                continue;
+            if(GhostCorner(tet) >= 0){
+                if(Conflict(static_cast<int >(f), p))
+                    return static_cast<int >(f);
+                continue;
+            }
+            bool inside = true;
+            for(int k = 0; k < 4 && inside; ++k)
+                inside = OrientWith(tet, k, p) >= 0;
+            if(inside)
+                return static_cast<int >(f);
+        }
+        return t;
+    }
+
+    /// @brief insert a point, returns a tetrahedron next to it
+    int InsertPoint(unsigned int pi, int start){
+        const DPoint3 &p = m_points[pi];
+        const int t = Locate(p, start);
+        for(int k = 0; k < 4; ++k){
+            if(m_tets[t].v[k] != Ghost && m_points[m_tets[t].v[k]] == p)
+                return t;
+        }
+        m_stamp += 2;
+        const unsigned int inside = m_stamp, outside = m_stamp + 1;
+        m_mark.resize(m_tets.size(), 0);
+        m_cavity.clear();
+        m_boundary.clear();
+        m_cavity.push_back(t);
+        m_mark[t] = inside;
+
+        // the cavity grows over the neighbors whose circumsphere holds p
+        for(size_t c = 0; c < m_cavity.size(); ++c){
+            const Tet &tet = m_tets[m_cavity[c]];
+            for(int k = 0; k < 4; ++k){
+                const int nb = tet.n[k];
+                if(m_mark[nb] == inside)
+                    continue;
+                if(m_mark[nb] != outside){
+                    if(Conflict(nb, p)){
+                        m_mark[nb] = inside;
+                        m_cavity.push_back(nb);
+                        continue;
+                    }
+                    m_mark[nb] = outside;
+                }
+                // the face seen from p, p takes the place of the corner
+                BoundaryFace face;
+                for(int j = 0; j < 4; ++j)
+                    face.v[j] = tet.v[j];
+                face.v[k] = pi;
+                face.corner = k;
+                face.outer = nb;
+                m_boundary.push_back(face);
+            }
+        }
+
+        // a cone from p over the border faces, the cavity slots are reused first
+        const size_t count = m_boundary.size();
+        // a cavity can hold more tetrahedra than faces, the spare ones are
+        // kept free for the next cavities
+        m_slots.assign(m_cavity.begin(), m_cavity.end());
+        while(m_slots.size() < count){
+            if(!m_free.empty()){
+                m_slots.push_back(m_free.back());
+                m_free.pop_back();
+                continue;
+            }
+            m_slots.push_back(static_cast<int >(m_tets.size()));
+            m_tets.push_back(Tet());
+        }
+        for(size_t i = count; i < m_slots.size(); ++i){
+            Tet &tet = m_tets[m_slots[i]];
+            for(int j = 0; j < 4; ++j){
+                tet.v[j] = Ghost;
+                tet.n[j] = -1;
+            }
+            m_free.push_back(m_slots[i]);
+        }
+        if(m_links.size() < 6 * count){
+            size_t size = 64;
+            while(size < 6 * count)
+                size *= 2;
+            m_links.assign(size, Link());
+        }
+        for(size_t i = 0; i < count; ++i){
+            const BoundaryFace &face = m_boundary[i];
+            const int s = m_slots[i];
+            Tet &tet = m_tets[s];
+            for(int j = 0; j < 4; ++j){
+                tet.v[j] = face.v[j];
+                tet.n[j] = -1;
+            }
+            tet.n[face.corner] = face.outer;
+            Tet &outer = m_tets[face.outer];
+            for(int j = 0; j < 4; ++j){
+                if(!Has(tet, outer.v[j]))
+                    outer.n[j] = s;
+            }
+            // the faces through p are shared by two new tetrahedra, they are
+            // matched by their edge out of p
+            for(int j = 0; j < 4; ++j){
+                if(j == face.corner)
+                    continue;
+                unsigned int e[2], m = 0;
+                for(int i2 = 0; i2 < 4; ++i2){
+                    if(i2 != j && i2 != face.corner)
+                        e[m++] = face.v[i2];
+                }
+                const uint64_t key = e[0] < e[1] ? (uint64_t(e[0]) << 32) | e[1] : (uint64_t(e[1]) << 32) | e[0];
+                LinkFace(key, 4 * s + j);
+            }
+        }
+        return m_slots[0];
+    }
+
+    /// @brief link the face 4 * tet + corner with the other new face on the
+    /// same edge, through a hash table whose entries of past insertions are stale
+    void LinkFace(uint64_t key, int face){
+        const size_t mask = m_links.size() - 1;
+        size_t h = static_cast<size_t >((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+        while(m_links[h].stamp == m_stamp){
+            if(m_links[h].key == key){
+                const int other = m_links[h].face;
+                m_tets[face / 4].n[face % 4] = other / 4;
+                m_tets[other / 4].n[other % 4] = face / 4;
+                return;
+            }
+            h = (h + 1) & mask;
+        }
+        m_links[h].key = key;
+        m_links[h].face = face;
+        m_links[h].stamp = m_stamp;
+    }
+
+    /// @brief drop the ghost tetrahedra and the free slots, the hull faces get no neighbor
+    void RemoveGhostTets(){
+        std::vector<int > remap(m_tets.size(), -1);
+        int kept = 0;
+        for(size_t t = 0; t < m_tets.size(); ++t){
+            if(GhostCorner(m_tets[t]) < 0)
+                remap[t] = kept++;
+        }
+        for(size_t t = 0; t < m_tets.size(); ++t){
+            if(remap[t] < 0)
+                continue;
+            Tet tet = m_tets[t];
+            for(int k = 0; k < 4; ++k)
+                tet.n[k] = remap[tet.n[k]];
+            m_tets[remap[t]] = tet;
+        }
+        m_tets.resize(kept);
+    }
+
+protected:
+    /// cavity face with p at the place of its opposite corner, and the tetrahedron out of it
+    struct BoundaryFace {
+        unsigned int v[4];
+        int corner;
+        int outer;
+    };
+    /// entry of the face matching table
+    struct Link {
+        uint64_t key = 0;
+        int face = -1;
+        unsigned int stamp = 0;
+    };
+
+    std::vector<DPoint3 > m_points;
+    std::vector<Tet > m_tets;
+
+    // insertion scratch
+    std::vector<unsigned int > m_mark;
+    std::vector<int > m_cavity;
+    std::vector<int > m_slots;
+    std::vector<int > m_free;
+    std::vector<BoundaryFace > m_boundary;
+    std::vector<Link > m_links;
+    unsigned int m_stamp = 0;
+    unsigned int m_random = 1u;
+};
+#endif /* DamonsDelaunay3D_h */
@@ -0,0 +1,175 @@
+#ifndef _DAMONS_EIGEN_H_
+#define _DAMONS_EIGEN_H_
+
+#include "DamonsMatrix.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace DMath {
+
+	/// @brief Eigen decomposition of a small symmetric matrix with cyclic Jacobi rotations.
+	///
+	/// Only the upper triangle of <b>m</b> is read. Everything lives on the
+	/// stack, a few sweeps are enough to reach machine precision.
+	///
+	/// @param m symmetric matrix.
+	/// @param values eigenvalues as return, ascending.
+	/// @param vectors eigenvectors as return, column i belongs to values[i].
+	template <class T, int n>
+	inline void SymmetricEigen(const DMatrix<T, n, n>& m, DVector<T, n>& values, DMatrix<T, n, n>& vectors) {
+		T a[n][n];
+		T v[n][n];
+		for (int r = 0; r < n; ++r) {
+			for (int c = r; c < n; ++c)
+				a[r][c] = a[c][r] = m(r, c);
+			for (int c = 0; c < n; ++c)
+				v[r][c] = r == c ? T(1) : T(0);
+		}
+
+		for (int sweep = 0; sweep < 32; ++sweep) {
+			T off = 0, diag = 0;
+			for (int p = 0; p < n; ++p) {
+				diag += std::fabs(a[p][p]);
+				for (int q = p + 1; q < n; ++q)
+					off += std::fabs(a[p][q]);
+			}
+			if (off <= std::numeric_limits<T>::epsilon() * diag || off == T(0))
+				break;
+
+			for (int p = 0; p < n - 1; ++p) {
+				for (int q = p + 1; q < n; ++q) {
+					if (a[p][q] == T(0))
+						continue;
+					// rotation angle zeroing a[p][q]
+					T theta = (a[q][q] - a[p][p]) / (T(2) * a[p][q]);
+					T t = (theta >= 0 ? T(1) : T(-1)) / (std::fabs(theta) + std::sqrt(theta * theta + T(1)));
+					T c = T(1) / std::sqrt(t * t + T(1));
+					T s = t * c;
+					for (int k = 0; k < n; ++k) {
+						T akp = a[k][p], akq = a[k][q];
+						a[k][p] = c * akp - s * akq;
+						a[k][q] = s * akp + c * akq;
+					}
+					for (int k = 0; k < n; ++k) {
+						T apk = a[p][k], aqk = a[q][k];
+						a[p][k] = c * apk - s * aqk;
+						a[q][k] = s * apk + c * aqk;
+					}
+					for (int k = 0; k < n; ++k) {
+						T vkp = v[k][p], vkq = v[k][q];
+						v[k][p] = c * vkp - s * vkq;
+						v[k][q] = s * vkp + c * vkq;
+					}
+				}
+			}
+		}
+
+		// sort ascending
+		int order[n];
+		for (int i = 0; i < n; ++i) {
+			int j = i;
+			while (j > 0 && a[order[j - 1]][order[j - 1]] > a[i][i]) {
+				order[j] = order[j - 1];
+				--j;
+			}
+			order[j] = i;
+		}
+		for (int i = 0; i < n; ++i) {
+			values[i] = a[order[i]][order[i]];
+			for (int k = 0; k < n; ++k)
+				vectors(k, i) = v[k][order[i]];
+		}
+	}
+
+	/// @brief Eigen decomposition of a symmetric 3x3 matrix with cyclic Jacobi rotations.
+	///
+	/// @param m symmetric matrix.
+	/// @param values eigenvalues as return, ascending.
+	/// @param vectors eigenvectors as return, column i belongs to values[i].
+	template <class T>
+	inline void SymmetricEigen3(const DMatrix<T, 3, 3>& m, DVector<T, 3>& values, DMatrix<T, 3, 3>& vectors) {
+		SymmetricEigen<T, 3>(m, values, vectors);
+	}
+
+	/// @brief Smallest eigenpair of a symmetric 3x3 matrix in closed form.
+	///
+	/// Eigenvalues come from the trigonometric solution of the characteristic
+	/// polynomial, the eigenvector from the largest cross product of two rows
+	/// of (m - value*I). When that is ill-conditioned (repeated smallest
+	/// eigenvalue) the Jacobi solver is used instead.
+	///
+	/// @param m symmetric matrix.
+	/// @param vector unit eigenvector of the smallest eigenvalue as return.
+	/// @param values all eigenvalues as return, ascending.
+	template <class T>
+	inline void SymmetricEigen3Smallest(const DMatrix<T, 3, 3>& m, DVector<T, 3>& vector, DVector<T, 3>& values) {
+		const T a00 = m(0, 0), a01 = m(0, 1), a02 = m(0, 2);
+		const T a11 = m(1, 1), a12 = m(1, 2), a22 = m(2, 2);
+
+		// scale to avoid over/underflow
+		T scale = std::max(std::max(std::max(std::fabs(a00), std::fabs(a01)), std::max(std::fabs(a02), std::fabs(a11))), std::max(std::fabs(a12), std::fabs(a22)));
+		if (scale == T(0)) {
+			values = DVector<T, 3>(T(0));
+			vector = DVector<T, 3>(T(0), T(0), T(1));
+			return;
+		}
+		const T inv = T(1) / scale;
+		const T b00 = a00 * inv, b01 = a01 * inv, b02 = a02 * inv;
+		const T b11 = a11 * inv, b12 = a12 * inv, b22 = a22 * inv;
+
+		const T q = (b00 + b11 + b22) / T(3);
+		const T p1 = b01 * b01 + b02 * b02 + b12 * b12;
+		const T d0 = b00 - q, d1 = b11 - q, d2 = b22 - q;
+		const T p2 = d0 * d0 + d1 * d1 + d2 * d2 + T(2) * p1;
+		const T p = std::sqrt(p2 / T(6));
+		if (p <= std::numeric_limits<T>::epsilon()) {
+			// multiple of the identity, every direction is an eigenvector
+			values = DVector<T, 3>(q * scale);
+			vector = DVector<T, 3>(T(0), T(0), T(1));
+			return;
+		}
+
+		const T ip = T(1) / p;
+		const T c00 = d0 * ip, c11 = d1 * ip, c22 = d2 * ip;
+		const T c01 = b01 * ip, c02 = b02 * ip, c12 = b12 * ip;
+		T r = (c00 * (c11 * c22 - c12 * c12) - c01 * (c01 * c22 - c12 * c02) + c02 * (c01 * c12 - c11 * c02)) / T(2);
+		r = std::min(std::max(r, T(-1)), T(1));
+		const T phi = std::acos(r) / T(3);
+		const T twoThirdPi = T(2.0943951023931954923);
+		const T e2 = q + T(2) * p * std::cos(phi);
+		const T e0 = q + T(2) * p * std::cos(phi + twoThirdPi);
+		const T e1 = T(3) * q - e0 - e2;
+
+		// rows of B - e0*I, the eigenvector is orthogonal to all of them
+		const T r0[3] = { b00 - e0, b01, b02 };
+		const T r1[3] = { b01, b11 - e0, b12 };
+		const T r2[3] = { b02, b12, b22 - e0 };
+		T x0[3] = { r0[1] * r1[2] - r0[2] * r1[1], r0[2] * r1[0] - r0[0] * r1[2], r0[0] * r1[1] - r0[1] * r1[0] };
+		T x1[3] = { r0[1] * r2[2] - r0[2] * r2[1], r0[2] * r2[0] - r0[0] * r2[2], r0[0] * r2[1] - r0[1] * r2[0] };
+		T x2[3] = { r1[1] * r2[2] - r1[2] * r2[1], r1[2] * r2[0] - r1[0] * r2[2], r1[0] * r2[1] - r1[1] * r2[0] };
+		const T n0 = x0[0] * x0[0] + x0[1] * x0[1] + x0[2] * x0[2];
+		const T n1 = x1[0] * x1[0] + x1[1] * x1[1] + x1[2] * x1[2];
+		const T n2 = x2[0] * x2[0] + x2[1] * x2[1] + x2[2] * x2[2];
+		const T *best = x0;
+		T bestNorm = n0;
+		if (n1 > bestNorm) { best = x1; bestNorm = n1; }
+		if (n2 > bestNorm) { best = x2; bestNorm = n2; }
+
+		// the gap to the middle eigenvalue bounds the accuracy of the cross product
+		const T gap = e1 - e0;
+		if (bestNorm <= T(1.0e4) * std::numeric_limits<T>::epsilon() * gap * gap || gap <= std::numeric_limits<T>::epsilon()) {
+			DMatrix<T, 3, 3> vectors;
+			SymmetricEigen3(m, values, vectors);
+			vector = vectors.GetColumn(0);
+			return;
+		}
+
+		const T invNorm = T(1) / std::sqrt(bestNorm);
+		vector = DVector<T, 3>(best[0] * invNorm, best[1] * invNorm, best[2] * invNorm);
+		values = DVector<T, 3>(e0 * scale, e1 * scale, e2 * scale);
+	}
+
+}; /// namespace DMath end
+
+#endif // !_DAMONS_EIGEN_H_
@@ -8,6 +8,7 @@
 #include "DamonsTriangle.h"
 #include "DamonsPlane.h"
 #include "DamonsLine.h"
+#include "DamonsPredicates.h"
 
 namespace DGraphic {
 
@@ -535,101 +536,79 @@ namespace DGraphic {
 				if (tri1.Is_degenerate() || tri2.Is_degenerate())
 					return false;
 				///2. triangle is on the one side of another,return
+				///   the sides are exact orientations, not distances against a tolerance
 				DPlane<T> plane1 = tri1.Plane();
 				DDirection<T > n1 = plane1.GetDirection();
-				float dis1 = n1.DotProduct((tri2[0] - plane1.GetOrigin()));
-				float dis2 = n1.DotProduct((tri2[1] - plane1.GetOrigin()));
-				float dis3 = n1.DotProduct((tri2[2] - plane1.GetOrigin()));
+				const double dis1 = Orient(tri1[0], tri1[1], tri1[2], tri2[0]);
+				const double dis2 = Orient(tri1[0], tri1[1], tri1[2], tri2[1]);
+				const double dis3 = Orient(tri1[0], tri1[1], tri1[2], tri2[2]);
 
-				if (std::abs(dis1) < DEplision)
-					dis1 = 0.0f;
-				if (std::abs(dis2) < DEplision)
-					dis2 = 0.0f;
-				if (std::abs(dis3) < DEplision)
-					dis3 = 0.0f;
-
-				float d1d2 = dis1*dis2;
-				float d1d3 = dis1*dis3;
-
-				if (d1d2 > 0 && d1d3 > 0){
+				if ((dis1 > 0 && dis2 > 0 && dis3 > 0) || (dis1 < 0 && dis2 < 0 && dis3 < 0)){
 					//all point above or below plane
 					return false;
 				}
 				///3.
 				DPlane<T> plane2 = tri2.Plane();
-				DDirection<T> n2 = plane2.GetDirection();
-				//two triangle plane is parallel
-				DDirection<T> n12 = n1.CrossProduct(n2);
-				if ((n12.x()*n12.x() + n12.y()*n12.y() + n12.z()*n12.z()) < DEplision){
-					//with same plane
-					if (std::abs(dis1) < DEplision || std::abs(dis2) < DEplision || std::abs(dis3) < DEplision)
+				DLine<T> l;
+				bool isinter = PlaneWithPlane(plane1, plane2, l);
+				//two triangle is on the same plane, or so close to it that the planes have no
+				//stable intersection line, parallel planes are rejected above
+				if ((dis1 == 0 && dis2 == 0 && dis3 == 0) || !isinter){
+					float A[3];
+					int i0, i1;
+					/* first project onto an axis-aligned plane, that maximizes the area */
+					/* of the triangles, compute indices: i0,i1. */
+					A[0] = fabsf(n1[0]);
+					A[1] = fabsf(n1[1]);
+					A[2] = fabsf(n1[2]);
+					if (A[0] > A[1])
 					{
-						float A[3];
-						int i0, i1;
-						/* first project onto an axis-aligned plane, that maximizes the area */
-						/* of the triangles, compute indices: i0,i1. */
-						A[0] = fabsf(n1[0]);
-						A[1] = fabsf(n1[1]);
-						A[2] = fabsf(n1[2]);
-						if (A[0] > A[1])
+						if (A[0] > A[2])
 						{
-							if (A[0] > A[2])
-							{
-								i0 = 1;      /* A[0] is greatest */
-								i1 = 2;
-							}
-							else
-							{
-								i0 = 0;      /* A[2] is greatest */
-								i1 = 1;
-							}
+							i0 = 1;      /* A[0] is greatest */
+							i1 = 2;
 						}
-						else   /* A[0]<=A[1] */
+						else
 						{
-							if (A[2] > A[1])
-							{
-								i0 = 0;      /* A[2] is greatest */
-								i1 = 1;
-							}
-							else
-							{
-								i0 = 0;      /* A[1] is greatest */
-								i1 = 2;
-							}
+							i0 = 0;      /* A[2] is greatest */
+							i1 = 1;
 						}
-						//////////////////////////////////////////////////////////////////////////
-						/* test all edges of triangle 1 against the edges of triangle 2 */
-						EDGE_AGAINST_TRI_EDGES(tri1[0], tri1[1], tri2[0], tri2[1], tri2[2]);
-						EDGE_AGAINST_TRI_EDGES(tri1[1], tri1[2], tri2[0], tri2[1], tri2[2]);
-						EDGE_AGAINST_TRI_EDGES(tri1[2], tri1[0], tri2[0], tri2[1], tri2[2]);
-
-						/* finally, test if tri1 is totally contained in tri2 or vice versa */
-						POINT_IN_TRI(tri1[0], tri2[0], tri2[1], tri2[2]);
-						POINT_IN_TRI(tri2[0], tri1[0], tri1[1], tri1[2]);
-
-						return false;
 					}
-					// plane is parallel and seperate
-					else{
-						return false;
+					else   /* A[0]<=A[1] */
+					{
+						if (A[2] > A[1])
+						{
+							i0 = 0;      /* A[2] is greatest */
+							i1 = 1;
+						}
+						else
+						{
+							i0 = 0;      /* A[1] is greatest */
+							i1 = 2;
+						}
 					}
+					//////////////////////////////////////////////////////////////////////////
+					/* test all edges of triangle 1 against the edges of triangle 2 */
+					EDGE_AGAINST_TRI_EDGES(tri1[0], tri1[1], tri2[0], tri2[1], tri2[2]);
+					EDGE_AGAINST_TRI_EDGES(tri1[1], tri1[2], tri2[0], tri2[1], tri2[2]);
+					EDGE_AGAINST_TRI_EDGES(tri1[2], tri1[0], tri2[0], tri2[1], tri2[2]);
+
+					/* finally, test if tri1 is totally contained in tri2 or vice versa */
+					POINT_IN_TRI(tri1[0], tri2[0], tri2[1], tri2[2]);
+					POINT_IN_TRI(tri2[0], tri1[0], tri1[1], tri1[2]);
+
+					return false;
 				}
 				///4.
-				float dis4 = n2.DotProduct((tri1[0] - plane2.GetOrigin()));
-				float dis5 = n2.DotProduct((tri1[1] - plane2.GetOrigin()));
-				float dis6 = n2.DotProduct((tri1[2] - plane2.GetOrigin()));
+				const double dis4 = Orient(tri2[0], tri2[1], tri2[2], tri1[0]);
+				const double dis5 = Orient(tri2[0], tri2[1], tri2[2], tri1[1]);
+				const double dis6 = Orient(tri2[0], tri2[1], tri2[2], tri1[2]);
 
-				float d4d5 = dis4*dis5;
-				float d4d6 = dis4*dis6;
-				if (d4d5 > 0 && d4d6 > 0){
+				if ((dis4 > 0 && dis5 > 0 && dis6 > 0) || (dis4 < 0 && dis5 < 0 && dis6 < 0)){
 					//all point above or below plane
 					return false;
 				}
-				///5.get the intersect line of two plane
-				DLine<T> l;
-				bool isinter = PlaneWithPlane(plane1, plane2, l);
-				assert(isinter);
-				///6.project triangle to intersect line
+				///5.project triangle to intersect line
 				DDirection<T> d = l.Direction();
 				DPoint<T> pl = l.GetSourcePoint();
 
@@ -682,6 +661,19 @@ namespace DGraphic {
 
 				return true;
 			}
+
+		protected:
+			/// @brief orientation of d against the plane of abc, the sign is exact
+			///
+			/// @return positive if d is below abc seen counter clockwise from above, 0 if coplanar
+			template<class T>
+			static double Orient(const DPoint<T> &a, const DPoint<T> &b, const DPoint<T> &c, const DPoint<T> &d){
+				const double pa[3] = { double(a.x()), double(a.y()), double(a.z()) };
+				const double pb[3] = { double(b.x()), double(b.y()), double(b.z()) };
+				const double pc[3] = { double(c.x()), double(c.y()), double(c.z()) };
+				const double pd[3] = { double(d.x()), double(d.y()), double(d.z()) };
+				return DMath::Orient3D(pa, pb, pc, pd);
+			}
 	};
 };
 
@@ -0,0 +1,524 @@
+#ifndef _DAMONS_ISOSURFACE_H_
+#define _DAMONS_ISOSURFACE_H_
+
+#include "DamonsParallel.h"
+#include "DamonsEigen.h"
+#include "DamonsMarchingCubes.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+using namespace DMath;
+
+namespace DGraphic {
+
+	/// class DIsoSurfaceExtractor
+	/// @breif isosurface of a scalar volume by marching cubes or dual contouring
+	///
+	/// the volume is a regular grid of samples, x varying fastest. a sample is
+	/// inside when its value is above the iso value. with closeBorder the grid
+	/// is wrapped in one layer of outside samples, so the surface is closed by
+	/// caps on the volume faces and every mesh edge has two triangles.
+	///
+	/// the grid is cut in slabs of z layers processed in parallel. a crossing
+	/// edge is owned by its lower sample and numbered by a prefix sum over the
+	/// layers, so every slab knows the ids of the shared edges without any
+	/// global map: it only keeps the edge ids of the two layers it is between.
+	///
+	/// marching cubes puts one vertex on every crossing edge. dual contouring
+	/// puts one vertex in every crossing cell, at the minimum of the quadric
+	/// error of the tangent planes on the cell edges (sharp edges and corners
+	/// are kept), and one quad around every crossing edge. its surface is
+	/// closed but may touch itself on ambiguous cell faces.
+	///
+	/// @tparam T type of volume data.
+	template<class T = float>
+	class DIsoSurfaceExtractor
+	{
+	public:
+		enum ExtractMode {
+			EXTRACT_MARCHING_CUBES,
+			EXTRACT_DUAL_CONTOURING
+		};
+
+		/// extraction parameters
+		struct Parameters {
+			ExtractMode mode;
+			/// close the surface on the volume border
+			bool closeBorder;
+			/// dual contouring: eigenvalues of the quadric below this ratio of the
+			/// largest are dropped, larger values smooth the sharp features
+			double featureThreshold;
+
+			Parameters() : mode(EXTRACT_MARCHING_CUBES), closeBorder(true), featureThreshold(0.1) {}
+		};
+
+		/// @brief create an extractor
+		///
+		/// @param values nx * ny * nz samples, x varying fastest
+		/// @param nx number of samples along x
+		/// @param ny number of samples along y
+		/// @param nz number of samples along z
+		/// @param origin position of the first sample
+		/// @param spacing distance between samples along each axis
+		DIsoSurfaceExtractor(const T *values, unsigned int nx, unsigned int ny, unsigned int nz, const double origin[3], const double spacing[3])
+			: m_values(values) {
+			m_size[0] = nx;
+			m_size[1] = ny;
+			m_size[2] = nz;
+			for (int a = 0; a < 3; ++a) {
+				m_origin[a] = origin[a];
+				m_spacing[a] = spacing[a];
+			}
+		}
+		~DIsoSurfaceExtractor() {
+		}
+
+	public:
+		/// @brief extract the isosurface
+		///
+		/// @param iso iso value
+		/// @param params extraction parameters
+		/// @param vertices mesh vertices as return, 3 per vertex
+		/// @param triangles mesh triangles as return, 3 vertex indices each,
+		///		counter clockwise seen from the outside
+		/// @return false when the volume is smaller than 2 samples along an axis
+		bool Extract(const T &iso, const Parameters &params, std::vector<T > &vertices, std::vector<unsigned int > &triangles) {
+			vertices.clear();
+			triangles.clear();
+			if (m_size[0] < 2 || m_size[1] < 2 || m_size[2] < 2)
+				return false;
+
+			m_iso = iso;
+			m_params = params;
+			m_pad = params.closeBorder ? 1 : 0;
+			for (int a = 0; a < 3; ++a)
+				m_grid[a] = static_cast<int>(m_size[a]) + 2 * m_pad;
+
+			if (params.mode == EXTRACT_DUAL_CONTOURING)
+				DualContouring(vertices, triangles);
+			else
+				MarchingCubes(vertices, triangles);
+			return true;
+		}
+
+		/// @brief opposite half-edge of every triangle edge
+		///
+		/// half-edge 3 * t + k goes from corner k to corner (k + 1) % 3 of
+		/// triangle t. edges are matched by a radix sort of their end points;
+		/// when more than two triangles share an edge the half-edges are paired
+		/// in sorted order.
+		///
+		/// @param triangles 3 vertex indices per triangle
+		/// @param pairs opposite half-edge as return, -1 on the border
+		static void HalfEdgePairs(const std::vector<unsigned int > &triangles, std::vector<int > &pairs) {
+			const size_t n = triangles.size();
+			pairs.assign(n, -1);
+			std::vector<uint64_t > keys(n);
+			std::vector<unsigned int > ids(n);
+			ParallelFor(0, n, [&](size_t h) {
+				const unsigned int a = triangles[h], b = triangles[h - h % 3 + (h % 3 + 1) % 3];
+				keys[h] = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+				ids[h] = static_cast<unsigned int>(h);
+			}, 1 << 14);
+			ParallelRadixSort(keys, ids, 64);
+
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int) {
+				// runs of the same edge starting in this block
+				size_t r = b;
+				while (r > 0 && r < e && keys[r - 1] == keys[r])
+					++r;
+				std::vector<unsigned int > forward, backward;
+				while (r < e) {
+					size_t last = r + 1;
+					while (last < n && keys[last] == keys[r])
+						++last;
+					forward.clear();
+					backward.clear();
+					for (size_t s = r; s < last; ++s) {
+						const unsigned int h = ids[s];
+						const unsigned int a = triangles[h], c = triangles[h - h % 3 + (h % 3 + 1) % 3];
+						(a < c ? forward : backward).push_back(h);
+					}
+					for (size_t k = 0; k < forward.size() && k < backward.size(); ++k) {
+						pairs[forward[k]] = static_cast<int>(backward[k]);
+						pairs[backward[k]] = static_cast<int>(forward[k]);
+					}
+					r = last;
+				}
+			}, 1 << 14);
+		}
+
+	protected:
+		static const unsigned int InvalidIndex = 0xffffffffu;
+
+		/// @brief sample value in padded grid coordinates, false outside the volume
+		bool Sample(int i, int j, int k, T &value) const {
+			i -= m_pad;
+			j -= m_pad;
+			k -= m_pad;
+			if (i < 0 || j < 0 || k < 0 || i >= int(m_size[0]) || j >= int(m_size[1]) || k >= int(m_size[2]))
+				return false;
+			value = m_values[(size_t(k) * m_size[1] + j) * m_size[0] + i];
+			return true;
+		}
+		bool Inside(int i, int j, int k) const {
+			T value;
+			return Sample(i, j, k, value) && value > m_iso;
+		}
+
+		/// @brief crossing point of the edge from (i,j,k) along axis
+		void EdgePoint(int i, int j, int k, int axis, double p[3]) const {
+			int q[3] = { i, j, k };
+			++q[axis];
+			T va = T(0), vb = T(0);
+			const bool ra = Sample(i, j, k, va), rb = Sample(q[0], q[1], q[2], vb);
+			// a padding sample puts the crossing on the volume face
+			double t = 0.5;
+			if (!ra)
+				t = 1.0;
+			else if (!rb)
+				t = 0.0;
+			else if (vb != va)
+				t = std::min(std::max(double(m_iso - va) / double(vb - va), 0.0), 1.0);
+			const int c[3] = { i - m_pad, j - m_pad, k - m_pad };
+			for (int a = 0; a < 3; ++a)
+				p[a] = m_origin[a] + (c[a] + (a == axis ? t : 0.0)) * m_spacing[a];
+		}
+
+		/// @brief slabs of layers handed to the threads
+		std::vector<int > Slabs(int layers) const {
+			const int count = std::max(1, std::min(layers, int(4 * ParallelThreadCount())));
+			std::vector<int > bounds(count + 1);
+			for (int s = 0; s <= count; ++s)
+				bounds[s] = static_cast<int>((int64_t(layers) * s) / count);
+			return bounds;
+		}
+
+		/// @brief exclusive prefix sum in place, returns the total
+		static size_t PrefixSum(std::vector<size_t > &counts) {
+			size_t sum = 0;
+			for (size_t &c : counts) {
+				const size_t v = c;
+				c = sum;
+				sum += v;
+			}
+			return sum;
+		}
+
+	protected:
+		/// @brief number the crossing edges owned by layer k, one id per sample and axis
+		void EdgeLayer(int k, size_t base, std::vector<unsigned int > &ids, T *vertices) const {
+			const int gx = m_grid[0], gy = m_grid[1], gz = m_grid[2];
+			ids.assign(3 * size_t(gx) * gy, InvalidIndex);
+			size_t id = base;
+			for (int j = 0; j < gy; ++j) {
+				for (int i = 0; i < gx; ++i) {
+					const bool in = Inside(i, j, k);
+					const int limit[3] = { gx, gy, gz };
+					int q[3] = { i, j, k };
+					for (int axis = 0; axis < 3; ++axis) {
+						if (q[axis] + 1 >= limit[axis])
+							continue;
+						int r[3] = { i, j, k };
+						++r[axis];
+						if (Inside(r[0], r[1], r[2]) == in)
+							continue;
+						if (vertices) {
+							double p[3];
+							EdgePoint(i, j, k, axis, p);
+							for (int a = 0; a < 3; ++a)
+								vertices[3 * (id - base) + a] = static_cast<T>(p[a]);
+						}
+						ids[3 * (size_t(j) * gx + i) + axis] = static_cast<unsigned int>(id++);
+					}
+				}
+			}
+		}
+
+		/// @brief marching cubes case of the cell with lower corner (i,j,k)
+		unsigned int CubeIndex(int i, int j, int k) const {
+			unsigned int index = 0;
+			for (int c = 0; c < 8; ++c)
+				if (Inside(i + (c & 1), j + ((c >> 1) & 1), k + ((c >> 2) & 1)))
+					index |= 1u << c;
+			return index;
+		}
+
+		void MarchingCubes(std::vector<T > &vertices, std::vector<unsigned int > &triangles) const {
+			const int gx = m_grid[0], gy = m_grid[1], gz = m_grid[2];
+			const DMarchingCubesTable &table = DMarchingCubesTable::Get();
+
+			// edges owned by every layer and triangles of every cell layer
+			std::vector<size_t > edgeOffsets(gz, 0), triOffsets(gz, 0);
+			ParallelFor(0, gz, [&](size_t k) {
+				std::vector<unsigned int > ids;
+				EdgeLayer(static_cast<int>(k), 0, ids, nullptr);
+				size_t edges = 0;
+				for (unsigned int id : ids)
+					edges += id != InvalidIndex;
+				size_t tris = 0;
+				if (int(k) + 1 < gz)
+					for (int j = 0; j + 1 < gy; ++j)
+						for (int i = 0; i + 1 < gx; ++i)
+							tris += table.GetTriangleCount(CubeIndex(i, j, static_cast<int>(k)));
+				edgeOffsets[k] = edges;
+				triOffsets[k] = tris;
+			}, 1);
+			vertices.resize(3 * PrefixSum(edgeOffsets));
+			triangles.resize(3 * PrefixSum(triOffsets));
+
+			const std::vector<int > slabs = Slabs(gz);
+			ParallelFor(0, slabs.size() - 1, [&](size_t s) {
+				const int k0 = slabs[s], k1 = slabs[s + 1];
+				std::vector<unsigned int > lower, upper;
+				EdgeLayer(k0, edgeOffsets[k0], lower, &vertices[3 * edgeOffsets[k0]]);
+				for (int k = k0; k < k1 && k + 1 < gz; ++k) {
+					// the first layer of the next slab is numbered but written by that slab
+					EdgeLayer(k + 1, edgeOffsets[k + 1], upper, k + 1 < k1 ? &vertices[3 * edgeOffsets[k + 1]] : nullptr);
+					unsigned int *out = &triangles[3 * triOffsets[k]];
+					for (int j = 0; j + 1 < gy; ++j) {
+						for (int i = 0; i + 1 < gx; ++i) {
+							const unsigned int index = CubeIndex(i, j, k);
+							const signed char *edges = table.GetTriangles(index);
+							for (int t = 0; t < 3 * table.GetTriangleCount(index); ++t) {
+								const int corner = DMarchingCubesTable::EdgeCorner(edges[t]);
+								const std::vector<unsigned int > &layer = (corner & 4) ? upper : lower;
+								const size_t v = size_t(j + ((corner >> 1) & 1)) * gx + i + (corner & 1);
+								*out++ = layer[3 * v + DMarchingCubesTable::EdgeAxis(edges[t])];
+							}
+						}
+					}
+					lower.swap(upper);
+				}
+			}, 1);
+		}
+
+	protected:
+		/// @brief unit outward normal on a crossing edge
+		void EdgeNormal(int i, int j, int k, int axis, double n[3]) const {
+			int q[3] = { i, j, k };
+			++q[axis];
+			T va = T(0), vb = T(0);
+			const bool ra = Sample(i, j, k, va), rb = Sample(q[0], q[1], q[2], vb);
+			n[0] = n[1] = n[2] = 0.0;
+			if (!ra || !rb) {
+				// crossing on the volume face
+				n[axis] = ra ? 1.0 : -1.0;
+				return;
+			}
+			double ga[3], gb[3];
+			Gradient(i, j, k, ga);
+			Gradient(q[0], q[1], q[2], gb);
+			const double t = vb != va ? std::min(std::max(double(m_iso - va) / double(vb - va), 0.0), 1.0) : 0.5;
+			double len = 0;
+			for (int a = 0; a < 3; ++a) {
+				// the values grow inwards
+				n[a] = -((1 - t) * ga[a] + t * gb[a]);
+				len += n[a] * n[a];
+			}
+			if (len > 0) {
+				len = 1.0 / std::sqrt(len);
+				for (int a = 0; a < 3; ++a)
+					n[a] *= len;
+			}
+			else {
+				n[axis] = Inside(i, j, k) ? 1.0 : -1.0;
+			}
+		}
+
+		/// @brief central differences, one sided on the volume border
+		void Gradient(int i, int j, int k, double g[3]) const {
+			T v0 = T(0);
+			Sample(i, j, k, v0);
+			for (int a = 0; a < 3; ++a) {
+				int lo[3] = { i, j, k }, hi[3] = { i, j, k };
+				--lo[a];
+				++hi[a];
+				T vl = v0, vh = v0;
+				const bool rl = Sample(lo[0], lo[1], lo[2], vl), rh = Sample(hi[0], hi[1], hi[2], vh);
+				const double steps = (rl ? 1 : 0) + (rh ? 1 : 0);
+				g[a] = steps > 0 ? double(vh - vl) / (steps * m_spacing[a]) : 0.0;
+			}
+		}
+
+		/// @brief vertex of a crossing cell, minimum of the quadric error of its edge planes
+		void CellVertex(int i, int j, int k, T *vertex) const {
+			DMatrix<double, 3, 3> ata;
+			double atb[3] = { 0, 0, 0 }, mass[3] = { 0, 0, 0 };
+			for (int r = 0; r < 3; ++r)
+				for (int c = 0; c < 3; ++c)
+					ata(r, c) = 0.0;
+			int count = 0;
+			for (int e = 0; e < 12; ++e) {
+				const int corner = DMarchingCubesTable::EdgeCorner(e), axis = DMarchingCubesTable::EdgeAxis(e);
+				const int a[3] = { i + (corner & 1), j + ((corner >> 1) & 1), k + ((corner >> 2) & 1) };
+				int b[3] = { a[0], a[1], a[2] };
+				++b[axis];
+				if (Inside(a[0], a[1], a[2]) == Inside(b[0], b[1], b[2]))
+					continue;
+				double p[3], n[3];
+				EdgePoint(a[0], a[1], a[2], axis, p);
+				EdgeNormal(a[0], a[1], a[2], axis, n);
+				const double d = n[0] * p[0] + n[1] * p[1] + n[2] * p[2];
+				for (int r = 0; r < 3; ++r) {
+					for (int c = 0; c < 3; ++c)
+						ata(r, c) += n[r] * n[c];
+					atb[r] += n[r] * d;
+					mass[r] += p[r];
+				}
+				++count;
+			}
+			for (int r = 0; r < 3; ++r)
+				mass[r] /= count;
+
+			// pseudo inverse around the mass point, flat directions stay at the mass point
+			double rhs[3];
+			for (int r = 0; r < 3; ++r)
+				rhs[r] = atb[r] - (ata(r, 0) * mass[0] + ata(r, 1) * mass[1] + ata(r, 2) * mass[2]);
+			DVector<double, 3> values;
+			DMatrix<double, 3, 3> vectors;
+			SymmetricEigen3(ata, values, vectors);
+			double x[3] = { mass[0], mass[1], mass[2] };
+			const double limit = m_params.featureThreshold * values[2];
+			for (int s = 0; s < 3; ++s) {
+				if (values[s] <= limit || values[s] <= 0)
+					continue;
+				const double proj = (vectors(0, s) * rhs[0] + vectors(1, s) * rhs[1] + vectors(2, s) * rhs[2]) / values[s];
+				for (int r = 0; r < 3; ++r)
+					x[r] += proj * vectors(r, s);
+			}
+
+			// stay in the cell and in the volume
+			const int c[3] = { i - m_pad, j - m_pad, k - m_pad };
+			for (int a = 0; a < 3; ++a) {
+				const double lo = m_origin[a] + std::max(c[a], 0) * m_spacing[a];
+				const double hi = m_origin[a] + std::min(c[a] + 1, int(m_size[a]) - 1) * m_spacing[a];
+				vertex[a] = static_cast<T>(std::min(std::max(x[a], lo), hi));
+			}
+		}
+
+		/// @brief number the crossing cells of cell layer k
+		void CellLayer(int k, size_t base, std::vector<unsigned int > &ids, T *vertices) const {
+			const int cx = m_grid[0] - 1, cy = m_grid[1] - 1;
+			ids.assign(size_t(cx) * cy, InvalidIndex);
+			size_t id = base;
+			for (int j = 0; j < cy; ++j) {
+				for (int i = 0; i < cx; ++i) {
+					const unsigned int index = CubeIndex(i, j, k);
+					if (index == 0 || index == 255)
+						continue;
+					if (vertices)
+						CellVertex(i, j, k, &vertices[3 * (id - base)]);
+					ids[size_t(j) * cx + i] = static_cast<unsigned int>(id++);
+				}
+			}
+		}
+
+		/// @brief visit the crossing edges of sample layer k that have 4 cells around them
+		///
+		/// func(c0, c1, c2, c3) gets the cells counter clockwise around the
+		/// outward direction, as (cell layer offset -1 or 0, i, j) triples.
+		template<class Func>
+		void EdgeQuads(int k, Func func) const {
+			const int gx = m_grid[0], gy = m_grid[1], gz = m_grid[2];
+			const int limit[3] = { gx, gy, gz };
+			for (int j = 0; j < gy; ++j) {
+				for (int i = 0; i < gx; ++i) {
+					const int p[3] = { i, j, k };
+					const bool in = Inside(i, j, k);
+					for (int axis = 0; axis < 3; ++axis) {
+						const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+						if (p[axis] + 1 >= limit[axis] || p[u] == 0 || p[v] == 0 || p[u] + 1 >= limit[u] || p[v] + 1 >= limit[v])
+							continue;
+						int q[3] = { i, j, k };
+						++q[axis];
+						if (Inside(q[0], q[1], q[2]) == in)
+							continue;
+						// lower corners of the cells, counter clockwise around +axis
+						int cells[4][3];
+						const int du[4] = { -1, 0, 0, -1 }, dv[4] = { -1, -1, 0, 0 };
+						for (int c = 0; c < 4; ++c) {
+							cells[c][0] = i;
+							cells[c][1] = j;
+							cells[c][2] = k;
+							cells[c][u] += du[c];
+							cells[c][v] += dv[c];
+						}
+						if (in)
+							func(cells[0], cells[1], cells[2], cells[3]);
+						else
+							func(cells[0], cells[3], cells[2], cells[1]);
+					}
+				}
+			}
+		}
+
+		void DualContouring(std::vector<T > &vertices, std::vector<unsigned int > &triangles) const {
+			const int gx = m_grid[0], gz = m_grid[2];
+
+			std::vector<size_t > cellOffsets(gz - 1, 0), quadOffsets(gz, 0);
+			ParallelFor(0, gz, [&](size_t k) {
+				if (int(k) + 1 < gz) {
+					std::vector<unsigned int > ids;
+					CellLayer(static_cast<int>(k), 0, ids, nullptr);
+					size_t cells = 0;
+					for (unsigned int id : ids)
+						cells += id != InvalidIndex;
+					cellOffsets[k] = cells;
+				}
+				size_t quads = 0;
+				EdgeQuads(static_cast<int>(k), [&](const int *, const int *, const int *, const int *) { ++quads; });
+				quadOffsets[k] = quads;
+			}, 1);
+			vertices.resize(3 * PrefixSum(cellOffsets));
+			triangles.resize(6 * PrefixSum(quadOffsets));
+
+			// sample layer k needs the cell layers k - 1 and k
+			const std::vector<int > slabs = Slabs(gz);
+			ParallelFor(0, slabs.size() - 1, [&](size_t s) {
+				const int k0 = slabs[s], k1 = slabs[s + 1];
+				std::vector<unsigned int > lower, upper;
+				if (k0 > 0)
+					CellLayer(k0 - 1, cellOffsets[k0 - 1], lower, nullptr);
+				for (int k = k0; k < k1; ++k) {
+					if (k + 1 < gz)
+						CellLayer(k, cellOffsets[k], upper, &vertices[3 * cellOffsets[k]]);
+					unsigned int *out = &triangles[6 * quadOffsets[k]];
+					const size_t cx = gx - 1;
+					EdgeQuads(k, [&](const int *c0, const int *c1, const int *c2, const int *c3) {
+						const int *cells[4] = { c0, c1, c2, c3 };
+						unsigned int ids[4];
+						for (int c = 0; c < 4; ++c) {
+							const std::vector<unsigned int > &layer = cells[c][2] < k ? lower : upper;
+							ids[c] = layer[size_t(cells[c][1]) * cx + cells[c][0]];
+						}
+						*out++ = ids[0];
+						*out++ = ids[1];
+						*out++ = ids[2];
+						*out++ = ids[0];
+						*out++ = ids[2];
+						*out++ = ids[3];
+					});
+					lower.swap(upper);
+				}
+			}, 1);
+		}
+
+	protected:
+		const T *m_values;
+		unsigned int m_size[3];
+		double m_origin[3];
+		double m_spacing[3];
+
+		T m_iso;
+		Parameters m_params;
+		int m_pad;
+		int m_grid[3];
+	};
+
+	template<class T>
+	const unsigned int DIsoSurfaceExtractor<T>::InvalidIndex;
+};
+#endif
@@ -0,0 +1,415 @@
+#ifndef _DAMONS_KDTREE_H_
+#define _DAMONS_KDTREE_H_
+
+#include "DamonsPoint.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <stdint.h>
+
+namespace DGraphic {
+
+	/// class DKdTree
+	/// @breif flattened left balanced k-d tree over 3d points
+	///
+	/// the tree has no pointers: node i is stored at slot i of flat arrays and
+	/// its children are 2i+1 and 2i+2. a left balanced tree of n nodes fills
+	/// exactly slots [0, n), so the tree costs the points themselves plus one
+	/// original index and one split axis per point. every node is a point; the
+	/// split axis is the widest extent of its subtree.
+	///
+	/// the top levels are split one after another, the remaining subtrees are
+	/// built in parallel. queries use a fixed size stack and write into caller
+	/// buffers, batched queries run over all cores with per-thread buffers.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DKdTree
+	{
+	public:
+		/// index returned for the missing neighbors of a kNN query
+		static const unsigned int InvalidIndex = 0xffffffffu;
+
+		DKdTree() {
+		}
+
+		/// @brief build a tree over points stored as x,y,z triples
+		///
+		/// @param xyz coordinates, 3 per point
+		/// @param n number of points
+		DKdTree(const T *xyz, size_t n) {
+			Build(xyz, n);
+		}
+
+		/// @brief build a tree over points
+		///
+		/// @param points the points, index in this vector is the point id
+		explicit DKdTree(const std::vector< DPoint<T> > &points) {
+			Build(points);
+		}
+
+		~DKdTree() {
+		}
+
+	public:
+		/// @brief build the tree over points stored as x,y,z triples
+		///
+		/// @param xyz coordinates, 3 per point
+		/// @param n number of points
+		void Build(const T *xyz, size_t n) {
+			assert(n < InvalidIndex);
+			std::vector<unsigned int > perm(n);
+			std::iota(perm.begin(), perm.end(), 0u);
+			BuildTree(xyz, perm);
+		}
+
+		/// @brief build the tree over points
+		///
+		/// @param points the points, index in this vector is the point id
+		void Build(const std::vector< DPoint<T> > &points) {
+			std::vector<T > xyz(points.size() * 3);
+			ParallelFor(0, points.size(), [&](size_t i) {
+				xyz[3 * i] = points[i].x();
+				xyz[3 * i + 1] = points[i].y();
+				xyz[3 * i + 2] = points[i].z();
+			});
+			Build(xyz.data(), points.size());
+		}
+
+	public:
+		/// @brief find the k nearest points
+		///
+		/// @param q query coordinates
+		/// @param k number of neighbors
+		/// @param indices point ids as return, k entries, nearest first, InvalidIndex when fewer points exist
+		/// @param sqrDists squared distances as return, k entries
+		/// @return number of neighbors found
+		unsigned int KnnSearch(const T q[3], unsigned int k, unsigned int *indices, T *sqrDists) const {
+			for (unsigned int i = 0; i < k; ++i) {
+				indices[i] = InvalidIndex;
+				sqrDists[i] = std::numeric_limits<T>::max();
+			}
+			if (k == 0 || m_index.empty())
+				return 0;
+
+			unsigned int found = 0;
+			const size_t n = m_index.size();
+			StackEntry stack[StackSize];
+			int top = 0;
+			stack[top++] = StackEntry(0, T(0));
+
+			while (top > 0) {
+				StackEntry e = stack[--top];
+				if (e.d2 > sqrDists[k - 1])
+					continue;
+				size_t node = e.node;
+				while (node < n) {
+					const T *p = &m_coords[3 * node];
+					T d2 = SquaredDistance(p, q);
+					if (d2 < sqrDists[k - 1]) {
+						// insertion into the sorted result
+						unsigned int j = found < k ? found++ : k - 1;
+						while (j > 0 && sqrDists[j - 1] > d2) {
+							sqrDists[j] = sqrDists[j - 1];
+							indices[j] = indices[j - 1];
+							--j;
+						}
+						sqrDists[j] = d2;
+						indices[j] = m_index[node];
+					}
+					const int dim = m_splitDim[node];
+					const T diff = q[dim] - p[dim];
+					const size_t nearChild = diff < 0 ? 2 * node + 1 : 2 * node + 2;
+					const size_t farChild = diff < 0 ? 2 * node + 2 : 2 * node + 1;
+					if (farChild < n && diff * diff < sqrDists[k - 1])
+						stack[top++] = StackEntry(farChild, diff * diff);
+					node = nearChild;
+				}
+			}
+			return found;
+		}
+
+		/// @brief find the k nearest points
+		///
+		/// @param q query point
+		/// @param k number of neighbors
+		/// @param indices point ids as return, nearest first
+		/// @param sqrDists squared distances as return
+		/// @return number of neighbors found
+		unsigned int KnnSearch(const DPoint<T> &q, unsigned int k, std::vector<unsigned int > &indices, std::vector<T > &sqrDists) const {
+			indices.resize(k);
+			sqrDists.resize(k);
+			T c[3] = { q.x(), q.y(), q.z() };
+			unsigned int found = KnnSearch(c, k, indices.data(), sqrDists.data());
+			indices.resize(found);
+			sqrDists.resize(found);
+			return found;
+		}
+
+		/// @brief find all points within distance r
+		///
+		/// @param q query coordinates
+		/// @param r search radius
+		/// @param indices point ids as return (appended, unsorted)
+		/// @param sqrDists squared distances as return (appended), may be null
+		/// @return number of points found
+		size_t RadiusSearch(const T q[3], const T &r, std::vector<unsigned int > &indices, std::vector<T > *sqrDists = nullptr) const {
+			if (m_index.empty())
+				return 0;
+			const size_t before = indices.size();
+			const size_t n = m_index.size();
+			const T r2 = r * r;
+			StackEntry stack[StackSize];
+			int top = 0;
+			stack[top++] = StackEntry(0, T(0));
+
+			while (top > 0) {
+				size_t node = stack[--top].node;
+				while (node < n) {
+					const T *p = &m_coords[3 * node];
+					T d2 = SquaredDistance(p, q);
+					if (d2 <= r2) {
+						indices.push_back(m_index[node]);
+						if (sqrDists)
+							sqrDists->push_back(d2);
+					}
+					const int dim = m_splitDim[node];
+					const T diff = q[dim] - p[dim];
+					const size_t nearChild = diff < 0 ? 2 * node + 1 : 2 * node + 2;
+					const size_t farChild = diff < 0 ? 2 * node + 2 : 2 * node + 1;
+					if (farChild < n && diff * diff <= r2)
+						stack[top++] = StackEntry(farChild, diff * diff);
+					node = nearChild;
+				}
+			}
+			return indices.size() - before;
+		}
+
+		/// @brief find all points within distance r
+		///
+		/// @param q query point
+		/// @param r search radius
+		/// @param indices point ids as return (appended, unsorted)
+		/// @return number of points found
+		size_t RadiusSearch(const DPoint<T> &q, const T &r, std::vector<unsigned int > &indices) const {
+			T c[3] = { q.x(), q.y(), q.z() };
+			return RadiusSearch(c, r, indices);
+		}
+
+		/// @brief kNN for many query points in parallel
+		///
+		/// @param queries query coordinates, 3 per query
+		/// @param nq number of queries
+		/// @param k number of neighbors
+		/// @param indices point ids as return, k per query, see KnnSearch
+		/// @param sqrDists squared distances as return, k per query
+		void KnnSearch(const T *queries, size_t nq, unsigned int k, std::vector<unsigned int > &indices, std::vector<T > &sqrDists) const {
+			indices.resize(nq * k);
+			sqrDists.resize(nq * k);
+			ParallelFor(0, nq, [&](size_t i) {
+				KnnSearch(&queries[3 * i], k, &indices[i * k], &sqrDists[i * k]);
+			}, 256);
+		}
+
+		/// @brief kNN of every indexed point, the point itself is its first neighbor
+		///
+		/// queries run in tree order so neighboring queries touch the same nodes,
+		/// results are stored by point id.
+		///
+		/// @param k number of neighbors
+		/// @param indices point ids as return, k per point
+		/// @param sqrDists squared distances as return, k per point
+		void KnnSearchAll(unsigned int k, std::vector<unsigned int > &indices, std::vector<T > &sqrDists) const {
+			const size_t n = m_index.size();
+			indices.resize(n * k);
+			sqrDists.resize(n * k);
+			ParallelFor(0, n, [&](size_t node) {
+				const size_t id = m_index[node];
+				KnnSearch(&m_coords[3 * node], k, &indices[id * k], &sqrDists[id * k]);
+			}, 256);
+		}
+
+		/// @brief radius search for many query points in parallel
+		///
+		/// results are returned in CSR form: the neighbors of query i are
+		/// indices[offsets[i]] .. indices[offsets[i+1]-1]
+		///
+		/// @param queries query coordinates, 3 per query
+		/// @param nq number of queries
+		/// @param r search radius
+		/// @param offsets offset of each query as return, size nq+1
+		/// @param indices point ids as return
+		void RadiusSearch(const T *queries, size_t nq, const T &r, std::vector<size_t > &offsets, std::vector<unsigned int > &indices) const {
+			offsets.assign(nq + 1, 0);
+			const unsigned int nthreads = ParallelThreadCount();
+			std::vector< std::vector<unsigned int > > found(nthreads);
+			std::vector< std::vector<unsigned int > > owner(nthreads);
+
+			ParallelForRange(0, nq, [&](size_t b, size_t e, unsigned int tid) {
+				std::vector<unsigned int > &buf = found[tid];
+				std::vector<unsigned int > &own = owner[tid];
+				for (size_t q = b; q < e; ++q) {
+					offsets[q + 1] = RadiusSearch(&queries[3 * q], r, buf);
+					own.resize(buf.size(), static_cast<unsigned int>(q));
+				}
+			}, 256);
+
+			for (size_t q = 0; q < nq; ++q)
+				offsets[q + 1] += offsets[q];
+			indices.resize(offsets[nq]);
+
+			ParallelFor(0, nthreads, [&](size_t t) {
+				const std::vector<unsigned int > &buf = found[t];
+				const std::vector<unsigned int > &own = owner[t];
+				size_t k = 0;
+				while (k < buf.size()) {
+					unsigned int q = own[k];
+					size_t dst = offsets[q];
+					while (k < buf.size() && own[k] == q)
+						indices[dst++] = buf[k++];
+				}
+			}, 1);
+		}
+
+	public:
+		/// @brief get number of points in the tree
+		inline size_t GetPointCount() const { return m_index.size(); }
+		/// @brief get the point id stored at a tree node
+		inline unsigned int GetNodeIndex(size_t node) const { return m_index[node]; }
+		/// @brief get the coordinates stored at a tree node
+		inline const T *GetNodePoint(size_t node) const { return &m_coords[3 * node]; }
+
+	protected:
+		/// enough for 2^64 points, the stack never holds more than one entry per level
+		enum { StackSize = 64 };
+
+		struct StackEntry {
+			StackEntry() {}
+			StackEntry(size_t n, T d) : node(n), d2(d) {}
+			size_t node;
+			T d2;
+		};
+
+		/// @brief one subtree to build: node slot and the point range it owns
+		struct BuildTask {
+			size_t node;
+			size_t begin;
+			size_t end;
+		};
+
+		static inline T SquaredDistance(const T *a, const T *b) {
+			T dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+			return dx * dx + dy * dy + dz * dz;
+		}
+
+		/// @brief size of the left subtree of a left balanced tree of n nodes
+		static inline size_t LeftSize(size_t n) {
+			if (n <= 1)
+				return 0;
+			size_t full = 1;// nodes on the deepest full level
+			while (2 * full - 1 + 2 * full <= n)
+				full *= 2;
+			// levels above the last one hold 2*full-1 nodes
+			size_t last = n - (2 * full - 1);
+			return (full - 1) + std::min(last, full);
+		}
+
+		void BuildTree(const T *xyz, std::vector<unsigned int > &perm) {
+			const size_t n = perm.size();
+			m_coords.resize(3 * n);
+			m_index.resize(n);
+			m_splitDim.resize(n);
+			if (n == 0)
+				return;
+
+			// split level by level until there are enough subtrees for all threads
+			std::vector<BuildTask > level(1), next;
+			level[0].node = 0;
+			level[0].begin = 0;
+			level[0].end = n;
+			const size_t wanted = 8 * ParallelThreadCount();
+			while (!level.empty() && level.size() < wanted) {
+				next.clear();
+				for (auto &t : level) {
+					size_t mid = SplitNode(xyz, perm, t);
+					if (t.begin < mid) {
+						BuildTask l = { 2 * t.node + 1, t.begin, mid };
+						next.push_back(l);
+					}
+					if (mid + 1 < t.end) {
+						BuildTask r = { 2 * t.node + 2, mid + 1, t.end };
+						next.push_back(r);
+					}
+				}
+				level.swap(next);
+			}
+
+			ParallelFor(0, level.size(), [&](size_t i) {
+				BuildSubtree(xyz, perm, level[i]);
+			}, 1);
+		}
+
+		void BuildSubtree(const T *xyz, std::vector<unsigned int > &perm, const BuildTask &task) {
+			size_t mid = SplitNode(xyz, perm, task);
+			if (task.begin < mid) {
+				BuildTask l = { 2 * task.node + 1, task.begin, mid };
+				BuildSubtree(xyz, perm, l);
+			}
+			if (mid + 1 < task.end) {
+				BuildTask r = { 2 * task.node + 2, mid + 1, task.end };
+				BuildSubtree(xyz, perm, r);
+			}
+		}
+
+		/// @brief pick the split axis and the node point of a subtree
+		/// @return position of the node point in perm
+		size_t SplitNode(const T *xyz, std::vector<unsigned int > &perm, const BuildTask &task) {
+			T lo[3], hi[3];
+			for (int a = 0; a < 3; ++a) {
+				lo[a] = std::numeric_limits<T>::max();
+				hi[a] = std::numeric_limits<T>::lowest();
+			}
+			for (size_t i = task.begin; i < task.end; ++i) {
+				const T *p = &xyz[3 * perm[i]];
+				for (int a = 0; a < 3; ++a) {
+					lo[a] = std::min(lo[a], p[a]);
+					hi[a] = std::max(hi[a], p[a]);
+				}
+			}
+			int dim = 0;
+			if (hi[1] - lo[1] > hi[dim] - lo[dim])
+				dim = 1;
+			if (hi[2] - lo[2] > hi[dim] - lo[dim])
+				dim = 2;
+
+			const size_t mid = task.begin + LeftSize(task.end - task.begin);
+			std::nth_element(perm.begin() + task.begin, perm.begin() + mid, perm.begin() + task.end,
+				[xyz, dim](unsigned int a, unsigned int b) {
+				return xyz[3 * a + dim] < xyz[3 * b + dim];
+			});
+
+			const unsigned int id = perm[mid];
+			m_coords[3 * task.node] = xyz[3 * id];
+			m_coords[3 * task.node + 1] = xyz[3 * id + 1];
+			m_coords[3 * task.node + 2] = xyz[3 * id + 2];
+			m_index[task.node] = id;
+			m_splitDim[task.node] = static_cast<unsigned char>(dim);
+			return mid;
+		}
+
+	protected:
+		// node points, x,y,z per node in tree order
+		std::vector<T > m_coords;
+		// original point id of each node
+		std::vector<unsigned int > m_index;
+		// split axis of each node
+		std::vector<unsigned char > m_splitDim;
+	};
+
+	template<class T>
+	const unsigned int DKdTree<T>::InvalidIndex;
+};
+#endif
@@ -0,0 +1,400 @@
+#ifndef _DAMONS_LODOCTREE_H_
+#define _DAMONS_LODOCTREE_H_
+
+#include "DamonsParallel.h"
+#include "DamonsMatrix.h"
+#include "utilities.h"
+#include <vector>
+#include <queue>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+using namespace DMath;
+
+namespace DGraphic {
+
+	/// class DLodOctree
+	/// @breif level of detail octree for point cloud display
+	///
+	/// the points are sorted along a Morton curve of 21 bits per axis, so
+	/// every octree node is a contiguous run of the sorted points. a node is
+	/// split while it holds more than leafCapacity points.
+	///
+	/// every node stores a representative subsample: the first point of each
+	/// occupied cell of a grid 2^sampleDepth times finer than the node, left
+	/// out the points already taken by its ancestors. the levels are additive,
+	/// a node and all its ancestors drawn together give the detail of the
+	/// node, and every point belongs to exactly one node. the sample spacing
+	/// of a node of depth d is the cube size / 2^(d + sampleDepth).
+	///
+	/// Select walks the tree by decreasing screen space error: a node is
+	/// refined while the spacing of its samples projects to more than
+	/// minPixelSpacing pixels, nodes outside the frustum are culled and the
+	/// walk stops at the point budget.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DLodOctree
+	{
+	public:
+		/// build parameters
+		struct Parameters {
+			/// nodes with more points are split
+			unsigned int leafCapacity;
+			/// the samples of a node come from a grid 2^sampleDepth cells wide
+			unsigned int sampleDepth;
+			/// deepest node, at most 21 - sampleDepth
+			unsigned int maxDepth;
+
+			Parameters() : leafCapacity(20000), sampleDepth(7), maxDepth(14) {}
+		};
+
+		/// octree node
+		struct Node {
+			double center[3];
+			double halfSize;
+			unsigned int depth;
+			int parent;
+			// -1 for missing children
+			int children[8];
+			// own points in GetNodePoints
+			size_t first;
+			size_t count;
+			// points of the whole subtree
+			size_t total;
+		};
+
+		/// camera of a Select query
+		struct Camera {
+			/// frustum planes a, b, c, d with a x + b y + c z + d >= 0 inside, (a, b, c) unit
+			double planes[6][4];
+			/// eye position
+			double eye[3];
+			/// pixels covered by one unit at distance one, viewport height / (2 tan(fovy / 2))
+			double projection;
+			/// nodes are refined while their sample spacing covers more pixels
+			double minPixelSpacing;
+
+			Camera() : projection(1000.0), minPixelSpacing(1.5) {
+				for (int p = 0; p < 6; ++p) {
+					planes[p][0] = planes[p][1] = planes[p][2] = 0.0;
+					planes[p][3] = 1.0;
+				}
+				eye[0] = eye[1] = eye[2] = 0.0;
+			}
+
+			/// @brief frustum planes of an OpenGL style view projection matrix
+			void SetFrustum(const DMatrix<double, 4, 4> &viewProjection) {
+				const DMatrix<double, 4, 4> &m = viewProjection;
+				for (int p = 0; p < 6; ++p) {
+					const int row = p >> 1;
+					const double sign = (p & 1) ? -1.0 : 1.0;
+					double len = 0;
+					for (int c = 0; c < 4; ++c) {
+						planes[p][c] = m(3, c) + sign * m(row, c);
+						if (c < 3)
+							len += planes[p][c] * planes[p][c];
+					}
+					len = len > 0 ? 1.0 / std::sqrt(len) : 0.0;
+					for (int c = 0; c < 4; ++c)
+						planes[p][c] *= len;
+				}
+			}
+		};
+
+	public:
+		/// @brief create an octree over a point array, Build must be called before use
+		///
+		/// @param xyz point coordinates, 3 per point, kept by reference
+		/// @param count number of points
+		DLodOctree(const T *xyz, size_t count) : m_xyz(xyz), m_count(count), m_size(1.0) {
+			m_origin[0] = m_origin[1] = m_origin[2] = 0.0;
+		}
+		~DLodOctree() {
+		}
+
+	public:
+		/// @brief build the octree
+		///
+		/// @param params build parameters
+		void Build(const Parameters &params = Parameters()) {
+			m_params = params;
+			m_params.sampleDepth = std::min(params.sampleDepth, KeyDepth);
+			m_params.maxDepth = std::min(params.maxDepth, KeyDepth - m_params.sampleDepth);
+			m_params.leafCapacity = std::max(1u, params.leafCapacity);
+			m_nodes.clear();
+			m_points.clear();
+			if (m_count == 0)
+				return;
+
+			std::vector<uint64_t > keys;
+			std::vector<unsigned int > order;
+			SortPoints(keys, order);
+			BuildNodes(keys);
+			AssignPoints(keys, order);
+		}
+
+		/// @brief number of nodes, node 0 is the root
+		size_t GetNodeCount() const { return m_nodes.size(); }
+		const Node &GetNode(size_t node) const { return m_nodes[node]; }
+		/// @brief indices of the points stored in a node, Node::count of them
+		const unsigned int *GetNodePoints(size_t node) const { return m_points.data() + m_nodes[node].first; }
+		/// @brief distance between the samples of a node
+		double GetNodeSpacing(size_t node) const { return m_size / double(uint64_t(1) << (m_nodes[node].depth + m_params.sampleDepth)); }
+
+		/// @brief nodes to draw for a camera
+		///
+		/// @param camera frustum, eye and projection of the view
+		/// @param pointBudget maximum number of points of the selected nodes
+		/// @param nodes selected nodes as return, parents before children
+		/// @return number of points of the selected nodes
+		size_t Select(const Camera &camera, size_t pointBudget, std::vector<unsigned int > &nodes) const {
+			nodes.clear();
+			if (m_nodes.empty() || !Visible(camera, 0))
+				return 0;
+
+			typedef std::pair<double, unsigned int > Entry;
+			std::priority_queue<Entry > queue;
+			queue.push(Entry(ScreenSpacing(camera, 0), 0u));
+			size_t points = 0;
+			while (!queue.empty()) {
+				const Entry top = queue.top();
+				queue.pop();
+				const Node &node = m_nodes[top.second];
+				if (points + node.count > pointBudget)
+					break;
+				points += node.count;
+				nodes.push_back(top.second);
+				if (top.first <= camera.minPixelSpacing)
+					continue;
+				for (int c = 0; c < 8; ++c) {
+					const int child = node.children[c];
+					if (child >= 0 && Visible(camera, child))
+						queue.push(Entry(ScreenSpacing(camera, child), static_cast<unsigned int>(child)));
+				}
+			}
+			return points;
+		}
+
+	protected:
+		static const unsigned int KeyDepth = 21;
+		static const unsigned char Duplicate = 0xff;
+
+		/// @brief bounding cube and Morton order of the points
+		void SortPoints(std::vector<uint64_t > &keys, std::vector<unsigned int > &order) {
+			const unsigned int nthreads = ParallelThreadCount();
+			std::vector<double > lo(3 * nthreads, std::numeric_limits<double >::max()), hi(3 * nthreads, -std::numeric_limits<double >::max());
+			ParallelForRange(0, m_count, [&](size_t b, size_t e, unsigned int tid) {
+				for (size_t i = b; i < e; ++i) {
+					for (int a = 0; a < 3; ++a) {
+						lo[3 * tid + a] = std::min<double>(lo[3 * tid + a], m_xyz[3 * i + a]);
+						hi[3 * tid + a] = std::max<double>(hi[3 * tid + a], m_xyz[3 * i + a]);
+					}
+				}
+			}, 1 << 16);
+			for (unsigned int t = 1; t < nthreads; ++t) {
+				for (int a = 0; a < 3; ++a) {
+					lo[a] = std::min(lo[a], lo[3 * t + a]);
+					hi[a] = std::max(hi[a], hi[3 * t + a]);
+				}
+			}
+			m_size = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+			if (m_size <= 0)
+				m_size = 1.0;
+			for (int a = 0; a < 3; ++a)
+				m_origin[a] = lo[a];
+
+			const double cells = double(1u << KeyDepth);
+			const double scale = cells / m_size;
+			keys.resize(m_count);
+			order.resize(m_count);
+			ParallelFor(0, m_count, [&](size_t i) {
+				uint32_t c[3];
+				for (int a = 0; a < 3; ++a)
+					c[a] = static_cast<uint32_t>(std::min(std::max((m_xyz[3 * i + a] - m_origin[a]) * scale, 0.0), cells - 1));
+				keys[i] = MortonEncode3(c[0], c[1], c[2]);
+				order[i] = static_cast<unsigned int>(i);
+			}, 1 << 14);
+			ParallelRadixSort(keys, order, 3 * KeyDepth);
+		}
+
+		/// @brief split the nodes level by level, children of a level are found in parallel
+		void BuildNodes(const std::vector<uint64_t > &keys) {
+			std::vector<size_t > begin(1, 0), end(1, m_count);
+			m_nodes.resize(1);
+			InitNode(m_nodes[0], keys[0], 0, -1, m_count);
+
+			size_t levelBegin = 0;
+			while (levelBegin < m_nodes.size()) {
+				const size_t levelEnd = m_nodes.size();
+				// child ranges of every node of the level
+				std::vector<size_t > bounds(9 * (levelEnd - levelBegin));
+				ParallelFor(levelBegin, levelEnd, [&](size_t n) {
+					size_t *b = &bounds[9 * (n - levelBegin)];
+					const Node &node = m_nodes[n];
+					if (node.total <= m_params.leafCapacity || node.depth >= m_params.maxDepth) {
+						std::fill(b, b + 9, size_t(0));
+						return;
+					}
+					const unsigned int shift = 3 * (KeyDepth - node.depth - 1);
+					b[0] = begin[n];
+					b[8] = end[n];
+					for (int c = 1; c < 8; ++c) {
+						const uint64_t prefix = ((keys[begin[n]] >> (shift + 3)) << 3) | uint64_t(c);
+						b[c] = std::lower_bound(keys.begin() + b[c - 1], keys.begin() + end[n], prefix << shift) - keys.begin();
+					}
+				}, 64);
+
+				for (size_t n = levelBegin; n < levelEnd; ++n) {
+					const size_t *b = &bounds[9 * (n - levelBegin)];
+					for (int c = 0; c < 8; ++c) {
+						if (b[c + 1] <= b[c])
+							continue;
+						Node child;
+						InitNode(child, keys[b[c]], m_nodes[n].depth + 1, static_cast<int>(n), b[c + 1] - b[c]);
+						m_nodes[n].children[c] = static_cast<int>(m_nodes.size());
+						m_nodes.push_back(child);
+						begin.push_back(b[c]);
+						end.push_back(b[c + 1]);
+					}
+				}
+				levelBegin = levelEnd;
+			}
+		}
+
+		void InitNode(Node &node, uint64_t key, unsigned int depth, int parent, size_t total) const {
+			uint32_t c[3];
+			const unsigned int shift = 3 * (KeyDepth - depth);
+			MortonDecode3((key >> shift) << shift, c[0], c[1], c[2]);
+			const double cell = m_size / double(1u << KeyDepth);
+			node.halfSize = 0.5 * m_size / double(1u << depth);
+			for (int a = 0; a < 3; ++a)
+				node.center[a] = m_origin[a] + c[a] * cell + node.halfSize;
+			node.depth = depth;
+			node.parent = parent;
+			for (int k = 0; k < 8; ++k)
+				node.children[k] = -1;
+			node.first = 0;
+			node.count = 0;
+			node.total = total;
+		}
+
+		/// @brief leaf of every sorted point
+		void PointLeaves(std::vector<unsigned int > &leaf) const {
+			leaf.resize(m_count);
+			// the nodes of a level tile the sorted order, leaves mark their range
+			std::vector<size_t > begin(m_nodes.size(), 0);
+			for (size_t n = 0; n < m_nodes.size(); ++n) {
+				size_t b = begin[n];
+				const Node &node = m_nodes[n];
+				bool isLeaf = true;
+				for (int c = 0; c < 8; ++c) {
+					if (node.children[c] < 0)
+						continue;
+					isLeaf = false;
+					begin[node.children[c]] = b;
+					b += m_nodes[node.children[c]].total;
+				}
+				if (isLeaf)
+					std::fill(leaf.begin() + begin[n], leaf.begin() + begin[n] + node.total, static_cast<unsigned int>(n));
+			}
+		}
+
+		/// @brief distribute the points on the nodes with a stable counting sort
+		void AssignPoints(const std::vector<uint64_t > &keys, const std::vector<unsigned int > &order) {
+			std::vector<unsigned int > owner;
+			PointLeaves(owner);
+
+			// a point is a sample of the first depth where it starts a new sample cell
+			const unsigned int L = m_params.sampleDepth;
+			ParallelFor(0, m_count, [&](size_t s) {
+				unsigned int depth = 0;
+				if (s > 0) {
+					const uint64_t diff = keys[s] ^ keys[s - 1];
+					if (diff == 0) {
+						depth = Duplicate;
+					}
+					else {
+						int high = 63;
+						while (!((diff >> high) & 1))
+							--high;
+						const unsigned int first = KeyDepth - high / 3;
+						depth = first > L ? first - L : 0;
+					}
+				}
+				unsigned int n = owner[s];
+				while (m_nodes[n].depth > depth)
+					n = static_cast<unsigned int>(m_nodes[n].parent);
+				owner[s] = n;
+			}, 1 << 14);
+
+			const size_t grain = 1 << 20;
+			const size_t blocks = (m_count + grain - 1) / grain;
+			const size_t nodeCount = m_nodes.size();
+			std::vector<size_t > counts(blocks * nodeCount, 0);
+			ParallelForRange(0, m_count, [&](size_t b, size_t e, unsigned int) {
+				size_t *c = &counts[(b / grain) * nodeCount];
+				for (size_t s = b; s < e; ++s)
+					++c[owner[s]];
+			}, grain);
+			size_t sum = 0;
+			for (size_t n = 0; n < nodeCount; ++n) {
+				m_nodes[n].first = sum;
+				for (size_t k = 0; k < blocks; ++k) {
+					const size_t c = counts[k * nodeCount + n];
+					counts[k * nodeCount + n] = sum;
+					sum += c;
+				}
+				m_nodes[n].count = sum - m_nodes[n].first;
+			}
+
+			m_points.resize(m_count);
+			ParallelForRange(0, m_count, [&](size_t b, size_t e, unsigned int) {
+				size_t *c = &counts[(b / grain) * nodeCount];
+				for (size_t s = b; s < e; ++s)
+					m_points[c[owner[s]]++] = order[s];
+			}, grain);
+		}
+
+	protected:
+		bool Visible(const Camera &camera, size_t node) const {
+			const Node &nd = m_nodes[node];
+			const double radius = nd.halfSize * std::sqrt(3.0);
+			for (int p = 0; p < 6; ++p) {
+				const double *pl = camera.planes[p];
+				if (pl[0] * nd.center[0] + pl[1] * nd.center[1] + pl[2] * nd.center[2] + pl[3] < -radius)
+					return false;
+			}
+			return true;
+		}
+
+		/// @brief pixels covered by the sample spacing of a node
+		double ScreenSpacing(const Camera &camera, size_t node) const {
+			const Node &nd = m_nodes[node];
+			const double spacing = GetNodeSpacing(node);
+			double d2 = 0;
+			for (int a = 0; a < 3; ++a)
+				d2 += (nd.center[a] - camera.eye[a]) * (nd.center[a] - camera.eye[a]);
+			const double distance = std::max(std::sqrt(d2) - nd.halfSize * std::sqrt(3.0), spacing);
+			return spacing / distance * camera.projection;
+		}
+
+	protected:
+		const T *m_xyz;
+		size_t m_count;
+
+		Parameters m_params;
+		double m_origin[3];
+		double m_size;
+		std::vector<Node > m_nodes;
+		std::vector<unsigned int > m_points;
+	};
+
+	template<class T>
+	const unsigned int DLodOctree<T>::KeyDepth;
+	template<class T>
+	const unsigned char DLodOctree<T>::Duplicate;
+};
+#endif
@@ -0,0 +1,159 @@
+#ifndef _DAMONS_MARCHINGCUBES_H_
+#define _DAMONS_MARCHINGCUBES_H_
+
+#include <vector>
+
+namespace DGraphic {
+
+	/// class DMarchingCubesTable
+	/// @breif marching cubes case table
+	///
+	/// corner c of a cube sits at (c & 1, (c >> 1) & 1, (c >> 2) & 1). edge e
+	/// runs along axis e / 4 from corner EdgeCorner(e) to EdgeCorner(e) | (1 << axis),
+	/// so an edge is named by its lower corner and its axis and neighboring
+	/// cubes agree on it without any lookup.
+	///
+	/// the 256 cases are not typed in but built once by walking the cube
+	/// faces: on every face the crossing edges are joined with the inside
+	/// corners kept apart when the face is ambiguous, and the face segments
+	/// are chained into loops which are split into triangles (at most 5 per
+	/// case, as in the classic table). the choice only depends on the face
+	/// itself, so the two cubes of a face always cut it the same way and the
+	/// surface has no cracks. a loop crossing an ambiguous face has two
+	/// segments there; no diagonal joins two edges of one face, else it would
+	/// lie in the face, shared with the neighbor cube, and the surface would
+	/// not be manifold. a corner is inside when its bit of the case index is
+	/// set; triangles are counter clockwise seen from the outside.
+	class DMarchingCubesTable
+	{
+	public:
+		/// @brief the shared table, built on first use
+		static const DMarchingCubesTable &Get() {
+			static const DMarchingCubesTable table;
+			return table;
+		}
+
+		/// @brief number of triangles of a case
+		int GetTriangleCount(unsigned int cubeIndex) const { return m_count[cubeIndex]; }
+		/// @brief 3 edges per triangle of a case
+		const signed char *GetTriangles(unsigned int cubeIndex) const { return m_edges[cubeIndex]; }
+
+		/// @brief axis of an edge, 0 x, 1 y, 2 z
+		static int EdgeAxis(int edge) { return edge >> 2; }
+		/// @brief lower corner of an edge
+		static int EdgeCorner(int edge) {
+			const int axis = edge >> 2, r = edge & 3;
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			// the two other coordinates in increasing axis order
+			const int lo = u < v ? u : v, hi = u < v ? v : u;
+			return ((r & 1) << lo) | ((r >> 1) << hi);
+		}
+		/// @brief whether two edges lie on a common face of the cube
+		static bool ShareFace(int a, int b) {
+			const int ca = EdgeCorner(a), cb = EdgeCorner(b);
+			for (int axis = 0; axis < 3; ++axis) {
+				if (axis != EdgeAxis(a) && axis != EdgeAxis(b) && ((ca >> axis) & 1) == ((cb >> axis) & 1))
+					return true;
+			}
+			return false;
+		}
+		/// @brief edge from its lower corner and axis
+		static int CornerEdge(int corner, int axis) {
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			const int lo = u < v ? u : v, hi = u < v ? v : u;
+			return (axis << 2) | ((corner >> lo) & 1) | (((corner >> hi) & 1) << 1);
+		}
+
+	protected:
+		DMarchingCubesTable() {
+			for (unsigned int c = 0; c < 256; ++c)
+				BuildCase(c);
+		}
+
+		void BuildCase(unsigned int cubeIndex) {
+			// next[e] is the edge following e along the surface loop
+			int next[12];
+			for (int e = 0; e < 12; ++e)
+				next[e] = -1;
+
+			for (int axis = 0; axis < 3; ++axis) {
+				const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+				for (int side = 0; side < 2; ++side) {
+					// face corners counter clockwise around the outward normal
+					int fc[4];
+					const int base = side << axis;
+					fc[0] = base;
+					fc[1] = base | (1 << u);
+					fc[2] = base | (1 << u) | (1 << v);
+					fc[3] = base | (1 << v);
+					if (side == 0) {
+						const int t = fc[1];
+						fc[1] = fc[3];
+						fc[3] = t;
+					}
+					bool in[4];
+					int fe[4];
+					for (int k = 0; k < 4; ++k) {
+						in[k] = ((cubeIndex >> fc[k]) & 1) != 0;
+						const int a = fc[k], b = fc[(k + 1) & 3];
+						const int lower = a < b ? a : b, diff = a ^ b;
+						fe[k] = CornerEdge(lower, diff == 1 ? 0 : (diff == 2 ? 1 : 2));
+					}
+					// every run of inside corners enters at edge k and leaves at
+					// the first outgoing edge after it, the segment goes back
+					// from there to the entering edge
+					for (int k = 0; k < 4; ++k) {
+						if (in[k] || !in[(k + 1) & 3])
+							continue;
+						int j = (k + 1) & 3;
+						while (!(in[j] && !in[(j + 1) & 3]))
+							j = (j + 1) & 3;
+						next[fe[j]] = fe[k];
+					}
+				}
+			}
+
+			int count = 0;
+			bool used[12] = { false };
+			for (int e = 0; e < 12; ++e) {
+				if (next[e] < 0 || used[e])
+					continue;
+				int loop[12], len = 0;
+				for (int c = e; !used[c]; c = next[c]) {
+					used[c] = true;
+					loop[len++] = c;
+				}
+				// the segment from the last edge back to the first one is the base
+				Split(cubeIndex, loop, 0, len - 1, count);
+			}
+			m_count[cubeIndex] = static_cast<unsigned char>(count);
+		}
+
+		/// @brief triangulate the part of a loop from i to j, whose base i-j is
+		/// a face segment or a diagonal, without a diagonal in a cube face
+		/// @return false when there is no such triangulation
+		bool Split(unsigned int cubeIndex, const int *loop, int i, int j, int &count) {
+			if (j - i < 2)
+				return true;
+			const int first = count;
+			for (int k = i + 1; k < j; ++k) {
+				if ((k - i > 1 && ShareFace(loop[i], loop[k])) || (j - k > 1 && ShareFace(loop[k], loop[j])))
+					continue;
+				if (Split(cubeIndex, loop, i, k, count) && Split(cubeIndex, loop, k, j, count)) {
+					m_edges[cubeIndex][3 * count] = static_cast<signed char>(loop[i]);
+					m_edges[cubeIndex][3 * count + 1] = static_cast<signed char>(loop[j]);
+					m_edges[cubeIndex][3 * count + 2] = static_cast<signed char>(loop[k]);
+					++count;
+					return true;
+				}
+				count = first;
+			}
+			return false;
+		}
+
+	protected:
+		unsigned char m_count[256];
+		signed char m_edges[256][16];
+	};
+};
+#endif
@@ -0,0 +1,305 @@
+#ifndef _DAMONS_NORMALORIENT_H_
+#define _DAMONS_NORMALORIENT_H_
+
+#include "DamonsKdTree.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <assert.h>
+
+namespace DGraphic {
+
+	/// class DNormalOrienter
+	/// @breif consistent orientation of unoriented point normals
+	///
+	/// builds the Riemannian graph of the points (k nearest neighbors, edge
+	/// cost 1 - |ni.nj|) and its minimum spanning forest with a parallel
+	/// Boruvka algorithm. every tree of the forest is seeded at one point and
+	/// the orientation is propagated along the tree edges, flipping a normal
+	/// when it disagrees with its parent, so the sign changes follow the
+	/// flattest paths of the surface.
+	///
+	/// each connected component is seeded on its own. with a viewpoint the
+	/// seed is the point facing the viewpoint most directly and it is turned
+	/// towards it, otherwise the seed is the highest point and it is turned to
+	/// +z. isolated points are oriented by the same rule.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DNormalOrienter
+	{
+	public:
+		/// @brief create an orienter
+		///
+		/// @param xyz point coordinates, 3 per point
+		/// @param tree k-d tree built over the same points
+		DNormalOrienter(const T *xyz, const DKdTree<T> &tree) : m_xyz(xyz), m_tree(tree) {
+		}
+		~DNormalOrienter() {
+		}
+
+	public:
+		/// @brief orient normals in place
+		///
+		/// @param k neighbors per point in the Riemannian graph
+		/// @param normals unit (or zero) normals, 3 per point, flipped in place
+		/// @param viewpoint sensor position x,y,z, may be null
+		/// @return number of connected components of the graph
+		unsigned int Orient(unsigned int k, T *normals, const T *viewpoint = nullptr) const {
+			const size_t n = m_tree.GetPointCount();
+			if (n == 0)
+				return 0;
+
+			std::vector<unsigned int > eu, ev;
+			std::vector<float > ew;
+			BuildGraph(k, normals, eu, ev, ew);
+
+			std::vector<unsigned int > comp, mst;
+			SpanningForest(n, eu, ev, ew, comp, mst);
+
+			// forest adjacency as CSR
+			std::vector<unsigned int > offsets(n + 1, 0), adj(2 * mst.size());
+			for (unsigned int e : mst) {
+				++offsets[eu[e] + 1];
+				++offsets[ev[e] + 1];
+			}
+			for (size_t i = 0; i < n; ++i)
+				offsets[i + 1] += offsets[i];
+			{
+				std::vector<unsigned int > fill(offsets.begin(), offsets.end() - 1);
+				for (unsigned int e : mst) {
+					adj[fill[eu[e]]++] = ev[e];
+					adj[fill[ev[e]]++] = eu[e];
+				}
+			}
+
+			// one seed per component
+			std::vector<unsigned int > seed(n, InvalidIndex);
+			std::vector<double > score(n, -1.0e300);
+			unsigned int components = 0;
+			for (size_t i = 0; i < n; ++i) {
+				const unsigned int c = comp[i];
+				if (seed[c] == InvalidIndex)
+					++components;
+				const double s = SeedScore(static_cast<unsigned int>(i), normals, viewpoint);
+				if (seed[c] == InvalidIndex || s > score[c]) {
+					seed[c] = static_cast<unsigned int>(i);
+					score[c] = s;
+				}
+			}
+
+			// breadth first propagation, a point with a zero normal passes on its parent's reference
+			std::vector<unsigned int > ref(n, InvalidIndex), queue;
+			queue.reserve(n);
+			for (size_t c = 0; c < n; ++c) {
+				if (seed[c] == InvalidIndex)
+					continue;
+				const unsigned int s = seed[c];
+				OrientSeed(s, normals, viewpoint);
+				ref[s] = s;
+				queue.clear();
+				queue.push_back(s);
+				for (size_t head = 0; head < queue.size(); ++head) {
+					const unsigned int p = queue[head];
+					const T *np = &normals[3 * ref[p]];
+					for (unsigned int a = offsets[p]; a < offsets[p + 1]; ++a) {
+						const unsigned int q = adj[a];
+						if (ref[q] != InvalidIndex)
+							continue;
+						T *nq = &normals[3 * q];
+						if (nq[0] == T(0) && nq[1] == T(0) && nq[2] == T(0)) {
+							ref[q] = ref[p];
+						}
+						else {
+							if (nq[0] * np[0] + nq[1] * np[1] + nq[2] * np[2] < T(0)) {
+								nq[0] = -nq[0];
+								nq[1] = -nq[1];
+								nq[2] = -nq[2];
+							}
+							ref[q] = q;
+						}
+						queue.push_back(q);
+					}
+				}
+			}
+
+			return components;
+		}
+
+	protected:
+		static const unsigned int InvalidIndex = DKdTree<T>::InvalidIndex;
+
+		/// @brief Riemannian kNN graph, one edge per (point, neighbor) pair
+		void BuildGraph(unsigned int k, const T *normals, std::vector<unsigned int > &eu, std::vector<unsigned int > &ev, std::vector<float > &ew) const {
+			const size_t n = m_tree.GetPointCount();
+			std::vector<unsigned int > knn;
+			std::vector<T > d;
+			m_tree.KnnSearchAll(k + 1, knn, d);
+			std::vector<T >().swap(d);
+
+			const size_t stride = k + 1;
+			assert(n * k < 0xffffffffu);
+			eu.assign(n * k, InvalidIndex);
+			ev.assign(n * k, InvalidIndex);
+			ew.assign(n * k, 0.0f);
+
+			ParallelFor(0, n, [&](size_t i) {
+				const T *ni = &normals[3 * i];
+				size_t out = i * k;
+				for (size_t a = 0; a < stride && out < (i + 1) * k; ++a) {
+					const unsigned int j = knn[i * stride + a];
+					if (j == InvalidIndex || j == i)
+						continue;
+					const T *nj = &normals[3 * j];
+					const double dot = std::fabs(double(ni[0]) * nj[0] + double(ni[1]) * nj[1] + double(ni[2]) * nj[2]);
+					eu[out] = static_cast<unsigned int>(i);
+					ev[out] = j;
+					ew[out] = static_cast<float>(std::max(0.0, 1.0 - dot));
+					++out;
+				}
+			}, 1024);
+
+			// drop the unused slots (fewer than k other points)
+			size_t m = 0;
+			for (size_t e = 0; e < eu.size(); ++e) {
+				if (eu[e] == InvalidIndex)
+					continue;
+				eu[m] = eu[e];
+				ev[m] = ev[e];
+				ew[m] = ew[e];
+				++m;
+			}
+			eu.resize(m);
+			ev.resize(m);
+			ew.resize(m);
+		}
+
+		/// @brief minimum spanning forest with parallel Boruvka rounds
+		///
+		/// every round each component picks its cheapest outgoing edge (atomic
+		/// minimum on weight bits and edge index, so ties are broken the same
+		/// way everywhere and no cycle can form), the picked edges merge the
+		/// components and edges inside a component are dropped.
+		///
+		/// @param n number of points
+		/// @param comp component representative of every point as return
+		/// @param mst indices of the forest edges as return
+		static void SpanningForest(size_t n, const std::vector<unsigned int > &eu, const std::vector<unsigned int > &ev, const std::vector<float > &ew,
+			std::vector<unsigned int > &comp, std::vector<unsigned int > &mst) {
+			const uint64_t none = ~uint64_t(0);
+			std::vector<unsigned int > parent(n);
+			comp.resize(n);
+			for (size_t i = 0; i < n; ++i)
+				parent[i] = comp[i] = static_cast<unsigned int>(i);
+			std::vector< std::atomic<uint64_t> > best(n);
+			std::vector<unsigned int > live(eu.size());
+			for (size_t e = 0; e < live.size(); ++e)
+				live[e] = static_cast<unsigned int>(e);
+			mst.clear();
+
+			// path halving while merging (sequential), read only lookups in parallel
+			auto find = [&](unsigned int x) {
+				while (parent[x] != x) {
+					parent[x] = parent[parent[x]];
+					x = parent[x];
+				}
+				return x;
+			};
+			auto root = [&](unsigned int x) {
+				while (parent[x] != x)
+					x = parent[x];
+				return x;
+			};
+
+			while (!live.empty()) {
+				ParallelFor(0, n, [&](size_t i) { best[i].store(none, std::memory_order_relaxed); }, 1 << 14);
+
+				ParallelForRange(0, live.size(), [&](size_t b, size_t e, unsigned int) {
+					for (size_t l = b; l < e; ++l) {
+						const unsigned int edge = live[l];
+						const unsigned int cu = comp[eu[edge]], cv = comp[ev[edge]];
+						if (cu == cv)
+							continue;
+						uint32_t bits;
+						std::memcpy(&bits, &ew[edge], sizeof(bits));
+						const uint64_t key = (uint64_t(bits) << 32) | edge;
+						AtomicMin(best[cu], key);
+						AtomicMin(best[cv], key);
+					}
+				}, 1 << 12);
+
+				// merging is cheap next to the edge scan
+				size_t added = 0;
+				for (size_t c = 0; c < n; ++c) {
+					const uint64_t key = best[c].load(std::memory_order_relaxed);
+					if (comp[c] != c || key == none)
+						continue;
+					const unsigned int edge = static_cast<unsigned int>(key & 0xffffffffu);
+					const unsigned int ru = find(eu[edge]), rv = find(ev[edge]);
+					if (ru == rv)
+						continue;
+					parent[std::max(ru, rv)] = std::min(ru, rv);
+					mst.push_back(edge);
+					++added;
+				}
+				if (added == 0)
+					break;
+
+				ParallelFor(0, n, [&](size_t i) { comp[i] = root(static_cast<unsigned int>(i)); }, 1 << 12);
+				ParallelFor(0, n, [&](size_t i) { parent[i] = comp[i]; }, 1 << 14);
+
+				live.erase(std::remove_if(live.begin(), live.end(), [&](unsigned int edge) {
+					return comp[eu[edge]] == comp[ev[edge]];
+				}), live.end());
+			}
+		}
+
+		static void AtomicMin(std::atomic<uint64_t> &a, uint64_t v) {
+			uint64_t cur = a.load(std::memory_order_relaxed);
+			while (v < cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+			}
+		}
+
+	protected:
+		/// @brief how well a point can seed its component, larger is better
+		double SeedScore(unsigned int i, const T *normals, const T *viewpoint) const {
+			const T *nrm = &normals[3 * i];
+			if (nrm[0] == T(0) && nrm[1] == T(0) && nrm[2] == T(0))
+				return -1.0e300;
+			const T *p = &m_xyz[3 * i];
+			if (!viewpoint)
+				return p[2];
+			const double dx = viewpoint[0] - p[0], dy = viewpoint[1] - p[1], dz = viewpoint[2] - p[2];
+			const double len = std::sqrt(dx * dx + dy * dy + dz * dz);
+			if (len == 0.0)
+				return 0.0;
+			return std::fabs(nrm[0] * dx + nrm[1] * dy + nrm[2] * dz) / len;
+		}
+
+		/// @brief turn a seed normal towards the viewpoint or +z
+		void OrientSeed(unsigned int i, T *normals, const T *viewpoint) const {
+			T *nrm = &normals[3 * i];
+			const T *p = &m_xyz[3 * i];
+			double dot = nrm[2];
+			if (viewpoint)
+				dot = nrm[0] * (viewpoint[0] - p[0]) + nrm[1] * (viewpoint[1] - p[1]) + nrm[2] * (viewpoint[2] - p[2]);
+			if (dot < 0) {
+				nrm[0] = -nrm[0];
+				nrm[1] = -nrm[1];
+				nrm[2] = -nrm[2];
+			}
+		}
+
+	protected:
+		const T *m_xyz;
+		const DKdTree<T> &m_tree;
+	};
+
+	template<class T>
+	const unsigned int DNormalOrienter<T>::InvalidIndex;
+};
+#endif
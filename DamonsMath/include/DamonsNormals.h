@@ -0,0 +1,151 @@
+#ifndef _DAMONS_NORMALS_H_
+#define _DAMONS_NORMALS_H_
+
+#include "DamonsKdTree.h"
+#include "DamonsEigen.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <cmath>
+
+namespace DGraphic {
+
+	/// class DNormalEstimator
+	/// @breif point cloud normals from the PCA of local neighborhoods
+	///
+	/// the normal of a point is the eigenvector of the smallest eigenvalue of
+	/// the covariance of its neighbors (kNN or fixed radius). covariances are
+	/// accumulated in double around the neighborhood centroid and solved in
+	/// closed form on the stack; only the neighbor buffers are allocated, once
+	/// per thread. points are visited in k-d tree order so consecutive queries
+	/// hit the same tree nodes.
+	///
+	/// normals are unit length but not oriented, points with fewer than three
+	/// neighbors get a zero normal.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DNormalEstimator
+	{
+	public:
+		/// @brief create an estimator
+		///
+		/// @param xyz point coordinates, 3 per point
+		/// @param tree k-d tree built over the same points
+		DNormalEstimator(const T *xyz, const DKdTree<T> &tree) : m_xyz(xyz), m_tree(tree) {
+		}
+		~DNormalEstimator() {
+		}
+
+	public:
+		/// @brief estimate normals from the k nearest neighbors (the point included)
+		///
+		/// @param k neighborhood size
+		/// @param normals normals as return, 3 per point
+		/// @param curvature surface variation l0/(l0+l1+l2) as return, 1 per point, may be null
+		void EstimateKnn(unsigned int k, T *normals, T *curvature = nullptr) const {
+			const size_t n = m_tree.GetPointCount();
+			std::vector< std::vector<unsigned int > > ids(ParallelThreadCount(), std::vector<unsigned int >(k));
+			std::vector< std::vector<T > > dists(ParallelThreadCount(), std::vector<T >(k));
+
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+				unsigned int *nb = ids[tid].data();
+				T *d = dists[tid].data();
+				for (size_t node = b; node < e; ++node) {
+					const unsigned int id = m_tree.GetNodeIndex(node);
+					unsigned int found = m_tree.KnnSearch(m_tree.GetNodePoint(node), k, nb, d);
+					FitNormal(nb, found, &normals[3 * id], curvature ? &curvature[id] : nullptr);
+				}
+			}, 512);
+		}
+
+		/// @brief estimate normals from all neighbors within a radius
+		///
+		/// @param radius neighborhood radius
+		/// @param normals normals as return, 3 per point
+		/// @param curvature surface variation as return, may be null
+		/// @param maxNeighbors use at most this many neighbors (0 = all), the nearest are kept
+		void EstimateRadius(const T &radius, T *normals, T *curvature = nullptr, unsigned int maxNeighbors = 0) const {
+			const size_t n = m_tree.GetPointCount();
+			std::vector< std::vector<unsigned int > > ids(ParallelThreadCount());
+			std::vector< std::vector<T > > dists(ParallelThreadCount());
+
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+				std::vector<unsigned int > &nb = ids[tid];
+				std::vector<T > &d = dists[tid];
+				for (size_t node = b; node < e; ++node) {
+					const unsigned int id = m_tree.GetNodeIndex(node);
+					nb.clear();
+					d.clear();
+					m_tree.RadiusSearch(m_tree.GetNodePoint(node), radius, nb, &d);
+					if (maxNeighbors > 0 && nb.size() > maxNeighbors)
+						KeepNearest(nb, d, maxNeighbors);
+					FitNormal(nb.data(), static_cast<unsigned int>(nb.size()), &normals[3 * id], curvature ? &curvature[id] : nullptr);
+				}
+			}, 512);
+		}
+
+	protected:
+		/// @brief keep the m nearest entries of a neighbor list
+		static void KeepNearest(std::vector<unsigned int > &nb, std::vector<T > &d, unsigned int m) {
+			// partial selection on (distance, id) pairs kept in the two arrays
+			for (unsigned int i = 0; i < m; ++i) {
+				size_t best = i;
+				for (size_t j = i + 1; j < nb.size(); ++j) {
+					if (d[j] < d[best])
+						best = j;
+				}
+				std::swap(d[i], d[best]);
+				std::swap(nb[i], nb[best]);
+			}
+			nb.resize(m);
+			d.resize(m);
+		}
+
+		/// @brief fit a plane to the neighbor points
+		void FitNormal(const unsigned int *nb, unsigned int count, T *normal, T *curvature) const {
+			if (count < 3) {
+				normal[0] = normal[1] = normal[2] = T(0);
+				if (curvature)
+					*curvature = T(0);
+				return;
+			}
+
+			double c[3] = { 0, 0, 0 };
+			for (unsigned int i = 0; i < count; ++i) {
+				const T *p = &m_xyz[3 * nb[i]];
+				c[0] += p[0];
+				c[1] += p[1];
+				c[2] += p[2];
+			}
+			const double inv = 1.0 / count;
+			c[0] *= inv;
+			c[1] *= inv;
+			c[2] *= inv;
+
+			double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+			for (unsigned int i = 0; i < count; ++i) {
+				const T *p = &m_xyz[3 * nb[i]];
+				const double dx = p[0] - c[0], dy = p[1] - c[1], dz = p[2] - c[2];
+				xx += dx * dx; xy += dx * dy; xz += dx * dz;
+				yy += dy * dy; yz += dy * dz; zz += dz * dz;
+			}
+
+			DMatrix<double, 3, 3> cov(xx, xy, xz, xy, yy, yz, xz, yz, zz);
+			DVector<double, 3> vec, values;
+			SymmetricEigen3Smallest(cov, vec, values);
+
+			normal[0] = static_cast<T>(vec[0]);
+			normal[1] = static_cast<T>(vec[1]);
+			normal[2] = static_cast<T>(vec[2]);
+			if (curvature) {
+				const double sum = values[0] + values[1] + values[2];
+				*curvature = sum > 0 ? static_cast<T>(std::max(0.0, values[0]) / sum) : T(0);
+			}
+		}
+
+	protected:
+		const T *m_xyz;
+		const DKdTree<T> &m_tree;
+	};
+};
+#endif
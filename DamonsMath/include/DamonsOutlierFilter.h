@@ -0,0 +1,141 @@
+#ifndef _DAMONS_OUTLIERFILTER_H_
+#define _DAMONS_OUTLIERFILTER_H_
+
+#include "DamonsKdTree.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <cmath>
+
+namespace DGraphic {
+
+	/// class DOutlierFilter
+	/// @breif statistical and radius outlier detection on point clouds
+	///
+	/// both filters only write a keep mask (1 keep, 0 outlier), the points are
+	/// not copied. queries run over all cores in k-d tree order with one
+	/// neighbor buffer per thread.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DOutlierFilter
+	{
+	public:
+		/// @brief create a filter
+		///
+		/// @param tree k-d tree built over the points to filter
+		explicit DOutlierFilter(const DKdTree<T> &tree) : m_tree(tree) {
+		}
+		~DOutlierFilter() {
+		}
+
+	public:
+		/// @brief statistical outlier removal
+		///
+		/// the mean distance of every point to its k nearest neighbors is
+		/// computed, a point is an outlier when its mean distance is larger
+		/// than the global mean plus stdMul standard deviations.
+		///
+		/// @param k number of neighbors, the point itself not counted
+		/// @param stdMul multiplier of the standard deviation
+		/// @param keep mask as return, one entry per point
+		/// @return number of points kept
+		size_t Statistical(unsigned int k, const double &stdMul, std::vector<unsigned char > &keep) const {
+			const size_t n = m_tree.GetPointCount();
+			keep.assign(n, 1);
+			if (n < 2 || k == 0)
+				return n;
+
+			std::vector<double > meanDist(n);
+			const unsigned int nthreads = ParallelThreadCount();
+			std::vector< std::vector<unsigned int > > ids(nthreads, std::vector<unsigned int >(k + 1));
+			std::vector< std::vector<T > > dists(nthreads, std::vector<T >(k + 1));
+			std::vector<double > sum(nthreads, 0.0), sum2(nthreads, 0.0);
+
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+				unsigned int *nb = ids[tid].data();
+				T *d = dists[tid].data();
+				double s = 0, s2 = 0;
+				for (size_t node = b; node < e; ++node) {
+					const unsigned int found = m_tree.KnnSearch(m_tree.GetNodePoint(node), k + 1, nb, d);
+					// the first neighbor is the point itself
+					double mean = 0;
+					for (unsigned int j = 1; j < found; ++j)
+						mean += std::sqrt(double(d[j]));
+					mean = found > 1 ? mean / (found - 1) : 0.0;
+					meanDist[m_tree.GetNodeIndex(node)] = mean;
+					s += mean;
+					s2 += mean * mean;
+				}
+				sum[tid] += s;
+				sum2[tid] += s2;
+			}, 512);
+
+			double s = 0, s2 = 0;
+			for (unsigned int t = 0; t < nthreads; ++t) {
+				s += sum[t];
+				s2 += sum2[t];
+			}
+			const double mean = s / n;
+			const double var = std::max(0.0, (s2 - s * mean) / (n - 1));
+			const double threshold = mean + stdMul * std::sqrt(var);
+
+			return Mark(keep, [&](size_t i) { return meanDist[i] <= threshold; });
+		}
+
+		/// @brief radius outlier removal
+		///
+		/// a point is an outlier when fewer than minNeighbors other points lie
+		/// within radius. only the minNeighbors nearest points are searched.
+		///
+		/// @param radius search radius
+		/// @param minNeighbors neighbors needed to keep a point
+		/// @param keep mask as return, one entry per point
+		/// @return number of points kept
+		size_t Radius(const T &radius, unsigned int minNeighbors, std::vector<unsigned char > &keep) const {
+			const size_t n = m_tree.GetPointCount();
+			keep.assign(n, 1);
+			if (minNeighbors == 0)
+				return n;
+
+			const unsigned int nthreads = ParallelThreadCount();
+			std::vector< std::vector<unsigned int > > ids(nthreads, std::vector<unsigned int >(minNeighbors + 1));
+			std::vector< std::vector<T > > dists(nthreads, std::vector<T >(minNeighbors + 1));
+			const T r2 = radius * radius;
+
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+				unsigned int *nb = ids[tid].data();
+				T *d = dists[tid].data();
+				for (size_t node = b; node < e; ++node) {
+					const unsigned int found = m_tree.KnnSearch(m_tree.GetNodePoint(node), minNeighbors + 1, nb, d);
+					keep[m_tree.GetNodeIndex(node)] = (found == minNeighbors + 1 && d[minNeighbors] <= r2) ? 1 : 0;
+				}
+			}, 512);
+
+			return Mark(keep, [&](size_t i) { return keep[i] != 0; });
+		}
+
+	protected:
+		/// @brief fill the mask from a predicate and count the kept points
+		template<class Pred>
+		static size_t Mark(std::vector<unsigned char > &keep, Pred pred) {
+			const unsigned int nthreads = ParallelThreadCount();
+			std::vector<size_t > kept(nthreads, 0);
+			ParallelForRange(0, keep.size(), [&](size_t b, size_t e, unsigned int tid) {
+				size_t c = 0;
+				for (size_t i = b; i < e; ++i) {
+					keep[i] = pred(i) ? 1 : 0;
+					c += keep[i];
+				}
+				kept[tid] += c;
+			}, 1 << 16);
+			size_t total = 0;
+			for (size_t c : kept)
+				total += c;
+			return total;
+		}
+
+	protected:
+		const DKdTree<T> &m_tree;
+	};
+};
+#endif
@@ -0,0 +1,156 @@
+#ifndef _DAMONS_PARALLEL_H_
+#define _DAMONS_PARALLEL_H_
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace DMath {
+
+	/// @brief Get the number of worker threads used by the parallel helpers.
+	///
+	/// @return hardware concurrency, at least 1.
+	inline unsigned int ParallelThreadCount() {
+		unsigned int n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : n;
+	}
+
+	/// @brief Run a function over the range [begin, end) split into blocks.
+	///
+	/// Blocks of <b>grain</b> indices are handed out dynamically to the worker
+	/// threads, so uneven work per index is balanced automatically.
+	/// the function is called as func(block_begin, block_end, thread_id) where
+	/// thread_id is in [0, ParallelThreadCount()) and can be used to address
+	/// per-thread buffers.
+	///
+	/// @param begin first index of the range.
+	/// @param end one past the last index of the range.
+	/// @param func function to call for each block.
+	/// @param grain number of indices per block.
+	template <class Func>
+	inline void ParallelForRange(size_t begin, size_t end, Func func, size_t grain = 1024) {
+		if (end <= begin)
+			return;
+		grain = std::max<size_t>(grain, 1);
+		const size_t blocks = (end - begin + grain - 1) / grain;
+		const unsigned int nthreads = static_cast<unsigned int>(std::min<size_t>(ParallelThreadCount(), blocks));
+		if (nthreads <= 1) {
+			func(begin, end, 0u);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		auto worker = [&](unsigned int tid) {
+			for (;;) {
+				size_t b = next.fetch_add(1);
+				if (b >= blocks)
+					break;
+				size_t first = begin + b * grain;
+				size_t last = std::min(end, first + grain);
+				func(first, last, tid);
+			}
+		};
+
+		std::vector<std::thread > threads;
+		threads.reserve(nthreads - 1);
+		for (unsigned int t = 1; t < nthreads; ++t)
+			threads.push_back(std::thread(worker, t));
+		worker(0);
+		for (auto &th : threads)
+			th.join();
+	}
+
+	/// @brief Run a function for each index of [begin, end) in parallel.
+	///
+	/// @param begin first index of the range.
+	/// @param end one past the last index of the range.
+	/// @param func function called as func(index).
+	/// @param grain number of indices per block.
+	template <class Func>
+	inline void ParallelFor(size_t begin, size_t end, Func func, size_t grain = 1024) {
+		ParallelForRange(begin, end, [&func](size_t b, size_t e, unsigned int) {
+			for (size_t i = b; i < e; ++i)
+				func(i);
+		}, grain);
+	}
+
+	/// @brief radix sort worker, values may be null
+	template <class V>
+	inline void ParallelRadixSort(std::vector<uint64_t>& keys, std::vector<V>* values, unsigned int keyBits) {
+		const size_t n = keys.size();
+		if (n < 2)
+			return;
+		const unsigned int parts = static_cast<unsigned int>(std::min<size_t>(ParallelThreadCount(), (n + 65535) / 65536));
+		const size_t grain = (n + parts - 1) / parts;
+		std::vector<uint64_t > keyTmp(n);
+		std::vector<V > valueTmp(values ? n : 0);
+		std::vector<size_t > counts(parts * 256);
+
+		for (unsigned int shift = 0; shift < keyBits; shift += 8) {
+			std::fill(counts.begin(), counts.end(), 0);
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int) {
+				size_t *c = &counts[(b / grain) * 256];
+				for (size_t i = b; i < e; ++i)
+					++c[(keys[i] >> shift) & 0xff];
+			}, grain);
+
+			// turn counts into scatter offsets, digit major then part
+			size_t sum = 0;
+			bool single = false;
+			for (unsigned int d = 0; d < 256; ++d) {
+				size_t total = 0;
+				for (unsigned int p = 0; p < parts; ++p)
+					total += counts[p * 256 + d];
+				if (total == n)
+					single = true;
+				for (unsigned int p = 0; p < parts; ++p) {
+					size_t c = counts[p * 256 + d];
+					counts[p * 256 + d] = sum;
+					sum += c;
+				}
+			}
+			if (single)
+				continue;
+
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int) {
+				size_t *c = &counts[(b / grain) * 256];
+				for (size_t i = b; i < e; ++i) {
+					size_t dst = c[(keys[i] >> shift) & 0xff]++;
+					keyTmp[dst] = keys[i];
+					if (values)
+						valueTmp[dst] = (*values)[i];
+				}
+			}, grain);
+			keys.swap(keyTmp);
+			if (values)
+				values->swap(valueTmp);
+		}
+	}
+
+	/// @brief Sort 64 bit keys together with their values, parallel LSD radix sort.
+	///
+	/// Only the low <b>keyBits</b> bits of the keys are used, 8 bits per pass;
+	/// a pass is skipped when all keys share its digit. Each thread histograms
+	/// and scatters one contiguous part of the array, so the sort is stable.
+	///
+	/// @param keys keys to sort.
+	/// @param values values moved with their keys, same size as keys.
+	/// @param keyBits number of significant key bits.
+	template <class V>
+	inline void ParallelRadixSort(std::vector<uint64_t>& keys, std::vector<V>& values, unsigned int keyBits = 64) {
+		ParallelRadixSort(keys, &values, keyBits);
+	}
+
+	/// @brief Sort 64 bit keys, parallel LSD radix sort.
+	///
+	/// @param keys keys to sort.
+	/// @param keyBits number of significant key bits.
+	inline void ParallelRadixSort(std::vector<uint64_t>& keys, unsigned int keyBits = 64) {
+		ParallelRadixSort(keys, static_cast<std::vector<unsigned char >*>(nullptr), keyBits);
+	}
+
+};/// namespace DMath end
+
+#endif // !_DAMONS_PARALLEL_H_
@@ -0,0 +1,729 @@
+#ifndef _DAMONS_POISSON_H_
+#define _DAMONS_POISSON_H_
+
+#include "DamonsParallel.h"
+#include "utilities.h"
+#include "DamonsMarchingCubes.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <assert.h>
+
+using namespace DMath;
+
+namespace DGraphic {
+
+	/// class DPoissonReconstruction
+	/// @breif screened Poisson surface reconstruction of oriented points
+	///
+	/// the indicator function (+0.5 inside, -0.5 outside) is solved on the
+	/// vertices of an octree of depth D over the bounding cube. the points are
+	/// sorted once in Morton order so the cells of every level are runs of
+	/// that order. the coarse levels are complete grids, the finer levels only
+	/// keep the vertices of the cells holding points, dilated by a band of
+	/// cells, so memory follows the surface area and not 8^D.
+	///
+	/// every level is discretized with trilinear elements: the right hand
+	/// side is the divergence of the splatted normals, the operator is the 7
+	/// point Laplacian plus the lumped screening term pulling the function to
+	/// 0 at the points. a point stands for the area of the finest cell around
+	/// it holding a few points, so sparse points still get their weight. the
+	/// levels are solved coarse to fine with a Jacobi preconditioned
+	/// conjugate gradient (cascadic multigrid); the coarse
+	/// solution gives the initial guess of the next level and the values on
+	/// the border of its band; outside its band a level takes the values of
+	/// the coarser levels. the surface is the iso level of the mean value at
+	/// the points, extracted by marching cubes over the finest band with one
+	/// vertex per crossing edge. where it leaves the band, it is followed
+	/// through the finest cells outside, so the mesh is always closed.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DPoissonReconstruction
+	{
+	public:
+		/// reconstruction parameters
+		struct Parameters {
+			/// depth of the finest level, the bounding cube is cut in 2^depth cells per axis
+			unsigned int depth;
+			/// levels up to this depth are solved as complete grids
+			unsigned int fullDepth;
+			/// cells added around the cells holding points on the sparse levels
+			unsigned int bandWidth;
+			/// weight of the screening term, 0 gives the plain Poisson solution
+			double screening;
+			/// ratio between the bounding cube and the bounding box of the points
+			double scale;
+			/// conjugate gradient iterations per level
+			unsigned int iterations;
+			/// relative residual stopping a level
+			double tolerance;
+
+			Parameters() : depth(8), fullDepth(5), bandWidth(2), screening(4.0), scale(1.1), iterations(100), tolerance(1.0e-5) {}
+		};
+
+		/// @brief create a reconstruction
+		///
+		/// @param xyz point coordinates, 3 per point
+		/// @param normals outward normals, 3 per point, need not be unit
+		/// @param count number of points
+		DPoissonReconstruction(const T *xyz, const T *normals, size_t count) : m_xyz(xyz), m_normals(normals), m_count(count) {
+		}
+		~DPoissonReconstruction() {
+		}
+
+	public:
+		/// @brief reconstruct the surface
+		///
+		/// @param params reconstruction parameters
+		/// @param vertices mesh vertices as return, 3 per vertex
+		/// @param triangles mesh triangles as return, 3 vertex indices each,
+		///		counter clockwise seen from the outside
+		/// @return false when there are no points or the depth is out of range
+		bool Reconstruct(const Parameters &params, std::vector<T > &vertices, std::vector<unsigned int > &triangles) {
+			vertices.clear();
+			triangles.clear();
+			if (m_count == 0 || params.depth < 2 || params.depth > MaxDepth)
+				return false;
+
+			m_params = params;
+			m_params.bandWidth = std::max(1u, params.bandWidth);
+			m_params.fullDepth = std::min(std::max(2u, params.fullDepth), params.depth);
+			SortSamples();
+
+			std::vector<Level > levels(m_params.depth - 1);
+			for (unsigned int d = 2; d <= m_params.depth; ++d) {
+				Level &level = levels[d - 2];
+				level.depth = d;
+				BuildVertices(level);
+				BuildNeighbors(level);
+				Solve(levels, d);
+				// the coarser levels only give values outside the finer bands
+				if (d < m_params.depth)
+					std::vector<unsigned int >().swap(level.neighbors);
+			}
+
+			Extract(levels, vertices, triangles);
+			return true;
+		}
+
+	protected:
+		static const unsigned int MaxDepth = 20;
+		static const unsigned int InvalidIndex = 0xffffffffu;
+		/// points a cell needs to give them its area
+		static const unsigned int SamplesPerCell = 8;
+
+		/// vertices of one level, sorted by Morton key
+		struct Level {
+			unsigned int depth;
+			std::vector<uint64_t > keys;
+			// -x +x -y +y -z +z neighbors, InvalidIndex on the band border
+			std::vector<unsigned int > neighbors;
+			std::vector<float > values;
+		};
+
+		/// points in Morton order of their finest cell
+		struct Sample {
+			float p[3];
+			float n[3];
+			float area;
+		};
+
+	protected:
+		static uint64_t Encode(unsigned int i, unsigned int j, unsigned int k) {
+			return MortonEncode3(i, j, k);
+		}
+		static void Decode(uint64_t key, unsigned int &i, unsigned int &j, unsigned int &k) {
+			MortonDecode3(key, i, j, k);
+		}
+
+		/// @brief index of a key in a sorted key array, InvalidIndex when missing
+		static unsigned int Find(const std::vector<uint64_t > &keys, uint64_t key) {
+			auto it = std::lower_bound(keys.begin(), keys.end(), key);
+			return (it != keys.end() && *it == key) ? static_cast<unsigned int>(it - keys.begin()) : InvalidIndex;
+		}
+
+		double CellSize(unsigned int depth) const { return m_size / double(1u << depth); }
+
+	protected:
+		/// @brief bounding cube, Morton sort of the points and their areas
+		void SortSamples() {
+			double lo[3], hi[3];
+			for (int a = 0; a < 3; ++a) {
+				lo[a] = std::numeric_limits<double >::max();
+				hi[a] = -std::numeric_limits<double >::max();
+			}
+			for (size_t i = 0; i < m_count; ++i) {
+				for (int a = 0; a < 3; ++a) {
+					lo[a] = std::min<double>(lo[a], m_xyz[3 * i + a]);
+					hi[a] = std::max<double>(hi[a], m_xyz[3 * i + a]);
+				}
+			}
+			m_size = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+			if (m_size <= 0)
+				m_size = 1.0;
+			m_size *= std::max(1.0, m_params.scale);
+			for (int a = 0; a < 3; ++a)
+				m_origin[a] = 0.5 * (lo[a] + hi[a]) - 0.5 * m_size;
+
+			const unsigned int cells = 1u << m_params.depth;
+			const double inv = cells / m_size;
+			std::vector<uint64_t > keys(m_count);
+			std::vector<unsigned int > order(m_count);
+			ParallelFor(0, m_count, [&](size_t i) {
+				unsigned int c[3];
+				for (int a = 0; a < 3; ++a) {
+					const double t = (m_xyz[3 * i + a] - m_origin[a]) * inv;
+					c[a] = static_cast<unsigned int>(std::min(std::max(t, 0.0), double(cells - 1)));
+				}
+				keys[i] = Encode(c[0], c[1], c[2]);
+				order[i] = static_cast<unsigned int>(i);
+			}, 1 << 14);
+			ParallelRadixSort(keys, order, 3 * m_params.depth);
+
+			// each point stands for the area of a cell shared by the points inside
+			// it, the finest cell around it holding enough points so sparse points
+			// are not given the area of a finest cell
+			m_samples.resize(m_count);
+			m_sampleKeys.swap(keys);
+			ParallelFor(0, m_count, [&](size_t s) {
+				unsigned int depth = m_params.depth;
+				size_t b = s, e = s + 1;
+				for (; depth >= 2; --depth) {
+					const unsigned int shift = 3 * (m_params.depth - depth);
+					const uint64_t lo = (m_sampleKeys[s] >> shift) << shift, hi = lo + (uint64_t(1) << shift);
+					b = std::lower_bound(m_sampleKeys.begin(), m_sampleKeys.begin() + s, lo) - m_sampleKeys.begin();
+					e = std::lower_bound(m_sampleKeys.begin() + s, m_sampleKeys.end(), hi) - m_sampleKeys.begin();
+					if (e - b >= SamplesPerCell || depth <= m_params.fullDepth)
+						break;
+				}
+				const double h = CellSize(depth);
+				Sample &sample = m_samples[s];
+				const size_t i = order[s];
+				double len = 0;
+				for (int a = 0; a < 3; ++a) {
+					sample.p[a] = static_cast<float>(m_xyz[3 * i + a] - m_origin[a]);
+					len += double(m_normals[3 * i + a]) * m_normals[3 * i + a];
+				}
+				len = len > 0 ? 1.0 / std::sqrt(len) : 0.0;
+				for (int a = 0; a < 3; ++a)
+					sample.n[a] = static_cast<float>(m_normals[3 * i + a] * len);
+				sample.area = static_cast<float>(h * h / double(e - b));
+			}, 1 << 12);
+		}
+
+		/// @brief first and last point of a cell of a level
+		void CellRange(unsigned int depth, unsigned int i, unsigned int j, unsigned int k, size_t &b, size_t &e) const {
+			const unsigned int shift = 3 * (m_params.depth - depth);
+			const uint64_t lo = Encode(i, j, k) << shift;
+			const uint64_t hi = lo + (uint64_t(1) << shift);
+			b = std::lower_bound(m_sampleKeys.begin(), m_sampleKeys.end(), lo) - m_sampleKeys.begin();
+			e = std::lower_bound(m_sampleKeys.begin() + b, m_sampleKeys.end(), hi) - m_sampleKeys.begin();
+		}
+
+		/// @brief interior vertices of a level, all of them or the band around the points
+		void BuildVertices(Level &level) const {
+			const unsigned int d = level.depth;
+			const unsigned int res = 1u << d;
+			std::vector<uint64_t > &keys = level.keys;
+			keys.clear();
+
+			if (d <= m_params.fullDepth) {
+				keys.reserve(size_t(res - 1) * (res - 1) * (res - 1));
+				for (unsigned int k = 1; k < res; ++k)
+					for (unsigned int j = 1; j < res; ++j)
+						for (unsigned int i = 1; i < res; ++i)
+							keys.push_back(Encode(i, j, k));
+				ParallelRadixSort(keys, 3 * (d + 1));
+				return;
+			}
+
+			// occupied cells are runs of the sorted point keys
+			const unsigned int shift = 3 * (m_params.depth - d);
+			keys.reserve(m_sampleKeys.size() / 4 + 1);
+			for (size_t s = 0; s < m_sampleKeys.size(); ++s) {
+				const uint64_t cell = m_sampleKeys[s] >> shift;
+				if (keys.empty() || keys.back() != cell)
+					keys.push_back(cell);
+			}
+
+			// cell corners dilated by the band, one axis at a time
+			const int w = static_cast<int>(m_params.bandWidth);
+			for (int axis = 0; axis < 3; ++axis) {
+				std::vector<uint64_t > grown(keys.size() * (2 * w + 2));
+				ParallelFor(0, keys.size(), [&](size_t c) {
+					unsigned int p[3];
+					Decode(keys[c], p[0], p[1], p[2]);
+					uint64_t *out = &grown[c * (2 * w + 2)];
+					for (int o = -w; o <= w + 1; ++o) {
+						unsigned int q[3] = { p[0], p[1], p[2] };
+						q[axis] = static_cast<unsigned int>(std::min(std::max(int(p[axis]) + o, 1), int(res) - 1));
+						*out++ = Encode(q[0], q[1], q[2]);
+					}
+				}, 1 << 12);
+				ParallelRadixSort(grown, 3 * (d + 1));
+				grown.erase(std::unique(grown.begin(), grown.end()), grown.end());
+				keys.swap(grown);
+			}
+			keys.shrink_to_fit();
+		}
+
+		/// @brief 6 neighbors of every vertex
+		void BuildNeighbors(Level &level) const {
+			const std::vector<uint64_t > &keys = level.keys;
+			level.neighbors.assign(6 * keys.size(), InvalidIndex);
+			ParallelFor(0, keys.size(), [&](size_t v) {
+				unsigned int p[3];
+				Decode(keys[v], p[0], p[1], p[2]);
+				for (int axis = 0; axis < 3; ++axis) {
+					for (int side = 0; side < 2; ++side) {
+						unsigned int q[3] = { p[0], p[1], p[2] };
+						q[axis] += side ? 1 : -1;
+						level.neighbors[6 * v + 2 * axis + side] = Find(keys, Encode(q[0], q[1], q[2]));
+					}
+				}
+			}, 1 << 10);
+		}
+
+		/// @brief value of a vertex of a solved level, prolonged from the coarser
+		/// levels outside its band, -0.5 on the border of the cube
+		float VertexValue(const std::vector<Level > &levels, unsigned int depth, const unsigned int p[3]) const {
+			const Level &level = levels[depth - 2];
+			const unsigned int v = Find(level.keys, Encode(p[0], p[1], p[2]));
+			if (v != InvalidIndex)
+				return level.values[v];
+			const unsigned int res = 1u << depth;
+			if (p[0] == 0 || p[1] == 0 || p[2] == 0 || p[0] >= res || p[1] >= res || p[2] >= res)
+				return -0.5f;
+			return depth > 2 ? Prolong(levels, depth - 1, p) : -0.5f;
+		}
+
+		/// @brief solution of a coarse level at a vertex of the next finer level
+		float Prolong(const std::vector<Level > &levels, unsigned int coarse, const unsigned int p[3]) const {
+			unsigned int lo[3], hi[3];
+			for (int a = 0; a < 3; ++a) {
+				lo[a] = p[a] >> 1;
+				hi[a] = (p[a] + 1) >> 1;
+			}
+			double sum = 0;
+			int n = 0;
+			unsigned int q[3];
+			for (q[2] = lo[2]; q[2] <= hi[2]; ++q[2])
+				for (q[1] = lo[1]; q[1] <= hi[1]; ++q[1])
+					for (q[0] = lo[0]; q[0] <= hi[0]; ++q[0]) {
+						sum += VertexValue(levels, coarse, q);
+						++n;
+					}
+			return static_cast<float>(sum / n);
+		}
+
+		/// @brief divergence and screening weights of a vertex
+		void Splat(unsigned int depth, const unsigned int p[3], double &rhs, double &weight) const {
+			const double h = CellSize(depth), inv = 1.0 / h;
+			rhs = 0;
+			weight = 0;
+			for (int c = 0; c < 8; ++c) {
+				// the vertex is corner 7 - c of the cell
+				const unsigned int ci = p[0] - 1 + (c & 1), cj = p[1] - 1 + ((c >> 1) & 1), ck = p[2] - 1 + ((c >> 2) & 1);
+				size_t b, e;
+				CellRange(depth, ci, cj, ck, b, e);
+				const double o[3] = { ci * h, cj * h, ck * h };
+				const int corner[3] = { 1 - (c & 1), 1 - ((c >> 1) & 1), 1 - ((c >> 2) & 1) };
+				for (size_t s = b; s < e; ++s) {
+					const Sample &sample = m_samples[s];
+					double wt[3], dw[3];
+					for (int a = 0; a < 3; ++a) {
+						const double t = std::min(std::max((sample.p[a] - o[a]) * inv, 0.0), 1.0);
+						wt[a] = corner[a] ? t : 1.0 - t;
+						dw[a] = corner[a] ? inv : -inv;
+					}
+					const double phi = wt[0] * wt[1] * wt[2];
+					// the normals point out, the indicator grows inwards
+					const double div = sample.n[0] * dw[0] * wt[1] * wt[2] + sample.n[1] * wt[0] * dw[1] * wt[2] + sample.n[2] * wt[0] * wt[1] * dw[2];
+					rhs -= sample.area * div;
+					weight += sample.area * phi;
+				}
+			}
+		}
+
+		/// @brief solve one level with Jacobi preconditioned conjugate gradients,
+		/// the coarser levels are solved
+		void Solve(std::vector<Level > &levels, unsigned int depth) const {
+			Level &level = levels[depth - 2];
+			const bool coarse = depth > 2;
+			const size_t n = level.keys.size();
+			const double h = CellSize(level.depth);
+			const double screen = m_params.screening / (h * h);
+			std::vector<float > rhs(n), diag(n);
+			level.values.resize(n);
+
+			ParallelFor(0, n, [&](size_t v) {
+				unsigned int p[3];
+				Decode(level.keys[v], p[0], p[1], p[2]);
+				double b, w;
+				Splat(level.depth, p, b, w);
+				b /= h;
+				// missing neighbors are known values moved to the right hand side
+				for (int s = 0; s < 6; ++s) {
+					if (level.neighbors[6 * v + s] != InvalidIndex)
+						continue;
+					unsigned int q[3] = { p[0], p[1], p[2] };
+					q[s >> 1] += (s & 1) ? 1 : -1;
+					b += coarse ? Prolong(levels, depth - 1, q) : -0.5;
+				}
+				rhs[v] = static_cast<float>(b);
+				diag[v] = static_cast<float>(6.0 + screen * w);
+				level.values[v] = coarse ? Prolong(levels, depth - 1, p) : 0.0f;
+			}, 1 << 8);
+
+			const unsigned int nthreads = ParallelThreadCount();
+			std::vector<double > partial(nthreads);
+			auto apply = [&](const std::vector<float > &x, std::vector<float > &y) {
+				ParallelFor(0, n, [&](size_t v) {
+					const unsigned int *nb = &level.neighbors[6 * v];
+					double s = diag[v] * double(x[v]);
+					for (int k = 0; k < 6; ++k)
+						if (nb[k] != InvalidIndex)
+							s -= x[nb[k]];
+					y[v] = static_cast<float>(s);
+				}, 1 << 12);
+			};
+			auto dot = [&](const std::vector<float > &x, const std::vector<float > &y) {
+				std::fill(partial.begin(), partial.end(), 0.0);
+				ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+					double s = 0;
+					for (size_t v = b; v < e; ++v)
+						s += double(x[v]) * y[v];
+					partial[tid] += s;
+				}, 1 << 14);
+				double s = 0;
+				for (double p : partial)
+					s += p;
+				return s;
+			};
+
+			std::vector<float > r(n), z(n), d(n), q(n);
+			apply(level.values, q);
+			ParallelFor(0, n, [&](size_t v) {
+				r[v] = rhs[v] - q[v];
+				z[v] = r[v] / diag[v];
+				d[v] = z[v];
+			}, 1 << 14);
+			std::vector<float >().swap(rhs);
+
+			const double norm0 = std::sqrt(dot(r, r));
+			double rz = dot(r, z);
+			for (unsigned int it = 0; it < m_params.iterations && norm0 > 0; ++it) {
+				apply(d, q);
+				const double dq = dot(d, q);
+				if (dq <= 0)
+					break;
+				const double alpha = rz / dq;
+				ParallelFor(0, n, [&](size_t v) {
+					level.values[v] += static_cast<float>(alpha * d[v]);
+					r[v] -= static_cast<float>(alpha * q[v]);
+					z[v] = r[v] / diag[v];
+				}, 1 << 14);
+				if (std::sqrt(dot(r, r)) <= m_params.tolerance * norm0)
+					break;
+				const double rzNew = dot(r, z);
+				const double beta = rzNew / rz;
+				rz = rzNew;
+				ParallelFor(0, n, [&](size_t v) {
+					d[v] = static_cast<float>(z[v] + beta * d[v]);
+				}, 1 << 14);
+			}
+		}
+
+		/// @brief trilinear value of the finest level at a point
+		double Evaluate(const std::vector<Level > &levels, const float p[3]) const {
+			const unsigned int depth = m_params.depth;
+			const double inv = 1.0 / CellSize(depth);
+			const unsigned int res = 1u << depth;
+			unsigned int c[3];
+			double t[3];
+			for (int a = 0; a < 3; ++a) {
+				const double x = p[a] * inv;
+				c[a] = static_cast<unsigned int>(std::min(std::max(x, 0.0), double(res - 1)));
+				t[a] = std::min(std::max(x - c[a], 0.0), 1.0);
+			}
+			double value = 0;
+			for (int k = 0; k < 8; ++k) {
+				const double w = ((k & 1) ? t[0] : 1 - t[0]) * ((k & 2) ? t[1] : 1 - t[1]) * ((k & 4) ? t[2] : 1 - t[2]);
+				const unsigned int q[3] = { c[0] + (k & 1), c[1] + ((k >> 1) & 1), c[2] + ((k >> 2) & 1) };
+				value += w * VertexValue(levels, depth, q);
+			}
+			return value;
+		}
+
+		/// @brief 8 corners of the cell whose lower corner is v, false when one is missing
+		static bool CellCorners(const Level &level, unsigned int v, unsigned int corners[8]) {
+			corners[0] = v;
+			for (int c = 1; c < 8; ++c) {
+				// step from the corner without the highest bit of c
+				const int axis = c >= 4 ? 2 : (c >= 2 ? 1 : 0);
+				const unsigned int from = corners[c & ~(1 << axis)];
+				corners[c] = from == InvalidIndex ? InvalidIndex : level.neighbors[6 * from + 2 * axis + 1];
+				if (corners[c] == InvalidIndex)
+					return false;
+			}
+			return true;
+		}
+
+		/// @brief marching cubes over the cells of the finest band, then over the
+		/// cells outside it the surface goes through
+		void Extract(const std::vector<Level > &levels, std::vector<T > &vertices, std::vector<unsigned int > &triangles) const {
+			const Level &level = levels.back();
+			const size_t n = level.keys.size();
+			const unsigned int res = 1u << level.depth;
+			const unsigned int nthreads = ParallelThreadCount();
+			const std::vector<float > &values = level.values;
+
+			// iso value, area weighted mean at the points
+			std::vector<double > sum(nthreads, 0.0), area(nthreads, 0.0);
+			ParallelForRange(0, m_samples.size(), [&](size_t b, size_t e, unsigned int tid) {
+				double s = 0, a = 0;
+				for (size_t i = b; i < e; ++i) {
+					s += m_samples[i].area * Evaluate(levels, m_samples[i].p);
+					a += m_samples[i].area;
+				}
+				sum[tid] += s;
+				area[tid] += a;
+			}, 1 << 12);
+			double s = 0, a = 0;
+			for (unsigned int t = 0; t < nthreads; ++t) {
+				s += sum[t];
+				a += area[t];
+			}
+			const float iso = static_cast<float>(a > 0 ? s / a : 0.0);
+
+			// cells with all corners in the band, named by their lower corner
+			std::vector<unsigned char > complete(n);
+			ParallelFor(0, n, [&](size_t v) {
+				unsigned int corners[8];
+				complete[v] = CellCorners(level, static_cast<unsigned int>(v), corners) ? 1 : 0;
+			}, 1 << 12);
+
+			// one mesh vertex per crossing edge of a complete cell, the edge is
+			// owned by its lower vertex so the ids come from a prefix sum
+			const size_t grain = 1 << 14;
+			const size_t blocks = (n + grain - 1) / grain;
+			std::vector<unsigned int > edgeIds(3 * n, InvalidIndex);
+			std::vector<size_t > offsets(blocks + 1, 0);
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int) {
+				size_t count = 0;
+				for (size_t v = b; v < e; ++v) {
+					const unsigned int *nb = &level.neighbors[6 * v];
+					for (int axis = 0; axis < 3; ++axis) {
+						const unsigned int u = nb[2 * axis + 1];
+						if (u == InvalidIndex || (values[v] > iso) == (values[u] > iso))
+							continue;
+						// the 4 cells around the edge
+						const int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+						const unsigned int c1 = nb[2 * a1], c2 = nb[2 * a2];
+						const unsigned int c3 = c1 == InvalidIndex ? InvalidIndex : level.neighbors[6 * c1 + 2 * a2];
+						if (complete[v] || (c1 != InvalidIndex && complete[c1]) || (c2 != InvalidIndex && complete[c2]) || (c3 != InvalidIndex && complete[c3])) {
+							edgeIds[3 * v + axis] = 0;
+							++count;
+						}
+					}
+				}
+				offsets[b / grain + 1] = count;
+			}, grain);
+			for (size_t k = 0; k < blocks; ++k)
+				offsets[k + 1] += offsets[k];
+
+			const double h = CellSize(level.depth);
+			vertices.resize(3 * offsets[blocks]);
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int) {
+				size_t id = offsets[b / grain];
+				for (size_t v = b; v < e; ++v) {
+					unsigned int p[3];
+					Decode(level.keys[v], p[0], p[1], p[2]);
+					for (int axis = 0; axis < 3; ++axis) {
+						if (edgeIds[3 * v + axis] == InvalidIndex)
+							continue;
+						const unsigned int u = level.neighbors[6 * v + 2 * axis + 1];
+						const double t = double(iso - values[v]) / double(values[u] - values[v]);
+						for (int c = 0; c < 3; ++c)
+							vertices[3 * id + c] = static_cast<T>(m_origin[c] + (p[c] + (c == axis ? t : 0.0)) * h);
+						edgeIds[3 * v + axis] = static_cast<unsigned int>(id++);
+					}
+				}
+			}, grain);
+
+			// triangles, counted then written per block. the crossing faces of
+			// the complete cells towards the other cells start the outside part
+			const DMarchingCubesTable &table = DMarchingCubesTable::Get();
+			auto cubeIndex = [&](const unsigned int corners[8]) {
+				unsigned int index = 0;
+				for (int c = 0; c < 8; ++c)
+					if (values[corners[c]] > iso)
+						index |= 1u << c;
+				return index;
+			};
+			std::vector< std::vector<uint64_t > > seeds(nthreads);
+			std::fill(offsets.begin(), offsets.end(), 0);
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int tid) {
+				size_t count = 0;
+				unsigned int corners[8];
+				for (size_t v = b; v < e; ++v) {
+					if (!complete[v] || !CellCorners(level, static_cast<unsigned int>(v), corners))
+						continue;
+					const unsigned int index = cubeIndex(corners);
+					count += table.GetTriangleCount(index);
+					if (index == 0 || index == 255)
+						continue;
+					for (int face = 0; face < 6; ++face) {
+						const int axis = face >> 1, side = face & 1;
+						const unsigned int other = side ? corners[1 << axis] : level.neighbors[6 * v + 2 * axis];
+						if ((other != InvalidIndex && complete[other]) || !FaceCrosses(index, axis, side))
+							continue;
+						unsigned int p[3];
+						Decode(level.keys[v], p[0], p[1], p[2]);
+						if (side ? p[axis] + 1 >= res : p[axis] == 0)
+							continue;
+						p[axis] += side ? 1 : -1;
+						seeds[tid].push_back(Encode(p[0], p[1], p[2]));
+					}
+				}
+				offsets[b / grain + 1] = count;
+			}, grain);
+			for (size_t k = 0; k < blocks; ++k)
+				offsets[k + 1] += offsets[k];
+
+			triangles.resize(3 * offsets[blocks]);
+			ParallelForRange(0, n, [&](size_t b, size_t e, unsigned int) {
+				unsigned int *out = triangles.data() + 3 * offsets[b / grain];
+				unsigned int corners[8];
+				for (size_t v = b; v < e; ++v) {
+					if (!complete[v] || !CellCorners(level, static_cast<unsigned int>(v), corners))
+						continue;
+					const unsigned int index = cubeIndex(corners);
+					const signed char *edges = table.GetTriangles(index);
+					for (int k = 0; k < 3 * table.GetTriangleCount(index); ++k) {
+						const int edge = edges[k];
+						*out++ = edgeIds[3 * corners[DMarchingCubesTable::EdgeCorner(edge)] + DMarchingCubesTable::EdgeAxis(edge)];
+					}
+				}
+			}, grain);
+
+			ExtractOutside(levels, iso, complete, edgeIds, seeds, vertices, triangles);
+		}
+
+		/// @brief whether the surface of a case crosses a face of the cube
+		static bool FaceCrosses(unsigned int index, int axis, int side) {
+			unsigned int inside = 0;
+			for (int c = 0; c < 8; ++c) {
+				if (((c >> axis) & 1) == side)
+					inside += (index >> c) & 1;
+			}
+			return inside != 0 && inside != 4;
+		}
+
+		/// @brief follow the surface through the finest cells outside the band,
+		/// from the cells of the seeds. their corners outside the band take the
+		/// values of the coarser levels and the band corners keep theirs, so the
+		/// cells on both sides of a face cut it the same way
+		void ExtractOutside(const std::vector<Level > &levels, float iso, const std::vector<unsigned char > &complete,
+			const std::vector<unsigned int > &edgeIds, const std::vector< std::vector<uint64_t > > &seeds,
+			std::vector<T > &vertices, std::vector<unsigned int > &triangles) const {
+			const Level &level = levels.back();
+			const unsigned int depth = level.depth, res = 1u << depth;
+			const double h = CellSize(depth);
+
+			std::unordered_map<uint64_t, float > known;
+			auto value = [&](const unsigned int q[3]) {
+				const uint64_t key = Encode(q[0], q[1], q[2]);
+				auto it = known.find(key);
+				if (it != known.end())
+					return it->second;
+				const float f = VertexValue(levels, depth, q);
+				known.emplace(key, f);
+				return f;
+			};
+			// the vertex of an edge, the band keeps the ids of its crossing edges
+			struct EdgeSlot {
+				unsigned int id[3];
+				EdgeSlot() { id[0] = id[1] = id[2] = InvalidIndex; }
+			};
+			std::unordered_map<uint64_t, EdgeSlot > edges;
+			auto edgeVertex = [&](const unsigned int q[3], int axis) {
+				const uint64_t key = Encode(q[0], q[1], q[2]);
+				const unsigned int v = Find(level.keys, key);
+				if (v != InvalidIndex && edgeIds[3 * v + axis] != InvalidIndex)
+					return edgeIds[3 * v + axis];
+				unsigned int &id = edges[key].id[axis];
+				if (id == InvalidIndex) {
+					unsigned int r[3] = { q[0], q[1], q[2] };
+					++r[axis];
+					const float f0 = value(q), f1 = value(r);
+					const double t = double(iso - f0) / double(f1 - f0);
+					id = static_cast<unsigned int>(vertices.size() / 3);
+					for (int c = 0; c < 3; ++c)
+						vertices.push_back(static_cast<T>(m_origin[c] + (q[c] + (c == axis ? t : 0.0)) * h));
+				}
+				return id;
+			};
+
+			std::unordered_set<uint64_t > visited;
+			std::vector<uint64_t > stack;
+			for (auto &part : seeds) {
+				for (uint64_t key : part) {
+					if (visited.insert(key).second)
+						stack.push_back(key);
+				}
+			}
+			const DMarchingCubesTable &table = DMarchingCubesTable::Get();
+			while (!stack.empty()) {
+				unsigned int p[3];
+				Decode(stack.back(), p[0], p[1], p[2]);
+				stack.pop_back();
+				unsigned int index = 0;
+				for (int c = 0; c < 8; ++c) {
+					const unsigned int q[3] = { p[0] + (c & 1), p[1] + ((c >> 1) & 1), p[2] + ((c >> 2) & 1) };
+					if (value(q) > iso)
+						index |= 1u << c;
+				}
+				const signed char *cut = table.GetTriangles(index);
+				for (int k = 0; k < 3 * table.GetTriangleCount(index); ++k) {
+					const int corner = DMarchingCubesTable::EdgeCorner(cut[k]);
+					const unsigned int q[3] = { p[0] + (corner & 1), p[1] + ((corner >> 1) & 1), p[2] + ((corner >> 2) & 1) };
+					triangles.push_back(edgeVertex(q, DMarchingCubesTable::EdgeAxis(cut[k])));
+				}
+				for (int face = 0; face < 6; ++face) {
+					const int axis = face >> 1, side = face & 1;
+					if (!FaceCrosses(index, axis, side) || (side ? p[axis] + 1 >= res : p[axis] == 0))
+						continue;
+					unsigned int q[3] = { p[0], p[1], p[2] };
+					q[axis] += side ? 1 : -1;
+					const uint64_t key = Encode(q[0], q[1], q[2]);
+					const unsigned int v = Find(level.keys, key);
+					if ((v == InvalidIndex || !complete[v]) && visited.insert(key).second)
+						stack.push_back(key);
+				}
+			}
+		}
+
+	protected:
+		const T *m_xyz;
+		const T *m_normals;
+		size_t m_count;
+
+		Parameters m_params;
+		double m_origin[3];
+		double m_size;
+		std::vector<uint64_t > m_sampleKeys;
+		std::vector<Sample > m_samples;
+	};
+
+	template<class T>
+	const unsigned int DPoissonReconstruction<T>::MaxDepth;
+	template<class T>
+	const unsigned int DPoissonReconstruction<T>::InvalidIndex;
+};
+#endif
@@ -7,6 +7,8 @@
 
 #include "DamonsObject.h"
 #include "DamonsVector.h"
+#include "DamonsPredicates.h"
+#include "DamonsSegmentIntersector.h"
 #include <vector>
 
 using namespace DMath;
@@ -89,6 +91,11 @@ namespace DGraphic {
 		unsigned int GetPolygonPointSize() const{
 			return IsClosed()? m_polygonPoints.size() - 1:m_polygonPoints.size();
 		}
+		/// @brief get a point of polygon
+		/// @return const DVector<T, 2>& : the point
+		const DVector<T, 2> &GetPolygonPoint(unsigned int i) const {
+			return m_polygonPoints[i];
+		}
 		/// @brief close polygon 
 		/// @return void
 		void ClosePolygon() {
@@ -101,16 +108,27 @@ namespace DGraphic {
 		/// @brief tell whether polygon is simple
 		/// @note a polygon is simple when there are two edges intersected
 		/// which means the intersected point is not end point.
+		/// the edges are swept once, stopping at the first crossing, O(n log n)
 		/// @return  true if simple otherwise false 
 		bool IsSimple() { 
 			ClosePolygon();
 			unsigned int sz = GetPolygonPointSize();
-			for(unsigned int i = 0;i < sz - 1;++i){
-                for(unsigned int j = i+1;j < sz ;++j){	if(IsSegmentIntersect(m_polygonPoints[i],m_polygonPoints[i+1],m_polygonPoints[j],m_polygonPoints[j+1]) > 1)
-					return false;
-                }
-			}
-			return true;
+			DSegmentIntersector<T> sweep;
+			for (unsigned int i = 0; i < sz; ++i)
+				sweep.AddSegment(m_polygonPoints[i], m_polygonPoints[i + 1]);
+			return !sweep.HasCrossing();
+		}
+		/// @brief all the intersections between the edges of polygon
+		/// @note edge i goes from point i to point i+1, the edges only meeting
+		/// at a common point, as consecutive ones, are not reported. O((n+k) log n)
+		/// @return  size_t number of intersecting edge pairs
+		size_t GetSelfIntersections(std::vector<typename DSegmentIntersector<T>::Intersection > &result) {
+			ClosePolygon();
+			unsigned int sz = GetPolygonPointSize();
+			DSegmentIntersector<T> sweep;
+			for (unsigned int i = 0; i < sz; ++i)
+				sweep.AddSegment(m_polygonPoints[i], m_polygonPoints[i + 1]);
+			return sweep.FindIntersections(result);
 		}
 		/// @brief tell whether polygon is convex
         /// @note perform this function makes polygon counterclockwise
@@ -125,11 +143,7 @@ namespace DGraphic {
 				auto &p1 = m_polygonPoints[i ];
 				auto &p2 = ((i + 1) == m_polygonPoints.size()) ? m_polygonPoints[0] : m_polygonPoints[i + 1];
 
-				const T Ax = p1[0] - p0[0];
-				const T Ay = p1[1] - p0[1];
-				const T Bx = p2[0] - p1[0];
-				const T By = p2[1] - p1[1];
-				if (Ax*By - Bx * Ay < 0)
+				if (Orient(p0, p1, p2) < 0)
 					return false;
 			}
  			return true;
@@ -165,49 +179,27 @@ namespace DGraphic {
 		int IsPointInPolygon(const DVector<T,2> &p) {
 			ClosePolygon();
 			unsigned int sz = GetPolygonPointSize();
-			int num_intersect = 0;
-			T x = p[0];
-			T y = p[1];
+			bool inside = false;
 
 			for (unsigned int i = 0; i < sz; ++i) {
 				auto &p0 = m_polygonPoints[i];
 				auto &p1 = m_polygonPoints[i + 1];
 
-				if ((p0 - p).LengthSquared() < DEplision*DEplision)
+				const double o = Orient(p0, p1, p);
+				//点在线段上
+				if (o == 0 && std::min(p0[0], p1[0]) <= p[0] && p[0] <= std::max(p0[0], p1[0])
+					&& std::min(p0[1], p1[1]) <= p[1] && p[1] <= std::max(p0[1], p1[1]))
 					return 1;
 
-				if (std::abs(p0[1] - y) < DEplision && std::abs(p1[1] - y) < DEplision) //点在线段的方向上
-				{
-					if (std::abs(p0[0] - x) < 0.00001)
-						return 1;
-					if (std::abs(p1[0] - x) < 0.00001)
-						return 1;
-					if ((p0[0] - x)*(p1[0] - x) < 0)
-						return 1;
-
-					continue;
+				//线段跨过射线所在直线, 下端点算在线段上, 上端点不算
+				if ((p0[1] > p[1]) != (p1[1] > p[1])) {
+					//向上的线段要求点在其左侧, 向下的在其右侧, 即交点在射线起点右侧
+					if (p1[1] > p0[1] ? o > 0 : o < 0)
+						inside = !inside;
 				}
-
-				if (std::min(p0[1], p1[1]) - y > -DEplision) //去掉误差 判断线段在射线之上或者在射线上方
-					continue;
-
-				if (std::abs(std::max(p0[1], p1[1]) - y) < DEplision)//线段最高点在射线上					
-				{
-					num_intersect++;
-					continue;
-				}
-
-				if (std::max(p0[1], p1[1]) < y)//线段在射线下
-					continue;
-
-				double xseg = p1[0] - (p1[0] - p0[0]) * (p1[1] - y) / (p1[1] - p0[1]); //求交
-				if (xseg < x)  //交点在射线起点的左侧
-					continue;
-
-				num_intersect++;
 			}
 
-			return num_intersect % 2 ? 2 : 0;
+			return inside ? 2 : 0;
 		}
 	public:
 		/// @brief reverse polygon
@@ -233,75 +225,42 @@ namespace DGraphic {
 		///			 2 overlap
 		///			 3 intersect at a point which is not endpoint
 		int IsSegmentIntersect(DVector<T, 2> &V0,DVector<T, 2> &V1,DVector<T, 2> &U0,DVector<T, 2> &U1) {
-				 							
-				const T Ax = V1[0] - V0[0];
-				const T Ay = V1[1] - V0[1];
-				const T Bx = U0[0] - U1[0];
-				const T By = U0[1] - U1[1];
-				const T Cx = V0[0] - U0[0];
-				const T Cy = V0[1] - U0[1];
-				const T f = Ay * Bx - Ax * By;
-				const T d = By * Cx - Bx * Cy;
-				const T e = Ax * Cy - Ay * Cx;
-
-				// the two lines are collinear.
-				if (std::abs(f) < DEplision && std::abs(e) < DEplision) {
-					//intersect at endpoint
-					if ((V0 - U0).LengthSquared() < DEplision*DEplision || (V0 - U1).LengthSquared() < DEplision*DEplision)
-						return 1;
-					else if ((V1 - U0).LengthSquared() < DEplision*DEplision || (V1 - U1).LengthSquared() < DEplision*DEplision)
-						return 1;
+			// orientations of each end against the other segment, with exact signs
+			const double o1 = Orient(V0, V1, U0);
+			const double o2 = Orient(V0, V1, U1);
+			const double o3 = Orient(U0, U1, V0);
+			const double o4 = Orient(U0, U1, V1);
 
-					double  l = Ax * Ax + Ay * Ay;
-					double t0 = -(Cx*Ax + Cy*Ay);
-					const T sx = U1[0] - V0[0];
-					const T sy = U1[1] - V0[1];
-					double t1 = (sx * Ax + Ay * sy) / l;
-					//overlap
-					if (std::min(t0, t1) < (1+DEplision) && std::min(t0, t1) > -DEplision)
-						return 2;
-					//disjoint
-					return 0;
-				}
-				//then the two lines are parallel and non-intersecting.
-				else if (std::abs(f) < DEplision && std::abs(e) > DEplision)
-					return 0;
-				//If 0 ≤ t ≤ 1 and 0 ≤ u ≤ 1, the two line segments meet at the point p + t r = q + u s
-				else if (std::abs(f) > DEplision) {
-                    T u = d/f;
-                    T v = e/f;
-                    
-                    if( std::abs(u) < DEplision || std::abs(v) < DEplision ||std::abs(u-1.0) < DEplision||std::abs(v-1.0) < DEplision)
-                        return 1;
-                    else if (u < 1.0+DEplision && u > 0.0-DEplision && v>0.0-DEplision && v<1.0+DEplision)
-                        return 3;
-                    else
-                        return 0;
-					/*// 0 < t < 1 and 0 < u < 1
-                    if ((f > 0.0 && d > 0.0 && d < f) || (f < 0.0 && d < 0.0 && d > f)){
-                        if(( e > 0.0 && e < f) ||(e < 0.0 && e>f))
-                            return 3;
-                        return 0;
-                    }
-					// t==0 && (u ==0||u==1)
-					else if (std::abs(d) < DEplision && (std::abs(e) < DEplision || std::abs(e - f) < DEplision))
-						return 1;
-					// t==1 && (u ==0||u==1)
-					else if (std::abs(d - f) < DEplision && (std::abs(e) < DEplision || std::abs(e - f) < DEplision))
-						return 1;
-					// u==0 && (t ==0||t==1)
-					else if (std::abs(e) < DEplision && (std::abs(d) < DEplision || std::abs(d - f) < DEplision))
-						return 1;
-					// u==1 && (t ==0||t==1)
-					else if (std::abs(e - f) < DEplision && (std::abs(d) < DEplision || std::abs(d - f) < DEplision))
-						return 1;
-					//end point intersect with another point which is not end point
-					else
-						return 3;*/
-				}
-				else//Otherwise, the two line segments are not parallel but do not intersect
+			// the two segments are collinear, compare them along the line
+			if (o1 == 0 && o2 == 0 && o3 == 0 && o4 == 0) {
+				const int axis = (V0[0] != V1[0] || V0[0] != U0[0] || V0[0] != U1[0]) ? 0 : 1;
+				const T vmin = std::min(V0[axis], V1[axis]), vmax = std::max(V0[axis], V1[axis]);
+				const T umin = std::min(U0[axis], U1[axis]), umax = std::max(U0[axis], U1[axis]);
+				//disjoint
+				if (vmax < umin || umax < vmin)
 					return 0;
+				//intersect at endpoint
+				if (vmax == umin || umax == vmin)
+					return 1;
+				//overlap
+				return 2;
+			}
+			//both ends of a segment on the same side of the other one
+			if ((o1 > 0 && o2 > 0) || (o1 < 0 && o2 < 0) || (o3 > 0 && o4 > 0) || (o3 < 0 && o4 < 0))
 				return 0;
+			//an end lies on the other segment
+			if (o1 == 0 || o2 == 0 || o3 == 0 || o4 == 0)
+				return 1;
+			return 3;
+		}
+
+		/// @brief orientation of abc
+		/// @return  positive if counter clockwise, negative if clockwise, 0 if collinear, the sign is exact
+		static double Orient(const DVector<T, 2> &a, const DVector<T, 2> &b, const DVector<T, 2> &c) {
+			const double pa[2] = { double(a[0]), double(a[1]) };
+			const double pb[2] = { double(b[0]), double(b[1]) };
+			const double pc[2] = { double(c[0]), double(c[1]) };
+			return DMath::Orient2D(pa, pb, pc);
 		}
 	protected:
 		typedef DVector<T, 2> PolygonPoint;
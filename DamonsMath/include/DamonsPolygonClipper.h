@@ -0,0 +1,603 @@
+#ifndef _DAMONS_POLYGON_CLIPPER_H_
+#define _DAMONS_POLYGON_CLIPPER_H_
+
+#include "DamonsVector.h"
+#include "DamonsPolygon.h"
+#include "DamonsPredicates.h"
+#include "DamonsSegmentIntersector.h"
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <limits>
+
+namespace DGraphic {
+
+	/// class DPolygonClipper
+	/// @breif boolean operations of polygons: intersection, union, difference, xor
+	///
+	/// the polygons are subjects or clips, they may have holes, overlap each
+	/// other or themselves. the inside of each set is told from the winding
+	/// numbers by a fill rule, as for Vatti's clipper:
+	///
+	/// - the points are snapped to an integer grid. the sweep of
+	///   DSegmentIntersector finds where the edges meet, and the pixels of the
+	///   ends and of the crossings are hot. each edge is routed through the
+	///   centers of the hot pixels it passes (snap rounding), then the edges
+	///   only meet at their end points, or are the same.
+	/// - a sweep line goes over the routed edges: an entering edge takes the
+	///   winding numbers of the edge below it in the sweep, plus its own.
+	/// - an edge is kept when the result is filled on one side only, turned
+	///   to have the result on its left, and the kept edges are linked in rings.
+	///
+	/// the signs are the exact ones of Orient2D on the grid points. the result
+	/// rings are simple, the outlines turn counter clockwise and the holes
+	/// clockwise, so they can be given as they are to the even odd rules
+	/// (DConstrainedDelaunay::AddPolygon...).
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DPolygonClipper
+	{
+	public:
+		typedef DVector<double, 2> ClipPoint;
+
+		enum ClipType { ClipIntersection, ClipUnion, ClipDifference, ClipXor };
+		enum PolyType { PolySubject, PolyClip };
+		/// inside of a set of polygons from the winding number of a point
+		enum FillRule { FillEvenOdd, FillNonZero, FillPositive, FillNegative };
+
+		DPolygonClipper() {}
+		~DPolygonClipper() {
+		}
+
+	public:
+		/// @brief add a polygon to the subjects or the clips
+		void AddPolygon(const DPolygon<T> &polygon, PolyType type) {
+			const unsigned int sz = polygon.GetPolygonPointSize();
+			if (sz < 3)
+				return;
+			for (unsigned int i = 0; i < sz; ++i) {
+				const DVector<T, 2> &p = polygon.GetPolygonPoint(i), &q = polygon.GetPolygonPoint((i + 1) % sz);
+				AddEdge(ClipPoint(double(p[0]), double(p[1])), ClipPoint(double(q[0]), double(q[1])), type);
+			}
+		}
+		void AddPolygons(const std::vector<DPolygon<T> > &polygons, PolyType type) {
+			for (auto &polygon : polygons)
+				AddPolygon(polygon, type);
+		}
+		/// @brief add a ring given by its points
+		void AddRing(const std::vector<ClipPoint > &ring, PolyType type) {
+			const size_t sz = ring.size();
+			if (sz < 3)
+				return;
+			for (size_t i = 0; i < sz; ++i)
+				AddEdge(ring[i], ring[(i + 1) % sz], type);
+		}
+		/// @brief remove all the polygons
+		void Clear() { m_edges.clear(); }
+
+		/// @brief step of the grid the points are snapped to, 0 for 2^-40 of the largest coordinate
+		void SetPrecision(double precision) { m_precision = precision; }
+		double GetPrecision() const { return m_precision; }
+
+		/// @brief run a boolean operation
+		///
+		/// @param op the operation, the difference is the subjects minus the clips
+		/// @param result as return, outlines counter clockwise and holes clockwise
+		/// @param fill fill rule of both the subjects and the clips
+		/// @return size_t number of rings
+		size_t Execute(ClipType op, std::vector<DPolygon<T> > &result, FillRule fill = FillEvenOdd) {
+			std::vector<std::vector<ClipPoint > > rings;
+			Execute(op, rings, fill);
+			result.clear();
+			for (auto &ring : rings) {
+				DPolygon<T> polygon;
+				for (auto &p : ring)
+					polygon.AddPoint(static_cast<T >(p[0]), static_cast<T >(p[1]));
+				result.push_back(polygon);
+			}
+			return result.size();
+		}
+		/// @brief run a boolean operation, the rings as lists of points
+		///
+		/// a DPolygon takes a last point closer than DEplision to the first one
+		/// for the closing point, these rings keep it.
+		size_t Execute(ClipType op, std::vector<std::vector<ClipPoint > > &result, FillRule fill = FillEvenOdd) {
+			result.clear();
+			m_op = op;
+			m_fill = fill;
+
+			// the edges on the grid, in the sweep order
+			const double unit = Unit();
+			std::vector<Edge > edges;
+			edges.reserve(m_edges.size());
+			for (auto &input : m_edges) {
+				Edge e = input;
+				e.a = ClipPoint(std::round(input.a[0] / unit), std::round(input.a[1] / unit));
+				e.b = ClipPoint(std::round(input.b[0] / unit), std::round(input.b[1] / unit));
+				if (e.a == e.b)
+					continue;
+				if (Before(e.b, e.a))
+					Turn(e);
+				edges.push_back(e);
+			}
+			SnapRound(edges);
+			Merge(edges);
+			Windings(edges);
+
+			Link(edges, result);
+			for (auto &ring : result) {
+				for (auto &p : ring)
+					p = ClipPoint(p[0] * unit, p[1] * unit);
+			}
+			return result.size();
+		}
+
+	protected:
+		/// an edge, a comes before b in the sweep once snapped. ds and dc are the
+		/// windings it adds to the subjects and the clips from below to above it
+		struct Edge {
+			ClipPoint a;
+			ClipPoint b;
+			int ds;
+			int dc;
+			/// the windings below it
+			int ws;
+			int wc;
+		};
+
+		void AddEdge(const ClipPoint &p, const ClipPoint &q, PolyType type) {
+			if (p == q)
+				return;
+			Edge e;
+			e.a = p;
+			e.b = q;
+			e.ds = type == PolySubject ? 1 : 0;
+			e.dc = type == PolyClip ? 1 : 0;
+			e.ws = e.wc = 0;
+			m_edges.push_back(e);
+		}
+
+		static void Turn(Edge &e) {
+			std::swap(e.a, e.b);
+			e.ds = -e.ds;
+			e.dc = -e.dc;
+		}
+
+		/// @brief the grid step, a power of two unless it is given
+		double Unit() const {
+			if (m_precision > 0)
+				return m_precision;
+			double largest = 0;
+			for (auto &e : m_edges) {
+				largest = std::max(largest, std::max(std::fabs(e.a[0]), std::fabs(e.a[1])));
+				largest = std::max(largest, std::max(std::fabs(e.b[0]), std::fabs(e.b[1])));
+			}
+			if (largest == 0)
+				return 1;
+			return std::ldexp(1.0, std::ilogb(largest) + 1 - GridBits);
+		}
+
+		/// @brief route the edges through the hot pixels they pass, after
+		/// that they only meet at their end points or are the same
+		void SnapRound(std::vector<Edge > &edges) const {
+			typedef DSegmentIntersector<double > Sweep;
+			std::vector<typename Sweep::Intersection > hits;
+			Sweep sweep;
+			for (auto &e : edges)
+				sweep.AddSegment(e.a, e.b);
+			if (sweep.FindIntersections(hits) == 0)
+				return;
+
+			// the ends and the crossings, the other meetings are at the ends
+			std::vector<ClipPoint > hot;
+			hot.reserve(2 * edges.size() + hits.size());
+			for (auto &e : edges) {
+				hot.push_back(e.a);
+				hot.push_back(e.b);
+			}
+			for (auto &h : hits) {
+				if (h.type == Sweep::IntersectCross)
+					hot.push_back(CrossPixel(edges[h.first], edges[h.second], h.point));
+			}
+			std::sort(hot.begin(), hot.end(), Before);
+			hot.erase(std::unique(hot.begin(), hot.end()), hot.end());
+
+			// the pixels near each edge, from a grid of buckets of the hot pixels
+			const size_t count = edges.size();
+			std::vector<std::pair<size_t, ClipPoint > > passes;
+			passes.reserve(2 * hits.size());
+			HotGrid grid(hot);
+			for (size_t i = 0; i < count; ++i) {
+				const Edge &e = edges[i];
+				grid.Visit(e.a, e.b, [&](const ClipPoint &p) {
+					if (p != e.a && p != e.b && Passes(e, p))
+						passes.push_back(std::make_pair(i, p));
+				});
+			}
+			// along each edge, the pixels go forward on its longer axis
+			std::sort(passes.begin(), passes.end(), [&edges](const std::pair<size_t, ClipPoint > &u, const std::pair<size_t, ClipPoint > &v) {
+				if (u.first != v.first)
+					return u.first < v.first;
+				const Edge &e = edges[u.first];
+				const double dx = e.b[0] - e.a[0], dy = e.b[1] - e.a[1];
+				const int major = std::fabs(dx) >= std::fabs(dy) ? 0 : 1;
+				const double forward[2] = { dx < 0 ? -1.0 : 1.0, dy < 0 ? -1.0 : 1.0 };
+				const double du = (v.second[major] - u.second[major]) * forward[major];
+				if (du != 0)
+					return du > 0;
+				return (v.second[1 - major] - u.second[1 - major]) * forward[1 - major] > 0;
+			});
+
+			std::vector<Edge > routed;
+			routed.reserve(count + passes.size());
+			size_t k = 0;
+			for (size_t i = 0; i < count; ++i) {
+				ClipPoint from = edges[i].a;
+				for (; k < passes.size() && passes[k].first == i; ++k) {
+					const ClipPoint &to = passes[k].second;
+					if (to == from)
+						continue;
+					Emit(edges[i], from, to, routed);
+					from = to;
+				}
+				Emit(edges[i], from, edges[i].b, routed);
+			}
+			edges.swap(routed);
+		}
+
+		/// @brief the pixel of the crossing of e and f, both edges pass it
+		static ClipPoint CrossPixel(const Edge &e, const Edge &f, const ClipPoint &point) {
+			const ClipPoint center(std::round(point[0]), std::round(point[1]));
+			if (Passes(e, center) && Passes(f, center))
+				return center;
+			// the rounded point is near a side of the pixel, the crossing is next to it
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					const ClipPoint p(center[0] + dx, center[1] + dy);
+					if (Passes(e, p) && Passes(f, p))
+						return p;
+				}
+			}
+			return center;
+		}
+
+		/// @brief true when the edge meets the pixel of p, the unit square around it
+		static bool Passes(const Edge &e, const ClipPoint &p) {
+			if (std::max(e.a[0], e.b[0]) < p[0] - 0.5 || std::min(e.a[0], e.b[0]) > p[0] + 0.5)
+				return false;
+			if (std::max(e.a[1], e.b[1]) < p[1] - 0.5 || std::min(e.a[1], e.b[1]) > p[1] + 0.5)
+				return false;
+			// the line of the edge leaves all the corners on one side
+			int above = 0, below = 0;
+			for (int c = 0; c < 4; ++c) {
+				const ClipPoint corner(p[0] + (c & 1 ? 0.5 : -0.5), p[1] + (c & 2 ? 0.5 : -0.5));
+				const double o = Orient(e.a, e.b, corner);
+				above += o > 0;
+				below += o < 0;
+			}
+			return above < 4 && below < 4;
+		}
+
+		/// a grid of buckets of the hot pixels, about one per bucket
+		class HotGrid {
+		public:
+			HotGrid(const std::vector<ClipPoint > &hot) : m_hot(hot) {
+				m_lo[0] = m_lo[1] = std::numeric_limits<double>::max();
+				double hi[2] = { -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max() };
+				for (auto &p : hot) {
+					for (int d = 0; d < 2; ++d) {
+						m_lo[d] = std::min(m_lo[d], p[d]);
+						hi[d] = std::max(hi[d], p[d]);
+					}
+				}
+				m_size = static_cast<int >(std::min(4096.0, std::max(1.0, std::ceil(std::sqrt(double(hot.size()))))));
+				for (int d = 0; d < 2; ++d)
+					m_step[d] = std::max(1.0, (hi[d] - m_lo[d]) / m_size);
+
+				// the pixels bucket by bucket
+				m_first.assign(size_t(m_size) * m_size + 1, 0);
+				for (auto &p : hot)
+					++m_first[Bucket(p) + 1];
+				for (size_t b = 1; b < m_first.size(); ++b)
+					m_first[b] += m_first[b - 1];
+				m_pixels.resize(hot.size());
+				std::vector<unsigned int > fill(m_first.begin(), m_first.end() - 1);
+				for (unsigned int i = 0; i < hot.size(); ++i)
+					m_pixels[fill[Bucket(hot[i])]++] = i;
+			}
+
+			/// @brief call f on the hot pixels of the buckets a pixel of the edge a b may meet
+			template<class F>
+			void Visit(const ClipPoint &a, const ClipPoint &b, F f) const {
+				const double x0 = std::min(a[0], b[0]), x1 = std::max(a[0], b[0]);
+				const int c0 = Cell(x0 - 0.5, 0), c1 = Cell(x1 + 0.5, 0);
+				for (int cx = c0; cx <= c1; ++cx) {
+					// the edge over the column, and half a pixel around
+					const double u0 = std::max(x0, m_lo[0] + cx * m_step[0] - 0.5);
+					const double u1 = std::min(x1, m_lo[0] + (cx + 1) * m_step[0] + 0.5);
+					double y0 = std::min(a[1], b[1]), y1 = std::max(a[1], b[1]);
+					if (a[0] != b[0]) {
+						const double v0 = a[1] + (u0 - a[0]) * (b[1] - a[1]) / (b[0] - a[0]);
+						const double v1 = a[1] + (u1 - a[0]) * (b[1] - a[1]) / (b[0] - a[0]);
+						y0 = std::max(y0, std::min(v0, v1));
+						y1 = std::min(y1, std::max(v0, v1));
+					}
+					// one more pixel for the rounding
+					const int r0 = Cell(y0 - 1.5, 1), r1 = Cell(y1 + 1.5, 1);
+					for (int cy = r0; cy <= r1; ++cy) {
+						const size_t bucket = size_t(cy) * m_size + cx;
+						for (unsigned int k = m_first[bucket]; k < m_first[bucket + 1]; ++k)
+							f(m_hot[m_pixels[k]]);
+					}
+				}
+			}
+
+		protected:
+			int Cell(double v, int d) const {
+				const double c = std::floor((v - m_lo[d]) / m_step[d]);
+				return static_cast<int >(std::max(0.0, std::min(double(m_size - 1), c)));
+			}
+			size_t Bucket(const ClipPoint &p) const {
+				return size_t(Cell(p[1], 1)) * m_size + Cell(p[0], 0);
+			}
+
+			const std::vector<ClipPoint > &m_hot;
+			double m_lo[2];
+			double m_step[2];
+			int m_size;
+			std::vector<unsigned int > m_first;
+			std::vector<unsigned int > m_pixels;
+		};
+
+		/// @brief a piece of the edge e from p to q, in the sweep order
+		static void Emit(const Edge &e, const ClipPoint &p, const ClipPoint &q, std::vector<Edge > &pieces) {
+			Edge piece = e;
+			piece.a = p;
+			piece.b = q;
+			if (Before(q, p))
+				Turn(piece);
+			pieces.push_back(piece);
+		}
+
+		/// @brief the same edges are one, with their windings added
+		void Merge(std::vector<Edge > &edges) const {
+			std::sort(edges.begin(), edges.end(), [](const Edge &e, const Edge &f) {
+				return Before(e.a, f.a) || (e.a == f.a && Before(e.b, f.b));
+			});
+			size_t n = 0;
+			for (size_t i = 0; i < edges.size(); ++i) {
+				if (n > 0 && edges[n - 1].a == edges[i].a && edges[n - 1].b == edges[i].b) {
+					edges[n - 1].ds += edges[i].ds;
+					edges[n - 1].dc += edges[i].dc;
+				}
+				else
+					edges[n++] = edges[i];
+			}
+			edges.resize(n);
+			edges.erase(std::remove_if(edges.begin(), edges.end(), [](const Edge &e) {
+				return e.ds == 0 && e.dc == 0;
+			}), edges.end());
+		}
+
+		/// @brief below to above order of two edges cut by the sweep line, they do not cross
+		struct Below {
+			const std::vector<Edge > *edges;
+			bool operator()(size_t i, size_t j) const {
+				if (i == j)
+					return false;
+				const Edge &e = (*edges)[i], &f = (*edges)[j];
+				// the edge entering later is compared to the line of the other one
+				if (e.a == f.a) {
+					const double o = Orient(e.a, e.b, f.b);
+					return o != 0 ? o > 0 : i < j;
+				}
+				if (Before(f.a, e.a)) {
+					double o = Orient(f.a, f.b, e.a);
+					if (o == 0)
+						o = Orient(f.a, f.b, e.b);
+					return o != 0 ? o < 0 : i < j;
+				}
+				double o = Orient(e.a, e.b, f.a);
+				if (o == 0)
+					o = Orient(e.a, e.b, f.b);
+				return o != 0 ? o > 0 : i < j;
+			}
+		};
+
+		/// @brief the windings below every edge, by a sweep line, then keep
+		/// the edges with the result on one side only
+		void Windings(std::vector<Edge > &edges) const {
+			struct Event {
+				ClipPoint p;
+				int kind;
+				size_t e;
+			};
+			std::vector<Event > events;
+			events.reserve(2 * edges.size());
+			for (size_t i = 0; i < edges.size(); ++i) {
+				Event enter = { edges[i].a, 1, i };
+				Event leave = { edges[i].b, 0, i };
+				events.push_back(enter);
+				events.push_back(leave);
+			}
+			// at a point the leaving edges go first
+			std::sort(events.begin(), events.end(), [](const Event &u, const Event &v) {
+				return Before(u.p, v.p) || (u.p == v.p && u.kind < v.kind);
+			});
+
+			Below below = { &edges };
+			std::set<size_t, Below > status(below);
+			std::vector<typename std::set<size_t, Below >::iterator > where(edges.size());
+			std::vector<size_t > entering;
+			for (size_t i = 0; i < events.size(); ) {
+				const Event &ev = events[i];
+				if (ev.kind == 0) {
+					status.erase(where[ev.e]);
+					++i;
+					continue;
+				}
+				// the edges leaving a point all go in, then take their windings from below
+				entering.clear();
+				for (; i < events.size() && events[i].p == ev.p; ++i) {
+					entering.push_back(events[i].e);
+					where[events[i].e] = status.insert(events[i].e).first;
+				}
+				std::sort(entering.begin(), entering.end(), below);
+				for (size_t e : entering) {
+					Edge &edge = edges[e];
+					edge.ws = edge.wc = 0;
+					if (where[e] != status.begin()) {
+						const Edge &under = edges[*std::prev(where[e])];
+						edge.ws = under.ws + under.ds;
+						edge.wc = under.wc + under.dc;
+					}
+				}
+			}
+		}
+
+		bool Filled(int w) const {
+			switch (m_fill) {
+			case FillNonZero: return w != 0;
+			case FillPositive: return w > 0;
+			case FillNegative: return w < 0;
+			default: return (w & 1) != 0;
+			}
+		}
+
+		bool Result(int ws, int wc) const {
+			const bool s = Filled(ws), c = Filled(wc);
+			switch (m_op) {
+			case ClipIntersection: return s && c;
+			case ClipUnion: return s || c;
+			case ClipDifference: return s && !c;
+			default: return s != c;
+			}
+		}
+
+		/// @brief link the kept edges in rings with the result on their left
+		void Link(const std::vector<Edge > &edges, std::vector<std::vector<ClipPoint > > &rings) const {
+			struct Arc {
+				ClipPoint from;
+				ClipPoint to;
+			};
+			std::vector<Arc > arcs;
+			for (auto &e : edges) {
+				const bool under = Result(e.ws, e.wc), over = Result(e.ws + e.ds, e.wc + e.dc);
+				if (under == over)
+					continue;
+				Arc arc = { over ? e.a : e.b, over ? e.b : e.a };
+				arcs.push_back(arc);
+			}
+			std::sort(arcs.begin(), arcs.end(), [](const Arc &u, const Arc &v) {
+				return Before(u.from, v.from) || (u.from == v.from && Before(u.to, v.to));
+			});
+			auto first = [&](const ClipPoint &p) {
+				return std::lower_bound(arcs.begin(), arcs.end(), p, [](const Arc &u, const ClipPoint &q) {
+					return Before(u.from, q);
+				}) - arcs.begin();
+			};
+
+			std::vector<char > used(arcs.size(), 0);
+			std::vector<ClipPoint > ring;
+			for (size_t start = 0; start < arcs.size(); ++start) {
+				if (used[start])
+					continue;
+				ring.clear();
+				size_t a = start;
+				while (true) {
+					used[a] = 1;
+					ring.push_back(arcs[a].from);
+					// the next arc at its end: the first one clockwise from the way
+					// back, so that rings touching at a point stay apart
+					const ClipPoint &v = arcs[a].to;
+					size_t next = arcs.size();
+					double best = 0;
+					const double back = std::atan2(arcs[a].from[1] - v[1], arcs[a].from[0] - v[0]);
+					for (size_t k = first(v); k < arcs.size() && arcs[k].from == v; ++k) {
+						if (used[k])
+							continue;
+						double turn = back - std::atan2(arcs[k].to[1] - v[1], arcs[k].to[0] - v[0]);
+						while (turn <= 0)
+							turn += 2 * M_PI;
+						if (next == arcs.size() || turn < best) {
+							next = k;
+							best = turn;
+						}
+					}
+					if (next == arcs.size())
+						break;
+					a = next;
+				}
+				Simplify(ring);
+				if (ring.size() >= 3)
+					rings.push_back(ring);
+			}
+		}
+
+		/// @brief remove the points in line with their neighbors
+		///
+		/// a point the ring passes twice is kept, else it would touch the middle
+		/// of an edge and cross it once scaled back
+		static void Simplify(std::vector<ClipPoint > &ring) {
+			std::vector<ClipPoint > twice(ring);
+			std::sort(twice.begin(), twice.end(), Before);
+			size_t count = 0;
+			for (size_t i = 1; i < twice.size(); ++i) {
+				if (twice[i] == twice[i - 1] && (count == 0 || !(twice[count - 1] == twice[i])))
+					twice[count++] = twice[i];
+			}
+			twice.resize(count);
+			auto removable = [&twice](const ClipPoint &a, const ClipPoint &b, const ClipPoint &c) {
+				return Orient(a, b, c) == 0 && !std::binary_search(twice.begin(), twice.end(), b, Before);
+			};
+
+			std::vector<ClipPoint > kept;
+			for (auto &p : ring) {
+				while (kept.size() >= 2 && removable(kept[kept.size() - 2], kept.back(), p))
+					kept.pop_back();
+				kept.push_back(p);
+			}
+			// the wrap around the first point
+			bool changed = true;
+			while (changed && kept.size() >= 3) {
+				changed = false;
+				const size_t n = kept.size();
+				if (removable(kept[n - 2], kept[n - 1], kept[0])) {
+					kept.pop_back();
+					changed = true;
+				}
+				else if (removable(kept[n - 1], kept[0], kept[1])) {
+					kept.erase(kept.begin());
+					changed = true;
+				}
+			}
+			ring.swap(kept);
+		}
+
+		/// @brief sweep order, by x then by y
+		static bool Before(const ClipPoint &a, const ClipPoint &b) {
+			return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+		}
+
+		static double Orient(const ClipPoint &a, const ClipPoint &b, const ClipPoint &c) {
+			const double pa[2] = { a[0], a[1] };
+			const double pb[2] = { b[0], b[1] };
+			const double pc[2] = { c[0], c[1] };
+			return DMath::Orient2D(pa, pb, pc);
+		}
+
+	protected:
+		/// bits of the grid below the largest coordinate
+		enum { GridBits = 40 };
+
+		std::vector<Edge > m_edges;
+		double m_precision = 0;
+		ClipType m_op = ClipUnion;
+		FillRule m_fill = FillEvenOdd;
+	};
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef _DAMONS_POLYGON_OFFSET_H_
+#define _DAMONS_POLYGON_OFFSET_H_
+
+#include "DamonsVector.h"
+#include "DamonsPolygon.h"
+#include "DamonsPolygonClipper.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace DGraphic {
+
+	/// class DPolygonOffset
+	/// @breif offsets of polygons by a distance, outward when it is positive
+	///
+	/// each edge is moved along its normal and the corners are joined by a
+	/// miter, an arc or a square cut. the moved rings cross themselves at the
+	/// concave corners and where the polygon is thinner than the distance,
+	/// their union with the positive fill rule of DPolygonClipper keeps what is
+	/// at the distance only. the outlines are counter clockwise and the holes
+	/// clockwise, the polygons given clockwise all together are turned first.
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DPolygonOffset
+	{
+	public:
+		typedef DVector<double, 2> OffsetPoint;
+
+		enum JoinType { JoinSquare, JoinRound, JoinMiter };
+
+		/// @param miterLimit longest miter, in times of the distance, longer ones are squared
+		/// @param arcTolerance largest gap of a round join to its arc, 0 for a part of the distance
+		DPolygonOffset(double miterLimit = 2.0, double arcTolerance = 0)
+			: m_miterLimit(miterLimit), m_arcTolerance(arcTolerance) {}
+		~DPolygonOffset() {
+		}
+
+	public:
+		/// @brief add a polygon, outline or hole
+		void AddPolygon(const DPolygon<T> &polygon, JoinType join = JoinSquare) {
+			Ring ring;
+			ring.join = join;
+			const unsigned int sz = polygon.GetPolygonPointSize();
+			for (unsigned int i = 0; i < sz; ++i) {
+				const DVector<T, 2> &p = polygon.GetPolygonPoint(i);
+				const OffsetPoint q = OffsetPoint(double(p[0]), double(p[1]));
+				// repeated points have no normal
+				if (ring.points.empty() || !(ring.points.back() == q))
+					ring.points.push_back(q);
+			}
+			while (ring.points.size() > 1 && ring.points.back() == ring.points.front())
+				ring.points.pop_back();
+			if (ring.points.size() >= 3)
+				m_rings.push_back(ring);
+		}
+		void AddPolygons(const std::vector<DPolygon<T> > &polygons, JoinType join = JoinSquare) {
+			for (auto &polygon : polygons)
+				AddPolygon(polygon, join);
+		}
+		/// @brief remove all the polygons
+		void Clear() { m_rings.clear(); }
+
+		/// @brief offset the polygons
+		///
+		/// @param delta distance, positive outward and negative inward
+		/// @param result as return, outlines counter clockwise and holes clockwise
+		/// @return size_t number of rings
+		size_t Execute(double delta, std::vector<DPolygon<T> > &result) {
+			result.clear();
+			if (m_rings.empty())
+				return 0;
+			const double turn = Turning();
+
+			DPolygonClipper<T> clipper;
+			std::vector<OffsetPoint > path;
+			for (auto &ring : m_rings) {
+				if (delta == 0) {
+					clipper.AddRing(ring.points, DPolygonClipper<T>::PolySubject);
+					continue;
+				}
+				OffsetRing(ring, turn * delta, path);
+				clipper.AddRing(path, DPolygonClipper<T>::PolySubject);
+			}
+			clipper.Execute(DPolygonClipper<T>::ClipUnion, result,
+				turn > 0 ? DPolygonClipper<T>::FillPositive : DPolygonClipper<T>::FillNegative);
+			return result.size();
+		}
+
+	protected:
+		struct Ring {
+			std::vector<OffsetPoint > points;
+			JoinType join;
+		};
+
+		/// @brief 1 when the ring of the lowest point is counter clockwise, else -1
+		double Turning() const {
+			size_t lowest = 0, at = 0;
+			for (size_t r = 0; r < m_rings.size(); ++r) {
+				const std::vector<OffsetPoint > &points = m_rings[r].points;
+				for (size_t i = 0; i < points.size(); ++i) {
+					const OffsetPoint &p = points[i], &q = m_rings[lowest].points[at];
+					if (p[1] < q[1] || (p[1] == q[1] && p[0] < q[0])) {
+						lowest = r;
+						at = i;
+					}
+				}
+			}
+			const std::vector<OffsetPoint > &points = m_rings[lowest].points;
+			double area = 0;
+			for (size_t i = 0; i < points.size(); ++i) {
+				const OffsetPoint &p = points[i], &q = points[(i + 1) % points.size()];
+				area += p[0] * q[1] - q[0] * p[1];
+			}
+			return area < 0 ? -1 : 1;
+		}
+
+		/// @brief the ring moved by delta to the right of its edges
+		void OffsetRing(const Ring &ring, double delta, std::vector<OffsetPoint > &path) const {
+			const std::vector<OffsetPoint > &points = ring.points;
+			const size_t n = points.size();
+			// unit normals on the right of the edges
+			std::vector<OffsetPoint > normals(n);
+			for (size_t i = 0; i < n; ++i) {
+				const OffsetPoint &p = points[i], &q = points[(i + 1) % n];
+				const double dx = q[0] - p[0], dy = q[1] - p[1];
+				const double len = std::sqrt(dx * dx + dy * dy);
+				normals[i] = OffsetPoint(dy / len, -dx / len);
+			}
+
+			// steps of a round join per radian, for the arc tolerance
+			const double radius = std::fabs(delta);
+			double tolerance = m_arcTolerance > 0 ? std::min(m_arcTolerance, radius) : radius * DefaultArcPart;
+			const double steps = M_PI / std::acos(1 - tolerance / radius);
+			const double stepSin = std::sin(2 * M_PI / steps), stepCos = std::cos(2 * M_PI / steps);
+			const double miter = 2 / (m_miterLimit * m_miterLimit);
+
+			path.clear();
+			for (size_t j = 0; j < n; ++j) {
+				const size_t k = (j + n - 1) % n;
+				const OffsetPoint &v = points[j], &nk = normals[k], &nj = normals[j];
+				const double sinA = nk[0] * nj[1] - nj[0] * nk[1];
+				const double cosA = nk[0] * nj[0] + nk[1] * nj[1];
+				if (std::fabs(sinA * delta) < 1e-12 * radius && cosA > 0) {
+					// in line, one point is enough
+					path.push_back(Move(v, nk, delta));
+					continue;
+				}
+				if (sinA * delta < 0) {
+					// the moved edges cross, the loop through v is removed by the union
+					path.push_back(Move(v, nk, delta));
+					path.push_back(v);
+					path.push_back(Move(v, nj, delta));
+					continue;
+				}
+				switch (ring.join) {
+				case JoinMiter:
+					if (1 + cosA >= miter) {
+						const double q = delta / (1 + cosA);
+						path.push_back(OffsetPoint(v[0] + (nk[0] + nj[0]) * q, v[1] + (nk[1] + nj[1]) * q));
+						break;
+					}
+					Square(v, nk, nj, sinA, cosA, delta, path);
+					break;
+				case JoinRound: {
+					const double a = std::atan2(sinA, cosA);
+					const int count = std::max(static_cast<int >(std::lround(steps * std::fabs(a) / (2 * M_PI))), 1);
+					const double s = sinA < 0 ? -stepSin : stepSin;
+					double x = nk[0], y = nk[1];
+					for (int i = 0; i < count; ++i) {
+						path.push_back(OffsetPoint(v[0] + x * delta, v[1] + y * delta));
+						const double t = x;
+						x = x * stepCos - s * y;
+						y = t * s + y * stepCos;
+					}
+					path.push_back(Move(v, nj, delta));
+					break;
+				}
+				default:
+					Square(v, nk, nj, sinA, cosA, delta, path);
+					break;
+				}
+			}
+		}
+
+		/// @brief a square join, cut across the bisector at the distance from v
+		static void Square(const OffsetPoint &v, const OffsetPoint &nk, const OffsetPoint &nj,
+			double sinA, double cosA, double delta, std::vector<OffsetPoint > &path) {
+			const double dx = std::tan(std::atan2(sinA, cosA) / 4);
+			path.push_back(OffsetPoint(v[0] + delta * (nk[0] - nk[1] * dx), v[1] + delta * (nk[1] + nk[0] * dx)));
+			path.push_back(OffsetPoint(v[0] + delta * (nj[0] + nj[1] * dx), v[1] + delta * (nj[1] - nj[0] * dx)));
+		}
+
+		static OffsetPoint Move(const OffsetPoint &v, const OffsetPoint &normal, double delta) {
+			return OffsetPoint(v[0] + normal[0] * delta, v[1] + normal[1] * delta);
+		}
+
+	protected:
+		/// arc tolerance in parts of the distance when none is given
+		static constexpr double DefaultArcPart = 0.002;
+
+		std::vector<Ring > m_rings;
+		double m_miterLimit;
+		double m_arcTolerance;
+	};
+};
+
+#endif
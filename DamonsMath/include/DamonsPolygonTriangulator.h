@@ -0,0 +1,234 @@
+#ifndef _DAMONS_POLYGON_TRIANGULATOR_H_
+#define _DAMONS_POLYGON_TRIANGULATOR_H_
+
+#include "DamonsVector.h"
+#include "DamonsPolygon.h"
+#include "DamonsPredicates.h"
+#include "DamonsConstrainedDelaunay.h"
+#include <vector>
+#include <cmath>
+
+namespace DGraphic {
+
+	/// class DPolygonTriangulator
+	/// @breif splits a simple polygon, or a planar face in space, into triangles
+	///
+	/// the polygon may be concave and may have collinear or repeated points.
+	/// a triangle or a quad is split at once, small polygons are cut by ear
+	/// clipping, which only tests the reflex points against each ear. large
+	/// polygons are given to the constrained Delaunay triangulation as one
+	/// ring, which is O(n log n), the ear clipping being kept as the fallback
+	/// when the ring crosses itself. the signs are the exact ones of Orient2D.
+	///
+	/// a face in space is projected on the plane of the largest component of
+	/// its Newell normal first. the triangles keep the turning of the input
+	/// and index its points, so a mesh face keeps its normal.
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DPolygonTriangulator
+	{
+	public:
+		typedef DVector<double, 2> RingPoint;
+
+		DPolygonTriangulator() {}
+		~DPolygonTriangulator() {
+		}
+
+	public:
+		/// @brief triangulate a polygon
+		///
+		/// @param polygon simple polygon, either orientation
+		/// @param triangles as return, 3 indices of polygon points per triangle
+		/// @return size_t number of triangles
+		size_t Triangulate(const DPolygon<T> &polygon, std::vector<unsigned int > &triangles) {
+			const unsigned int count = polygon.GetPolygonPointSize();
+			m_ring.resize(count);
+			for (unsigned int i = 0; i < count; ++i) {
+				const DVector<T, 2> &p = polygon.GetPolygonPoint(i);
+				m_ring[i] = RingPoint(double(p[0]), double(p[1]));
+			}
+			return Run(triangles);
+		}
+
+		/// @brief triangulate a planar face in space
+		///
+		/// @param coords x,y,z of the face points, in the face order
+		/// @param count number of face points
+		/// @param triangles as return, 3 indices of face points per triangle
+		/// @param stride distance between two points in coords
+		/// @return size_t number of triangles
+		size_t TriangulateFace(const T *coords, unsigned int count, std::vector<unsigned int > &triangles, unsigned int stride = 3) {
+			// Newell normal, the largest component tells the projection plane
+			double normal[3] = { 0, 0, 0 };
+			for (unsigned int i = 0; i < count; ++i) {
+				const T *p = coords + i * stride;
+				const T *q = coords + ((i + 1) % count) * stride;
+				normal[0] += (double(p[1]) - q[1]) * (double(p[2]) + q[2]);
+				normal[1] += (double(p[2]) - q[2]) * (double(p[0]) + q[0]);
+				normal[2] += (double(p[0]) - q[0]) * (double(p[1]) + q[1]);
+			}
+			int axis = 2;
+			if (std::fabs(normal[0]) > std::fabs(normal[1]) && std::fabs(normal[0]) > std::fabs(normal[2]))
+				axis = 0;
+			else if (std::fabs(normal[1]) > std::fabs(normal[2]))
+				axis = 1;
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+			m_ring.resize(count);
+			for (unsigned int i = 0; i < count; ++i) {
+				const T *p = coords + i * stride;
+				m_ring[i] = RingPoint(double(p[u]), double(p[v]));
+			}
+			return Run(triangles);
+		}
+
+	protected:
+		/// @brief triangulate m_ring, whatever its turning
+		size_t Run(std::vector<unsigned int > &triangles) {
+			triangles.clear();
+			const unsigned int count = static_cast<unsigned int >(m_ring.size());
+			if (count < 3)
+				return 0;
+			if (count == 3) {
+				Emit(0, 1, 2, triangles);
+				return 1;
+			}
+
+			// a clockwise ring is mirrored, its triangles turn as the input
+			double area = 0;
+			for (unsigned int i = 0; i < count; ++i) {
+				const RingPoint &p = m_ring[i], &q = m_ring[(i + 1) % count];
+				area += p[0] * q[1] - q[0] * p[1];
+			}
+			if (area < 0) {
+				for (auto &p : m_ring)
+					p[1] = -p[1];
+			}
+
+			if (count == 4)
+				Quad(triangles);
+			else if (count <= EarClipLimit || !DelaunayClip(triangles)) {
+				triangles.clear();
+				EarClip(triangles);
+			}
+			return triangles.size() / 3;
+		}
+
+		/// @brief the diagonal of a quad leaving both halves counter clockwise
+		void Quad(std::vector<unsigned int > &triangles) const {
+			if (Orient(0, 1, 2) > 0 && Orient(0, 2, 3) > 0) {
+				Emit(0, 1, 2, triangles);
+				Emit(0, 2, 3, triangles);
+			}
+			else {
+				Emit(1, 2, 3, triangles);
+				Emit(1, 3, 0, triangles);
+			}
+		}
+
+		/// @brief ear clipping of a counter clockwise ring
+		///
+		/// a point is an ear when it is convex and no reflex point of the ring
+		/// lies in or on its triangle. once around the ring without an ear, the
+		/// ring is not simple and its first convex point is cut anyway.
+		void EarClip(std::vector<unsigned int > &triangles) {
+			const unsigned int count = static_cast<unsigned int >(m_ring.size());
+			m_prev.resize(count);
+			m_next.resize(count);
+			m_reflex.resize(count);
+			for (unsigned int i = 0; i < count; ++i) {
+				m_prev[i] = (i + count - 1) % count;
+				m_next[i] = (i + 1) % count;
+			}
+			for (unsigned int i = 0; i < count; ++i)
+				m_reflex[i] = Orient(m_prev[i], i, m_next[i]) <= 0;
+
+			unsigned int remaining = count, i = 0, misses = 0;
+			while (remaining > 3) {
+				if (!IsEar(i) && misses < remaining) {
+					i = m_next[i];
+					++misses;
+					continue;
+				}
+				if (misses >= remaining) {
+					// no ear at all, cut the first convex point
+					for (unsigned int k = 0; k < remaining && m_reflex[i]; ++k)
+						i = m_next[i];
+				}
+				const unsigned int p = m_prev[i], q = m_next[i];
+				Emit(p, i, q, triangles);
+				m_next[p] = q;
+				m_prev[q] = p;
+				m_reflex[p] = Orient(m_prev[p], p, q) <= 0;
+				m_reflex[q] = Orient(p, q, m_next[q]) <= 0;
+				--remaining;
+				misses = 0;
+				i = q;
+			}
+			Emit(m_prev[i], i, m_next[i], triangles);
+		}
+
+		/// @brief true when the point i of the ring is an ear
+		bool IsEar(unsigned int i) const {
+			if (m_reflex[i])
+				return false;
+			const unsigned int p = m_prev[i], q = m_next[i];
+			const RingPoint &a = m_ring[p], &b = m_ring[i], &c = m_ring[q];
+			for (unsigned int v = m_next[q]; v != p; v = m_next[v]) {
+				if (!m_reflex[v])
+					continue;
+				const RingPoint &d = m_ring[v];
+				// a repeated corner point touches the ear without entering it
+				if (d == a || d == b || d == c)
+					continue;
+				if (Orient(p, i, v) >= 0 && Orient(i, q, v) >= 0 && Orient(q, p, v) >= 0)
+					return false;
+			}
+			return true;
+		}
+
+		/// @brief constrained Delaunay triangulation of a counter clockwise ring
+		/// @return false when the ring crosses itself, then the triangles are not valid
+		bool DelaunayClip(std::vector<unsigned int > &triangles) const {
+			DConstrainedDelaunay<double > cdt;
+			DPolygon<double > ring;
+			for (auto &p : m_ring)
+				ring.AddPoint(p);
+			cdt.AddPolygon(ring);
+			cdt.ConstrainedTriangulate();
+			// a crossing adds a point where no point of the ring was
+			if (cdt.GetTriangleCount() == 0 || cdt.GetPointCount() != ring.GetPolygonPointSize())
+				return false;
+
+			triangles.reserve(3 * cdt.GetTriangleCount());
+			unsigned int a, b, c;
+			for (size_t t = 0; t < cdt.GetTriangleCount(); ++t) {
+				cdt.GetTriangle(t, a, b, c);
+				Emit(a, b, c, triangles);
+			}
+			return true;
+		}
+
+		double Orient(unsigned int a, unsigned int b, unsigned int c) const {
+			return DMath::Orient2D(&m_ring[a][0], &m_ring[b][0], &m_ring[c][0]);
+		}
+
+		static void Emit(unsigned int a, unsigned int b, unsigned int c, std::vector<unsigned int > &triangles) {
+			triangles.push_back(a);
+			triangles.push_back(b);
+			triangles.push_back(c);
+		}
+
+	protected:
+		/// rings larger than this go to the constrained Delaunay triangulation
+		enum { EarClipLimit = 64 };
+
+		std::vector<RingPoint > m_ring;
+		std::vector<unsigned int > m_prev;
+		std::vector<unsigned int > m_next;
+		std::vector<char > m_reflex;
+	};
+};
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef _DAMONS_PREDICATES_H_
+#define _DAMONS_PREDICATES_H_
+
+#include <cmath>
+#include <vector>
+
+namespace DMath {
+
+	/// exact arithmetic on expansions, after J. R. Shewchuk, "Adaptive
+	/// Precision Floating-Point Arithmetic and Fast Robust Geometric
+	/// Predicates". an expansion is an unevaluated sum of doubles sorted by
+	/// increasing magnitude that do not overlap, so its sign is the sign of
+	/// its last component and sums and products of expansions are exact.
+	/// IEEE double arithmetic with round to nearest even is assumed.
+	namespace DExact {
+
+		typedef std::vector<double > Expansion;
+
+		/// @brief a + b = x + y exactly, x is the rounded sum
+		inline void TwoSum(double a, double b, double &x, double &y) {
+			x = a + b;
+			const double bv = x - a;
+			const double av = x - bv;
+			y = (a - av) + (b - bv);
+		}
+
+		/// @brief a + b = x + y exactly when |a| >= |b|
+		inline void FastTwoSum(double a, double b, double &x, double &y) {
+			x = a + b;
+			y = b - (x - a);
+		}
+
+		/// @brief a - b = x + y exactly, x is the rounded difference
+		inline void TwoDiff(double a, double b, double &x, double &y) {
+			x = a - b;
+			const double bv = a - x;
+			const double av = x + bv;
+			y = (a - av) + (bv - b);
+		}
+
+		/// @brief a = hi + lo with both halves of 26 bits
+		inline void Split(double a, double &hi, double &lo) {
+			const double c = 134217729.0 * a;
+			const double big = c - a;
+			hi = c - big;
+			lo = a - hi;
+		}
+
+		/// @brief a * b = x + y exactly, x is the rounded product
+		inline void TwoProduct(double a, double b, double &x, double &y) {
+			x = a * b;
+			double ahi, alo, bhi, blo;
+			Split(a, ahi, alo);
+			Split(b, bhi, blo);
+			const double err1 = x - ahi * bhi;
+			const double err2 = err1 - alo * bhi;
+			const double err3 = err2 - ahi * blo;
+			y = alo * blo - err3;
+		}
+
+		/// @brief a - b as an expansion
+		inline Expansion Difference(double a, double b) {
+			double x, y;
+			TwoDiff(a, b, x, y);
+			Expansion e;
+			if (y != 0.0)
+				e.push_back(y);
+			if (x != 0.0 || e.empty())
+				e.push_back(x);
+			return e;
+		}
+
+		/// @brief e + f, zero components are dropped
+		inline Expansion Sum(const Expansion &e, const Expansion &f) {
+			// merge by increasing magnitude then carry the sum upwards
+			Expansion g(e.size() + f.size());
+			size_t ei = 0, fi = 0, gi = 0;
+			while (ei < e.size() && fi < f.size()) {
+				if ((f[fi] > e[ei]) == (f[fi] > -e[ei]))
+					g[gi++] = e[ei++];
+				else
+					g[gi++] = f[fi++];
+			}
+			while (ei < e.size())
+				g[gi++] = e[ei++];
+			while (fi < f.size())
+				g[gi++] = f[fi++];
+
+			Expansion h;
+			if (g.empty())
+				return Expansion(1, 0.0);
+			h.reserve(g.size());
+			double q = g[0];
+			for (size_t k = 1; k < g.size(); ++k) {
+				double qnew, hh;
+				TwoSum(q, g[k], qnew, hh);
+				if (hh != 0.0)
+					h.push_back(hh);
+				q = qnew;
+			}
+			if (q != 0.0 || h.empty())
+				h.push_back(q);
+			return h;
+		}
+
+		/// @brief e * b, zero components are dropped
+		inline Expansion Scale(const Expansion &e, double b) {
+			Expansion h;
+			h.reserve(2 * e.size());
+			double q, hh;
+			TwoProduct(e[0], b, q, hh);
+			if (hh != 0.0)
+				h.push_back(hh);
+			for (size_t k = 1; k < e.size(); ++k) {
+				double p1, p0, sum;
+				TwoProduct(e[k], b, p1, p0);
+				TwoSum(q, p0, sum, hh);
+				if (hh != 0.0)
+					h.push_back(hh);
+				FastTwoSum(p1, sum, q, hh);
+				if (hh != 0.0)
+					h.push_back(hh);
+			}
+			if (q != 0.0 || h.empty())
+				h.push_back(q);
+			return h;
+		}
+
+		/// @brief e * f
+		inline Expansion Product(const Expansion &e, const Expansion &f) {
+			Expansion h = Scale(e, f[0]);
+			for (size_t k = 1; k < f.size(); ++k)
+				h = Sum(h, Scale(e, f[k]));
+			return h;
+		}
+
+		/// @brief -e
+		inline Expansion Negate(Expansion e) {
+			for (size_t k = 0; k < e.size(); ++k)
+				e[k] = -e[k];
+			return e;
+		}
+
+		/// @brief a * d - b * c
+		inline Expansion Cross(const Expansion &a, const Expansion &b, const Expansion &c, const Expansion &d) {
+			return Sum(Product(a, d), Negate(Product(b, c)));
+		}
+
+		/// @brief x^2 + y^2 (+ z^2)
+		inline Expansion Lift(const Expansion &x, const Expansion &y, const Expansion *z = nullptr) {
+			Expansion h = Sum(Product(x, x), Product(y, y));
+			if (z)
+				h = Sum(h, Product(*z, *z));
+			return h;
+		}
+
+		/// @brief the most significant component, it has the sign of e
+		inline double Estimate(const Expansion &e) { return e.back(); }
+
+		inline double Orient2D(const double *pa, const double *pb, const double *pc) {
+			const Expansion acx = Difference(pa[0], pc[0]), acy = Difference(pa[1], pc[1]);
+			const Expansion bcx = Difference(pb[0], pc[0]), bcy = Difference(pb[1], pc[1]);
+			return Estimate(Cross(acx, acy, bcx, bcy));
+		}
+
+		inline double Orient3D(const double *pa, const double *pb, const double *pc, const double *pd) {
+			Expansion ad[3], bd[3], cd[3];
+			for (int k = 0; k < 3; ++k) {
+				ad[k] = Difference(pa[k], pd[k]);
+				bd[k] = Difference(pb[k], pd[k]);
+				cd[k] = Difference(pc[k], pd[k]);
+			}
+			Expansion det = Product(ad[2], Cross(bd[0], bd[1], cd[0], cd[1]));
+			det = Sum(det, Product(bd[2], Cross(cd[0], cd[1], ad[0], ad[1])));
+			det = Sum(det, Product(cd[2], Cross(ad[0], ad[1], bd[0], bd[1])));
+			return Estimate(det);
+		}
+
+		inline double InCircle(const double *pa, const double *pb, const double *pc, const double *pd) {
+			const Expansion adx = Difference(pa[0], pd[0]), ady = Difference(pa[1], pd[1]);
+			const Expansion bdx = Difference(pb[0], pd[0]), bdy = Difference(pb[1], pd[1]);
+			const Expansion cdx = Difference(pc[0], pd[0]), cdy = Difference(pc[1], pd[1]);
+			Expansion det = Product(Lift(adx, ady), Cross(bdx, bdy, cdx, cdy));
+			det = Sum(det, Product(Lift(bdx, bdy), Cross(cdx, cdy, adx, ady)));
+			det = Sum(det, Product(Lift(cdx, cdy), Cross(adx, ady, bdx, bdy)));
+			return Estimate(det);
+		}
+
+		inline double InSphere(const double *pa, const double *pb, const double *pc, const double *pd, const double *pe) {
+			Expansion ae[3], be[3], ce[3], de[3];
+			for (int k = 0; k < 3; ++k) {
+				ae[k] = Difference(pa[k], pe[k]);
+				be[k] = Difference(pb[k], pe[k]);
+				ce[k] = Difference(pc[k], pe[k]);
+				de[k] = Difference(pd[k], pe[k]);
+			}
+			const Expansion ab = Cross(ae[0], ae[1], be[0], be[1]);
+			const Expansion bc = Cross(be[0], be[1], ce[0], ce[1]);
+			const Expansion cd = Cross(ce[0], ce[1], de[0], de[1]);
+			const Expansion da = Cross(de[0], de[1], ae[0], ae[1]);
+			const Expansion ac = Cross(ae[0], ae[1], ce[0], ce[1]);
+			const Expansion bd = Cross(be[0], be[1], de[0], de[1]);
+
+			const Expansion abc = Sum(Sum(Product(ae[2], bc), Negate(Product(be[2], ac))), Product(ce[2], ab));
+			const Expansion bcd = Sum(Sum(Product(be[2], cd), Negate(Product(ce[2], bd))), Product(de[2], bc));
+			const Expansion cda = Sum(Sum(Product(ce[2], da), Product(de[2], ac)), Product(ae[2], cd));
+			const Expansion dab = Sum(Sum(Product(de[2], ab), Product(ae[2], bd)), Product(be[2], da));
+
+			Expansion det = Sum(Product(Lift(de[0], de[1], &de[2]), abc), Negate(Product(Lift(ce[0], ce[1], &ce[2]), dab)));
+			det = Sum(det, Sum(Product(Lift(be[0], be[1], &be[2]), cda), Negate(Product(Lift(ae[0], ae[1], &ae[2]), bcd))));
+			return Estimate(det);
+		}
+	};
+
+	/// error bounds of the floating point filters, in units of the
+	/// permanent of the determinant
+	struct DPredicateBounds {
+		static double Epsilon() { return 1.1102230246251565e-16; }
+		static double Orient2D() { return (3.0 + 16.0 * Epsilon()) * Epsilon(); }
+		static double Orient3D() { return (7.0 + 56.0 * Epsilon()) * Epsilon(); }
+		static double InCircle() { return (10.0 + 96.0 * Epsilon()) * Epsilon(); }
+		static double InSphere() { return (16.0 + 224.0 * Epsilon()) * Epsilon(); }
+	};
+
+	/// @brief Orientation of three points in the plane.
+	///
+	/// The determinant is evaluated in floating point and only recomputed
+	/// exactly when its magnitude is below the rounding error bound, so the
+	/// sign is always right and the common case costs a few multiplications.
+	///
+	/// @param pa,pb,pc x y of the points.
+	/// @return positive if they are counter clockwise, negative if clockwise,
+	/// zero if collinear. the magnitude is about twice the triangle area.
+	inline double Orient2D(const double *pa, const double *pb, const double *pc) {
+		const double detleft = (pa[0] - pc[0]) * (pb[1] - pc[1]);
+		const double detright = (pa[1] - pc[1]) * (pb[0] - pc[0]);
+		const double det = detleft - detright;
+		double detsum;
+		if (detleft > 0.0) {
+			if (detright <= 0.0)
+				return det;
+			detsum = detleft + detright;
+		}
+		else if (detleft < 0.0) {
+			if (detright >= 0.0)
+				return det;
+			detsum = -detleft - detright;
+		}
+		else
+			return det;
+		const double errbound = DPredicateBounds::Orient2D() * detsum;
+		if (det >= errbound || -det >= errbound)
+			return det;
+		return DExact::Orient2D(pa, pb, pc);
+	}
+
+	/// @brief Orientation of four points in space.
+	///
+	/// @param pa,pb,pc,pd x y z of the points.
+	/// @return positive if pd lies below the plane of pa, pb, pc, which
+	/// appear counter clockwise seen from above, negative above, zero if the
+	/// points are coplanar. the magnitude is about six times the volume.
+	inline double Orient3D(const double *pa, const double *pb, const double *pc, const double *pd) {
+		const double adx = pa[0] - pd[0], ady = pa[1] - pd[1], adz = pa[2] - pd[2];
+		const double bdx = pb[0] - pd[0], bdy = pb[1] - pd[1], bdz = pb[2] - pd[2];
+		const double cdx = pc[0] - pd[0], cdy = pc[1] - pd[1], cdz = pc[2] - pd[2];
+		const double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+		const double cdxady = cdx * ady, adxcdy = adx * cdy;
+		const double adxbdy = adx * bdy, bdxady = bdx * ady;
+		const double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+		const double permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * std::fabs(adz)
+			+ (std::fabs(cdxady) + std::fabs(adxcdy)) * std::fabs(bdz)
+			+ (std::fabs(adxbdy) + std::fabs(bdxady)) * std::fabs(cdz);
+		const double errbound = DPredicateBounds::Orient3D() * permanent;
+		if (det > errbound || -det > errbound)
+			return det;
+		return DExact::Orient3D(pa, pb, pc, pd);
+	}
+
+	/// @brief Position of a point against the circle through three points.
+	///
+	/// @param pa,pb,pc x y of the circle points, counter clockwise.
+	/// @param pd x y of the tested point.
+	/// @return positive if pd is inside the circle, negative outside, zero
+	/// if the four points are cocircular. the sign is reversed when pa, pb,
+	/// pc are clockwise.
+	inline double InCircle(const double *pa, const double *pb, const double *pc, const double *pd) {
+		const double adx = pa[0] - pd[0], ady = pa[1] - pd[1];
+		const double bdx = pb[0] - pd[0], bdy = pb[1] - pd[1];
+		const double cdx = pc[0] - pd[0], cdy = pc[1] - pd[1];
+		const double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+		const double alift = adx * adx + ady * ady;
+		const double cdxady = cdx * ady, adxcdy = adx * cdy;
+		const double blift = bdx * bdx + bdy * bdy;
+		const double adxbdy = adx * bdy, bdxady = bdx * ady;
+		const double clift = cdx * cdx + cdy * cdy;
+		const double det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) + clift * (adxbdy - bdxady);
+		const double permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * alift
+			+ (std::fabs(cdxady) + std::fabs(adxcdy)) * blift
+			+ (std::fabs(adxbdy) + std::fabs(bdxady)) * clift;
+		const double errbound = DPredicateBounds::InCircle() * permanent;
+		if (det > errbound || -det > errbound)
+			return det;
+		return DExact::InCircle(pa, pb, pc, pd);
+	}
+
+	/// @brief Position of a point against the sphere through four points.
+	///
+	/// @param pa,pb,pc,pd x y z of the sphere points, with Orient3D(pa, pb, pc, pd) > 0.
+	/// @param pe x y z of the tested point.
+	/// @return positive if pe is inside the sphere, negative outside, zero
+	/// if the five points are cospherical. the sign is reversed when the
+	/// orientation of the first four is negative.
+	inline double InSphere(const double *pa, const double *pb, const double *pc, const double *pd, const double *pe) {
+		const double aex = pa[0] - pe[0], aey = pa[1] - pe[1], aez = pa[2] - pe[2];
+		const double bex = pb[0] - pe[0], bey = pb[1] - pe[1], bez = pb[2] - pe[2];
+		const double cex = pc[0] - pe[0], cey = pc[1] - pe[1], cez = pc[2] - pe[2];
+		const double dex = pd[0] - pe[0], dey = pd[1] - pe[1], dez = pd[2] - pe[2];
+
+		const double aexbey = aex * bey, bexaey = bex * aey;
+		const double bexcey = bex * cey, cexbey = cex * bey;
+		const double cexdey = cex * dey, dexcey = dex * cey;
+		const double dexaey = dex * aey, aexdey = aex * dey;
+		const double aexcey = aex * cey, cexaey = cex * aey;
+		const double bexdey = bex * dey, dexbey = dex * bey;
+		const double ab = aexbey - bexaey, bc = bexcey - cexbey, cd = cexdey - dexcey;
+		const double da = dexaey - aexdey, ac = aexcey - cexaey, bd = bexdey - dexbey;
+
+		const double abc = aez * bc - bez * ac + cez * ab;
+		const double bcd = bez * cd - cez * bd + dez * bc;
+		const double cda = cez * da + dez * ac + aez * cd;
+		const double dab = dez * ab + aez * bd + bez * da;
+
+		const double alift = aex * aex + aey * aey + aez * aez;
+		const double blift = bex * bex + bey * bey + bez * bez;
+		const double clift = cex * cex + cey * cey + cez * cez;
+		const double dlift = dex * dex + dey * dey + dez * dez;
+		const double det = (dlift * abc - clift * dab) + (blift * cda - alift * bcd);
+
+		const double aezplus = std::fabs(aez), bezplus = std::fabs(bez);
+		const double cezplus = std::fabs(cez), dezplus = std::fabs(dez);
+		const double aexbeyplus = std::fabs(aexbey), bexaeyplus = std::fabs(bexaey);
+		const double bexceyplus = std::fabs(bexcey), cexbeyplus = std::fabs(cexbey);
+		const double cexdeyplus = std::fabs(cexdey), dexceyplus = std::fabs(dexcey);
+		const double dexaeyplus = std::fabs(dexaey), aexdeyplus = std::fabs(aexdey);
+		const double aexceyplus = std::fabs(aexcey), cexaeyplus = std::fabs(cexaey);
+		const double bexdeyplus = std::fabs(bexdey), dexbeyplus = std::fabs(dexbey);
+		const double permanent = ((cexdeyplus + dexceyplus) * bezplus + (dexbeyplus + bexdeyplus) * cezplus + (bexceyplus + cexbeyplus) * dezplus) * alift
+			+ ((dexaeyplus + aexdeyplus) * cezplus + (aexceyplus + cexaeyplus) * dezplus + (cexdeyplus + dexceyplus) * aezplus) * blift
+			+ ((aexbeyplus + bexaeyplus) * dezplus + (bexdeyplus + dexbeyplus) * aezplus + (dexaeyplus + aexdeyplus) * bezplus) * clift
+			+ ((bexceyplus + cexbeyplus) * aezplus + (cexaeyplus + aexceyplus) * bezplus + (aexbeyplus + bexaeyplus) * cezplus) * dlift;
+		const double errbound = DPredicateBounds::InSphere() * permanent;
+		if (det > errbound || -det > errbound)
+			return det;
+		return DExact::InSphere(pa, pb, pc, pd, pe);
+	}
+};
+#endif
@@ -0,0 +1,365 @@
+#ifndef _DAMONS_PREPARED_POLYGON_H_
+#define _DAMONS_PREPARED_POLYGON_H_
+
+#include "DamonsVector.h"
+#include "DamonsPolygon.h"
+#include "DamonsPredicates.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace DGraphic {
+
+	/// class DPreparedPolygon
+	/// @breif a polygon indexed once for many point in polygon queries
+	///
+	/// the box of the polygon is cut in a grid of cells, each listing the
+	/// edges that meet it, and every cell gets a reference point inside it
+	/// on none of its edges (its center unless an edge holds it) whose code
+	/// is computed once, exactly, walking the rows of the grid from the left
+	/// of the box. a point takes the code of the reference of its cell,
+	/// flipped by every edge of the cell that crosses the way from the point
+	/// to the reference, which stays in the cell. the edges of a cell are
+	/// stored as arrays of coordinates and tested without branches, a loop
+	/// the compiler vectorizes.
+	///
+	/// the orientations are floating point with the rounding bound of
+	/// Orient2D: when one is within it (the point is on an edge, the way
+	/// passes through a vertex...) the same edges are tested again with the
+	/// exact Orient2D, a vertex on the way counting on one side of it. so the
+	/// codes are those of DPolygon::IsPointInPolygon, without any epsilon:
+	/// 2 inside, 1 on an edge, 0 outside. the index holds every edge once per
+	/// cell it meets, a few cells per edge for most shapes; the grid is made
+	/// coarser when long edges (a star) would meet more than EntriesPerEdge
+	/// cells each on average, so memory stays linear in the edges.
+	///
+	/// a batch of points is classified in parallel.
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DPreparedPolygon
+	{
+	public:
+		DPreparedPolygon() {}
+		explicit DPreparedPolygon(const DPolygon<T> &polygon) { Prepare(polygon); }
+		~DPreparedPolygon() {
+		}
+
+	public:
+		/// @brief index the edges of a polygon
+		///
+		/// @param polygon the polygon, either orientation
+		void Prepare(const DPolygon<T> &polygon) {
+			m_cellStart.clear();
+			m_cellCode.clear();
+			const unsigned int sz = polygon.GetPolygonPointSize();
+			if (sz < 2)
+				return;
+
+			m_xmin = m_ymin = std::numeric_limits<double>::max();
+			m_xmax = m_ymax = std::numeric_limits<double>::lowest();
+			for (unsigned int i = 0; i < sz; ++i) {
+				const DVector<T, 2> &p = polygon.GetPolygonPoint(i);
+				m_xmin = std::min(m_xmin, double(p[0]));
+				m_xmax = std::max(m_xmax, double(p[0]));
+				m_ymin = std::min(m_ymin, double(p[1]));
+				m_ymax = std::max(m_ymax, double(p[1]));
+			}
+			PrepareCells(polygon, sz);
+		}
+
+		/// @brief tell whether a point lie in polygon
+		/// @return  2 if in polygon
+		///			 1 if on Polygon edge
+		///			 0 if out polygon
+		int IsPointInPolygon(const T &x, const T &y) const {
+			return Locate(double(x), double(y));
+		}
+		int IsPointInPolygon(const DVector<T, 2> &p) const {
+			return Locate(double(p[0]), double(p[1]));
+		}
+
+		/// @brief classify a batch of points in parallel
+		///
+		/// @param coords x,y of the points, stride values apart (3 for x,y,z)
+		/// @param count number of points
+		/// @param codes as return, the code of IsPointInPolygon of every point
+		/// @param stride distance between two points in coords
+		void Classify(const T *coords, size_t count, std::vector<unsigned char > &codes, unsigned int stride = 2) const {
+			codes.resize(count);
+			DMath::ParallelFor(0, count, [&](size_t i) {
+				const T *p = coords + i * stride;
+				codes[i] = static_cast<unsigned char >(Locate(double(p[0]), double(p[1])));
+			}, 1 << 12);
+		}
+
+	protected:
+		int Locate(double x, double y) const {
+			if (m_cellStart.empty() || !(x >= m_xmin && x <= m_xmax && y >= m_ymin && y <= m_ymax))
+				return 0;
+			const unsigned int i = CellX(x), j = CellY(y);
+			const size_t c = size_t(j) * m_gx + i;
+			const int code = m_cellCode[c];
+			const double cx = m_refX[c], cy = m_refY[c];
+			const size_t b = m_cellStart[c], e = m_cellStart[c + 1];
+			const double *ax = m_cx0.data(), *ay = m_cy0.data(), *bx = m_cx1.data(), *by = m_cy1.data();
+			const double *side = m_side.data();
+			const double bound = DMath::DPredicateBounds::Orient2D();
+
+			// the way from the point to the reference crosses ab when they are on
+			// both sides of ab, and a and b on both sides of the way
+			int flip = 0, unsure = 0;
+			for (size_t k = b; k < e; ++k) {
+				const double l1 = (ax[k] - x) * (by[k] - y), r1 = (ay[k] - y) * (bx[k] - x);
+				const double l2 = (x - ax[k]) * (cy - ay[k]), r2 = (y - ay[k]) * (cx - ax[k]);
+				const double l3 = (x - bx[k]) * (cy - by[k]), r3 = (y - by[k]) * (cx - bx[k]);
+				const double o1 = l1 - r1, o2 = l2 - r2, o3 = l3 - r3;
+				unsure |= (std::fabs(o1) <= bound * (std::fabs(l1) + std::fabs(r1)))
+					| (std::fabs(o2) <= bound * (std::fabs(l2) + std::fabs(r2)))
+					| (std::fabs(o3) <= bound * (std::fabs(l3) + std::fabs(r3)))
+					| (side[k] == 0);
+				flip ^= ((o1 > 0) != (side[k] > 0)) & ((o2 > 0) != (o3 > 0));
+			}
+			if (unsure)
+				return ClassifyExact(x, y, c);
+			return flip ? 2 - code : code;
+		}
+
+		/// @brief the code of a point of cell c with exact orientations
+		int ClassifyExact(double x, double y, size_t c) const {
+			const double p[2] = { x, y }, r[2] = { m_refX[c], m_refY[c] };
+			bool flip = false;
+			for (size_t k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+				const double a[2] = { m_cx0[k], m_cy0[k] }, b[2] = { m_cx1[k], m_cy1[k] };
+				const double o = DMath::Orient2D(a, b, p);
+				if (o == 0 && std::min(a[0], b[0]) <= x && x <= std::max(a[0], b[0])
+					&& std::min(a[1], b[1]) <= y && y <= std::max(a[1], b[1]))
+					return 1;
+				if (Crosses(p, r, a, b, o))
+					flip = !flip;
+			}
+			return flip ? 2 - m_cellCode[c] : m_cellCode[c];
+		}
+
+		/// @brief whether the way from p to r, both on no edge, crosses the edge ab
+		///
+		/// a vertex on the line of the way counts on its left, as if the way
+		/// were moved a little to the right: the parity of the crossings is
+		/// kept and the way never passes through a vertex.
+		/// @param o Orient2D(a, b, p)
+		static bool Crosses(const double p[2], const double r[2], const double a[2], const double b[2], double o) {
+			if ((DMath::Orient2D(p, r, a) >= 0) == (DMath::Orient2D(p, r, b) >= 0))
+				return false;
+			const double s = DMath::Orient2D(a, b, r);
+			return (o > 0 && s < 0) || (o < 0 && s > 0);
+		}
+
+		/// @brief a point of cell c on none of its edges, its center when it can
+		void FindReference(size_t c, double &rx, double &ry) const {
+			const unsigned int i = unsigned(c % m_gx), j = unsigned(c / m_gx);
+			const double x0 = m_xmin + i / m_sx, y0 = m_ymin + j / m_sy;
+			const size_t b = m_cellStart[c], e = m_cellStart[c + 1];
+			auto onEdge = [&](double x, double y) {
+				const double p[2] = { x, y };
+				for (size_t k = b; k < e; ++k) {
+					const double a[2] = { m_cx0[k], m_cy0[k] }, q[2] = { m_cx1[k], m_cy1[k] };
+					if (DMath::Orient2D(a, q, p) == 0 && std::min(a[0], q[0]) <= x && x <= std::max(a[0], q[0])
+						&& std::min(a[1], q[1]) <= y && y <= std::max(a[1], q[1]))
+						return true;
+				}
+				return false;
+			};
+			rx = CenterX(i);
+			ry = CenterY(j);
+			if (!onEdge(rx, ry))
+				return;
+			// an edge holds at most n points of a n x n lattice, more than the
+			// edges always leaves one free
+			for (size_t n = 2;; ++n) {
+				for (size_t v = 0; v < n * n; ++v) {
+					rx = x0 + ((v % n) + 0.5) / (n * m_sx);
+					ry = y0 + ((v / n) + 0.5) / (n * m_sy);
+					if (CellX(rx) == i && CellY(ry) == j && !onEdge(rx, ry))
+						return;
+				}
+			}
+		}
+
+		/// @brief the grid, about two cells per edge, the cell edges, the
+		/// references and their codes
+		void PrepareCells(const DPolygon<T> &polygon, unsigned int sz) {
+			const double w = std::max(m_xmax - m_xmin, 0.0), h = std::max(m_ymax - m_ymin, 0.0);
+			// a flat polygon has a single cell, its reference is out of the box
+			double cells = (w > 0 && h > 0) ? 2.0 * sz : 1.0;
+			const double aspect = (w > 0 && h > 0) ? w / h : 1;
+			auto setGrid = [&]() {
+				m_gx = static_cast<unsigned int >(std::max(1.0, std::min(std::sqrt(cells * aspect), cells)));
+				m_gy = static_cast<unsigned int >(std::max(1.0, std::min(cells / m_gx, cells)));
+				m_sx = w > 0 ? m_gx / w : 0;
+				m_sy = h > 0 ? m_gy / h : 0;
+			};
+			setGrid();
+
+			// the cells of an edge, row by row of the grid, a little wider than
+			// the part of the edge in the row so that no cell it meets is missed
+			std::vector<unsigned int > edgeOf;
+			auto forCells = [&](unsigned int e, size_t *start, bool fill) {
+				const DVector<T, 2> &p = polygon.GetPolygonPoint(e), &q = polygon.GetPolygonPoint((e + 1) % sz);
+				const double px = p[0], py = p[1], qx = q[0], qy = q[1];
+				const double ylo = std::min(py, qy), yhi = std::max(py, qy);
+				const double margin = 1e-6 * (m_sx > 0 ? 1 / m_sx : 1);
+				const double ymargin = 1e-6 * (m_sy > 0 ? 1 / m_sy : 1);
+				const unsigned int j1 = CellY(yhi);
+				for (unsigned int j = CellY(ylo); j <= j1; ++j) {
+					double xlo = std::min(px, qx), xhi = std::max(px, qx);
+					if (py != qy && m_sy > 0) {
+						const double y0 = std::max(ylo, m_ymin + j / m_sy - ymargin), y1 = std::min(yhi, m_ymin + (j + 1) / m_sy + ymargin);
+						const double x0 = px + (qx - px) * ((y0 - py) / (qy - py));
+						const double x1 = px + (qx - px) * ((y1 - py) / (qy - py));
+						xlo = std::max(xlo, std::min(x0, x1) - margin);
+						xhi = std::min(xhi, std::max(x0, x1) + margin);
+					}
+					const unsigned int i1 = CellX(xhi);
+					for (unsigned int i = CellX(xlo); i <= i1; ++i) {
+						const size_t c = size_t(j) * m_gx + i;
+						if (!fill) {
+							++start[c + 1];
+							continue;
+						}
+						const size_t k = start[c]++;
+						m_cx0[k] = px;
+						m_cy0[k] = py;
+						m_cx1[k] = qx;
+						m_cy1[k] = qy;
+						edgeOf[k] = e;
+					}
+				}
+			};
+
+			// long edges (a star) meet about sqrt(cells) cells each, the grid is
+			// made coarser until they meet EntriesPerEdge cells on average
+			size_t count;
+			for (;;) {
+				count = size_t(m_gx) * m_gy;
+				m_cellStart.assign(count + 1, 0);
+				for (unsigned int e = 0; e < sz; ++e)
+					forCells(e, m_cellStart.data(), false);
+				size_t entries = 0;
+				for (size_t c = 1; c <= count; ++c)
+					entries += m_cellStart[c];
+				if (entries <= size_t(EntriesPerEdge) * sz || count == 1)
+					break;
+				const double ratio = double(EntriesPerEdge) * sz / entries;
+				cells = std::max(1.0, std::min(cells * ratio * ratio, count / 2.0));
+				setGrid();
+			}
+			for (size_t c = 0; c < count; ++c)
+				m_cellStart[c + 1] += m_cellStart[c];
+			const size_t entries = m_cellStart[count];
+			m_cx0.resize(entries);
+			m_cy0.resize(entries);
+			m_cx1.resize(entries);
+			m_cy1.resize(entries);
+			m_side.resize(entries);
+			edgeOf.resize(entries);
+			std::vector<size_t > fill(m_cellStart.begin(), m_cellStart.end() - 1);
+			for (unsigned int e = 0; e < sz; ++e)
+				forCells(e, fill.data(), true);
+
+			// the references and the side of the edges of their cell
+			m_refX.resize(count);
+			m_refY.resize(count);
+			m_cellCode.assign(count, 0);
+			DMath::ParallelFor(0, count, [&](size_t c) {
+				if (count == 1) {
+					m_refX[c] = m_xmin - 1 - w;
+					m_refY[c] = m_ymin - 1 - h;
+				}
+				else
+					FindReference(c, m_refX[c], m_refY[c]);
+				const double o[2] = { m_refX[c], m_refY[c] };
+				for (size_t k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+					const double a[2] = { m_cx0[k], m_cy0[k] }, b[2] = { m_cx1[k], m_cy1[k] };
+					const double d = DMath::Orient2D(a, b, o);
+					m_side[k] = d > 0 ? 1 : (d < 0 ? -1 : 0);
+				}
+			}, 256);
+			if (count == 1)
+				return;
+
+			// the codes along every row of cells: the way from the left of the box
+			// to the first reference only meets the edges of the first cell, the way
+			// between two references those of their two cells, counted once
+			std::vector< std::vector<size_t > > stamps(DMath::ParallelThreadCount());
+			DMath::ParallelForRange(0, m_gy, [&](size_t jb, size_t je, unsigned int tid) {
+				std::vector<size_t > &stamp = stamps[tid];
+				stamp.resize(sz, 0);
+				for (size_t j = jb; j < je; ++j) {
+					double r[2] = { m_xmin - 1 / m_sx, m_refY[j * m_gx] };
+					bool inside = false;
+					for (size_t c = j * m_gx; c < (j + 1) * m_gx; ++c) {
+						const double p[2] = { m_refX[c], m_refY[c] };
+						const bool first = c == j * m_gx;
+						if (!first) {
+							for (size_t k = m_cellStart[c - 1]; k < m_cellStart[c]; ++k)
+								stamp[edgeOf[k]] = c + 1;
+						}
+						auto cross = [&](size_t k) {
+							const double a[2] = { m_cx0[k], m_cy0[k] }, b[2] = { m_cx1[k], m_cy1[k] };
+							if (Crosses(p, r, a, b, DMath::Orient2D(a, b, p)))
+								inside = !inside;
+						};
+						for (size_t k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+							if (first || stamp[edgeOf[k]] != c + 1)
+								cross(k);
+						}
+						if (!first) {
+							for (size_t k = m_cellStart[c - 1]; k < m_cellStart[c]; ++k)
+								cross(k);
+						}
+						m_cellCode[c] = inside ? 2 : 0;
+						r[0] = p[0];
+						r[1] = p[1];
+					}
+				}
+			}, 4);
+		}
+
+		unsigned int CellX(double x) const {
+			const double i = std::floor((x - m_xmin) * m_sx);
+			return i <= 0 ? 0 : (i >= m_gx - 1 ? m_gx - 1 : static_cast<unsigned int >(i));
+		}
+		unsigned int CellY(double y) const {
+			const double j = std::floor((y - m_ymin) * m_sy);
+			return j <= 0 ? 0 : (j >= m_gy - 1 ? m_gy - 1 : static_cast<unsigned int >(j));
+		}
+		double CenterX(unsigned int i) const { return m_sx > 0 ? m_xmin + (i + 0.5) / m_sx : m_xmin; }
+		double CenterY(unsigned int j) const { return m_sy > 0 ? m_ymin + (j + 0.5) / m_sy : m_ymin; }
+
+	protected:
+		/// average cells met by an edge above which the grid is made coarser
+		enum { EntriesPerEdge = 64 };
+
+		double m_xmin = 0, m_ymin = 0, m_xmax = 0, m_ymax = 0;
+
+		unsigned int m_gx = 0, m_gy = 0;
+		double m_sx = 0, m_sy = 0;
+		/// edges of cell c are m_cellStart[c] .. m_cellStart[c + 1]
+		std::vector<size_t > m_cellStart;
+		std::vector<double > m_cx0;
+		std::vector<double > m_cy0;
+		std::vector<double > m_cx1;
+		std::vector<double > m_cy1;
+		/// sign of the orientation of the edge and the cell reference
+		std::vector<double > m_side;
+		/// reference point of the cells, in the cell and on none of its edges
+		std::vector<double > m_refX;
+		std::vector<double > m_refY;
+		/// code of the references, 0 or 2
+		std::vector<unsigned char > m_cellCode;
+	};
+};
+
+#endif
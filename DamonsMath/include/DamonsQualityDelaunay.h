@@ -0,0 +1,404 @@
+//
+//  DamonsQualityDelaunay.h
+//  DPolygonTest
+//
+
+#ifndef DamonsQualityDelaunay_h
+#define DamonsQualityDelaunay_h
+
+#include "DamonsConstrainedDelaunay.h"
+
+/// quality triangulation by Delaunay refinement (Ruppert, Chew): points are
+/// added at the circumcenters of the bad triangles, and at the middle of the
+/// segments they would encroach, until every triangle has its smallest angle
+/// and its area within the bounds.
+template < class T = double>
+class DQualityDelaunay : public DConstrainedDelaunay<T>{
+public:
+    using typename DDelaunay<T>::DPoint2;
+protected:
+    using typename DDelaunay<T>::Face;
+    using DDelaunay<T>::Ghost;
+    using DDelaunay<T>::m_points;
+    using DDelaunay<T>::m_faces;
+    using DDelaunay<T>::m_fixed;
+    using DDelaunay<T>::m_start;
+    using DDelaunay<T>::m_mark;
+    using DDelaunay<T>::m_stamp;
+    using DDelaunay<T>::m_slots;
+    using DDelaunay<T>::m_boundary;
+
+    enum { FixedEdge = DConstrainedDelaunay<T>::FixedEdge };
+
+    /// a triangle to split, with its corners to know when it is gone
+    struct BadTriangle {
+        int face;
+        unsigned int v[3];
+    };
+    /// buckets of the bad triangles by quality
+    enum { BucketCount = 256 };
+    /// a constrained edge to split, forced when a circumcenter encroaches it
+    struct SubSegment {
+        unsigned int a;
+        unsigned int b;
+        bool forced;
+    };
+
+public:
+    DQualityDelaunay(){}
+    DQualityDelaunay(std::vector<DPoint2 > &points) : DConstrainedDelaunay<T>(points) {}
+
+    /// @brief constrained triangulation of the points, segments and rings, then Refine
+    void QualityTriangulate(double minAngle = 20.0, double maxArea = 0.0, size_t maxPoints = 0){
+        this->ConstrainedTriangulate();
+        Refine(minAngle, maxArea, maxPoints);
+    }
+
+    /// @brief Delaunay refinement of the current triangulation
+    ///
+    /// the constrained edges and the border of the triangulation are the
+    /// segments, the border edges are marked constrained by the refinement.
+    /// a segment is split when a point lies in its diametral circle, at its
+    /// middle, or at a power of two distance from its input end so the
+    /// splits around a small input angle stay on concentric circles. a bad
+    /// triangle is split at its circumcenter, found by a walk from the
+    /// triangle, unless the circumcenter encroaches a segment which is split
+    /// instead. the triangles are taken from a bucketed priority queue, the
+    /// worst first and the last queued first among equals, which keeps the
+    /// insertions next to each other. each insertion only looks at the
+    /// triangles it creates.
+    /// the skinny triangles made by two segments at a small input angle are
+    /// left as they are.
+    ///
+    /// @param minAngle smallest angle in degrees, refinement ends for sure
+    /// up to 20.7 and in practice up to about 33
+    /// @param maxArea largest triangle area, 0 for no bound
+    /// @param maxPoints most points to add, 0 for no bound
+    void Refine(double minAngle = 20.0, double maxArea = 0.0, size_t maxPoints = 0){
+        if(m_faces.empty())
+            return;
+        const double s = std::sin(minAngle * std::acos(-1.0) / 180.0);
+        m_ratio = minAngle > 0 ? 1.0 / (s * s) : std::numeric_limits<double >::max();
+        m_maxArea = maxArea;
+        m_inputCount = m_points.size();
+        m_origin.clear();
+        if(m_fixed.empty())
+            m_fixed.assign(m_faces.size(), 0);
+        m_start.assign(m_points.size(), -1);
+        m_mark.assign(m_faces.size(), 0);
+        for(size_t f = 0; f < m_faces.size(); ++f){
+            for(int k = 0; k < 3; ++k){
+                m_start[m_faces[f].v[k]] = static_cast<int >(f);
+                if(m_faces[f].n[k] < 0)
+                    this->SetEdgeFlags(static_cast<int >(f), k, this->EdgeFlags(static_cast<int >(f), k) | FixedEdge);
+            }
+        }
+
+        m_encroached.clear();
+        m_buckets.assign(BucketCount, std::vector<BadTriangle >());
+        m_top = -1;
+        for(size_t f = 0; f < m_faces.size(); ++f){
+            for(int k = 0; k < 3; ++k){
+                const int nb = m_faces[f].n[k];
+                if((nb < 0 || static_cast<int >(f) < nb) && (this->EdgeFlags(static_cast<int >(f), k) & FixedEdge) && Encroached(static_cast<int >(f), k))
+                    PushSegment(static_cast<int >(f), k, false);
+            }
+            Check(static_cast<int >(f));
+        }
+
+        size_t added = 0;
+        while(maxPoints == 0 || added < maxPoints){
+            if(!m_encroached.empty()){
+                const SubSegment segment = m_encroached.back();
+                m_encroached.pop_back();
+                if(SplitSegment(segment))
+                    ++added;
+                continue;
+            }
+            while(m_top >= 0 && m_buckets[m_top].empty())
+                --m_top;
+            if(m_top < 0)
+                break;
+            const BadTriangle bad = m_buckets[m_top].back();
+            m_buckets[m_top].pop_back();
+            const Face &face = m_faces[bad.face];
+            if(face.v[0] != bad.v[0] || face.v[1] != bad.v[1] || face.v[2] != bad.v[2])
+                continue;
+            if(SplitTriangle(bad.face))
+                ++added;
+        }
+
+        m_encroached.clear();
+        std::vector<std::vector<BadTriangle > >().swap(m_buckets);
+        std::vector<std::pair<unsigned int, unsigned int > >().swap(m_origin);
+        std::vector<unsigned int >().swap(m_mark);
+        std::vector<int >().swap(m_start);
+    }
+
+protected:
+    /// @brief true when p is strictly in the diametral circle of a b
+    static bool Encroaches(const DPoint2 &a, const DPoint2 &b, const DPoint2 &p){
+        return (double(a.x()) - p.x()) * (double(b.x()) - p.x()) + (double(a.y()) - p.y()) * (double(b.y()) - p.y()) < 0;
+    }
+
+    /// @brief true when the apex of a triangle of the edge opposite to corner k encroaches it
+    bool Encroached(int f, int k) const {
+        const Face &face = m_faces[f];
+        const unsigned int a = face.v[(k + 1) % 3], b = face.v[(k + 2) % 3];
+        if(Encroaches(m_points[a], m_points[b], m_points[face.v[k]]))
+            return true;
+        const int nb = face.n[k];
+        if(nb < 0)
+            return false;
+        const Face &other = m_faces[nb];
+        for(int j = 0; j < 3; ++j){
+            if(other.v[j] != a && other.v[j] != b)
+                return Encroaches(m_points[a], m_points[b], m_points[other.v[j]]);
+        }
+        return false;
+    }
+
+    void PushSegment(int f, int k, bool forced){
+        SubSegment segment = { m_faces[f].v[(k + 1) % 3], m_faces[f].v[(k + 2) % 3], forced };
+        m_encroached.push_back(segment);
+    }
+
+    /// @brief the edge a b, by a turn around a both ways since the border stops it
+    bool FindEdge(unsigned int a, unsigned int b, int &f, int &k) const {
+        const int first = m_start[a];
+        for(int way = 1; way < 3; ++way){
+            int t = first;
+            for(size_t turn = 0; t >= 0 && turn < m_faces.size(); ++turn){
+                const Face &face = m_faces[t];
+                const int i = face.v[0] == a ? 0 : (face.v[1] == a ? 1 : 2);
+                if(face.v[(i + 1) % 3] == b || face.v[(i + 2) % 3] == b){
+                    f = t;
+                    k = face.v[(i + 1) % 3] == b ? (i + 2) % 3 : (i + 1) % 3;
+                    return true;
+                }
+                t = face.n[(i + way) % 3];
+                if(t == first)
+                    break;
+            }
+        }
+        return false;
+    }
+
+    /// @brief the input segment a piece of segment comes from
+    std::pair<unsigned int, unsigned int > Origin(unsigned int a, unsigned int b) const {
+        if(a >= m_inputCount && m_origin[a - m_inputCount].first != Ghost)
+            return m_origin[a - m_inputCount];
+        if(b >= m_inputCount && m_origin[b - m_inputCount].first != Ghost)
+            return m_origin[b - m_inputCount];
+        return std::make_pair(a, b);
+    }
+
+    /// @brief where to split a segment, false when it is too short for it
+    bool SplitPoint(unsigned int a, unsigned int b, DPoint2 &p) const {
+        const DPoint2 &pa = m_points[a], &pb = m_points[b];
+        const double dx = double(pb.x()) - pa.x(), dy = double(pb.y()) - pa.y();
+        double t = 0.5;
+        if((a < m_inputCount) != (b < m_inputCount)){
+            // concentric shells around the input end
+            const double length = std::sqrt(dx * dx + dy * dy);
+            t = std::pow(2.0, std::floor(std::log2(length / 2) + 0.5)) / length;
+            if(b < m_inputCount)
+                t = 1 - t;
+        }
+        p = DPoint2(T(pa.x() + t * dx), T(pa.y() + t * dy));
+        return !(p == pa) && !(p == pb);
+    }
+
+    bool SplitSegment(const SubSegment &segment){
+        int f = -1, k = 0;
+        if(!FindEdge(segment.a, segment.b, f, k) || !(this->EdgeFlags(f, k) & FixedEdge))
+            return false;
+        if(!segment.forced && !Encroached(f, k))
+            return false;
+        DPoint2 p;
+        if(!SplitPoint(segment.a, segment.b, p))
+            return false;
+        const unsigned int x = AddVertex(p, Origin(segment.a, segment.b));
+        this->InsertPoint(x, f, f, k);
+        Inserted();
+        return true;
+    }
+
+    bool SplitTriangle(int f){
+        const Face &face = m_faces[f];
+        const DPoint2 &p0 = m_points[face.v[0]], &p1 = m_points[face.v[1]], &p2 = m_points[face.v[2]];
+        const double bx = double(p1.x()) - p0.x(), by = double(p1.y()) - p0.y();
+        const double cx = double(p2.x()) - p0.x(), cy = double(p2.y()) - p0.y();
+        const double d = 2 * (bx * cy - by * cx);
+        const double b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+        const DPoint2 c(T(p0.x() + (cy * b2 - by * c2) / d), T(p0.y() + (bx * c2 - cx * b2) / d));
+
+        int blocked = -1, corner = 0;
+        const int t = WalkTo(c, f, blocked, corner);
+        if(t < 0){
+            // the circumcenter is behind a segment, which is split instead
+            if(blocked < 0)
+                return false;
+            SubSegment segment = { m_faces[blocked].v[(corner + 1) % 3], m_faces[blocked].v[(corner + 2) % 3], true };
+            if(!SplitSegment(segment))
+                return false;
+            Check(f);
+            return true;
+        }
+        if(Reject(c, t)){
+            Check(f);
+            return false;
+        }
+        const unsigned int x = AddVertex(c, std::make_pair(Ghost, Ghost));
+        this->InsertPoint(x, t);
+        if(m_start[x] < 0){
+            m_points.pop_back();
+            m_start.pop_back();
+            m_origin.pop_back();
+            return false;
+        }
+        Inserted();
+        return true;
+    }
+
+    /// @brief triangle holding p by a walk from f, -1 when a segment is in the way
+    int WalkTo(const DPoint2 &p, int f, int &blocked, int &corner) const {
+        int t = f, previous = -1;
+        blocked = -1;
+        for(size_t steps = 0; steps < m_faces.size(); ++steps){
+            const Face &face = m_faces[t];
+            int k = -1;
+            for(int j = 0; j < 3; ++j){
+                if(face.n[j] != previous && this->Orient(m_points[face.v[(j + 1) % 3]], m_points[face.v[(j + 2) % 3]], p) < 0){
+                    k = j;
+                    break;
+                }
+            }
+            if(k < 0)
+                return t;
+            if(this->EdgeFlags(t, k) & FixedEdge){
+                blocked = t;
+                corner = k;
+                return -1;
+            }
+            previous = t;
+            t = face.n[k];
+        }
+        return -1;
+    }
+
+    /// @brief true when p encroaches a segment of its cavity, the segments are queued
+    bool Reject(const DPoint2 &p, int t){
+        m_stamp += 2;
+        const unsigned int inside = m_stamp;
+        m_mark.resize(m_faces.size(), 0);
+        m_visit.clear();
+        m_visit.push_back(t);
+        m_mark[t] = inside;
+        bool rejected = false;
+        for(size_t i = 0; i < m_visit.size(); ++i){
+            const int cf = m_visit[i];
+            for(int k = 0; k < 3; ++k){
+                const Face &face = m_faces[cf];
+                if(this->EdgeFlags(cf, k) & FixedEdge){
+                    const unsigned int a = face.v[(k + 1) % 3], b = face.v[(k + 2) % 3];
+                    DPoint2 split;
+                    if(Encroaches(m_points[a], m_points[b], p) && SplitPoint(a, b, split)){
+                        PushSegment(cf, k, true);
+                        rejected = true;
+                    }
+                    continue;
+                }
+                const int nb = face.n[k];
+                if(nb >= 0 && m_mark[nb] != inside && this->Conflict(nb, p)){
+                    m_mark[nb] = inside;
+                    m_visit.push_back(nb);
+                }
+            }
+        }
+        return rejected;
+    }
+
+    unsigned int AddVertex(const DPoint2 &p, const std::pair<unsigned int, unsigned int > &origin){
+        m_points.push_back(p);
+        m_start.push_back(-1);
+        m_origin.push_back(origin);
+        return static_cast<unsigned int >(m_points.size() - 1);
+    }
+
+    /// @brief queue the new triangles of the last insertion and the segments they encroach
+    void Inserted(){
+        for(size_t i = 0; i < m_boundary.size(); ++i){
+            const int s = m_slots[i];
+            Check(s);
+            for(int k = 0; k < 3; ++k){
+                if((this->EdgeFlags(s, k) & FixedEdge) && Encroached(s, k))
+                    PushSegment(s, k, false);
+            }
+        }
+    }
+
+    /// @brief true when u w lie at the same distance on two segments from
+    /// their common end: the triangle comes from a small input angle
+    bool InputAngle(unsigned int u, unsigned int w) const {
+        if(u < m_inputCount || w < m_inputCount)
+            return false;
+        const std::pair<unsigned int, unsigned int > &ou = m_origin[u - m_inputCount], &ow = m_origin[w - m_inputCount];
+        if(ou.first == Ghost || ow.first == Ghost || ou == ow)
+            return false;
+        unsigned int j = Ghost;
+        if(ou.first == ow.first || ou.first == ow.second)
+            j = ou.first;
+        else if(ou.second == ow.first || ou.second == ow.second)
+            j = ou.second;
+        if(j == Ghost)
+            return false;
+        const DPoint2 du = m_points[u] - m_points[j], dw = m_points[w] - m_points[j];
+        const double lu = double(du.x()) * du.x() + double(du.y()) * du.y();
+        const double lw = double(dw.x()) * dw.x() + double(dw.y()) * dw.y();
+        return std::fabs(lu - lw) <= 1e-6 * (lu + lw);
+    }
+
+    /// @brief queue a triangle when its smallest angle or its area is out of bounds
+    void Check(int f){
+        const Face &face = m_faces[f];
+        double length[3];
+        for(int k = 0; k < 3; ++k){
+            const DPoint2 e = m_points[face.v[(k + 2) % 3]] - m_points[face.v[(k + 1) % 3]];
+            length[k] = double(e.x()) * e.x() + double(e.y()) * e.y();
+        }
+        const double area2 = this->Orient(m_points[face.v[0]], m_points[face.v[1]], m_points[face.v[2]]);
+        if(area2 <= 0)
+            return;
+        const int shortest = length[0] < length[1] ? (length[0] < length[2] ? 0 : 2) : (length[1] < length[2] ? 1 : 2);
+        // circumradius over shortest edge, squared, times 4
+        const double ratio = length[(shortest + 1) % 3] * length[(shortest + 2) % 3] / (area2 * area2);
+        const bool large = m_maxArea > 0 && area2 > 2 * m_maxArea;
+        if(!large && (ratio <= m_ratio || InputAngle(face.v[(shortest + 1) % 3], face.v[(shortest + 2) % 3])))
+            return;
+        BadTriangle bad;
+        bad.face = f;
+        for(int k = 0; k < 3; ++k)
+            bad.v[k] = face.v[k];
+        // four buckets per power of two of the ratio
+        int exponent = 0;
+        const double mantissa = std::frexp(ratio, &exponent);
+        const int bucket = std::max(0, std::min(int(BucketCount) - 1, 4 * exponent + int((mantissa - 0.5) * 8)));
+        m_buckets[bucket].push_back(bad);
+        m_top = std::max(m_top, bucket);
+    }
+
+protected:
+    double m_ratio = 0;
+    double m_maxArea = 0;
+    /// points before the refinement
+    size_t m_inputCount = 0;
+    /// input segment of every added point on a segment, Ghost for the circumcenters
+    std::vector<std::pair<unsigned int, unsigned int > > m_origin;
+    std::vector<SubSegment > m_encroached;
+    std::vector<std::vector<BadTriangle > > m_buckets;
+    /// highest bucket which may not be empty
+    int m_top = -1;
+    std::vector<int > m_visit;
+};
+#endif /* DamonsQualityDelaunay_h */
@@ -0,0 +1,484 @@
+#ifndef _DAMONS_REGISTRATION_H_
+#define _DAMONS_REGISTRATION_H_
+
+#include "DamonsKdTree.h"
+#include "DamonsSpatialGrid.h"
+#include "DamonsEigen.h"
+#include "DamonsQuaternion.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace DGraphic {
+
+	/// class DICPRegistration
+	/// @breif rigid registration of a point cloud onto a point cloud or a triangle mesh
+	///
+	/// iterative closest point, point to point or point to plane. at every
+	/// iteration a subset of the source points is moved by the current
+	/// transform and matched in parallel to the closest target point (k-d
+	/// tree) or the closest point on the target triangles (spatial grid of the
+	/// triangle bounds). pairs farther than the distance threshold or whose
+	/// normals differ by more than the angle threshold are rejected, and the
+	/// increment is solved in closed form: Horn's quaternion method for point
+	/// to point, the linearized 6x6 normal equations for point to plane.
+	///
+	/// the per thread sums are reduced at the end of the matching pass, no
+	/// correspondence list is stored.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DICPRegistration
+	{
+	public:
+		enum ICPMethod { ICP_POINT_TO_POINT, ICP_POINT_TO_PLANE };
+
+		/// registration settings
+		struct Parameters {
+			ICPMethod method;
+			// iteration limit
+			unsigned int maxIterations;
+			// pairs farther than this are rejected
+			T maxDistance;
+			// pairs whose normals differ more than this (radians) are rejected, 0 disables, needs source normals
+			T maxNormalAngle;
+			// source points matched per iteration (evenly strided, the same at every iteration), 0 uses all of them
+			size_t sampleCount;
+			// stop when the increment rotation (radians) and translation (relative to the source size) are below this
+			double tolerance;
+
+			Parameters() : method(ICP_POINT_TO_POINT), maxIterations(50), maxDistance(std::numeric_limits<T>::max()),
+				maxNormalAngle(0), sampleCount(50000), tolerance(1.0e-5) {
+			}
+		};
+
+	public:
+		DICPRegistration() : m_xyz(nullptr), m_normals(nullptr), m_tree(nullptr) {
+		}
+		~DICPRegistration() {
+		}
+
+	public:
+		/// @brief register onto a point cloud
+		///
+		/// @param xyz target coordinates, 3 per point
+		/// @param normals target normals, needed for point to plane, may be null
+		/// @param tree k-d tree built over the target points
+		void SetTarget(const T *xyz, const T *normals, const DKdTree<T> &tree) {
+			m_xyz = xyz;
+			m_normals = normals;
+			m_tree = &tree;
+			m_points.clear();
+			m_triangles.clear();
+			m_faceNormals.clear();
+			m_grid.reset();
+		}
+
+		/// @brief register onto a triangle mesh
+		///
+		/// the triangles are indexed by a spatial grid with cells of about two
+		/// mean edge lengths, coarser if needed to keep the grid unhashed.
+		///
+		/// @param points mesh vertices
+		/// @param triangles vertex indices, 3 per triangle
+		void SetTarget(const std::vector< DPoint<T> > &points, const std::vector<unsigned int > &triangles) {
+			m_xyz = nullptr;
+			m_normals = nullptr;
+			m_tree = nullptr;
+			m_points = points;
+			m_triangles = triangles;
+
+			const size_t nt = triangles.size() / 3;
+			m_faceNormals.resize(3 * nt);
+			std::vector<double > edges(nt, 0.0);
+			ParallelFor(0, nt, [&](size_t t) {
+				const DPoint<T> &a = points[triangles[3 * t]], &b = points[triangles[3 * t + 1]], &c = points[triangles[3 * t + 2]];
+				const T u[3] = { b.x() - a.x(), b.y() - a.y(), b.z() - a.z() };
+				const T v[3] = { c.x() - a.x(), c.y() - a.y(), c.z() - a.z() };
+				T nrm[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+				const T len = std::sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+				for (int a = 0; a < 3; ++a)
+					m_faceNormals[3 * t + a] = len > 0 ? nrm[a] / len : T(0);
+				edges[t] = std::sqrt(double(u[0] * u[0] + u[1] * u[1] + u[2] * u[2])) + std::sqrt(double(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]));
+			}, 4096);
+
+			DBox<T> box;
+			for (const auto &p : points)
+				box.ExtendBox(p);
+			double meanEdge = 0;
+			for (double e : edges)
+				meanEdge += e;
+			meanEdge = nt ? meanEdge / (2 * nt) : 1.0;
+			double volume = 1;
+			for (int a = 0; a < 3; ++a)
+				volume *= std::max(double(box.GetMax(a) - box.GetMin(a)), meanEdge);
+			const double cellSize = std::max(2 * meanEdge, std::cbrt(volume / double(1 << 20)));
+
+			m_grid.reset(new DSpatialGrid<T>(box, static_cast<T>(cellSize > 0 ? cellSize : 1.0)));
+			m_grid->BuildFromTriangles(m_points, m_triangles);
+		}
+
+		/// @brief align a source cloud onto the target
+		///
+		/// @param xyz source coordinates, 3 per point
+		/// @param n number of source points
+		/// @param normals source normals for the angle rejection, may be null
+		/// @param params settings
+		/// @param transform initial guess as input, source to target transform as return
+		/// @param rms rms distance of the accepted pairs at every iteration as return, may be null
+		/// @return false when too few pairs were found to solve
+		bool Align(const T *xyz, size_t n, const T *normals, const Parameters &params, DMatrix<double, 4, 4> &transform, std::vector<double > *rms = nullptr) const {
+			if (rms)
+				rms->clear();
+			if (n == 0 || (!m_tree && m_triangles.empty()))
+				return false;
+			const bool toPlane = params.method == ICP_POINT_TO_PLANE;
+			if (toPlane && m_tree && !m_normals)
+				return false;
+
+			const size_t samples = (params.sampleCount == 0 || params.sampleCount >= n) ? n : params.sampleCount;
+			const size_t stride = n / samples;
+			const double maxD2 = params.maxDistance < std::numeric_limits<T>::max() ? double(params.maxDistance) * params.maxDistance : std::numeric_limits<double>::max();
+			const double minCos = (params.maxNormalAngle > 0 && normals) ? std::cos(double(params.maxNormalAngle)) : -1.0;
+
+			// source coordinates are centered for accuracy
+			double center[3] = { 0, 0, 0 };
+			for (size_t s = 0; s < samples; ++s) {
+				for (int a = 0; a < 3; ++a)
+					center[a] += xyz[3 * s * stride + a];
+			}
+			for (int a = 0; a < 3; ++a)
+				center[a] /= samples;
+			double size = 0;
+			for (size_t s = 0; s < samples; ++s) {
+				for (int a = 0; a < 3; ++a)
+					size += (xyz[3 * s * stride + a] - center[a]) * (xyz[3 * s * stride + a] - center[a]);
+			}
+			size = std::sqrt(size / samples);
+			const unsigned int nthreads = ParallelThreadCount();
+			std::vector<Sums > sums(nthreads);
+			std::vector< std::vector<unsigned int > > buffers(nthreads);
+
+			for (unsigned int it = 0; it < params.maxIterations; ++it) {
+				double R[3][3], t[3];
+				for (int r = 0; r < 3; ++r) {
+					for (int c = 0; c < 3; ++c)
+						R[r][c] = transform(r, c);
+					t[r] = transform(r, 3);
+				}
+				for (auto &s : sums)
+					s = Sums();
+
+				ParallelForRange(0, samples, [&](size_t b, size_t e, unsigned int tid) {
+					Sums &acc = sums[tid];
+					for (size_t s = b; s < e; ++s) {
+						const size_t i = s * stride;
+						const T *sp = &xyz[3 * i];
+						double p[3], q[3], qn[3];
+						for (int r = 0; r < 3; ++r)
+							p[r] = R[r][0] * sp[0] + R[r][1] * sp[1] + R[r][2] * sp[2] + t[r];
+						double d2;
+						if (!Closest(p, maxD2, q, qn, d2, buffers[tid]))
+							continue;
+						if (minCos > -1.0) {
+							const T *sn = &normals[3 * i];
+							double pn[3];
+							for (int r = 0; r < 3; ++r)
+								pn[r] = R[r][0] * sn[0] + R[r][1] * sn[1] + R[r][2] * sn[2];
+							// unoriented normals are accepted either way round
+							if (std::fabs(pn[0] * qn[0] + pn[1] * qn[1] + pn[2] * qn[2]) < minCos)
+								continue;
+						}
+						for (int r = 0; r < 3; ++r) {
+							p[r] -= center[r];
+							q[r] -= center[r];
+						}
+						acc.Add(p, q, qn, d2, toPlane);
+					}
+				}, 256);
+
+				Sums total;
+				for (const auto &s : sums)
+					total.Merge(s);
+				if (total.count < 6)
+					return false;
+
+				const double error = std::sqrt(total.d2 / total.count);
+				if (rms)
+					rms->push_back(error);
+
+				double dR[3][3], dt[3];
+				if (!(toPlane ? SolvePlane(total, dR, dt) : SolvePoint(total, dR, dt)))
+					return false;
+
+				// the increment acts on centered coordinates: x -> dR (x - c) + dt + c
+				double shift[3];
+				for (int r = 0; r < 3; ++r)
+					shift[r] = dt[r] + center[r] - (dR[r][0] * center[0] + dR[r][1] * center[1] + dR[r][2] * center[2]);
+				DMatrix<double, 4, 4> step = DMatrix<double, 4, 4>::Identity();
+				for (int r = 0; r < 3; ++r) {
+					for (int c = 0; c < 3; ++c)
+						step(r, c) = dR[r][c];
+					step(r, 3) = shift[r];
+				}
+				transform = step * transform;
+
+				const double angle = std::acos(std::min(1.0, std::max(-1.0, 0.5 * (dR[0][0] + dR[1][1] + dR[2][2] - 1.0))));
+				if (angle <= params.tolerance && std::sqrt(dt[0] * dt[0] + dt[1] * dt[1] + dt[2] * dt[2]) <= params.tolerance * size)
+					break;
+			}
+			return true;
+		}
+
+	protected:
+		/// per thread sums of the accepted pairs
+		struct Sums {
+			size_t count;
+			double d2;
+			// point to point: sums of p, q and p q^T
+			double sp[3], sq[3], pq[3][3];
+			// point to plane: upper triangle of A^T A and A^T b
+			double ata[21], atb[6];
+
+			Sums() : count(0), d2(0) {
+				std::fill(sp, sp + 3, 0.0);
+				std::fill(sq, sq + 3, 0.0);
+				std::fill(&pq[0][0], &pq[0][0] + 9, 0.0);
+				std::fill(ata, ata + 21, 0.0);
+				std::fill(atb, atb + 6, 0.0);
+			}
+
+			void Add(const double *p, const double *q, const double *n, double dist2, bool toPlane) {
+				++count;
+				d2 += dist2;
+				if (toPlane) {
+					// residual (p - q).n linearized in (rotation vector, translation)
+					const double a[6] = { p[1] * n[2] - p[2] * n[1], p[2] * n[0] - p[0] * n[2], p[0] * n[1] - p[1] * n[0], n[0], n[1], n[2] };
+					const double b = (q[0] - p[0]) * n[0] + (q[1] - p[1]) * n[1] + (q[2] - p[2]) * n[2];
+					int k = 0;
+					for (int r = 0; r < 6; ++r) {
+						for (int c = r; c < 6; ++c)
+							ata[k++] += a[r] * a[c];
+						atb[r] += a[r] * b;
+					}
+				}
+				else {
+					for (int r = 0; r < 3; ++r) {
+						sp[r] += p[r];
+						sq[r] += q[r];
+						for (int c = 0; c < 3; ++c)
+							pq[r][c] += p[r] * q[c];
+					}
+				}
+			}
+
+			void Merge(const Sums &o) {
+				count += o.count;
+				d2 += o.d2;
+				for (int r = 0; r < 3; ++r) {
+					sp[r] += o.sp[r];
+					sq[r] += o.sq[r];
+					for (int c = 0; c < 3; ++c)
+						pq[r][c] += o.pq[r][c];
+				}
+				for (int k = 0; k < 21; ++k)
+					ata[k] += o.ata[k];
+				for (int k = 0; k < 6; ++k)
+					atb[k] += o.atb[k];
+			}
+		};
+
+		/// @brief closest target point and its normal
+		bool Closest(const double *p, double maxD2, double *q, double *qn, double &d2, std::vector<unsigned int > &buffer) const {
+			if (m_tree) {
+				const T query[3] = { static_cast<T>(p[0]), static_cast<T>(p[1]), static_cast<T>(p[2]) };
+				unsigned int id;
+				T dist2;
+				if (m_tree->KnnSearch(query, 1, &id, &dist2) == 0 || dist2 > maxD2)
+					return false;
+				d2 = dist2;
+				for (int a = 0; a < 3; ++a) {
+					q[a] = m_xyz[3 * id + a];
+					qn[a] = m_normals ? m_normals[3 * id + a] : 0.0;
+				}
+				return true;
+			}
+
+			// grow the search from half a cell, a hit closer than the radius is final
+			const double maxDist = maxD2 < std::numeric_limits<double>::max() ? std::sqrt(maxD2) : std::numeric_limits<double>::max();
+			const DPoint<T> query(static_cast<T>(p[0]), static_cast<T>(p[1]), static_cast<T>(p[2]));
+			double r = std::min(0.5 * m_grid->GetCellSize(), maxDist);
+			bool found = false;
+			for (;;) {
+				buffer.clear();
+				m_grid->RadiusSearch(query, static_cast<T>(r), buffer);
+				d2 = r * r;
+				for (unsigned int tri : buffer) {
+					double c[3];
+					ClosestOnTriangle(p, tri, c);
+					const double dd = (c[0] - p[0]) * (c[0] - p[0]) + (c[1] - p[1]) * (c[1] - p[1]) + (c[2] - p[2]) * (c[2] - p[2]);
+					if (dd <= d2) {
+						d2 = dd;
+						found = true;
+						for (int a = 0; a < 3; ++a) {
+							q[a] = c[a];
+							qn[a] = m_faceNormals[3 * tri + a];
+						}
+					}
+				}
+				if (found || r >= maxDist)
+					break;
+				r = std::min(2 * r, maxDist);
+			}
+			return found;
+		}
+
+		/// @brief closest point of a target triangle (Voronoi regions of the triangle)
+		void ClosestOnTriangle(const double *p, unsigned int tri, double *out) const {
+			const DPoint<T> &A = m_points[m_triangles[3 * tri]], &B = m_points[m_triangles[3 * tri + 1]], &C = m_points[m_triangles[3 * tri + 2]];
+			const double a[3] = { A.x(), A.y(), A.z() }, b[3] = { B.x(), B.y(), B.z() }, c[3] = { C.x(), C.y(), C.z() };
+			double ab[3], ac[3], ap[3];
+			for (int k = 0; k < 3; ++k) {
+				ab[k] = b[k] - a[k];
+				ac[k] = c[k] - a[k];
+				ap[k] = p[k] - a[k];
+			}
+			auto dot = [](const double *u, const double *v) { return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]; };
+			auto set = [out](const double *base, const double *u, double s, const double *v, double w) {
+				for (int k = 0; k < 3; ++k)
+					out[k] = base[k] + s * u[k] + w * v[k];
+			};
+
+			const double d1 = dot(ab, ap), d2 = dot(ac, ap);
+			if (d1 <= 0 && d2 <= 0) { set(a, ab, 0, ac, 0); return; }
+			double bp[3];
+			for (int k = 0; k < 3; ++k)
+				bp[k] = p[k] - b[k];
+			const double d3 = dot(ab, bp), d4 = dot(ac, bp);
+			if (d3 >= 0 && d4 <= d3) { set(b, ab, 0, ac, 0); return; }
+			const double vc = d1 * d4 - d3 * d2;
+			if (vc <= 0 && d1 >= 0 && d3 <= 0) { set(a, ab, d1 / (d1 - d3), ac, 0); return; }
+			double cp[3];
+			for (int k = 0; k < 3; ++k)
+				cp[k] = p[k] - c[k];
+			const double d5 = dot(ab, cp), d6 = dot(ac, cp);
+			if (d6 >= 0 && d5 <= d6) { set(c, ab, 0, ac, 0); return; }
+			const double vb = d5 * d2 - d1 * d6;
+			if (vb <= 0 && d2 >= 0 && d6 <= 0) { set(a, ab, 0, ac, d2 / (d2 - d6)); return; }
+			const double va = d3 * d6 - d5 * d4;
+			if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+				const double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+				for (int k = 0; k < 3; ++k)
+					out[k] = b[k] + w * (c[k] - b[k]);
+				return;
+			}
+			const double denom = 1.0 / (va + vb + vc);
+			set(a, ab, vb * denom, ac, vc * denom);
+		}
+
+		/// @brief point to point increment, Horn's closed form quaternion
+		static bool SolvePoint(const Sums &s, double R[3][3], double t[3]) {
+			const double inv = 1.0 / s.count;
+			double mp[3], mq[3], S[3][3];
+			for (int r = 0; r < 3; ++r) {
+				mp[r] = s.sp[r] * inv;
+				mq[r] = s.sq[r] * inv;
+			}
+			for (int r = 0; r < 3; ++r)
+				for (int c = 0; c < 3; ++c)
+					S[r][c] = s.pq[r][c] - s.count * mp[r] * mq[c];
+
+			const double sxx = S[0][0], sxy = S[0][1], sxz = S[0][2];
+			const double syx = S[1][0], syy = S[1][1], syz = S[1][2];
+			const double szx = S[2][0], szy = S[2][1], szz = S[2][2];
+			DMatrix<double, 4, 4> N;
+			N(0, 0) = sxx + syy + szz; N(0, 1) = syz - szy;       N(0, 2) = szx - sxz;       N(0, 3) = sxy - syx;
+			N(1, 1) = sxx - syy - szz; N(1, 2) = sxy + syx;       N(1, 3) = szx + sxz;
+			N(2, 2) = -sxx + syy - szz; N(2, 3) = syz + szy;
+			N(3, 3) = -sxx - syy + szz;
+
+			DVector<double, 4> values;
+			DMatrix<double, 4, 4> vectors;
+			DMath::SymmetricEigen<double, 4>(N, values, vectors);
+			DQuaternion<double> quat(vectors(0, 3), vectors(1, 3), vectors(2, 3), vectors(3, 3));
+			quat.Normalize();
+			QuaternionToRotation(quat, R);
+
+			for (int r = 0; r < 3; ++r)
+				t[r] = mq[r] - (R[r][0] * mp[0] + R[r][1] * mp[1] + R[r][2] * mp[2]);
+			return true;
+		}
+
+		/// @brief point to plane increment, linearized normal equations solved by Cholesky
+		static bool SolvePlane(const Sums &s, double R[3][3], double t[3]) {
+			double A[6][6], x[6];
+			int k = 0;
+			for (int r = 0; r < 6; ++r) {
+				for (int c = r; c < 6; ++c)
+					A[r][c] = A[c][r] = s.ata[k++];
+				x[r] = s.atb[r];
+			}
+
+			// L L^T in place (lower triangle)
+			for (int j = 0; j < 6; ++j) {
+				double d = A[j][j];
+				for (int m = 0; m < j; ++m)
+					d -= A[j][m] * A[j][m];
+				if (d <= 1.0e-12 * std::max(1.0, std::fabs(A[j][j])))
+					return false;
+				A[j][j] = std::sqrt(d);
+				for (int i = j + 1; i < 6; ++i) {
+					double v = A[i][j];
+					for (int m = 0; m < j; ++m)
+						v -= A[i][m] * A[j][m];
+					A[i][j] = v / A[j][j];
+				}
+			}
+			for (int i = 0; i < 6; ++i) {
+				for (int m = 0; m < i; ++m)
+					x[i] -= A[i][m] * x[m];
+				x[i] /= A[i][i];
+			}
+			for (int i = 5; i >= 0; --i) {
+				for (int m = i + 1; m < 6; ++m)
+					x[i] -= A[m][i] * x[m];
+				x[i] /= A[i][i];
+			}
+
+			// exact rotation for the solved rotation vector
+			const double angle = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+			DQuaternion<double> quat(1.0, 0.0, 0.0, 0.0);
+			if (angle > 0) {
+				const double h = std::sin(0.5 * angle) / angle;
+				quat = DQuaternion<double>(std::cos(0.5 * angle), x[0] * h, x[1] * h, x[2] * h);
+			}
+			QuaternionToRotation(quat, R);
+			t[0] = x[3];
+			t[1] = x[4];
+			t[2] = x[5];
+			return true;
+		}
+
+		static void QuaternionToRotation(const DQuaternion<double> &quat, double R[3][3]) {
+			const DMatrix<double, 3> m = quat.ToMatrix();
+			for (int r = 0; r < 3; ++r)
+				for (int c = 0; c < 3; ++c)
+					R[r][c] = m(r, c);
+		}
+
+	protected:
+		// point cloud target
+		const T *m_xyz;
+		const T *m_normals;
+		const DKdTree<T> *m_tree;
+		// mesh target
+		std::vector< DPoint<T> > m_points;
+		std::vector<unsigned int > m_triangles;
+		std::vector<T > m_faceNormals;
+		std::unique_ptr< DSpatialGrid<T> > m_grid;
+	};
+};
+#endif
@@ -0,0 +1,568 @@
+#ifndef _DAMONS_SEGMENT_INTERSECTOR_H_
+#define _DAMONS_SEGMENT_INTERSECTOR_H_
+
+#include "DamonsVector.h"
+#include "DamonsSegment.h"
+#include "DamonsPredicates.h"
+#include <vector>
+#include <queue>
+#include <unordered_set>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+namespace DGraphic {
+
+	/// class DSegmentIntersector
+	/// @breif intersections of a set of segments in the plane by a sweep line
+	///
+	/// Bentley-Ottmann: a line sweeps the end points and the crossings from
+	/// left to right (then bottom to top), the segments it cuts are kept in
+	/// order in a treap and only the neighbors in that order are tested, so
+	/// all the k intersecting pairs of n segments are found in
+	/// O((n + k) log n). a crossing only reorders the segments through it in
+	/// the treap, the order is never computed from the rounded crossing
+	/// points: the segments are compared with the exact Orient2D on their
+	/// end points.
+	///
+	/// stopped at the first crossing, the same sweep is the Shamos-Hoey test,
+	/// which is exact and O(n log n).
+	///
+	/// only the xy of the segments is used, the zero length segments are ignored.
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DSegmentIntersector
+	{
+	public:
+		typedef DVector<double, 2> SweepPoint;
+
+		/// how two segments meet, the codes of DPolygon::IsSegmentIntersect
+		enum IntersectType { IntersectNone = 0, IntersectEnd = 1, IntersectOverlap = 2, IntersectCross = 3 };
+
+		/// a pair of intersecting segments
+		struct Intersection {
+			/// the segments, first < second
+			unsigned int first;
+			unsigned int second;
+			/// IntersectEnd, IntersectOverlap or IntersectCross
+			int type;
+			/// the crossing point, the end point on the other segment, or the start of the overlap
+			SweepPoint point;
+		};
+
+		DSegmentIntersector() {}
+		~DSegmentIntersector() {
+		}
+
+	public:
+		/// @brief add a segment
+		/// @return unsigned int its index in the intersections
+		unsigned int AddSegment(const DVector<T, 2> &a, const DVector<T, 2> &b) {
+			Segment s;
+			s.p = SweepPoint(double(a[0]), double(a[1]));
+			s.q = SweepPoint(double(b[0]), double(b[1]));
+			if (Before(s.q, s.p))
+				std::swap(s.p, s.q);
+			m_segments.push_back(s);
+			return static_cast<unsigned int >(m_segments.size() - 1);
+		}
+		/// @brief add a segment, its z is ignored
+		/// @return unsigned int its index in the intersections
+		unsigned int AddSegment(const DSegment<T> &segment) {
+			return AddSegment(DVector<T, 2>(segment[0][0], segment[0][1]), DVector<T, 2>(segment[1][0], segment[1][1]));
+		}
+		/// @brief remove all the segments
+		void Clear() { m_segments.clear(); }
+		/// @brief number of segments
+		size_t GetSegmentCount() const { return m_segments.size(); }
+
+		/// @brief all the pairs of intersecting segments
+		///
+		/// @param result as return, in the order the sweep meets them
+		/// @param sharedEnds report the pairs only meeting at a common end point
+		///  too, such as the consecutive edges of a polyline
+		/// @return size_t number of pairs
+		size_t FindIntersections(std::vector<Intersection > &result, bool sharedEnds = false) {
+			result.clear();
+			Sweep(&result, sharedEnds);
+			return result.size();
+		}
+
+		/// @brief true when two segments cross or overlap, an end point on
+		/// another segment does not count
+		bool HasCrossing() {
+			return Sweep(nullptr, false);
+		}
+
+	protected:
+		/// a segment, p comes before q in the sweep
+		struct Segment {
+			SweepPoint p;
+			SweepPoint q;
+		};
+
+		/// relative error of the areas a crossing point is made of, 2^-44
+		static constexpr double AreaPrecision = 5.684341886080802e-14;
+
+		/// at one point the ends are done first, then the crossings, then the starts
+		enum { EndEvent = 0, CrossEvent = 1, StartEvent = 2 };
+
+		struct Event {
+			SweepPoint point;
+			int kind;
+			/// the segment, or the lower segment of a crossing
+			unsigned int a;
+			/// the upper segment of a crossing
+			unsigned int b;
+		};
+
+		struct Later {
+			bool operator()(const Event &e, const Event &f) const {
+				if (e.point[0] != f.point[0])
+					return e.point[0] > f.point[0];
+				if (e.point[1] != f.point[1])
+					return e.point[1] > f.point[1];
+				return e.kind > f.kind;
+			}
+		};
+
+		/// a treap node, the segments are in sweep order from bottom to top
+		struct Node {
+			int left;
+			int right;
+			int parent;
+			uint32_t priority;
+			unsigned int segment;
+		};
+
+		/// @brief run the sweep
+		/// @param result where to report the pairs, nullptr to stop at the first crossing
+		/// @return true when stopped at a crossing
+		bool Sweep(std::vector<Intersection > *result, bool sharedEnds) {
+			const unsigned int count = static_cast<unsigned int >(m_segments.size());
+			m_result = result;
+			m_sharedEnds = sharedEnds;
+			m_found = false;
+			m_nodes.resize(count);
+			m_nodeOf.assign(count, -1);
+			m_free.resize(count);
+			for (unsigned int i = 0; i < count; ++i)
+				m_free[i] = count - 1 - i;
+			m_root = -1;
+			m_seed = 2463534242u;
+			m_reported.clear();
+			m_events = std::priority_queue<Event, std::vector<Event >, Later >();
+
+			// the end points are sorted once, only the crossings go through the heap
+			std::vector<Event > points;
+			points.reserve(2 * count);
+			for (unsigned int i = 0; i < count; ++i) {
+				const Segment &s = m_segments[i];
+				if (s.p == s.q)
+					continue;
+				Event start = { s.p, StartEvent, i, i };
+				Event end = { s.q, EndEvent, i, i };
+				points.push_back(start);
+				points.push_back(end);
+			}
+			std::sort(points.begin(), points.end(), [](const Event &e, const Event &f) { return Later()(f, e); });
+
+			std::vector<unsigned int > ended;
+			m_current = SweepPoint(-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max());
+			size_t next = 0;
+			while ((next < points.size() || !m_events.empty()) && !m_found) {
+				Event e;
+				if (m_events.empty() || (next < points.size() && !Later()(points[next], m_events.top())))
+					e = points[next++];
+				else {
+					e = m_events.top();
+					m_events.pop();
+				}
+				if (e.point != m_current) {
+					m_current = e.point;
+					ended.clear();
+				}
+				switch (e.kind) {
+				case EndEvent:
+					Remove(e.a);
+					if (m_sharedEnds)
+						ended.push_back(e.a);
+					break;
+				case CrossEvent:
+					Swap(e.a, e.b);
+					break;
+				default:
+					Insert(e.a);
+					// the segments ending here touch it by their end
+					for (unsigned int s : ended)
+						Check(s, e.a);
+					break;
+				}
+			}
+
+			std::vector<Node >().swap(m_nodes);
+			std::vector<int >().swap(m_nodeOf);
+			std::vector<unsigned int >().swap(m_free);
+			m_reported.clear();
+			m_events = std::priority_queue<Event, std::vector<Event >, Later >();
+			return m_found;
+		}
+
+		/// @brief a segment enters at its first point, it meets its neighbors
+		/// and all the segments through that point
+		void Insert(unsigned int s) {
+			const int n = InsertNode(s);
+			const SweepPoint &p = m_segments[s].p;
+			for (int x = Prev(n); x >= 0 && !m_found; x = Prev(x)) {
+				Check(m_nodes[x].segment, s);
+				if (!Through(m_nodes[x].segment, p))
+					break;
+			}
+			for (int x = Next(n); x >= 0 && !m_found; x = Next(x)) {
+				Check(s, m_nodes[x].segment);
+				if (!Through(m_nodes[x].segment, p))
+					break;
+			}
+			Settle(n, p);
+		}
+
+		/// @brief a segment leaves at its last point, its two neighbors meet
+		void Remove(unsigned int s) {
+			const int n = m_nodeOf[s];
+			if (n < 0)
+				return;
+			const SweepPoint &q = m_segments[s].q;
+			int below = Prev(n), above = Next(n);
+			for (int x = below; x >= 0 && Through(m_nodes[x].segment, q); x = Prev(x))
+				Check(m_nodes[x].segment, s);
+			for (int x = above; x >= 0 && Through(m_nodes[x].segment, q); x = Next(x))
+				Check(s, m_nodes[x].segment);
+			EraseNode(n);
+			if (below >= 0 && above >= 0)
+				Check(m_nodes[below].segment, m_nodes[above].segment);
+			if (below >= 0 && Through(m_nodes[below].segment, q))
+				Settle(below, q);
+			else if (above >= 0 && Through(m_nodes[above].segment, q))
+				Settle(above, q);
+		}
+
+		/// @brief the segments through the end point p, around the node n, go in
+		/// their order after p. those coming from before p cross there, but their
+		/// crossing may wait in the queue at a rounded point after p
+		void Settle(int n, const SweepPoint &p) {
+			int lo = n, hi = n, before = 0;
+			for (int x = Prev(lo); x >= 0 && Through(m_nodes[x].segment, p); x = Prev(x))
+				lo = x;
+			for (int x = Next(hi); x >= 0 && Through(m_nodes[x].segment, p); x = Next(x))
+				hi = x;
+			m_run.clear();
+			for (int z = lo; ; z = Next(z)) {
+				m_run.push_back(z);
+				before += m_segments[m_nodes[z].segment].p != p;
+				if (z == hi)
+					break;
+			}
+			if (before >= 2 && !m_found)
+				Reorder();
+		}
+
+		/// @brief the crossing of a below b: the run of segments from a to b
+		/// through the crossing point is put in its order after the point
+		void Swap(unsigned int a, unsigned int b) {
+			const int na = m_nodeOf[a], nb = m_nodeOf[b];
+			if (na < 0 || nb < 0)
+				return;
+			// walk up from both at once, the first to meet the other is below
+			int x = na, y = nb;
+			while (true) {
+				if (x >= 0 && (x = Next(x)) == nb)
+					break;
+				if (y >= 0 && (y = Next(y)) == na)
+					return;
+				if (x < 0 && y < 0)
+					return;
+			}
+
+			m_run.clear();
+			for (int z = na; z != nb; z = Next(z))
+				m_run.push_back(z);
+			m_run.push_back(nb);
+			Reorder();
+		}
+
+		/// @brief the run of nodes through one point is put in its order after
+		/// the point, some of it may have been swapped already by another
+		/// crossing at the same point
+		void Reorder() {
+			// the segments in between also pass through the point
+			for (size_t i = 0; i + 2 < m_run.size(); ++i) {
+				for (size_t j = i + 2; j < m_run.size(); ++j)
+					Check(m_nodes[m_run[i]].segment, m_nodes[m_run[j]].segment);
+			}
+			m_runSegments.clear();
+			for (int z : m_run)
+				m_runSegments.push_back(m_nodes[z].segment);
+			std::sort(m_runSegments.begin(), m_runSegments.end(), [this](unsigned int s, unsigned int t) {
+				return After(s, t);
+			});
+			for (size_t i = 0; i < m_run.size(); ++i) {
+				m_nodes[m_run[i]].segment = m_runSegments[i];
+				m_nodeOf[m_runSegments[i]] = m_run[i];
+			}
+			const int below = Prev(m_run.front()), above = Next(m_run.back());
+			if (below >= 0)
+				Check(m_nodes[below].segment, m_nodes[m_run.front()].segment);
+			if (above >= 0)
+				Check(m_nodes[m_run.back()].segment, m_nodes[above].segment);
+		}
+
+		/// @brief report lower and upper if they meet, and plan their crossing
+		void Check(unsigned int lower, unsigned int upper) {
+			if (m_found)
+				return;
+			const uint64_t key = lower < upper ? (uint64_t(lower) << 32 | upper) : (uint64_t(upper) << 32 | lower);
+			if (m_reported.count(key))
+				return;
+			const Segment &s = m_segments[lower], &t = m_segments[upper];
+			SweepPoint point;
+			const int type = Classify(s, t, point);
+			if (type == IntersectNone)
+				return;
+			if (type == IntersectEnd && !m_sharedEnds && (s.p == t.p || s.p == t.q || s.q == t.p || s.q == t.q))
+				return;
+			m_reported.insert(key);
+
+			if (!m_result) {
+				m_found = type != IntersectEnd;
+				return;
+			}
+			Intersection hit = { std::min(lower, upper), std::max(lower, upper), type, point };
+			m_result->push_back(hit);
+			if (type == IntersectCross) {
+				// a crossing rounded behind the sweep is done at once
+				Event e = { Before(m_current, point) ? point : m_current, CrossEvent, lower, upper };
+				m_events.push(e);
+			}
+		}
+
+		/// @brief how two segments meet, with exact signs
+		static int Classify(const Segment &s, const Segment &t, SweepPoint &point) {
+			const double o1 = Orient(s.p, s.q, t.p);
+			const double o2 = Orient(s.p, s.q, t.q);
+			const double o3 = Orient(t.p, t.q, s.p);
+			const double o4 = Orient(t.p, t.q, s.q);
+
+			// collinear, compare them along the line
+			if (o1 == 0 && o2 == 0 && o3 == 0 && o4 == 0) {
+				if (Before(s.q, t.p) || Before(t.q, s.p))
+					return IntersectNone;
+				if (s.q == t.p || t.q == s.p) {
+					point = s.q == t.p ? s.q : s.p;
+					return IntersectEnd;
+				}
+				point = Before(s.p, t.p) ? t.p : s.p;
+				return IntersectOverlap;
+			}
+			if ((o1 > 0 && o2 > 0) || (o1 < 0 && o2 < 0) || (o3 > 0 && o4 > 0) || (o3 < 0 && o4 < 0))
+				return IntersectNone;
+			if (o1 == 0 || o2 == 0 || o3 == 0 || o4 == 0) {
+				point = o1 == 0 ? t.p : (o2 == 0 ? t.q : (o3 == 0 ? s.p : s.q));
+				return IntersectEnd;
+			}
+
+			// the ends of s are on both sides of t, their areas do not cancel
+			const double a3 = Area(t.p, t.q, s.p), a4 = Area(t.p, t.q, s.q);
+			const double u = a3 / (a3 - a4);
+			point = SweepPoint(s.p[0] + u * (s.q[0] - s.p[0]), s.p[1] + u * (s.q[1] - s.p[1]));
+			// in the boxes of both, a crossing on a vertical segment keeps its x
+			for (int d = 0; d < 2; ++d) {
+				const double lo = std::max(std::min(s.p[d], s.q[d]), std::min(t.p[d], t.q[d]));
+				const double hi = std::min(std::max(s.p[d], s.q[d]), std::max(t.p[d], t.q[d]));
+				point[d] = std::min(std::max(point[d], lo), hi);
+			}
+			return IntersectCross;
+		}
+
+		/// @brief Orient2D right to 2^-44 of its value, not only its sign
+		static double Area(const SweepPoint &a, const SweepPoint &b, const SweepPoint &c) {
+			const double detleft = (a[0] - c[0]) * (b[1] - c[1]);
+			const double detright = (a[1] - c[1]) * (b[0] - c[0]);
+			const double det = detleft - detright;
+			if (std::fabs(det) * AreaPrecision >= DMath::DPredicateBounds::Orient2D() * (std::fabs(detleft) + std::fabs(detright)))
+				return det;
+			const double pa[2] = { a[0], a[1] };
+			const double pb[2] = { b[0], b[1] };
+			const double pc[2] = { c[0], c[1] };
+			return DMath::DExact::Orient2D(pa, pb, pc);
+		}
+
+		/// @brief true when the segment s, cut by the sweep, passes through p
+		bool Through(unsigned int s, const SweepPoint &p) const {
+			return Orient(m_segments[s].p, m_segments[s].q, p) == 0;
+		}
+
+		/// @brief true when the entering segment s is below the segment t
+		bool Below(unsigned int s, unsigned int t) const {
+			const Segment &a = m_segments[s], &b = m_segments[t];
+			double o = Orient(b.p, b.q, a.p);
+			// starting on t, the other end tells the side
+			if (o == 0)
+				o = Orient(b.p, b.q, a.q);
+			if (o == 0)
+				return s < t;
+			return o < 0;
+		}
+
+		/// @brief true when s is below t after the point where they cross
+		bool After(unsigned int s, unsigned int t) const {
+			const Segment &a = m_segments[s], &b = m_segments[t];
+			const double o = Orient(a.p, a.q, b.q);
+			if (o == 0)
+				return s < t;
+			return o > 0;
+		}
+
+		/// @brief sweep order, by x then by y
+		static bool Before(const SweepPoint &a, const SweepPoint &b) {
+			return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+		}
+
+		static double Orient(const SweepPoint &a, const SweepPoint &b, const SweepPoint &c) {
+			const double pa[2] = { a[0], a[1] };
+			const double pb[2] = { b[0], b[1] };
+			const double pc[2] = { c[0], c[1] };
+			return DMath::Orient2D(pa, pb, pc);
+		}
+
+	protected:
+		int InsertNode(unsigned int s) {
+			const int n = static_cast<int >(m_free.back());
+			m_free.pop_back();
+			Node &node = m_nodes[n];
+			node.left = node.right = node.parent = -1;
+			node.segment = s;
+			m_seed ^= m_seed << 13;
+			m_seed ^= m_seed >> 17;
+			m_seed ^= m_seed << 5;
+			node.priority = m_seed;
+			m_nodeOf[s] = n;
+			if (m_root < 0) {
+				m_root = n;
+				return n;
+			}
+
+			int x = m_root;
+			while (true) {
+				int &child = Below(s, m_nodes[x].segment) ? m_nodes[x].left : m_nodes[x].right;
+				if (child < 0) {
+					child = n;
+					break;
+				}
+				x = child;
+			}
+			node.parent = x;
+			while (node.parent >= 0 && node.priority < m_nodes[node.parent].priority)
+				Rotate(n);
+			return n;
+		}
+
+		void EraseNode(int n) {
+			while (m_nodes[n].left >= 0 && m_nodes[n].right >= 0) {
+				const int l = m_nodes[n].left, r = m_nodes[n].right;
+				Rotate(m_nodes[l].priority < m_nodes[r].priority ? l : r);
+			}
+			const int c = m_nodes[n].left >= 0 ? m_nodes[n].left : m_nodes[n].right;
+			const int p = m_nodes[n].parent;
+			if (c >= 0)
+				m_nodes[c].parent = p;
+			if (p < 0)
+				m_root = c;
+			else if (m_nodes[p].left == n)
+				m_nodes[p].left = c;
+			else
+				m_nodes[p].right = c;
+			m_nodeOf[m_nodes[n].segment] = -1;
+			m_free.push_back(n);
+		}
+
+		/// @brief move x above its parent, the in order sequence is kept
+		void Rotate(int x) {
+			const int p = m_nodes[x].parent, g = m_nodes[p].parent;
+			if (m_nodes[p].left == x) {
+				const int c = m_nodes[x].right;
+				m_nodes[p].left = c;
+				if (c >= 0)
+					m_nodes[c].parent = p;
+				m_nodes[x].right = p;
+			}
+			else {
+				const int c = m_nodes[x].left;
+				m_nodes[p].right = c;
+				if (c >= 0)
+					m_nodes[c].parent = p;
+				m_nodes[x].left = p;
+			}
+			m_nodes[p].parent = x;
+			m_nodes[x].parent = g;
+			if (g < 0)
+				m_root = x;
+			else if (m_nodes[g].left == p)
+				m_nodes[g].left = x;
+			else
+				m_nodes[g].right = x;
+		}
+
+		/// @brief the node above x, -1 at the top
+		int Next(int x) const {
+			if (m_nodes[x].right >= 0) {
+				x = m_nodes[x].right;
+				while (m_nodes[x].left >= 0)
+					x = m_nodes[x].left;
+				return x;
+			}
+			int y = m_nodes[x].parent;
+			while (y >= 0 && x == m_nodes[y].right) {
+				x = y;
+				y = m_nodes[y].parent;
+			}
+			return y;
+		}
+
+		/// @brief the node below x, -1 at the bottom
+		int Prev(int x) const {
+			if (m_nodes[x].left >= 0) {
+				x = m_nodes[x].left;
+				while (m_nodes[x].right >= 0)
+					x = m_nodes[x].right;
+				return x;
+			}
+			int y = m_nodes[x].parent;
+			while (y >= 0 && x == m_nodes[y].left) {
+				x = y;
+				y = m_nodes[y].parent;
+			}
+			return y;
+		}
+
+	protected:
+		std::vector<Segment > m_segments;
+
+		// sweep state
+		std::priority_queue<Event, std::vector<Event >, Later > m_events;
+		std::vector<Node > m_nodes;
+		std::vector<int > m_nodeOf;
+		std::vector<unsigned int > m_free;
+		std::vector<int > m_run;
+		std::vector<unsigned int > m_runSegments;
+		std::unordered_set<uint64_t > m_reported;
+		std::vector<Intersection > *m_result = nullptr;
+		SweepPoint m_current;
+		int m_root = -1;
+		uint32_t m_seed = 0;
+		bool m_sharedEnds = false;
+		bool m_found = false;
+	};
+};
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef _DAMONS_SLICER_H_
+#define _DAMONS_SLICER_H_
+
+#include "DamonsPoint.h"
+#include "DamonsPolygon.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <stdint.h>
+
+namespace DGraphic {
+
+	/// class DSlicer
+	/// @breif cut a triangle mesh with a stack of planes z = h
+	///
+	/// triangles are sorted by their lowest z value, each worker thread sweeps
+	/// a contiguous range of layers keeping only the triangles whose z-range
+	/// covers the current plane active. a triangle vertex lying exactly on a
+	/// plane is treated as above it, so every cut triangle crosses exactly two
+	/// edges and the cut point of an edge only depends on that edge. segments
+	/// are then stitched into contours through the mesh edges they share.
+	///
+	/// for a closed mesh with outward normals, outer contours are counter
+	/// clockwise and holes are clockwise (seen from +z).
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DSlicer
+	{
+	public:
+		typedef DVector<T, 2> ContourPoint;
+		typedef std::vector< DPolygon<T> > LayerContours;
+
+		/// @brief create a slicer over a triangle mesh
+		///
+		/// @param points mesh vertices, kept by the slicer (moved when given a temporary)
+		/// @param triangles vertex indexes of triangles, 3 per triangle, kept as the points
+		DSlicer(std::vector< DPoint<T> > points, std::vector<unsigned int > triangles)
+			: m_points(std::move(points)), m_triangles(std::move(triangles)) {
+			SortTriangles();
+		}
+		~DSlicer() {
+		}
+
+	public:
+		/// @brief slice the mesh with planes z = heights[i]
+		///
+		/// @param heights z values of layers, need not be sorted
+		/// @param layers contours of each layer as return, layers[i] belongs to heights[i]
+		/// @param keepOpen whether open chains (from open or non-manifold meshes) are kept
+		void Slice(const std::vector<T> &heights, std::vector< LayerContours > &layers, bool keepOpen = false) const {
+			layers.clear();
+			layers.resize(heights.size());
+			if (heights.empty() || m_order.empty())
+				return;
+
+			std::vector<unsigned int > layerOrder(heights.size());
+			std::iota(layerOrder.begin(), layerOrder.end(), 0u);
+			std::sort(layerOrder.begin(), layerOrder.end(), [&heights](unsigned int a, unsigned int b) {
+				return heights[a] < heights[b];
+			});
+
+			// one contiguous range of sorted layers per block, every block runs its own sweep
+			const size_t nlayers = heights.size();
+			const size_t grain = std::max<size_t>(1, (nlayers + 4 * ParallelThreadCount() - 1) / (4 * ParallelThreadCount()));
+			ParallelForRange(0, nlayers, [&](size_t b, size_t e, unsigned int) {
+				SweepLayers(heights, layerOrder, b, e, layers, keepOpen);
+			}, grain);
+		}
+
+		/// @brief slice the mesh with uniformly spaced planes z = start + i*step
+		///
+		/// @param start z value of the first layer
+		/// @param step distance between two layers
+		/// @param count number of layers
+		/// @param layers contours of each layer as return
+		/// @param keepOpen whether open chains are kept
+		void SliceUniform(const T &start, const T &step, unsigned int count, std::vector< LayerContours > &layers, bool keepOpen = false) const {
+			std::vector<T > heights(count);
+			for (unsigned int i = 0; i < count; ++i)
+				heights[i] = start + step * static_cast<T>(i);
+			Slice(heights, layers, keepOpen);
+		}
+
+		/// @brief slice the mesh with a single plane z = h
+		///
+		/// @param h z value of the plane
+		/// @param contours contours of this plane as return
+		/// @param keepOpen whether open chains are kept
+		void SliceOne(const T &h, LayerContours &contours, bool keepOpen = false) const {
+			std::vector< LayerContours > layers;
+			Slice(std::vector<T >(1, h), layers, keepOpen);
+			contours.swap(layers[0]);
+		}
+
+		/// @brief get the z range of the mesh
+		///
+		/// @param zmin lowest z as return
+		/// @param zmax highest z as return
+		void GetZRange(T &zmin, T &zmax) const {
+			zmin = std::numeric_limits<T>::max();
+			zmax = std::numeric_limits<T>::lowest();
+			for (auto &p : m_points) {
+				zmin = std::min(zmin, p.z());
+				zmax = std::max(zmax, p.z());
+			}
+		}
+
+	protected:
+		/// @brief one cut segment, from the cut point of the edge going down
+		/// to the cut point of the edge going up
+		struct Segment {
+			uint64_t from;
+			uint64_t to;
+			ContourPoint p;
+		};
+
+		/// @brief compute z range of triangles and sort them by lowest z
+		void SortTriangles() {
+			const size_t ntri = m_triangles.size() / 3;
+			m_zmin.resize(ntri);
+			m_zmax.resize(ntri);
+			ParallelFor(0, ntri, [this](size_t t) {
+				T z0 = m_points[m_triangles[3 * t]].z();
+				T z1 = m_points[m_triangles[3 * t + 1]].z();
+				T z2 = m_points[m_triangles[3 * t + 2]].z();
+				m_zmin[t] = std::min(z0, std::min(z1, z2));
+				m_zmax[t] = std::max(z0, std::max(z1, z2));
+			});
+
+			m_order.resize(ntri);
+			std::iota(m_order.begin(), m_order.end(), 0u);
+			std::sort(m_order.begin(), m_order.end(), [this](unsigned int a, unsigned int b) {
+				return m_zmin[a] < m_zmin[b];
+			});
+
+			// highest z reached by the sorted triangles up to each one
+			m_reach.resize(ntri);
+			T reach = std::numeric_limits<T>::lowest();
+			for (size_t i = 0; i < ntri; ++i) {
+				reach = std::max(reach, m_zmax[m_order[i]]);
+				m_reach[i] = reach;
+			}
+		}
+
+		static inline uint64_t EdgeKey(unsigned int a, unsigned int b) {
+			return a < b ? ((uint64_t(a) << 32) | b) : ((uint64_t(b) << 32) | a);
+		}
+
+		/// @brief cut point of edge (a,b), computed from the ordered edge so both
+		/// triangles sharing it get the same value
+		inline ContourPoint EdgePoint(unsigned int a, unsigned int b, const T &h) const {
+			if (b < a)
+				std::swap(a, b);
+			const DPoint<T> &pa = m_points[a];
+			const DPoint<T> &pb = m_points[b];
+			T t = (h - pa.z()) / (pb.z() - pa.z());
+			return ContourPoint(pa.x() + t * (pb.x() - pa.x()), pa.y() + t * (pb.y() - pa.y()));
+		}
+
+		/// @brief sweep sorted layers [lb, le) keeping an active triangle list
+		void SweepLayers(const std::vector<T> &heights, const std::vector<unsigned int > &layerOrder,
+			size_t lb, size_t le, std::vector< LayerContours > &layers, bool keepOpen) const {
+
+			std::vector<unsigned int > active;
+			std::vector<Segment > segments;
+			// the triangles sorted before the first one reaching the lowest plane
+			// of the block all end below it, the sweep starts after them
+			size_t next = std::lower_bound(m_reach.begin(), m_reach.end(), heights[layerOrder[lb]]) - m_reach.begin();
+
+			for (size_t l = lb; l < le; ++l) {
+				const T h = heights[layerOrder[l]];
+				// add triangles starting below this plane
+				while (next < m_order.size() && m_zmin[m_order[next]] <= h) {
+					active.push_back(m_order[next]);
+					++next;
+				}
+				// drop triangles ending below this plane
+				active.erase(std::remove_if(active.begin(), active.end(), [this, &h](unsigned int t) {
+					return m_zmax[t] < h;
+				}), active.end());
+
+				segments.clear();
+				for (auto t : active)
+					CutTriangle(t, h, segments);
+
+				StitchSegments(segments, h, layers[layerOrder[l]], keepOpen);
+			}
+		}
+
+		/// @brief cut one triangle, push at most one segment
+		inline void CutTriangle(unsigned int t, const T &h, std::vector<Segment > &segments) const {
+			const unsigned int *v = &m_triangles[3 * t];
+			bool above[3];
+			for (int k = 0; k < 3; ++k)
+				above[k] = m_points[v[k]].z() >= h;
+
+			if (above[0] == above[1] && above[1] == above[2])
+				return;
+
+			int down = -1, up = -1;
+			for (int k = 0; k < 3; ++k) {
+				int n = (k + 1) % 3;
+				if (above[k] && !above[n])
+					down = k;
+				else if (!above[k] && above[n])
+					up = k;
+			}
+
+			Segment s;
+			s.from = EdgeKey(v[down], v[(down + 1) % 3]);
+			s.to = EdgeKey(v[up], v[(up + 1) % 3]);
+			s.p = EdgePoint(v[down], v[(down + 1) % 3], h);
+			segments.push_back(s);
+		}
+
+		/// @brief link segments whose end edge is the start edge of another
+		void StitchSegments(std::vector<Segment > &segments, const T &h, LayerContours &contours, bool keepOpen) const {
+			const size_t ns = segments.size();
+			if (ns == 0)
+				return;
+
+			std::sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b) {
+				return a.from < b.from;
+			});
+
+			auto findFrom = [&segments](uint64_t key) -> int {
+				auto it = std::lower_bound(segments.begin(), segments.end(), key, [](const Segment &s, uint64_t k) {
+					return s.from < k;
+				});
+				if (it != segments.end() && it->from == key)
+					return static_cast<int>(it - segments.begin());
+				return -1;
+			};
+
+			std::vector<int > nextSeg(ns);
+			std::vector<char > hasPrev(ns, 0);
+			for (size_t i = 0; i < ns; ++i) {
+				nextSeg[i] = findFrom(segments[i].to);
+				if (nextSeg[i] >= 0)
+					hasPrev[nextSeg[i]] = 1;
+			}
+
+			std::vector<char > visited(ns, 0);
+			std::vector<ContourPoint > chain;
+
+			// open chains start at segments nobody leads to
+			if (keepOpen) {
+				for (size_t i = 0; i < ns; ++i) {
+					if (hasPrev[i] || visited[i])
+						continue;
+					chain.clear();
+					int c = static_cast<int>(i);
+					int last = c;
+					while (c >= 0 && !visited[c]) {
+						visited[c] = 1;
+						chain.push_back(segments[c].p);
+						last = c;
+						c = nextSeg[c];
+					}
+					// the end point of the last segment closes the chain
+					if (nextSeg[last] < 0) {
+						uint64_t key = segments[last].to;
+						chain.push_back(EdgePoint(static_cast<unsigned int>(key >> 32), static_cast<unsigned int>(key & 0xffffffff), h));
+					}
+					if (chain.size() > 1)
+						contours.push_back(DPolygon<T>(chain));
+				}
+			}
+
+			for (size_t i = 0; i < ns; ++i) {
+				if (visited[i])
+					continue;
+				chain.clear();
+				int c = static_cast<int>(i);
+				bool closed = false;
+				while (c >= 0 && !visited[c]) {
+					visited[c] = 1;
+					chain.push_back(segments[c].p);
+					c = nextSeg[c];
+					if (c == static_cast<int>(i))
+						closed = true;
+				}
+				if ((closed || keepOpen) && chain.size() > 2)
+					contours.push_back(DPolygon<T>(chain));
+			}
+		}
+
+	protected:
+		std::vector< DPoint<T> > m_points;
+		std::vector<unsigned int > m_triangles;
+		std::vector<T > m_zmin;
+		std::vector<T > m_zmax;
+		std::vector<unsigned int > m_order;
+		/// m_reach[i] is the highest zmax of m_order[0..i], it never decreases
+		std::vector<T > m_reach;
+	};
+};
+#endif
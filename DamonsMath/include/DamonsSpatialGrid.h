@@ -0,0 +1,525 @@
+#ifndef _DAMONS_SPATIAL_GRID_H_
+#define _DAMONS_SPATIAL_GRID_H_
+
+#include "DamonsPoint.h"
+#include "DamonsBox.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <utility>
+#include <stdint.h>
+
+namespace DGraphic {
+
+	/// class DSpatialGrid
+	/// @breif uniform grid index for fixed radius neighbor queries
+	///
+	/// the grid covers a DBox with cubic cells of a given size. items are points
+	/// or axis aligned boxes (e.g. triangle bounds), a box is stored in every cell
+	/// it overlaps. items are bucketed with a counting sort into two flat arrays
+	/// (CSR): m_cellStart[c] .. m_cellStart[c+1] indexes m_cellItems.
+	///
+	/// the bucket entries of boxes are kept under LargeItemCells per item or per
+	/// bucket: past that, the widest boxes go to a list every query tests, so
+	/// wide boxes take no memory per cell.
+	///
+	/// when the box holds too many cells for the number of items the grid turns
+	/// into a hashed grid: cells are folded into a table of about twice the item
+	/// count, so memory never depends on the cell size.
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DSpatialGrid
+	{
+	public:
+		typedef std::pair<unsigned int, unsigned int > ItemPair;
+
+		/// @brief create an empty grid
+		///
+		/// @param box box covered by the grid, items outside are clamped to the border cells
+		/// @param cellSize edge length of a cell
+		DSpatialGrid(const DBox<T> &box, const T &cellSize) : m_box(box), m_cellSize(cellSize),
+			m_hashed(false), m_isPoints(true), m_itemCount(0) {
+			assert(cellSize > 0);
+			m_invCellSize = T(1) / cellSize;
+			for (int a = 0; a < 3; ++a) {
+				T extent = std::max(T(0), m_box.GetMax(a) - m_box.GetMin(a));
+				m_dims[a] = static_cast<int64_t>(std::floor(extent * m_invCellSize)) + 1;
+			}
+		}
+		~DSpatialGrid() {
+		}
+
+	public:
+		/// @brief index a set of points
+		///
+		/// @param points the points, index in this vector is the item id
+		void BuildFromPoints(const std::vector< DPoint<T> > &points) {
+			m_coords.resize(points.size() * 3);
+			ParallelFor(0, points.size(), [&](size_t i) {
+				m_coords[3 * i] = points[i].x();
+				m_coords[3 * i + 1] = points[i].y();
+				m_coords[3 * i + 2] = points[i].z();
+			});
+			BuildPoints();
+		}
+
+		/// @brief index a set of points stored as x,y,z triples
+		///
+		/// @param xyz coordinates, 3 per point
+		/// @param n number of points
+		void BuildFromPoints(const T *xyz, size_t n) {
+			m_coords.assign(xyz, xyz + 3 * n);
+			BuildPoints();
+		}
+
+		/// @brief index a set of boxes
+		///
+		/// @param boxes the boxes, index in this vector is the item id
+		void BuildFromBoxes(const std::vector< DBox<T> > &boxes) {
+			m_coords.resize(boxes.size() * 6);
+			ParallelFor(0, boxes.size(), [&](size_t i) {
+				for (int a = 0; a < 3; ++a) {
+					m_coords[6 * i + a] = boxes[i].GetMin(a);
+					m_coords[6 * i + 3 + a] = boxes[i].GetMax(a);
+				}
+			});
+			BuildBoxes();
+		}
+
+		/// @brief index the bounds of triangles
+		///
+		/// @param points mesh vertices
+		/// @param triangles vertex indexes, 3 per triangle, triangle id is the item id
+		void BuildFromTriangles(const std::vector< DPoint<T> > &points, const std::vector<unsigned int > &triangles) {
+			const size_t ntri = triangles.size() / 3;
+			m_coords.resize(ntri * 6);
+			ParallelFor(0, ntri, [&](size_t t) {
+				const DPoint<T> &p0 = points[triangles[3 * t]];
+				const DPoint<T> &p1 = points[triangles[3 * t + 1]];
+				const DPoint<T> &p2 = points[triangles[3 * t + 2]];
+				for (int a = 0; a < 3; ++a) {
+					m_coords[6 * t + a] = std::min(p0[a], std::min(p1[a], p2[a]));
+					m_coords[6 * t + 3 + a] = std::max(p0[a], std::max(p1[a], p2[a]));
+				}
+			});
+			BuildBoxes();
+		}
+
+	public:
+		/// @brief find all items within distance r of a point
+		/// for box items the distance is measured to the box
+		///
+		/// @param p query point
+		/// @param r search radius
+		/// @param result item ids as return (appended, unsorted)
+		void RadiusSearch(const DPoint<T> &p, const T &r, std::vector<unsigned int > &result) const {
+			std::vector<uint64_t > cells;
+			size_t first = result.size();
+			QueryCells(p, r, cells);
+			const T r2 = r * r;
+			for (auto c : cells) {
+				for (size_t k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+					unsigned int id = m_cellItems[k];
+					if (SquaredDistance(id, p) <= r2)
+						result.push_back(id);
+				}
+			}
+			for (auto id : m_largeItems) {
+				if (SquaredDistance(id, p) <= r2)
+					result.push_back(id);
+			}
+			if (!m_isPoints) {
+				std::sort(result.begin() + first, result.end());
+				result.erase(std::unique(result.begin() + first, result.end()), result.end());
+			}
+		}
+
+		/// @brief radius search for many points in parallel
+		///
+		/// results are returned in CSR form: the neighbors of queries[i] are
+		/// indices[offsets[i]] .. indices[offsets[i+1]-1]
+		///
+		/// @param queries query points
+		/// @param r search radius
+		/// @param offsets offset of each query as return, size queries.size()+1
+		/// @param indices item ids as return
+		void RadiusSearch(const std::vector< DPoint<T> > &queries, const T &r,
+			std::vector<size_t > &offsets, std::vector<unsigned int > &indices) const {
+			const size_t nq = queries.size();
+			offsets.assign(nq + 1, 0);
+			std::vector< std::vector<unsigned int > > found(ParallelThreadCount());
+			std::vector< std::vector<unsigned int > > owner(ParallelThreadCount());
+
+			ParallelForRange(0, nq, [&](size_t b, size_t e, unsigned int tid) {
+				std::vector<unsigned int > &buf = found[tid];
+				std::vector<unsigned int > &own = owner[tid];
+				for (size_t q = b; q < e; ++q) {
+					size_t before = buf.size();
+					RadiusSearch(queries[q], r, buf);
+					offsets[q + 1] = buf.size() - before;
+					own.resize(buf.size(), static_cast<unsigned int>(q));
+				}
+			}, 256);
+
+			for (size_t q = 0; q < nq; ++q)
+				offsets[q + 1] += offsets[q];
+			indices.resize(offsets[nq]);
+
+			ParallelFor(0, found.size(), [&](size_t t) {
+				const std::vector<unsigned int > &buf = found[t];
+				const std::vector<unsigned int > &own = owner[t];
+				size_t k = 0;
+				while (k < buf.size()) {
+					unsigned int q = own[k];
+					size_t dst = offsets[q];
+					while (k < buf.size() && own[k] == q)
+						indices[dst++] = buf[k++];
+				}
+			}, 1);
+		}
+
+		/// @brief find the closest point item within distance r
+		///
+		/// @param p query point
+		/// @param r search radius
+		/// @param id closest item as return
+		/// @param distance distance to the closest item as return
+		/// @return true if an item was found
+		bool FindNearest(const DPoint<T> &p, const T &r, unsigned int &id, T &distance) const {
+			std::vector<uint64_t > cells;
+			QueryCells(p, r, cells);
+			T best = r * r;
+			bool found = false;
+			auto visit = [&](unsigned int item) {
+				T d2 = SquaredDistance(item, p);
+				if (d2 <= best) {
+					if (found && d2 == best && item > id)
+						return;
+					best = d2;
+					id = item;
+					found = true;
+				}
+			};
+			for (auto c : cells) {
+				for (size_t k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k)
+					visit(m_cellItems[k]);
+			}
+			for (auto item : m_largeItems)
+				visit(item);
+			if (found)
+				distance = std::sqrt(best);
+			return found;
+		}
+
+		/// @brief find all pairs of items closer than eps
+		/// points are compared by distance, boxes by overlap after growing them by eps
+		///
+		/// @param eps distance threshold
+		/// @param pairs pairs (i,j) with i < j as return, sorted
+		void PairsWithin(const T &eps, std::vector<ItemPair > &pairs) const {
+			pairs.clear();
+			std::vector< std::vector<ItemPair > > found(ParallelThreadCount());
+			const T eps2 = eps * eps;
+
+			ParallelForRange(0, m_itemCount, [&](size_t b, size_t e, unsigned int tid) {
+				std::vector<uint64_t > cells;
+				std::vector<unsigned int > cand;
+				std::vector<ItemPair > &buf = found[tid];
+				for (size_t i = b; i < e; ++i) {
+					cells.clear();
+					cand.clear();
+					if (m_isPoints) {
+						DPoint<T> p(m_coords[3 * i], m_coords[3 * i + 1], m_coords[3 * i + 2]);
+						QueryCells(p, eps, cells);
+						for (auto c : cells) {
+							for (size_t k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+								unsigned int j = m_cellItems[k];
+								if (j > i && SquaredDistance(j, p) <= eps2)
+									cand.push_back(j);
+							}
+						}
+						std::sort(cand.begin(), cand.end());
+					}
+					else {
+						const T *bi = &m_coords[6 * i];
+						BoxCells(bi, eps, cells);
+						for (auto c : cells) {
+							for (size_t k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+								unsigned int j = m_cellItems[k];
+								if (j > i && BoxesOverlap(bi, &m_coords[6 * j], eps))
+									cand.push_back(j);
+							}
+						}
+						for (auto j : m_largeItems) {
+							if (j > i && BoxesOverlap(bi, &m_coords[6 * j], eps))
+								cand.push_back(j);
+						}
+						std::sort(cand.begin(), cand.end());
+						cand.erase(std::unique(cand.begin(), cand.end()), cand.end());
+					}
+					for (auto j : cand)
+						buf.push_back(ItemPair(static_cast<unsigned int>(i), j));
+				}
+			}, 512);
+
+			size_t total = 0;
+			for (auto &f : found)
+				total += f.size();
+			pairs.reserve(total);
+			for (auto &f : found)
+				pairs.insert(pairs.end(), f.begin(), f.end());
+			std::sort(pairs.begin(), pairs.end());
+		}
+
+	public:
+		/// @brief get cell edge length
+		inline T GetCellSize() const { return m_cellSize; }
+		/// @brief get number of cells along an axis (0,1,2)
+		inline int64_t GetDimension(int axis) const { return m_dims[axis]; }
+		/// @brief get number of buckets, cells or hash slots
+		inline size_t GetBucketCount() const { return m_cellStart.empty() ? 0 : m_cellStart.size() - 1; }
+		/// @brief whether cells are folded into a hash table
+		inline bool IsHashed() const { return m_hashed; }
+		/// @brief get number of indexed items
+		inline size_t GetItemCount() const { return m_itemCount; }
+		/// @brief get number of boxes too wide to be bucketed
+		inline size_t GetLargeItemCount() const { return m_largeItems.size(); }
+
+	protected:
+		/// @brief integer cell coordinate of a value along an axis, clamped to the grid
+		inline int64_t CellCoord(const T &v, int axis) const {
+			T f = (v - m_box.GetMin(axis)) * m_invCellSize;
+			if (!(f > 0))
+				return 0;
+			int64_t c = static_cast<int64_t>(f);
+			return c >= m_dims[axis] ? m_dims[axis] - 1 : c;
+		}
+
+		/// @brief bucket of cell (i,j,k)
+		inline uint64_t Bucket(int64_t i, int64_t j, int64_t k) const {
+			if (!m_hashed)
+				return static_cast<uint64_t>((k * m_dims[1] + j) * m_dims[0] + i);
+			uint64_t h = (static_cast<uint64_t>(i) * 73856093ull) ^ (static_cast<uint64_t>(j) * 19349663ull) ^ (static_cast<uint64_t>(k) * 83492791ull);
+			return h & (m_tableSize - 1);
+		}
+
+		/// @brief choose plain or hashed cell addressing for n items
+		void ChooseLayout(size_t n) {
+			const double cells = double(m_dims[0]) * double(m_dims[1]) * double(m_dims[2]);
+			const double limit = std::max(double(1 << 20), 8.0 * double(n));
+			m_hashed = cells > limit;
+			if (m_hashed) {
+				m_tableSize = 1024;
+				while (m_tableSize < 2 * n)
+					m_tableSize <<= 1;
+			}
+			else
+				m_tableSize = static_cast<uint64_t>(cells);
+		}
+
+		/// @brief distinct buckets of the cells overlapping [p-r, p+r]
+		void QueryCells(const DPoint<T> &p, const T &r, std::vector<uint64_t > &cells) const {
+			T b[6] = { p.x(), p.y(), p.z(), p.x(), p.y(), p.z() };
+			BoxCells(b, r, cells);
+		}
+
+		/// @brief number of cells overlapping a box
+		double CellSpan(const T *b) const {
+			double span = 1;
+			for (int a = 0; a < 3; ++a)
+				span *= double(CellCoord(b[3 + a], a) - CellCoord(b[a], a) + 1);
+			return span;
+		}
+
+		/// @brief distinct buckets of the cells overlapping a box grown by r
+		void BoxCells(const T *b, const T &r, std::vector<uint64_t > &cells) const {
+			int64_t lo[3], hi[3];
+			for (int a = 0; a < 3; ++a) {
+				lo[a] = CellCoord(b[a] - r, a);
+				hi[a] = CellCoord(b[3 + a] + r, a);
+			}
+			// a range wider than the hash table touches every bucket anyway
+			if (m_hashed && double(hi[0] - lo[0] + 1) * double(hi[1] - lo[1] + 1) * double(hi[2] - lo[2] + 1) >= double(m_tableSize)) {
+				for (uint64_t c = 0; c < m_tableSize; ++c)
+					cells.push_back(c);
+				return;
+			}
+			for (int64_t k = lo[2]; k <= hi[2]; ++k)
+				for (int64_t j = lo[1]; j <= hi[1]; ++j)
+					for (int64_t i = lo[0]; i <= hi[0]; ++i)
+						cells.push_back(Bucket(i, j, k));
+			if (m_hashed) {
+				std::sort(cells.begin(), cells.end());
+				cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+			}
+		}
+
+		/// @brief squared distance from a point to an item
+		inline T SquaredDistance(unsigned int id, const DPoint<T> &p) const {
+			T d2 = 0;
+			if (m_isPoints) {
+				const T *c = &m_coords[3 * id];
+				for (int a = 0; a < 3; ++a)
+					d2 += (c[a] - p[a]) * (c[a] - p[a]);
+			}
+			else {
+				const T *c = &m_coords[6 * id];
+				for (int a = 0; a < 3; ++a) {
+					T d = std::max(c[a] - p[a], std::max(T(0), p[a] - c[3 + a]));
+					d2 += d * d;
+				}
+			}
+			return d2;
+		}
+
+		static inline bool BoxesOverlap(const T *a, const T *b, const T &eps) {
+			for (int k = 0; k < 3; ++k) {
+				if (a[3 + k] + eps < b[k] || b[3 + k] + eps < a[k])
+					return false;
+			}
+			return true;
+		}
+
+		/// @brief counting sort of single cell items
+		void BuildPoints() {
+			m_isPoints = true;
+			m_itemCount = m_coords.size() / 3;
+			ChooseLayout(m_itemCount);
+
+			std::vector<uint64_t > bucketOf(m_itemCount);
+			ParallelFor(0, m_itemCount, [&](size_t i) {
+				const T *c = &m_coords[3 * i];
+				bucketOf[i] = Bucket(CellCoord(c[0], 0), CellCoord(c[1], 1), CellCoord(c[2], 2));
+			});
+
+			m_largeItems.clear();
+			std::vector< std::atomic<size_t> > counts(m_tableSize + 1);
+			for (auto &c : counts)
+				c.store(0, std::memory_order_relaxed);
+			ParallelFor(0, m_itemCount, [&](size_t i) {
+				counts[bucketOf[i]].fetch_add(1, std::memory_order_relaxed);
+			});
+			Scatter(counts, m_itemCount, [&](size_t i, std::vector< std::atomic<size_t> > &cursor) {
+				m_cellItems[cursor[bucketOf[i]].fetch_add(1, std::memory_order_relaxed)] = static_cast<unsigned int>(i);
+			});
+		}
+
+		/// @brief counting sort of items spanning several cells
+		void BuildBoxes() {
+			m_isPoints = false;
+			m_itemCount = m_coords.size() / 6;
+			ChooseLayout(m_itemCount);
+
+			// a hashed box never takes more entries than the table has buckets
+			std::vector<double > span(m_itemCount);
+			ParallelFor(0, m_itemCount, [&](size_t i) {
+				span[i] = CellSpan(&m_coords[6 * i]);
+				if (m_hashed)
+					span[i] = std::min(span[i], double(m_tableSize));
+			});
+			double entries = 0;
+			for (auto c : span)
+				entries += c;
+			std::vector<char > large(m_itemCount, 0);
+			const double budget = double(LargeItemCells) * double(std::max<uint64_t>(m_itemCount, m_tableSize));
+			if (entries > budget) {
+				std::vector<unsigned int > widest(m_itemCount);
+				for (size_t i = 0; i < m_itemCount; ++i)
+					widest[i] = static_cast<unsigned int>(i);
+				std::sort(widest.begin(), widest.end(), [&span](unsigned int a, unsigned int b) {
+					return span[a] > span[b];
+				});
+				for (size_t k = 0; k < m_itemCount && entries > budget; ++k) {
+					large[widest[k]] = 1;
+					entries -= span[widest[k]];
+				}
+			}
+
+			std::vector< std::atomic<size_t> > counts(m_tableSize + 1);
+			for (auto &c : counts)
+				c.store(0, std::memory_order_relaxed);
+			std::atomic<size_t> total(0);
+			ParallelForRange(0, m_itemCount, [&](size_t b, size_t e, unsigned int) {
+				std::vector<uint64_t > cells;
+				size_t local = 0;
+				for (size_t i = b; i < e; ++i) {
+					if (large[i])
+						continue;
+					cells.clear();
+					BoxCells(&m_coords[6 * i], T(0), cells);
+					for (auto c : cells)
+						counts[c].fetch_add(1, std::memory_order_relaxed);
+					local += cells.size();
+				}
+				total.fetch_add(local);
+			});
+			m_largeItems.clear();
+			for (size_t i = 0; i < m_itemCount; ++i) {
+				if (large[i])
+					m_largeItems.push_back(static_cast<unsigned int>(i));
+			}
+			Scatter(counts, total.load(), [&](size_t i, std::vector< std::atomic<size_t> > &cursor) {
+				if (large[i])
+					return;
+				std::vector<uint64_t > cells;
+				BoxCells(&m_coords[6 * i], T(0), cells);
+				for (auto c : cells)
+					m_cellItems[cursor[c].fetch_add(1, std::memory_order_relaxed)] = static_cast<unsigned int>(i);
+			});
+		}
+
+		/// @brief prefix sum of counts then place items, cells are sorted afterwards
+		/// so the layout does not depend on thread scheduling
+		template<class Place>
+		void Scatter(std::vector< std::atomic<size_t> > &counts, size_t total, Place place) {
+			const size_t nb = static_cast<size_t>(m_tableSize);
+			m_cellStart.resize(nb + 1);
+			size_t sum = 0;
+			for (size_t c = 0; c < nb; ++c) {
+				m_cellStart[c] = sum;
+				sum += counts[c].load(std::memory_order_relaxed);
+				counts[c].store(m_cellStart[c], std::memory_order_relaxed);
+			}
+			m_cellStart[nb] = sum;
+			assert(sum == total);
+
+			m_cellItems.resize(total);
+			ParallelForRange(0, m_itemCount, [&](size_t b, size_t e, unsigned int) {
+				for (size_t i = b; i < e; ++i)
+					place(i, counts);
+			});
+			ParallelFor(0, nb, [&](size_t c) {
+				if (m_cellStart[c + 1] - m_cellStart[c] > 1)
+					std::sort(m_cellItems.begin() + m_cellStart[c], m_cellItems.begin() + m_cellStart[c + 1]);
+			}, 4096);
+		}
+
+	protected:
+		/// bucket entries allowed per item or per bucket, the widest boxes past
+		/// that go to m_largeItems
+		enum { LargeItemCells = 64 };
+
+		DBox<T> m_box;
+		T m_cellSize;
+		T m_invCellSize;
+		int64_t m_dims[3];
+		bool m_hashed;
+		bool m_isPoints;
+		uint64_t m_tableSize;
+		size_t m_itemCount;
+
+		// item geometry: x,y,z per point or min,max per box
+		std::vector<T > m_coords;
+		// CSR buckets
+		std::vector<size_t > m_cellStart;
+		std::vector<unsigned int > m_cellItems;
+		// boxes too wide to be bucketed, sorted
+		std::vector<unsigned int > m_largeItems;
+	};
+};
+#endif
@@ -0,0 +1,447 @@
+#ifndef _DAMONS_VORONOI_H_
+#define _DAMONS_VORONOI_H_
+
+#include "DamonsPoint.h"
+#include "DamonsBox.h"
+#include "DamonsPolygon.h"
+#include "DamonsParallel.h"
+#include "DamonsDelaunay.h"
+#include "DamonsPolygonClipper.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace DGraphic {
+
+	/// class DVoronoi
+	/// @breif Voronoi cells of the points of a Delaunay triangulation
+	///
+	/// the cell vertices are the circumcenters of the triangles, computed in
+	/// one parallel pass. the cell of a point is assembled by turning counter
+	/// clockwise around it over the triangle neighbors, so it comes out as a
+	/// convex counter clockwise polygon without any search. the cells of the
+	/// hull points are unbounded, they are cut from the clip box by the
+	/// bisectors with their Delaunay neighbors instead.
+	///
+	/// every cell is clipped to a box, or to a polygon which may be concave:
+	/// a coarse grid over the polygon tells the cells that are surely inside
+	/// or outside it, only the cells on its border are intersected with it by
+	/// DPolygonClipper. such a cell may fall apart in several rings.
+	/// the result is stored as CSR twice: the rings of cell i are
+	/// m_rings[i] .. m_rings[i + 1], the vertices of ring r are
+	/// m_vertices[m_offsets[r]] .. m_vertices[m_offsets[r + 1]].
+	///
+	/// @tparam T type of point data.
+	template<class T = double>
+	class DVoronoi
+	{
+	public:
+		typedef DVector<T, 2> CellPoint;
+
+		DVoronoi() {}
+		~DVoronoi() {
+		}
+
+	public:
+		/// @brief cells of all the points of a triangulation, clipped to the xy of a box
+		///
+		/// @param delaunay an unconstrained Delaunay triangulation
+		/// @param box clip box, its z is ignored
+		void Build(const DDelaunay<T> &delaunay, const DBox<T> &box) {
+			m_clip = nullptr;
+			Compute(delaunay, box.GetMin(0), box.GetMin(1), box.GetMax(0), box.GetMax(1));
+		}
+
+		/// @brief cells of all the points of a triangulation, clipped to a polygon
+		///
+		/// a cell crossing a concave part of the polygon twice gets one ring per piece.
+		///
+		/// @param delaunay an unconstrained Delaunay triangulation
+		/// @param polygon clip polygon, simple, either orientation
+		void Build(const DDelaunay<T> &delaunay, const DPolygon<T> &polygon) {
+			m_polygon.clear();
+			const unsigned int sz = polygon.GetPolygonPointSize();
+			double area = 0;
+			for (unsigned int i = 0; i < sz; ++i) {
+				const CellPoint &p = polygon.GetPolygonPoint(i);
+				const CellPoint &q = polygon.GetPolygonPoint((i + 1) % sz);
+				area += double(p[0]) * q[1] - double(q[0]) * p[1];
+				m_polygon.push_back(p);
+			}
+			if (area < 0)
+				std::reverse(m_polygon.begin(), m_polygon.end());
+
+			m_rings.assign(delaunay.GetPointCount() + 1, 0);
+			m_offsets.assign(1, 0);
+			m_vertices.clear();
+			if (m_polygon.size() < 3)
+				return;
+			T lx = std::numeric_limits<T>::max(), ly = lx, hx = std::numeric_limits<T>::lowest(), hy = hx;
+			for (auto &p : m_polygon) {
+				lx = std::min(lx, p[0]);
+				ly = std::min(ly, p[1]);
+				hx = std::max(hx, p[0]);
+				hy = std::max(hy, p[1]);
+			}
+			m_clip = &m_polygon;
+			BuildGrid(lx, ly, hx, hy);
+			Compute(delaunay, lx, ly, hx, hy);
+			m_clip = nullptr;
+		}
+
+		/// @brief number of cells, one per point of the triangulation
+		size_t GetCellCount() const { return m_rings.empty() ? 0 : m_rings.size() - 1; }
+		/// @brief number of rings of a cell: 0 when it is clipped away or its point
+		/// is a duplicate left out of the triangulation, more than 1 only when a
+		/// concave clip polygon cuts it apart
+		size_t GetCellRingCount(size_t i) const { return m_rings[i + 1] - m_rings[i]; }
+		/// @brief number of vertices of ring k of a cell
+		size_t GetCellSize(size_t i, size_t k = 0) const { return m_offsets[m_rings[i] + k + 1] - m_offsets[m_rings[i] + k]; }
+		/// @brief first vertex of ring k of a cell, counter clockwise
+		const CellPoint *GetCell(size_t i, size_t k = 0) const { return m_vertices.data() + m_offsets[m_rings[i] + k]; }
+		/// @brief area of a cell, all its rings
+		double GetCellArea(size_t i) const {
+			double area = 0;
+			for (size_t r = 0; r < GetCellRingCount(i); ++r) {
+				const CellPoint *c = GetCell(i, r);
+				const size_t n = GetCellSize(i, r);
+				for (size_t k = 0; k < n; ++k) {
+					const CellPoint &p = c[k], &q = c[(k + 1) % n];
+					area += double(p[0]) * q[1] - double(q[0]) * p[1];
+				}
+			}
+			return area / 2;
+		}
+		/// @brief CSR arrays, cell i has the rings rings[i] .. rings[i + 1],
+		/// ring r spans offsets[r] .. offsets[r + 1] in vertices
+		const std::vector<size_t > &GetCellRings() const { return m_rings; }
+		const std::vector<size_t > &GetCellOffsets() const { return m_offsets; }
+		const std::vector<CellPoint > &GetCellVertices() const { return m_vertices; }
+
+	protected:
+		typedef DVector<double, 2> Vertex;
+		typedef std::vector<Vertex > Ring;
+		/// status of the polygon grid cells
+		enum { GridOutside = 0, GridBorder = 1, GridInside = 2 };
+
+		/// @brief cells clipped to a rectangle, and to m_clip when set
+		void Compute(const DDelaunay<T> &delaunay, double lx, double ly, double hx, double hy) {
+			const size_t npoints = delaunay.GetPointCount();
+			const size_t ntri = delaunay.GetTriangleCount();
+			m_rings.assign(npoints + 1, 0);
+			m_offsets.assign(1, 0);
+			m_vertices.clear();
+			if (npoints == 0 || !(lx <= hx && ly <= hy))
+				return;
+
+			// circumcenters, relative to the first corner to keep precision
+			std::vector<Vertex > centers(ntri);
+			ParallelFor(0, ntri, [&](size_t t) {
+				unsigned int a, b, c;
+				delaunay.GetTriangle(t, a, b, c);
+				const CellPoint &pa = delaunay.GetPoint(a), &pb = delaunay.GetPoint(b), &pc = delaunay.GetPoint(c);
+				const double bx = double(pb[0]) - pa[0], by = double(pb[1]) - pa[1];
+				const double cx = double(pc[0]) - pa[0], cy = double(pc[1]) - pa[1];
+				const double d = 2 * (bx * cy - by * cx);
+				const double bl = bx * bx + by * by, cl = cx * cx + cy * cy;
+				centers[t] = Vertex(pa[0] + (cy * bl - by * cl) / d, pa[1] + (bx * cl - cx * bl) / d);
+			}, 1 << 14);
+
+			// a triangle around each point, the first one counter clockwise for the hull points
+			std::vector<int > start(npoints, -1);
+			std::vector<char > hull(npoints, 0);
+			for (size_t t = 0; t < ntri; ++t) {
+				unsigned int v[3];
+				delaunay.GetTriangle(t, v[0], v[1], v[2]);
+				for (int k = 0; k < 3; ++k) {
+					if (!hull[v[k]])
+						start[v[k]] = static_cast<int >(t);
+					if (delaunay.GetNeighbor(t, k) < 0) {
+						start[v[(k + 1) % 3]] = static_cast<int >(t);
+						hull[v[(k + 1) % 3]] = 1;
+					}
+				}
+			}
+
+			// cells by blocks, each block keeps its rings until the offsets are known
+			const size_t grain = 1 << 12;
+			const size_t nblocks = (npoints + grain - 1) / grain;
+			std::vector<std::vector<CellPoint > > blocks(nblocks);
+			std::vector<std::vector<size_t > > sizes(nblocks);
+			ParallelForRange(0, npoints, [&](size_t b, size_t e, unsigned int) {
+				std::vector<CellPoint > &out = blocks[b / grain];
+				std::vector<size_t > &counts = sizes[b / grain];
+				Ring ring, scratch;
+				std::vector<Ring > pieces;
+				auto emit = [&](const Ring &r, size_t i) {
+					for (auto &p : r)
+						out.push_back(CellPoint(static_cast<T >(p[0]), static_cast<T >(p[1])));
+					counts.push_back(r.size());
+					++m_rings[i + 1];
+				};
+				for (size_t i = b; i < e; ++i) {
+					ring.clear();
+					if (start[i] >= 0)
+						Cell(delaunay, centers, static_cast<unsigned int >(i), start[i], hull[i] != 0, lx, ly, hx, hy, ring, scratch);
+					if (ring.size() < 3)
+						continue;
+					if (!m_clip) {
+						emit(ring, i);
+						continue;
+					}
+					pieces.clear();
+					ClipPolygon(ring, scratch, pieces);
+					for (auto &piece : pieces)
+						emit(piece, i);
+				}
+			}, grain);
+
+			for (size_t i = 0; i < npoints; ++i)
+				m_rings[i + 1] += m_rings[i];
+			m_offsets.assign(m_rings[npoints] + 1, 0);
+			ParallelFor(0, nblocks, [&](size_t k) {
+				std::copy(sizes[k].begin(), sizes[k].end(), m_offsets.begin() + m_rings[k * grain] + 1);
+			}, 1);
+			for (size_t r = 0; r < m_rings[npoints]; ++r)
+				m_offsets[r + 1] += m_offsets[r];
+			m_vertices.resize(m_offsets.back());
+			ParallelFor(0, nblocks, [&](size_t k) {
+				std::copy(blocks[k].begin(), blocks[k].end(), m_vertices.begin() + m_offsets[m_rings[k * grain]]);
+				std::vector<CellPoint >().swap(blocks[k]);
+				std::vector<size_t >().swap(sizes[k]);
+			}, 1);
+		}
+
+		/// @brief the cell of point v clipped to the rectangle
+		void Cell(const DDelaunay<T> &delaunay, const std::vector<Vertex > &centers, unsigned int v, int first, bool onHull,
+			double lx, double ly, double hx, double hy, Ring &ring, Ring &scratch) const {
+			if (onHull) {
+				// the box cut by the bisectors with every neighbor
+				ring.push_back(Vertex(lx, ly));
+				ring.push_back(Vertex(hx, ly));
+				ring.push_back(Vertex(hx, hy));
+				ring.push_back(Vertex(lx, hy));
+				const CellPoint &p = delaunay.GetPoint(v);
+				int t = first;
+				do {
+					unsigned int c[3];
+					delaunay.GetTriangle(t, c[0], c[1], c[2]);
+					const int k = c[0] == v ? 0 : (c[1] == v ? 1 : 2);
+					for (int j = 1; j < 3 && !ring.empty(); ++j) {
+						const CellPoint &q = delaunay.GetPoint(c[(k + j) % 3]);
+						const double nx = double(q[0]) - p[0], ny = double(q[1]) - p[1];
+						const double off = nx * (double(q[0]) + p[0]) / 2 + ny * (double(q[1]) + p[1]) / 2;
+						ClipHalfPlane(ring, scratch, nx, ny, off);
+					}
+					t = delaunay.GetNeighbor(t, (k + 1) % 3);
+				} while (t >= 0 && t != first);
+			}
+			else {
+				// the circumcenters counter clockwise around v
+				int t = first;
+				do {
+					const Vertex &c = centers[t];
+					if (ring.empty() || c != ring.back())
+						ring.push_back(c);
+					unsigned int a, b, d;
+					delaunay.GetTriangle(t, a, b, d);
+					const int k = a == v ? 0 : (b == v ? 1 : 2);
+					t = delaunay.GetNeighbor(t, (k + 1) % 3);
+				} while (t != first);
+				if (ring.size() > 1 && ring.front() == ring.back())
+					ring.pop_back();
+				bool inside = true;
+				for (auto &c : ring)
+					inside = inside && c[0] >= lx && c[0] <= hx && c[1] >= ly && c[1] <= hy;
+				if (!inside) {
+					ClipHalfPlane(ring, scratch, -1, 0, -lx);
+					ClipHalfPlane(ring, scratch, 1, 0, hx);
+					ClipHalfPlane(ring, scratch, 0, -1, -ly);
+					ClipHalfPlane(ring, scratch, 0, 1, hy);
+				}
+			}
+			if (ring.size() < 3)
+				ring.clear();
+		}
+
+		/// @brief keep the part of a ring where nx * x + ny * y <= off, a concave
+		/// ring keeps flat bridges along the line
+		static void ClipHalfPlane(Ring &ring, Ring &scratch, double nx, double ny, double off) {
+			scratch.clear();
+			const size_t n = ring.size();
+			for (size_t i = 0; i < n; ++i) {
+				const Vertex &p = ring[i], &q = ring[(i + 1) % n];
+				const double dp = nx * p[0] + ny * p[1] - off, dq = nx * q[0] + ny * q[1] - off;
+				if (dp <= 0)
+					scratch.push_back(p);
+				if ((dp < 0 && dq > 0) || (dp > 0 && dq < 0)) {
+					const double s = dp / (dp - dq);
+					scratch.push_back(Vertex(p[0] + s * (q[0] - p[0]), p[1] + s * (q[1] - p[1])));
+				}
+			}
+			ring.swap(scratch);
+		}
+
+		/// @brief pieces of a convex cell inside the clip polygon
+		void ClipPolygon(Ring &ring, Ring &scratch, std::vector<Ring > &pieces) const {
+			double lx = ring[0][0], ly = ring[0][1], hx = lx, hy = ly;
+			for (auto &p : ring) {
+				lx = std::min(lx, p[0]);
+				ly = std::min(ly, p[1]);
+				hx = std::max(hx, p[0]);
+				hy = std::max(hy, p[1]);
+			}
+			// the cell may lie in grid cells which are all inside or all outside
+			const int x0 = GridX(lx), x1 = GridX(hx), y0 = GridY(ly), y1 = GridY(hy);
+			bool in = true, out = true;
+			for (int y = y0; y <= y1; ++y) {
+				for (int x = x0; x <= x1; ++x) {
+					const signed char s = m_grid[size_t(y) * m_gridSize + x];
+					in = in && s == GridInside;
+					out = out && s == GridOutside;
+				}
+			}
+			if (in) {
+				pieces.push_back(ring);
+				return;
+			}
+			if (out)
+				return;
+			// the edges near the cell, without any the side of its first vertex tells
+			const Vertex &o = ring[0];
+			const size_t m = m_polygon.size();
+			bool touched = false;
+			in = false;
+			for (size_t i = 0; i < m && !touched; ++i) {
+				const CellPoint &p = m_polygon[i], &q = m_polygon[(i + 1) % m];
+				if ((p[1] > o[1]) != (q[1] > o[1]) && o[0] < p[0] + (o[1] - p[1]) * (double(q[0]) - p[0]) / (double(q[1]) - p[1]))
+					in = !in;
+				if (std::max(p[0], q[0]) >= lx && std::min(p[0], q[0]) <= hx && std::max(p[1], q[1]) >= ly && std::min(p[1], q[1]) <= hy)
+					touched = EdgeNearCell(p, q, ring);
+			}
+			if (!touched) {
+				if (in)
+					pieces.push_back(ring);
+				return;
+			}
+			// the polygon cut to a box around the cell, its bridges stay outside the cell
+			const double mx = (hx - lx) / 16, my = (hy - ly) / 16;
+			Ring local;
+			local.assign(m_polygon.begin(), m_polygon.end());
+			ClipHalfPlane(local, scratch, -1, 0, -(lx - mx));
+			ClipHalfPlane(local, scratch, 1, 0, hx + mx);
+			ClipHalfPlane(local, scratch, 0, -1, -(ly - my));
+			ClipHalfPlane(local, scratch, 0, 1, hy + my);
+			if (local.size() < 3)
+				return;
+			DPolygonClipper<double> clipper;
+			clipper.AddRing(local, DPolygonClipper<double>::PolySubject);
+			clipper.AddRing(ring, DPolygonClipper<double>::PolyClip);
+			clipper.Execute(DPolygonClipper<double>::ClipIntersection, pieces);
+		}
+
+		/// @brief false when the line of segment pq surely leaves the whole cell on one side
+		static bool EdgeNearCell(const CellPoint &p, const CellPoint &q, const Ring &ring) {
+			const double dx = double(q[0]) - p[0], dy = double(q[1]) - p[1];
+			int above = 0, below = 0;
+			for (auto &v : ring) {
+				const double u = dx * (v[1] - p[1]), w = dy * (v[0] - p[0]);
+				const double s = u - w, bound = 1e-12 * (std::fabs(u) + std::fabs(w));
+				above += s > bound;
+				below += s < -bound;
+			}
+			return above < static_cast<int >(ring.size()) && below < static_cast<int >(ring.size());
+		}
+
+		int GridX(double x) const {
+			return std::min(m_gridSize - 1, std::max(0, static_cast<int >((x - m_gridOrigin[0]) / m_gridCell[0])));
+		}
+		int GridY(double y) const {
+			return std::min(m_gridSize - 1, std::max(0, static_cast<int >((y - m_gridOrigin[1]) / m_gridCell[1])));
+		}
+
+		/// @brief grid over the polygon: cells crossed by an edge are on the
+		/// border, the others get the side of their connected region
+		void BuildGrid(double lx, double ly, double hx, double hy) {
+			const size_t m = m_polygon.size();
+			m_gridSize = static_cast<int >(std::min<size_t >(1024, std::max<size_t >(4, static_cast<size_t >(2 * std::sqrt(double(m))))));
+			m_gridOrigin = Vertex(lx, ly);
+			m_gridCell = Vertex(std::max((hx - lx) / m_gridSize, std::numeric_limits<double>::min()),
+				std::max((hy - ly) / m_gridSize, std::numeric_limits<double>::min()));
+			const size_t cells = size_t(m_gridSize) * m_gridSize;
+			m_grid.assign(cells, -1);
+			for (size_t i = 0; i < m; ++i) {
+				const CellPoint &p = m_polygon[i], &q = m_polygon[(i + 1) % m];
+				// the cells of the edge box, a cell touching the border of one is kept too
+				const int x0 = GridX(std::min(p[0], q[0])), x1 = GridX(std::max(p[0], q[0]));
+				const int y0 = GridY(std::min(p[1], q[1])), y1 = GridY(std::max(p[1], q[1]));
+				for (int y = y0; y <= y1; ++y) {
+					for (int x = x0; x <= x1; ++x) {
+						if (EdgeCrossesCell(p, q, x, y))
+							m_grid[size_t(y) * m_gridSize + x] = GridBorder;
+					}
+				}
+			}
+			// flood the regions between border cells, one point test per region
+			std::vector<size_t > stack;
+			DPolygon<T> polygon;
+			for (auto &p : m_polygon)
+				polygon.AddPoint(p);
+			for (size_t c = 0; c < cells; ++c) {
+				if (m_grid[c] >= 0)
+					continue;
+				const int cx = static_cast<int >(c % m_gridSize), cy = static_cast<int >(c / m_gridSize);
+				const CellPoint center(static_cast<T >(m_gridOrigin[0] + (cx + 0.5) * m_gridCell[0]), static_cast<T >(m_gridOrigin[1] + (cy + 0.5) * m_gridCell[1]));
+				const signed char side = polygon.IsPointInPolygon(center) == 2 ? GridInside : GridOutside;
+				m_grid[c] = side;
+				stack.push_back(c);
+				while (!stack.empty()) {
+					const size_t s = stack.back();
+					stack.pop_back();
+					const int sx = static_cast<int >(s % m_gridSize), sy = static_cast<int >(s / m_gridSize);
+					const int nx[4] = { sx - 1, sx + 1, sx, sx };
+					const int ny[4] = { sy, sy, sy - 1, sy + 1 };
+					for (int k = 0; k < 4; ++k) {
+						if (nx[k] < 0 || ny[k] < 0 || nx[k] >= m_gridSize || ny[k] >= m_gridSize)
+							continue;
+						const size_t nc = size_t(ny[k]) * m_gridSize + nx[k];
+						if (m_grid[nc] < 0) {
+							m_grid[nc] = side;
+							stack.push_back(nc);
+						}
+					}
+				}
+			}
+		}
+
+		/// @brief true when segment pq meets the closed grid cell (x, y), slightly enlarged
+		bool EdgeCrossesCell(const CellPoint &p, const CellPoint &q, int x, int y) const {
+			const double ex = 1e-9 * m_gridCell[0], ey = 1e-9 * m_gridCell[1];
+			const double lx = m_gridOrigin[0] + x * m_gridCell[0] - ex, hx = m_gridOrigin[0] + (x + 1) * m_gridCell[0] + ex;
+			const double ly = m_gridOrigin[1] + y * m_gridCell[1] - ey, hy = m_gridOrigin[1] + (y + 1) * m_gridCell[1] + ey;
+			// the corners of the cell are not all on one side of the line pq
+			const double dx = double(q[0]) - p[0], dy = double(q[1]) - p[1];
+			const double s0 = dx * (ly - p[1]) - dy * (lx - p[0]);
+			const double s1 = dx * (ly - p[1]) - dy * (hx - p[0]);
+			const double s2 = dx * (hy - p[1]) - dy * (lx - p[0]);
+			const double s3 = dx * (hy - p[1]) - dy * (hx - p[0]);
+			return !((s0 > 0 && s1 > 0 && s2 > 0 && s3 > 0) || (s0 < 0 && s1 < 0 && s2 < 0 && s3 < 0));
+		}
+
+	protected:
+		std::vector<size_t > m_rings;
+		std::vector<size_t > m_offsets;
+		std::vector<CellPoint > m_vertices;
+
+		// polygon clipping
+		std::vector<CellPoint > m_polygon;
+		const std::vector<CellPoint > *m_clip = nullptr;
+		std::vector<signed char > m_grid;
+		int m_gridSize = 0;
+		Vertex m_gridOrigin;
+		Vertex m_gridCell;
+	};
+};
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef _DAMONS_VOXELFILTER_H_
+#define _DAMONS_VOXELFILTER_H_
+
+#include "DamonsPoint.h"
+#include "DamonsBox.h"
+#include "DamonsParallel.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+namespace DGraphic {
+
+	/// class DVoxelDownsampler
+	/// @breif voxel grid subsampling of point clouds, fed chunk by chunk
+	///
+	/// the grid is laid over a bounding box known in advance (e.g. from the
+	/// file header or a previous pass), every point gets an integer key made
+	/// of its packed voxel coordinates. a chunk is sorted by key with a
+	/// parallel radix sort, the runs of equal keys are reduced in parallel and
+	/// the per voxel sums are merged into the key sorted result. only the
+	/// current chunk and one accumulator per occupied voxel are in memory, so
+	/// the input can be streamed in a single pass.
+	///
+	/// a voxel yields one point: the centroid of its points, or the point
+	/// closest to the voxel center (the centroid is not known until the end of
+	/// the stream). normals, colors and scalars are averaged; normals are
+	/// summed sign aligned so unoriented normals do not cancel out.
+	///
+	/// @tparam T type of point data.
+	template<class T = float>
+	class DVoxelDownsampler
+	{
+	public:
+		enum SampleMode { SAMPLE_CENTROID, SAMPLE_NEAREST_CENTER };
+
+		/// @brief create a downsampler
+		///
+		/// @param box bounding box of all the points, outer points are clamped to it
+		/// @param voxelSize edge length of the voxels
+		/// @param mode position of the output points
+		DVoxelDownsampler(const DBox<double> &box, const double &voxelSize, SampleMode mode = SAMPLE_CENTROID)
+			: m_size(voxelSize), m_mode(mode), m_normals(false), m_colors(false), m_scalars(0) {
+			assert(voxelSize > 0);
+			unsigned int total = 0;
+			for (int a = 0; a < 3; ++a) {
+				m_origin[a] = box.GetMin(a);
+				const double extent = std::max(0.0, box.GetMax(a) - box.GetMin(a));
+				m_dim[a] = static_cast<uint64_t>(std::floor(extent / voxelSize)) + 1;
+				m_bits[a] = 0;
+				while ((uint64_t(1) << m_bits[a]) < m_dim[a])
+					++m_bits[a];
+				m_shift[a] = total;
+				total += m_bits[a];
+			}
+			// voxel coordinates must fit in the 64 bit key
+			assert(total <= 64);
+			m_keyBits = total;
+		}
+		~DVoxelDownsampler() {
+		}
+
+	public:
+		/// @brief declare the attributes carried by the points, call before AddPoints
+		///
+		/// @param normals points have normals
+		/// @param colors points have r,g,b colors
+		/// @param scalarCount number of scalar values per point
+		void SetAttributes(bool normals, bool colors, unsigned int scalarCount) {
+			assert(m_cells.keys.empty());
+			m_normals = normals;
+			m_colors = colors;
+			m_scalars = scalarCount;
+		}
+
+		/// @brief add a chunk of points
+		///
+		/// @param xyz coordinates, 3 per point
+		/// @param count number of points
+		/// @param normals 3 per point, needed when declared in SetAttributes
+		/// @param colors 3 per point, needed when declared in SetAttributes
+		/// @param scalars one array of count values per declared scalar
+		void AddPoints(const T *xyz, size_t count, const T *normals = nullptr, const unsigned char *colors = nullptr, const T * const *scalars = nullptr) {
+			if (count == 0)
+				return;
+			assert(!m_normals || normals);
+			assert(!m_colors || colors);
+			assert(m_scalars == 0 || scalars);
+
+			std::vector<uint64_t > keys(count);
+			std::vector<unsigned int > order(count);
+			ParallelFor(0, count, [&](size_t i) {
+				keys[i] = Key(&xyz[3 * i]);
+				order[i] = static_cast<unsigned int>(i);
+			}, 1 << 14);
+			ParallelRadixSort(keys, order, m_keyBits);
+
+			std::vector<size_t > runs;
+			runs.push_back(0);
+			for (size_t i = 1; i < count; ++i) {
+				if (keys[i] != keys[i - 1])
+					runs.push_back(i);
+			}
+			runs.push_back(count);
+
+			Cells chunk;
+			chunk.Resize(runs.size() - 1, m_normals, m_colors, m_scalars);
+			ParallelFor(0, runs.size() - 1, [&](size_t r) {
+				chunk.keys[r] = keys[runs[r]];
+				chunk.count[r] = 0;
+				T center[3];
+				Center(chunk.keys[r], center);
+				chunk.nearestD2[r] = std::numeric_limits<T>::max();
+				for (size_t i = runs[r]; i < runs[r + 1]; ++i) {
+					const size_t id = order[i];
+					const T *p = &xyz[3 * id];
+					++chunk.count[r];
+					T d2 = 0;
+					for (int a = 0; a < 3; ++a) {
+						chunk.sum[3 * r + a] += p[a];
+						d2 += (p[a] - center[a]) * (p[a] - center[a]);
+					}
+					if (d2 < chunk.nearestD2[r]) {
+						chunk.nearestD2[r] = d2;
+						for (int a = 0; a < 3; ++a)
+							chunk.nearest[3 * r + a] = p[a];
+					}
+					if (m_normals)
+						AddNormal(&chunk.normal[3 * r], &normals[3 * id], 1.0);
+					if (m_colors) {
+						for (int a = 0; a < 3; ++a)
+							chunk.color[3 * r + a] += colors[3 * id + a];
+					}
+					for (unsigned int s = 0; s < m_scalars; ++s)
+						chunk.scalar[m_scalars * r + s] += scalars[s][id];
+				}
+			}, 256);
+
+			Merge(chunk);
+		}
+
+		/// @brief get the number of occupied voxels so far
+		size_t GetVoxelCount() const { return m_cells.keys.size(); }
+
+		/// @brief get the key bit count used by the radix sort
+		unsigned int GetKeyBits() const { return m_keyBits; }
+
+		/// @brief get one point per occupied voxel, in key order
+		///
+		/// @param xyz coordinates as return, 3 per point
+		/// @param normals unit normals as return (zero if they cancelled), may be null
+		/// @param colors averaged colors as return, may be null
+		/// @param scalars averaged scalars as return, one array per scalar, may be null
+		void GetResult(std::vector<T > &xyz, std::vector<T > *normals = nullptr, std::vector<unsigned char > *colors = nullptr, std::vector< std::vector<T > > *scalars = nullptr) const {
+			const size_t n = m_cells.keys.size();
+			xyz.resize(3 * n);
+			if (normals && m_normals)
+				normals->resize(3 * n);
+			if (colors && m_colors)
+				colors->resize(3 * n);
+			if (scalars && m_scalars) {
+				scalars->resize(m_scalars);
+				for (auto &s : *scalars)
+					s.resize(n);
+			}
+
+			ParallelFor(0, n, [&](size_t v) {
+				const double inv = 1.0 / m_cells.count[v];
+				for (int a = 0; a < 3; ++a)
+					xyz[3 * v + a] = m_mode == SAMPLE_CENTROID ? static_cast<T>(m_cells.sum[3 * v + a] * inv) : m_cells.nearest[3 * v + a];
+				if (normals && m_normals) {
+					const double *nv = &m_cells.normal[3 * v];
+					const double len = std::sqrt(nv[0] * nv[0] + nv[1] * nv[1] + nv[2] * nv[2]);
+					const double s = len > 0 ? 1.0 / len : 0.0;
+					for (int a = 0; a < 3; ++a)
+						(*normals)[3 * v + a] = static_cast<T>(nv[a] * s);
+				}
+				if (colors && m_colors) {
+					for (int a = 0; a < 3; ++a)
+						(*colors)[3 * v + a] = static_cast<unsigned char>(std::min(255.0, m_cells.color[3 * v + a] * inv + 0.5));
+				}
+				if (scalars) {
+					for (unsigned int s = 0; s < m_scalars; ++s)
+						(*scalars)[s][v] = static_cast<T>(m_cells.scalar[m_scalars * v + s] * inv);
+				}
+			}, 4096);
+		}
+
+	protected:
+		/// per voxel accumulators, sorted by key
+		struct Cells {
+			std::vector<uint64_t > keys;
+			std::vector<unsigned int > count;
+			std::vector<double > sum;
+			std::vector<double > normal;
+			std::vector<double > color;
+			std::vector<double > scalar;
+			std::vector<T > nearest;
+			std::vector<T > nearestD2;
+
+			void Resize(size_t n, bool normals, bool colors, unsigned int scalars) {
+				keys.resize(n);
+				count.resize(n, 0);
+				sum.resize(3 * n, 0.0);
+				if (normals)
+					normal.resize(3 * n, 0.0);
+				if (colors)
+					color.resize(3 * n, 0.0);
+				scalar.resize(scalars * n, 0.0);
+				nearest.resize(3 * n);
+				nearestD2.resize(n);
+			}
+		};
+
+		/// @brief packed voxel coordinates of a point
+		uint64_t Key(const T *p) const {
+			uint64_t key = 0;
+			for (int a = 0; a < 3; ++a) {
+				double c = std::floor((p[a] - m_origin[a]) / m_size);
+				c = std::min(std::max(c, 0.0), double(m_dim[a] - 1));
+				key |= static_cast<uint64_t>(c) << m_shift[a];
+			}
+			return key;
+		}
+
+		/// @brief center of the voxel with this key
+		void Center(uint64_t key, T *c) const {
+			for (int a = 0; a < 3; ++a) {
+				const uint64_t i = (key >> m_shift[a]) & ((uint64_t(1) << m_bits[a]) - 1);
+				c[a] = static_cast<T>(m_origin[a] + (i + 0.5) * m_size);
+			}
+		}
+
+		/// @brief add a normal to a sum, flipped to agree with it
+		static void AddNormal(double *sum, const T *nrm, double weight) {
+			const double dot = sum[0] * nrm[0] + sum[1] * nrm[1] + sum[2] * nrm[2];
+			const double s = dot < 0 ? -weight : weight;
+			sum[0] += s * nrm[0];
+			sum[1] += s * nrm[1];
+			sum[2] += s * nrm[2];
+		}
+
+		/// @brief copy voxel i of src into voxel j of dst, or add it when add is set
+		void Combine(Cells &dst, size_t j, const Cells &src, size_t i, bool add) const {
+			if (!add) {
+				dst.keys[j] = src.keys[i];
+				dst.count[j] = 0;
+				dst.nearestD2[j] = std::numeric_limits<T>::max();
+			}
+			dst.count[j] += src.count[i];
+			for (int a = 0; a < 3; ++a)
+				dst.sum[3 * j + a] += src.sum[3 * i + a];
+			if (m_colors) {
+				for (int a = 0; a < 3; ++a)
+					dst.color[3 * j + a] += src.color[3 * i + a];
+			}
+			if (m_normals) {
+				const double *sn = &src.normal[3 * i];
+				double *dn = &dst.normal[3 * j];
+				const double s = (dn[0] * sn[0] + dn[1] * sn[1] + dn[2] * sn[2]) < 0 ? -1.0 : 1.0;
+				for (int a = 0; a < 3; ++a)
+					dn[a] += s * sn[a];
+			}
+			for (unsigned int s = 0; s < m_scalars; ++s)
+				dst.scalar[m_scalars * j + s] += src.scalar[m_scalars * i + s];
+			if (src.nearestD2[i] < dst.nearestD2[j]) {
+				dst.nearestD2[j] = src.nearestD2[i];
+				for (int a = 0; a < 3; ++a)
+					dst.nearest[3 * j + a] = src.nearest[3 * i + a];
+			}
+		}
+
+		/// @brief merge the voxels of a chunk into the result, both sorted by key
+		void Merge(const Cells &chunk) {
+			if (m_cells.keys.empty()) {
+				m_cells = chunk;
+				return;
+			}
+
+			size_t common = 0;
+			{
+				size_t i = 0, j = 0;
+				while (i < m_cells.keys.size() && j < chunk.keys.size()) {
+					if (m_cells.keys[i] < chunk.keys[j]) ++i;
+					else if (chunk.keys[j] < m_cells.keys[i]) ++j;
+					else { ++common; ++i; ++j; }
+				}
+			}
+
+			Cells merged;
+			merged.Resize(m_cells.keys.size() + chunk.keys.size() - common, m_normals, m_colors, m_scalars);
+			size_t i = 0, j = 0, o = 0;
+			while (i < m_cells.keys.size() || j < chunk.keys.size()) {
+				if (j == chunk.keys.size() || (i < m_cells.keys.size() && m_cells.keys[i] < chunk.keys[j]))
+					Combine(merged, o++, m_cells, i++, false);
+				else if (i == m_cells.keys.size() || chunk.keys[j] < m_cells.keys[i])
+					Combine(merged, o++, chunk, j++, false);
+				else {
+					Combine(merged, o, m_cells, i++, false);
+					Combine(merged, o++, chunk, j++, true);
+				}
+			}
+			std::swap(m_cells, merged);
+		}
+
+	protected:
+		double m_origin[3];
+		double m_size;
+		uint64_t m_dim[3];
+		unsigned int m_bits[3];
+		unsigned int m_shift[3];
+		unsigned int m_keyBits;
+		SampleMode m_mode;
+		bool m_normals;
+		bool m_colors;
+		unsigned int m_scalars;
+		Cells m_cells;
+	};
+};
+#endif
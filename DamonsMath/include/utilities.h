@@ -112,6 +112,74 @@ namespace DMath {
 		return x;
 	}
 
+	/// @brief Interleave the low 21 bits of three coordinates into a 3D Morton code.
+	///
+	/// Bit b of i, j and k goes to bit 3b, 3b + 1 and 3b + 2 of the code, so
+	/// sorting codes walks a Z order curve and every octree cell is a
+	/// contiguous run of codes sharing a prefix.
+	///
+	/// @param i,j,k cell coordinates, below 2^21.
+	/// @return Morton code.
+	inline uint64_t MortonEncode3(uint32_t i, uint32_t j, uint32_t k) {
+		uint64_t c[3] = { i, j, k };
+		for (int a = 0; a < 3; ++a) {
+			uint64_t x = c[a] & 0x1fffff;
+			x = (x | x << 32) & 0x1f00000000ffffULL;
+			x = (x | x << 16) & 0x1f0000ff0000ffULL;
+			x = (x | x << 8) & 0x100f00f00f00f00fULL;
+			x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+			x = (x | x << 2) & 0x1249249249249249ULL;
+			c[a] = x;
+		}
+		return c[0] | (c[1] << 1) | (c[2] << 2);
+	}
+
+	/// @brief Split a 3D Morton code back into its coordinates.
+	///
+	/// @param code Morton code.
+	/// @param i,j,k coordinates as return.
+	inline void MortonDecode3(uint64_t code, uint32_t &i, uint32_t &j, uint32_t &k) {
+		uint32_t *c[3] = { &i, &j, &k };
+		for (int a = 0; a < 3; ++a) {
+			uint64_t x = (code >> a) & 0x1249249249249249ULL;
+			x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ULL;
+			x = (x ^ (x >> 4)) & 0x100f00f00f00f00fULL;
+			x = (x ^ (x >> 8)) & 0x1f0000ff0000ffULL;
+			x = (x ^ (x >> 16)) & 0x1f00000000ffffULL;
+			x = (x ^ (x >> 32)) & 0x1fffff;
+			*c[a] = static_cast<uint32_t>(x);
+		}
+	}
+
+	/// @brief Position of a cell along a 2D Hilbert curve.
+	///
+	/// Unlike the Z order, consecutive positions are always neighboring cells,
+	/// which keeps points sorted by it close to each other.
+	///
+	/// @param x,y cell coordinates, below 2^order.
+	/// @param order bits per axis, at most 31.
+	/// @return Hilbert index.
+	inline uint64_t HilbertEncode2(uint32_t x, uint32_t y, unsigned int order) {
+		const uint32_t n = uint32_t(1) << order;
+		uint64_t d = 0;
+		for (uint32_t s = n >> 1; s > 0; s >>= 1) {
+			const uint32_t rx = (x & s) ? 1 : 0;
+			const uint32_t ry = (y & s) ? 1 : 0;
+			d += uint64_t(s) * s * ((3 * rx) ^ ry);
+			// rotate the quadrant so the sub curve starts at its origin
+			if (ry == 0) {
+				if (rx == 1) {
+					x = n - 1 - x;
+					y = n - 1 - y;
+				}
+				const uint32_t t = x;
+				x = y;
+				y = t;
+			}
+		}
+		return d;
+	}
+
 	/// @brief  Generate a random value of type T.
 	/// @anchor mathfu_Random
 	///
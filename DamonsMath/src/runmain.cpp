@@ -1,9 +1,549 @@
 #include <iostream>
+#include <map>
+#include <random>
+#include <cmath>
 #include "..\include\DamonsBox.h"
 #include "..\include\DamonsPoint.h"
+#include "..\include\DamonsPoisson.h"
+#include "..\include\DamonsIsoSurface.h"
+#include "..\include\DamonsDelaunay.h"
+#include "..\include\DamonsConstrainedDelaunay.h"
+#include "..\include\DamonsVoronoi.h"
+#include "..\include\DamonsSpatialGrid.h"
+#include "..\include\DamonsKdTree.h"
+#include "..\include\DamonsSegmentIntersector.h"
+#include "..\include\DamonsPreparedPolygon.h"
+#include "..\include\DamonsPolygonClipper.h"
+#include "..\include\DamonsPolygonOffset.h"
+#include <array>
+#include <algorithm>
+
+// every edge has exactly two triangles, one in each direction
+static bool IsClosedManifold(const std::vector<unsigned int > &triangles, size_t &bad) {
+	std::map<std::pair<unsigned int, unsigned int >, int > edges;
+	for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+		for (int k = 0; k < 3; ++k) {
+			const unsigned int a = triangles[t + k], b = triangles[t + (k + 1) % 3];
+			edges[std::make_pair(a, b)] += 1;
+		}
+	}
+	bad = 0;
+	for (auto &e : edges) {
+		auto it = edges.find(std::make_pair(e.first.second, e.first.first));
+		if (e.second != 1 || it == edges.end() || it->second != 1)
+			++bad;
+	}
+	return bad == 0;
+}
+
+static double Volume(const std::vector<float > &vertices, const std::vector<unsigned int > &triangles) {
+	double volume = 0;
+	for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+		const float *a = &vertices[3 * triangles[t]], *b = &vertices[3 * triangles[t + 1]], *c = &vertices[3 * triangles[t + 2]];
+		volume += a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) + a[2] * (b[0] * c[1] - b[1] * c[0]);
+	}
+	return volume / 6.0;
+}
+
+// reconstruct points sampled on the unit sphere
+static bool CheckPoissonSphere(size_t count, unsigned int depth) {
+	std::mt19937 random(7);
+	std::normal_distribution<float > normal;
+	std::vector<float > xyz(3 * count);
+	for (size_t i = 0; i < count; ++i) {
+		float p[3] = { normal(random), normal(random), normal(random) };
+		const float r = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		for (int a = 0; a < 3; ++a)
+			xyz[3 * i + a] = p[a] / r;
+	}
+	DGraphic::DPoissonReconstruction<float> poisson(xyz.data(), xyz.data(), count);
+	DGraphic::DPoissonReconstruction<float>::Parameters params;
+	params.depth = depth;
+	std::vector<float > vertices;
+	std::vector<unsigned int > triangles;
+	poisson.Reconstruct(params, vertices, triangles);
+
+	size_t bad = 0;
+	const bool closed = !triangles.empty() && IsClosedManifold(triangles, bad);
+	const double volume = Volume(vertices, triangles), sphere = 4.0 / 3.0 * 3.14159265358979;
+	const bool ok = closed && std::fabs(volume - sphere) < 0.05 * sphere;
+	std::cout << "poisson sphere " << count << " points depth " << depth << ": " << triangles.size() / 3
+		<< " triangles, " << bad << " bad edges, volume " << volume << (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
+// marching cubes on random noise, every ambiguous face case shows up
+static bool CheckMarchingCubesNoise() {
+	const unsigned int n = 40;
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float > uniform(-1.0f, 1.0f);
+	std::vector<float > values(n * n * n);
+	for (auto &v : values)
+		v = uniform(random);
+	const double origin[3] = { 0, 0, 0 }, spacing[3] = { 1, 1, 1 };
+	DGraphic::DIsoSurfaceExtractor<float> extractor(values.data(), n, n, n, origin, spacing);
+	DGraphic::DIsoSurfaceExtractor<float>::Parameters params;
+	std::vector<float > vertices;
+	std::vector<unsigned int > triangles;
+	extractor.Extract(0.0f, params, vertices, triangles);
+
+	size_t bad = 0;
+	const bool ok = IsClosedManifold(triangles, bad);
+	std::cout << "marching cubes noise: " << triangles.size() / 3 << " triangles, " << bad << " bad edges"
+		<< (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
+static double SquaredBoxDistance(const DGraphic::DBox<double> &box, const DGraphic::DPoint<double> &p) {
+	double d2 = 0;
+	for (int a = 0; a < 3; ++a) {
+		const double d = std::max(box.GetMin(a) - p[a], std::max(0.0, p[a] - box.GetMax(a)));
+		d2 += d * d;
+	}
+	return d2;
+}
+
+// radius queries and pairs against brute force, on a dense grid then on a hashed one
+static bool CheckSpatialGrid() {
+	std::mt19937 random(3);
+	std::uniform_real_distribution<double > uniform(0, 100);
+	std::vector<DGraphic::DPoint<double> > points;
+	std::vector<DGraphic::DBox<double> > boxes;
+	for (int i = 0; i < 2000; ++i) {
+		const DGraphic::DPoint<double> p(uniform(random), uniform(random), uniform(random));
+		// a few wide boxes go past the bucket limit
+		const double w = i % 50 == 0 ? uniform(random) * 0.8 : 0.5;
+		points.push_back(p);
+		boxes.push_back(DGraphic::DBox<double>(p, DGraphic::DPoint<double>(p[0] + w, p[1] + w, p[2] + w)));
+	}
+	std::vector<DGraphic::DPoint<double> > queries;
+	for (int q = 0; q < 200; ++q)
+		queries.push_back(DGraphic::DPoint<double>(uniform(random), uniform(random), uniform(random)));
+	const DGraphic::DBox<double> box(DGraphic::DPoint<double>(0, 0, 0), DGraphic::DPoint<double>(200, 200, 200));
+	const double r = 6, eps = 1;
+
+	bool ok = true;
+	for (double cellSize : { 4.0, 0.01 }) {
+		DGraphic::DSpatialGrid<double> pointGrid(box, cellSize), boxGrid(box, cellSize);
+		pointGrid.BuildFromPoints(points);
+		boxGrid.BuildFromBoxes(boxes);
+		size_t bad = 0;
+		for (auto &p : queries) {
+			std::vector<unsigned int > found, boxFound, expected, boxExpected;
+			pointGrid.RadiusSearch(p, r, found);
+			boxGrid.RadiusSearch(p, r, boxFound);
+			for (unsigned int i = 0; i < points.size(); ++i) {
+				const double dx = points[i][0] - p[0], dy = points[i][1] - p[1], dz = points[i][2] - p[2];
+				if (dx * dx + dy * dy + dz * dz <= r * r)
+					expected.push_back(i);
+				if (SquaredBoxDistance(boxes[i], p) <= r * r)
+					boxExpected.push_back(i);
+			}
+			std::sort(found.begin(), found.end());
+			std::sort(boxFound.begin(), boxFound.end());
+			bad += found != expected || boxFound != boxExpected;
+		}
+		std::vector<DGraphic::DSpatialGrid<double>::ItemPair > pairs;
+		boxGrid.PairsWithin(eps, pairs);
+		size_t expectedPairs = 0;
+		for (size_t i = 0; i < boxes.size(); ++i) {
+			for (size_t j = i + 1; j < boxes.size(); ++j) {
+				bool overlap = true;
+				for (int a = 0; a < 3; ++a)
+					overlap = overlap && boxes[i].GetMax(a) + eps >= boxes[j].GetMin(a) && boxes[j].GetMax(a) + eps >= boxes[i].GetMin(a);
+				expectedPairs += overlap;
+			}
+		}
+		const bool pass = bad == 0 && pairs.size() == expectedPairs;
+		std::cout << "spatial grid" << (pointGrid.IsHashed() ? " hashed" : "") << ": " << bad << " bad queries, "
+			<< pairs.size() << " / " << expectedPairs << " pairs" << (pass ? " passed" : " FAILED") << std::endl;
+		ok = ok && pass;
+	}
+	return ok;
+}
+
+// batched kNN and radius search against brute force, on a lattice with ties and duplicates
+static bool CheckKdTree() {
+	std::mt19937 random(5);
+	std::uniform_int_distribution<int > lattice(0, 20);
+	std::vector<double > xyz, queries;
+	for (int i = 0; i < 3 * 3000; ++i)
+		xyz.push_back(lattice(random) * 0.5);
+	for (int i = 0; i < 3 * 300; ++i)
+		queries.push_back(lattice(random) * 0.5 + 0.25);
+	const size_t n = xyz.size() / 3, nq = queries.size() / 3;
+	const unsigned int k = 12;
+	const double r = 1.5;
+	DGraphic::DKdTree<double> tree(xyz.data(), n);
+	std::vector<unsigned int > indices;
+	std::vector<double > sqrDists;
+	tree.KnnSearch(queries.data(), nq, k, indices, sqrDists);
+
+	size_t bad = 0;
+	std::vector<double > all(n);
+	for (size_t q = 0; q < nq; ++q) {
+		const double *p = &queries[3 * q];
+		std::vector<unsigned int > inside, found;
+		for (size_t i = 0; i < n; ++i) {
+			const double dx = xyz[3 * i] - p[0], dy = xyz[3 * i + 1] - p[1], dz = xyz[3 * i + 2] - p[2];
+			all[i] = dx * dx + dy * dy + dz * dz;
+			if (all[i] <= r * r)
+				inside.push_back(static_cast<unsigned int >(i));
+		}
+		tree.RadiusSearch(p, r, found);
+		std::sort(found.begin(), found.end());
+		// ties may give other ids, the distances are the same
+		std::partial_sort(all.begin(), all.begin() + k, all.end());
+		bool same = found == inside;
+		for (unsigned int j = 0; j < k; ++j)
+			same = same && sqrDists[q * k + j] == all[j];
+		bad += !same;
+	}
+	const bool ok = bad == 0;
+	std::cout << "kd-tree: " << nq << " queries, " << bad << " bad" << (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
+// triangles of a triangulation by their corner coordinates, smallest corner first
+static std::vector<std::array<double, 6> > TriangleCoordinates(const DDelaunay<double> &delaunay) {
+	std::vector<std::array<double, 6> > triangles(delaunay.GetTriangleCount());
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		unsigned int v[3];
+		delaunay.GetTriangle(t, v[0], v[1], v[2]);
+		int first = 0;
+		for (int k = 1; k < 3; ++k) {
+			const DVector<double, 2> &p = delaunay.GetPoint(v[k]), &q = delaunay.GetPoint(v[first]);
+			if (p.x() < q.x() || (p.x() == q.x() && p.y() < q.y()))
+				first = k;
+		}
+		for (int k = 0; k < 3; ++k) {
+			const DVector<double, 2> &p = delaunay.GetPoint(v[(first + k) % 3]);
+			triangles[t][2 * k] = p.x() + 0.0;
+			triangles[t][2 * k + 1] = p.y() + 0.0;
+		}
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// the strips give the triangles of the serial triangulation, with duplicates, -0 and cocircular points
+static bool CheckParallelDelaunay() {
+	std::mt19937 random(1);
+	std::normal_distribution<double > normal;
+	std::vector<double > coords;
+	for (int i = 0; i < 5000; ++i) {
+		coords.push_back(std::round(normal(random) * 20) / 2);
+		coords.push_back(std::round(normal(random) * 20) / 2);
+	}
+	// -0 copies of the points on the axes
+	for (size_t i = 0; i < 10000; i += 2) {
+		if (coords[i] == 0 || coords[i + 1] == 0) {
+			coords.push_back(coords[i] == 0 ? -0.0 : coords[i]);
+			coords.push_back(coords[i + 1] == 0 ? -0.0 : coords[i + 1]);
+		}
+	}
+	DDelaunay<double> serial, parallel;
+	serial.SetPoints(coords.data(), coords.size() / 2);
+	parallel.SetPoints(coords.data(), coords.size() / 2);
+	serial.DelaunayTriangulate();
+	parallel.ParallelDelaunayTriangulate(2);
+	const bool ok = serial.GetTriangleCount() > 0 && TriangleCoordinates(serial) == TriangleCoordinates(parallel);
+	std::cout << "parallel delaunay: " << serial.GetTriangleCount() << " / " << parallel.GetTriangleCount()
+		<< " triangles" << (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
+static double Orient(const DVector<double, 2> &a, const DVector<double, 2> &b, const DVector<double, 2> &c) {
+	const double pa[2] = { a[0], a[1] }, pb[2] = { b[0], b[1] }, pc[2] = { c[0], c[1] };
+	return DMath::Orient2D(pa, pb, pc);
+}
+
+// how two segments meet, the codes of DSegmentIntersector
+static int SegmentMeet(const DVector<double, 2> &a, const DVector<double, 2> &b, const DVector<double, 2> &c, const DVector<double, 2> &d) {
+	const double o1 = Orient(a, b, c), o2 = Orient(a, b, d), o3 = Orient(c, d, a), o4 = Orient(c, d, b);
+	if (o1 == 0 && o2 == 0 && o3 == 0 && o4 == 0) {
+		const int axis = a[0] != b[0] ? 0 : 1;
+		const double lo = std::max(std::min(a[axis], b[axis]), std::min(c[axis], d[axis]));
+		const double hi = std::min(std::max(a[axis], b[axis]), std::max(c[axis], d[axis]));
+		return lo > hi ? 0 : (lo == hi ? 1 : 2);
+	}
+	if ((o1 > 0 && o2 > 0) || (o1 < 0 && o2 < 0) || (o3 > 0 && o4 > 0) || (o3 < 0 && o4 < 0))
+		return 0;
+	return o1 == 0 || o2 == 0 || o3 == 0 || o4 == 0 ? 1 : 3;
+}
+
+// every pair of segments against brute force, random ones then lattice ones which overlap and share ends
+static bool CheckSegmentIntersector() {
+	std::mt19937 random(13);
+	std::uniform_real_distribution<double > uniform(0, 1);
+	std::uniform_int_distribution<int > lattice(0, 6);
+	bool ok = true;
+	for (int mode = 0; mode < 2; ++mode) {
+		std::vector<DVector<double, 2> > ends;
+		for (int i = 0; i < 2 * 600; ++i) {
+			if (mode == 0)
+				ends.push_back(DVector<double, 2>(uniform(random), uniform(random)));
+			else
+				ends.push_back(DVector<double, 2>(lattice(random), lattice(random)));
+		}
+		DGraphic::DSegmentIntersector<double> sweep;
+		for (size_t i = 0; i < ends.size(); i += 2)
+			sweep.AddSegment(ends[i], ends[i + 1]);
+		std::vector<DGraphic::DSegmentIntersector<double>::Intersection > hits;
+		sweep.FindIntersections(hits, true);
+		std::vector<std::array<unsigned int, 3> > found, expected;
+		for (auto &h : hits)
+			found.push_back({ h.first, h.second, static_cast<unsigned int >(h.type) });
+		bool crossing = false;
+		for (unsigned int i = 0; i < ends.size() / 2; ++i) {
+			for (unsigned int j = i + 1; j < ends.size() / 2; ++j) {
+				if (ends[2 * i] == ends[2 * i + 1] || ends[2 * j] == ends[2 * j + 1])
+					continue;
+				const int type = SegmentMeet(ends[2 * i], ends[2 * i + 1], ends[2 * j], ends[2 * j + 1]);
+				if (type != 0)
+					expected.push_back({ i, j, static_cast<unsigned int >(type) });
+				crossing = crossing || type > 1;
+			}
+		}
+		std::sort(found.begin(), found.end());
+		const bool pass = found == expected && sweep.HasCrossing() == crossing;
+		std::cout << "segment intersector " << (mode == 0 ? "random" : "lattice") << ": " << found.size() << " / "
+			<< expected.size() << " pairs" << (pass ? " passed" : " FAILED") << std::endl;
+		ok = ok && pass;
+	}
+	return ok;
+}
+
+// the codes of DPolygon::IsPointInPolygon, on lattice polygons queried at their vertices, on their edges and around
+static bool CheckPreparedPolygon() {
+	std::mt19937 random(17);
+	size_t bad = 0, onEdge = 0, total = 0;
+	for (int t = 0; t < 60; ++t) {
+		const int n = 3 + t % 20, size = 3 + t % 6;
+		std::uniform_int_distribution<int > lattice(0, size);
+		DGraphic::DPolygon<double> polygon;
+		for (int i = 0; i < n; ++i)
+			polygon.AddPoint(lattice(random), lattice(random));
+		DGraphic::DPreparedPolygon<double> prepared(polygon);
+
+		std::vector<double > coords;
+		for (int i = -2; i <= 4 * size + 2; ++i) {
+			for (int j = -2; j <= 4 * size + 2; ++j) {
+				coords.push_back(i * 0.25);
+				coords.push_back(j * 0.25);
+			}
+		}
+		const unsigned int sz = polygon.GetPolygonPointSize();
+		for (unsigned int i = 0; i < sz; ++i) {
+			const DVector<double, 2> &p = polygon.GetPolygonPoint(i), &q = polygon.GetPolygonPoint((i + 1) % sz);
+			coords.push_back(p[0] + (q[0] - p[0]) / 3);
+			coords.push_back(p[1] + (q[1] - p[1]) / 3);
+		}
+		std::vector<unsigned char > codes;
+		prepared.Classify(coords.data(), coords.size() / 2, codes);
+		for (size_t i = 0; i < codes.size(); ++i) {
+			const int expected = polygon.IsPointInPolygon(coords[2 * i], coords[2 * i + 1]);
+			bad += codes[i] != expected || prepared.IsPointInPolygon(coords[2 * i], coords[2 * i + 1]) != expected;
+			onEdge += expected == 1;
+		}
+		total += codes.size();
+	}
+	const bool ok = bad == 0;
+	std::cout << "prepared polygon: " << total << " points, " << onEdge << " on edges, " << bad << " bad"
+		<< (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
+static DGraphic::DPolygon<double> RegularPolygon(double cx, double cy, double radius, int n) {
+	DGraphic::DPolygon<double> ring;
+	for (int i = 0; i < n; ++i) {
+		const double a = 2 * 3.14159265358979 * i / n;
+		ring.AddPoint(cx + radius * std::cos(a), cy + radius * std::sin(a));
+	}
+	return ring;
+}
+
+static double RingArea(const DGraphic::DPolygon<double> &ring) {
+	double area = 0;
+	const unsigned int n = ring.GetPolygonPointSize();
+	for (unsigned int i = 0; i < n; ++i) {
+		const DVector<double, 2> &p = ring.GetPolygonPoint(i), &q = ring.GetPolygonPoint((i + 1) % n);
+		area += p.x() * q.y() - q.x() * p.y();
+	}
+	return std::fabs(area) / 2;
+}
+
+// the triangles cover a square with a hole and an island in the hole, random points and a breakline inside
+static bool CheckConstrainedDomain() {
+	DConstrainedDelaunay<double> cdt;
+	DGraphic::DPolygon<double> square, hole = RegularPolygon(5, 5, 3, 40), island = RegularPolygon(5, 5, 1, 12);
+	square.AddPoint(0, 0);
+	square.AddPoint(10, 0);
+	square.AddPoint(10, 10);
+	square.AddPoint(0, 10);
+	cdt.AddPolygon(square);
+	cdt.AddPolygon(hole);
+	cdt.AddPolygon(island);
+	std::mt19937 random(9);
+	std::uniform_real_distribution<double > uniform(0, 10);
+	for (int i = 0; i < 2000; ++i)
+		cdt.AddPoint(DVector<double, 2>(uniform(random), uniform(random)));
+	// across the hole, the pieces in it go with the hole
+	cdt.AddSegment(cdt.AddPoint(DVector<double, 2>(0.5, 0.5)), cdt.AddPoint(DVector<double, 2>(9.5, 9.5)));
+	cdt.ConstrainedTriangulate();
+
+	double area = 0;
+	size_t flat = 0;
+	for (size_t t = 0; t < cdt.GetTriangleCount(); ++t) {
+		unsigned int v[3];
+		cdt.GetTriangle(t, v[0], v[1], v[2]);
+		const DVector<double, 2> &a = cdt.GetPoint(v[0]), &b = cdt.GetPoint(v[1]), &c = cdt.GetPoint(v[2]);
+		const double twice = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+		flat += twice <= 0;
+		area += twice / 2;
+	}
+	const double expected = 100 - RingArea(hole) + RingArea(island);
+	const bool ok = flat == 0 && std::fabs(area - expected) < 1e-9 * expected;
+	std::cout << "constrained delaunay: " << cdt.GetTriangleCount() << " triangles, " << flat << " flat, area "
+		<< area << " of " << expected << (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
+typedef DGraphic::DPolygonClipper<double> Clipper;
+
+static double ClipArea(const std::vector<DGraphic::DPolygon<double> > &subjects, const std::vector<DGraphic::DPolygon<double> > &clips, Clipper::ClipType op) {
+	Clipper clipper;
+	clipper.AddPolygons(subjects, Clipper::PolySubject);
+	clipper.AddPolygons(clips, Clipper::PolyClip);
+	std::vector<std::vector<Clipper::ClipPoint > > rings;
+	clipper.Execute(op, rings);
+	// outlines counter clockwise, holes clockwise
+	double area = 0;
+	for (auto &ring : rings) {
+		for (size_t i = 0; i < ring.size(); ++i) {
+			const Clipper::ClipPoint &p = ring[i], &q = ring[(i + 1) % ring.size()];
+			area += (p[0] * q[1] - q[0] * p[1]) / 2;
+		}
+	}
+	return area;
+}
+
+static DGraphic::DPolygon<double> Rectangle(double lx, double ly, double hx, double hy) {
+	DGraphic::DPolygon<double> rectangle;
+	rectangle.AddPoint(lx, ly);
+	rectangle.AddPoint(hx, ly);
+	rectangle.AddPoint(hx, hy);
+	rectangle.AddPoint(lx, hy);
+	return rectangle;
+}
+
+// the areas of the boolean operations and of offsets
+static bool CheckPolygonClipper() {
+	const std::vector<DGraphic::DPolygon<double> > a(1, Rectangle(0, 0, 2, 2)), b(1, Rectangle(1, 1, 3, 3));
+	std::vector<DGraphic::DPolygon<double> > holed(a);
+	holed.push_back(Rectangle(0.5, 0.5, 1.5, 1.5));
+	bool ok = std::fabs(ClipArea(a, b, Clipper::ClipIntersection) - 1) < 1e-9 && std::fabs(ClipArea(a, b, Clipper::ClipUnion) - 7) < 1e-9
+		&& std::fabs(ClipArea(a, b, Clipper::ClipDifference) - 3) < 1e-9 && std::fabs(ClipArea(a, b, Clipper::ClipXor) - 6) < 1e-9
+		&& std::fabs(ClipArea(holed, b, Clipper::ClipIntersection) - 0.75) < 1e-9;
+
+	// random stars: |A u B| + |A n B| = |A| + |B|, the xor and the difference follow
+	std::mt19937 random(19);
+	std::uniform_real_distribution<double > uniform(0.2, 1);
+	size_t bad = 0;
+	for (int t = 0; t < 50; ++t) {
+		std::vector<DGraphic::DPolygon<double> > s(1), c(1);
+		for (int i = 0; i < 40; ++i) {
+			const double angle = 2 * 3.14159265358979 * i / 40, rs = uniform(random), rc = uniform(random);
+			s[0].AddPoint(rs * std::cos(angle), rs * std::sin(angle));
+			c[0].AddPoint(0.3 + rc * std::cos(angle), 0.2 + rc * std::sin(angle));
+		}
+		const double as = RingArea(s[0]), ac = RingArea(c[0]);
+		const double inter = ClipArea(s, c, Clipper::ClipIntersection), uni = ClipArea(s, c, Clipper::ClipUnion);
+		const double diff = ClipArea(s, c, Clipper::ClipDifference), sym = ClipArea(s, c, Clipper::ClipXor);
+		const double tolerance = 1e-9 * (as + ac);
+		bad += !(std::fabs(uni + inter - as - ac) < tolerance && std::fabs(sym - uni + inter) < tolerance && std::fabs(diff - as + inter) < tolerance && inter > 0);
+	}
+
+	// a square moved out and in with miter joins
+	DGraphic::DPolygonOffset<double> offset;
+	offset.AddPolygon(a[0], DGraphic::DPolygonOffset<double>::JoinMiter);
+	std::vector<DGraphic::DPolygon<double> > grown, shrunk;
+	offset.Execute(0.5, grown);
+	offset.Execute(-0.5, shrunk);
+	ok = ok && bad == 0 && grown.size() == 1 && shrunk.size() == 1 && std::fabs(RingArea(grown[0]) - 9) < 1e-9 && std::fabs(RingArea(shrunk[0]) - 1) < 1e-9;
+	std::cout << "polygon clipper: " << bad << " bad random pairs" << (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
+static double CellAreaSum(const DGraphic::DVoronoi<double> &voronoi) {
+	double area = 0;
+	for (size_t i = 0; i < voronoi.GetCellCount(); ++i)
+		area += voronoi.GetCellArea(i);
+	return area;
+}
+
+// the cells cover the clip region, on a grid where all the quads are cocircular
+static bool CheckVoronoiArea() {
+	std::vector<double > coords;
+	for (int i = 0; i < 10; ++i) {
+		for (int j = 0; j < 10; ++j) {
+			coords.push_back((i + 0.5) / 10);
+			coords.push_back((j + 0.5) / 10);
+		}
+	}
+	DDelaunay<double> delaunay;
+	delaunay.SetPoints(coords.data(), coords.size() / 2);
+	delaunay.DelaunayTriangulate();
+
+	DGraphic::DVoronoi<double> voronoi;
+	voronoi.Build(delaunay, DGraphic::DBox<double>(DGraphic::DPoint<double>(0, 0, 0), DGraphic::DPoint<double>(1, 1, 0)));
+	const double box = CellAreaSum(voronoi);
+	DGraphic::DPolygon<double> square, shape;
+	square.AddPoint(0, 0);
+	square.AddPoint(1, 0);
+	square.AddPoint(1, 1);
+	square.AddPoint(0, 1);
+	voronoi.Build(delaunay, square);
+	const double inSquare = CellAreaSum(voronoi);
+	// an L with a slot, the cells along the slot fall apart
+	shape.AddPoint(0, 0);
+	shape.AddPoint(0.44, 0);
+	shape.AddPoint(0.44, 0.3);
+	shape.AddPoint(0.46, 0.3);
+	shape.AddPoint(0.46, 0);
+	shape.AddPoint(1, 0);
+	shape.AddPoint(1, 0.5);
+	shape.AddPoint(0.5, 0.5);
+	shape.AddPoint(0.5, 1);
+	shape.AddPoint(0, 1);
+	voronoi.Build(delaunay, shape);
+	const double inShape = CellAreaSum(voronoi);
+	size_t split = 0;
+	for (size_t i = 0; i < voronoi.GetCellCount(); ++i)
+		split += voronoi.GetCellRingCount(i) > 1;
+
+	const double shapeArea = 0.75 - 0.02 * 0.3;
+	const bool ok = std::fabs(box - 1) < 1e-9 && std::fabs(inSquare - 1) < 1e-9 && std::fabs(inShape - shapeArea) < 1e-9 && split > 0;
+	std::cout << "voronoi area: box " << box << ", square " << inSquare << ", L " << inShape << " of " << shapeArea
+		<< ", " << split << " split cells" << (ok ? " passed" : " FAILED") << std::endl;
+	return ok;
+}
+
 int main() {
 
 	DGraphic::DBox<float> m_box;
+	CheckSpatialGrid();
+	CheckKdTree();
+	CheckParallelDelaunay();
+	CheckConstrainedDomain();
+	CheckSegmentIntersector();
+	CheckPreparedPolygon();
+	CheckPolygonClipper();
+	CheckVoronoiArea();
+	CheckMarchingCubesNoise();
+	CheckPoissonSphere(20000, 8);
+	CheckPoissonSphere(10000, 7);
+	CheckPoissonSphere(50000, 8);
 	system("pause");
 	return 0;
-}
\ No newline at end of file
+}